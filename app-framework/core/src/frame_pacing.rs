@@ -0,0 +1,238 @@
+//! Per-monitor frame timing for [`crate::RenderMode::Predictive`].
+//!
+//! Shift reports every vblank a frame of ours was shown at, which gives the monitor's refresh
+//! phase. Together with how long our recent frames took from `on_render` to Shift's ack, that
+//! tells how late a frame can start and still make the next vblank. A safety margin on top
+//! grows whenever a frame misses and shrinks again while frames land on time.
+
+/// How a presented frame landed relative to the vblank it was rendered for.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum PresentTiming {
+	/// Shown at the vblank it was rendered for.
+	OnTime,
+	/// Shown at least one refresh before the vblank it was rendered for; it was started
+	/// earlier than it had to.
+	Early,
+	/// Shown at least one refresh after the vblank it was rendered for.
+	Missed,
+}
+
+/// When to render a frame, in `CLOCK_MONOTONIC` nanoseconds.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) struct FramePlan {
+	pub render_at_ns: u64,
+	pub target_vblank_ns: u64,
+}
+
+/// Render durations remembered; the slowest of them is what the next frame is assumed to take.
+const RENDER_SAMPLES: usize = 16;
+/// The margin never drops below this.
+const MIN_MARGIN_NS: u64 = 1_000_000;
+
+#[derive(Debug)]
+pub(crate) struct FramePredictor {
+	/// Latest vblank and the refresh period, from `frame_presented`.
+	phase: Option<(u64, u64)>,
+	render_ns: [u64; RENDER_SAMPLES],
+	render_len: usize,
+	render_next: usize,
+	/// Time left between Shift's ack and the vblank, for its own compositing.
+	margin_ns: u64,
+}
+
+impl Default for FramePredictor {
+	fn default() -> Self {
+		Self {
+			phase: None,
+			render_ns: [0; RENDER_SAMPLES],
+			render_len: 0,
+			render_next: 0,
+			margin_ns: 2 * MIN_MARGIN_NS,
+		}
+	}
+}
+
+impl FramePredictor {
+	/// A frame was shown at `vblank_ns` on a monitor refreshing every `refresh_ns`.
+	pub fn presented(&mut self, vblank_ns: u64, refresh_ns: u64) {
+		if refresh_ns == 0 {
+			return;
+		}
+		// Feedback queued behind newer events must not move the phase back.
+		match self.phase {
+			Some((last, _)) if last > vblank_ns => self.phase = Some((last, refresh_ns)),
+			_ => self.phase = Some((vblank_ns, refresh_ns)),
+		}
+	}
+
+	/// A frame took `duration_ns` from `on_render` until Shift acked it.
+	pub fn record_render(&mut self, duration_ns: u64) {
+		self.render_ns[self.render_next] = duration_ns;
+		self.render_next = (self.render_next + 1) % RENDER_SAMPLES;
+		self.render_len = (self.render_len + 1).min(RENDER_SAMPLES);
+	}
+
+	fn render_estimate_ns(&self) -> u64 {
+		self.render_ns[..self.render_len]
+			.iter()
+			.copied()
+			.max()
+			.unwrap_or(0)
+	}
+
+	/// The latest moment a frame requested at `now_ns` can start and still make a vblank,
+	/// and that vblank. `None` until Shift has reported a vblank.
+	pub fn plan(&self, now_ns: u64) -> Option<FramePlan> {
+		let (last_vblank_ns, refresh_ns) = self.phase?;
+		let lead_ns = self.margin_ns + self.render_estimate_ns();
+		let earliest_ns = now_ns + lead_ns;
+		let periods = earliest_ns
+			.saturating_sub(last_vblank_ns)
+			.div_ceil(refresh_ns)
+			.max(1);
+		let target_vblank_ns = last_vblank_ns + periods * refresh_ns;
+		Some(FramePlan {
+			render_at_ns: target_vblank_ns - lead_ns,
+			target_vblank_ns,
+		})
+	}
+
+	/// Classifies a frame shown at `vblank_ns`, and adapts the margin if it was rendered
+	/// for `target_vblank_ns`. `missed` is Shift's own verdict.
+	pub fn outcome(
+		&mut self,
+		target_vblank_ns: Option<u64>,
+		vblank_ns: u64,
+		refresh_ns: u64,
+		missed: bool,
+	) -> PresentTiming {
+		let half_refresh_ns = refresh_ns / 2;
+		let Some(target_vblank_ns) = target_vblank_ns else {
+			return if missed {
+				PresentTiming::Missed
+			} else {
+				PresentTiming::OnTime
+			};
+		};
+		let timing = if vblank_ns + half_refresh_ns < target_vblank_ns {
+			PresentTiming::Early
+		} else if missed || vblank_ns > target_vblank_ns + half_refresh_ns {
+			PresentTiming::Missed
+		} else {
+			PresentTiming::OnTime
+		};
+		self.margin_ns = match timing {
+			PresentTiming::Missed => (self.margin_ns + refresh_ns / 8).min(half_refresh_ns),
+			PresentTiming::Early => self.margin_ns - self.margin_ns / 8,
+			PresentTiming::OnTime => self.margin_ns - self.margin_ns / 32,
+		}
+		.max(MIN_MARGIN_NS);
+		timing
+	}
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	const REFRESH: u64 = 16_666_667;
+
+	#[test]
+	fn no_plan_before_feedback() {
+		assert_eq!(FramePredictor::default().plan(1_000), None);
+	}
+
+	#[test]
+	fn plans_for_the_next_reachable_vblank() {
+		let mut predictor = FramePredictor::default();
+		predictor.presented(100 * REFRESH, REFRESH);
+		predictor.record_render(3_000_000);
+
+		// Plenty of time before the next vblank: start as late as possible.
+		let now = 100 * REFRESH + 1_000_000;
+		let plan = predictor.plan(now).unwrap();
+		assert_eq!(plan.target_vblank_ns, 101 * REFRESH);
+		assert_eq!(
+			plan.render_at_ns,
+			101 * REFRESH - 3_000_000 - 2 * MIN_MARGIN_NS
+		);
+		assert!(plan.render_at_ns > now);
+
+		// Too close to the next vblank: aim for the one after.
+		let now = 101 * REFRESH - 4_000_000;
+		let plan = predictor.plan(now).unwrap();
+		assert_eq!(plan.target_vblank_ns, 102 * REFRESH);
+	}
+
+	#[test]
+	fn slowest_recent_render_wins() {
+		let mut predictor = FramePredictor::default();
+		predictor.presented(0, REFRESH);
+		predictor.record_render(2_000_000);
+		predictor.record_render(6_000_000);
+		predictor.record_render(1_000_000);
+		let plan = predictor.plan(0).unwrap();
+		assert_eq!(plan.render_at_ns, REFRESH - 6_000_000 - 2 * MIN_MARGIN_NS);
+
+		for _ in 0..RENDER_SAMPLES {
+			predictor.record_render(1_000_000);
+		}
+		let plan = predictor.plan(0).unwrap();
+		assert_eq!(plan.render_at_ns, REFRESH - 1_000_000 - 2 * MIN_MARGIN_NS);
+	}
+
+	#[test]
+	fn misses_grow_the_margin_and_hits_shrink_it() {
+		let mut predictor = FramePredictor::default();
+		predictor.presented(0, REFRESH);
+		let before = predictor.plan(0).unwrap().render_at_ns;
+
+		let timing = predictor.outcome(Some(REFRESH), 2 * REFRESH, REFRESH, false);
+		assert_eq!(timing, PresentTiming::Missed);
+		let after_miss = predictor.plan(0).unwrap().render_at_ns;
+		assert!(after_miss < before);
+
+		for _ in 0..200 {
+			assert_eq!(
+				predictor.outcome(Some(REFRESH), REFRESH, REFRESH, false),
+				PresentTiming::OnTime
+			);
+		}
+		assert_eq!(predictor.margin_ns, MIN_MARGIN_NS);
+	}
+
+	#[test]
+	fn margin_is_capped_at_half_a_refresh() {
+		let mut predictor = FramePredictor::default();
+		for _ in 0..100 {
+			predictor.outcome(Some(REFRESH), 3 * REFRESH, REFRESH, true);
+		}
+		assert_eq!(predictor.margin_ns, REFRESH / 2);
+	}
+
+	#[test]
+	fn classifies_early_frames_and_trusts_shift_without_a_target() {
+		let mut predictor = FramePredictor::default();
+		assert_eq!(
+			predictor.outcome(Some(3 * REFRESH), 2 * REFRESH, REFRESH, false),
+			PresentTiming::Early
+		);
+		assert_eq!(
+			predictor.outcome(None, 2 * REFRESH, REFRESH, true),
+			PresentTiming::Missed
+		);
+		assert_eq!(
+			predictor.outcome(None, 2 * REFRESH, REFRESH, false),
+			PresentTiming::OnTime
+		);
+	}
+
+	#[test]
+	fn stale_feedback_keeps_the_newest_vblank() {
+		let mut predictor = FramePredictor::default();
+		predictor.presented(10 * REFRESH, REFRESH);
+		predictor.presented(9 * REFRESH, REFRESH);
+		let plan = predictor.plan(10 * REFRESH).unwrap();
+		assert_eq!(plan.target_vblank_ns, 11 * REFRESH);
+	}
+}
@@ -17,10 +17,17 @@ use tab_client::{TabClient, TabClientConfig, TabClientError, TabSwapchain};
 pub use tab_protocol::{
 	AxisOrientation, AxisPhase, AxisSource, SessionCreatedPayload, SessionInfo, SessionRole,
 };
-use tab_protocol::{BufferIndex, ButtonState, InputEventPayload, KeyState, TouchContact};
+use tab_protocol::{
+	BufferIndex, ButtonState, InputEventPayload, KeyState, TouchContact, latency::monotonic_ns,
+};
 use thiserror::Error;
 use tracing::{debug, info};
 
+mod frame_pacing;
+
+pub use frame_pacing::PresentTiming;
+use frame_pacing::{FramePlan, FramePredictor};
+
 const BTN_LEFT: u32 = 272;
 
 /// Frame scheduling policy used by the runtime.
@@ -30,6 +37,11 @@ pub enum RenderMode {
 	Eager,
 	/// Render only when explicitly scheduled by the application.
 	Scheduled,
+	/// Like [`RenderMode::Scheduled`], but a scheduled frame is held back until the latest
+	/// moment it can still make the next vblank, learned from Shift's presentation feedback
+	/// and the app's recent render times. Input that arrives meanwhile lands in that frame.
+	/// Renders right away until the first frame on a monitor has been presented.
+	Predictive,
 }
 
 /// Runtime configuration used during framework initialization.
@@ -40,6 +52,7 @@ pub struct Config {
 	render_node_path: Option<PathBuf>,
 	render_mode: RenderMode,
 	opengl_es_version: (u8, u8),
+	swapchain_buffers: usize,
 }
 
 impl Config {
@@ -51,6 +64,7 @@ impl Config {
 			render_node_path: None,
 			render_mode: RenderMode::Scheduled,
 			opengl_es_version: (3, 0),
+			swapchain_buffers: tab_protocol::MIN_SWAPCHAIN_BUFFERS,
 		}
 	}
 
@@ -87,6 +101,12 @@ impl Config {
 		self
 	}
 
+	/// Sets the number of buffers allocated per monitor swapchain (2 to 4).
+	pub fn set_swapchain_buffers(&mut self, count: usize) -> &mut Self {
+		self.swapchain_buffers = count;
+		self
+	}
+
 	/// Requests a specific OpenGL ES version.
 	pub fn opengl_es_version(&mut self, major: u8, minor: u8) -> &mut Self {
 		self.opengl_es_version = (major, minor);
@@ -98,6 +118,11 @@ impl Config {
 		self.render_mode
 	}
 
+	/// Returns the configured number of buffers per monitor swapchain.
+	pub fn swapchain_buffers(&self) -> usize {
+		self.swapchain_buffers
+	}
+
 	/// Returns the requested OpenGL ES version.
 	pub fn requested_opengl_es_version(&self) -> (u8, u8) {
 		self.opengl_es_version
@@ -232,6 +257,12 @@ pub struct PresentEvent {
 	pub monitor_id: String,
 	/// Buffer index that reached presentation completion.
 	pub buffer_index: BufferIndex,
+	/// `CLOCK_MONOTONIC` nanoseconds of the vblank the buffer was shown at, if Shift reported
+	/// one. `None` for frames replaced before they were shown.
+	pub vblank_ns: Option<u64>,
+	/// How the frame landed relative to the vblank it was rendered for, alongside `vblank_ns`.
+	/// Only [`RenderMode::Predictive`] reports [`PresentTiming::Early`].
+	pub timing: Option<PresentTiming>,
 }
 
 /// Emitted when a monitor is added.
@@ -743,6 +774,8 @@ pub struct TabAppFramework<A: Application> {
 	render_mode: RenderMode,
 	monitors: HashMap<String, MonitorRuntime>,
 	scheduled: HashSet<String>,
+	/// Frames held back by [`RenderMode::Predictive`] until their render time.
+	deferred: HashMap<String, FramePlan>,
 	watched_fds: HashSet<RawFd>,
 	event_queue: Rc<RefCell<VecDeque<QueuedEvent>>>,
 	exiting: bool,
@@ -763,7 +796,10 @@ impl<A: Application> TabAppFramework<A> {
 			.map_err(|e| FrameworkError::Config(format!("app init failed: {e:#}")))?;
 
 		let cfg = init_ctx.config().clone();
-		let mut client_cfg = TabClientConfig::new(cfg.token()).socket_path(cfg.socket_path.clone());
+		let mut client_cfg = TabClientConfig::new(cfg.token())
+			.socket_path(cfg.socket_path.clone())
+			.swapchain_buffers(cfg.swapchain_buffers)
+			.preallocate_swapchains(true);
 		if let Some(render_node) = cfg.render_node_path {
 			client_cfg = client_cfg.render_node(render_node);
 		}
@@ -772,8 +808,11 @@ impl<A: Application> TabAppFramework<A> {
 		Self::attach_event_queue(&mut client, Rc::clone(&queue));
 
 		let mut monitors = HashMap::new();
-		for tab_monitor in client.monitors() {
-			let monitor = Monitor::from_tab_monitor(tab_monitor);
+		let tab_monitors = client
+			.monitors()
+			.map(Monitor::from_tab_monitor)
+			.collect::<Vec<_>>();
+		for monitor in tab_monitors {
 			let swapchain = client.create_swapchain(&monitor.id)?;
 			monitors.insert(monitor.id.clone(), MonitorRuntime::new(monitor, swapchain));
 		}
@@ -803,6 +842,7 @@ impl<A: Application> TabAppFramework<A> {
 			render_mode: cfg.render_mode,
 			monitors,
 			scheduled,
+			deferred: HashMap::new(),
 			watched_fds: HashSet::new(),
 			event_queue: queue,
 			exiting: false,
@@ -819,12 +859,17 @@ impl<A: Application> TabAppFramework<A> {
 	pub fn run(&mut self) -> Result<(), FrameworkError> {
 		while !self.exiting {
 			let has_queued_events = !self.event_queue.borrow().is_empty();
-			let timeout_ms = if self.scheduled.is_empty() && !has_queued_events {
-				-1
+			let timeout = if !self.scheduled.is_empty() || has_queued_events {
+				Some(Duration::ZERO)
 			} else {
-				0
+				let now_ns = monotonic_ns();
+				self
+					.deferred
+					.values()
+					.map(|plan| Duration::from_nanos(plan.render_at_ns.saturating_sub(now_ns)))
+					.min()
 			};
-			let (tab_ready, ready_fds) = self.poll_once(timeout_ms)?;
+			let (tab_ready, ready_fds) = self.poll_once(timeout)?;
 			if tab_ready {
 				self.client.dispatch_events()?;
 			}
@@ -852,7 +897,13 @@ impl<A: Application> TabAppFramework<A> {
 		});
 		let q = Rc::clone(&queue);
 		client.on_input_event(move |ev| {
-			q.borrow_mut().push_back(QueuedEvent::Input(ev.clone()));
+			let mut q = q.borrow_mut();
+			match ev {
+				TabInputEvent::Event(payload) => q.push_back(QueuedEvent::Input(payload.clone())),
+				TabInputEvent::Batch(events) => {
+					q.extend(events.iter().cloned().map(QueuedEvent::Input));
+				}
+			}
 		});
 		let q = Rc::clone(&queue);
 		client.on_session_event(move |ev| {
@@ -860,7 +911,9 @@ impl<A: Application> TabAppFramework<A> {
 		});
 	}
 
-	fn poll_once(&self, timeout_ms: i32) -> Result<(bool, Vec<RawFd>), FrameworkError> {
+	/// Waits up to `timeout`, forever with `None`. Nanosecond resolution, so predictive
+	/// frames start on time.
+	fn poll_once(&self, timeout: Option<Duration>) -> Result<(bool, Vec<RawFd>), FrameworkError> {
 		let mut pending_release_fds = Vec::new();
 		for monitor in self.monitors.values() {
 			for fence in &monitor.pending_release_fences {
@@ -891,11 +944,18 @@ impl<A: Application> TabAppFramework<A> {
 				revents: 0,
 			});
 		}
+		let timeout = timeout.map(|timeout| libc::timespec {
+			tv_sec: timeout.as_secs() as libc::time_t,
+			tv_nsec: timeout.subsec_nanos() as libc::c_long,
+		});
 		let rc = unsafe {
-			libc::poll(
+			libc::ppoll(
 				pollfds.as_mut_ptr(),
 				pollfds.len() as libc::nfds_t,
-				timeout_ms,
+				timeout
+					.as_ref()
+					.map_or(std::ptr::null(), |timeout| timeout as *const libc::timespec),
+				std::ptr::null(),
 			)
 		};
 		if rc < 0 {
@@ -957,6 +1017,7 @@ impl<A: Application> TabAppFramework<A> {
 						self.cursor_position =
 							clamp_point_to_layout(&placements, self.cursor_position.0, self.cursor_position.1);
 						self.scheduled.remove(&monitor_id);
+						self.deferred.remove(&monitor_id);
 						self.call_app(|app, ctx| {
 							app.on_monitor_removed(
 								ctx,
@@ -968,13 +1029,39 @@ impl<A: Application> TabAppFramework<A> {
 						});
 					}
 				},
+				QueuedEvent::Render(TabRenderEvent::FramePresented {
+					monitor_id,
+					vblank_ns,
+					refresh_ns,
+					missed,
+					..
+				}) => {
+					let Some(monitor) = self.monitors.get_mut(&monitor_id) else {
+						continue;
+					};
+					monitor.predictor.presented(vblank_ns, refresh_ns);
+					// The newest acked frame is the one that was shown.
+					let Some(buffer) = monitor.last_submitted.take() else {
+						continue;
+					};
+					let target = monitor.target_vblank_ns[buffer as usize].take();
+					let timing = monitor
+						.predictor
+						.outcome(target, vblank_ns, refresh_ns, missed);
+					monitor.presented[buffer as usize] = Some((vblank_ns, timing));
+				}
 				QueuedEvent::Render(ev) => {
-					self.stats.buffer_release_events += 1;
+					// Requests are sent with the blocking `request_buffer`, so acks and
+					// rejections are already handled in `render_scheduled`.
 					let TabRenderEvent::BufferReleased {
 						monitor_id,
 						buffer,
 						release_fence_fd,
-					} = ev;
+					} = ev
+					else {
+						continue;
+					};
+					self.stats.buffer_release_events += 1;
 					self.stats.instant_log(&format!(
 						"buffer_release event monitor={monitor_id} buffer={} fence={}",
 						buffer as u8,
@@ -985,6 +1072,7 @@ impl<A: Application> TabAppFramework<A> {
 						}
 					));
 					let mut should_emit_present = false;
+					let mut presented = None;
 					if let Some(monitor) = self.monitors.get_mut(&monitor_id) {
 						if let Some(fd) = release_fence_fd {
 							monitor.pending_release_fences[buffer as usize] =
@@ -992,6 +1080,7 @@ impl<A: Application> TabAppFramework<A> {
 						} else {
 							if monitor.pending_present[buffer as usize] {
 								monitor.pending_present[buffer as usize] = false;
+								presented = monitor.take_presented(buffer);
 								should_emit_present = true;
 							}
 							monitor.swapchain.mark_released(buffer);
@@ -1008,13 +1097,14 @@ impl<A: Application> TabAppFramework<A> {
 								PresentEvent {
 									monitor_id: monitor_id.clone(),
 									buffer_index: buffer,
+									vblank_ns: presented.map(|(vblank_ns, _)| vblank_ns),
+									timing: presented.map(|(_, timing)| timing),
 								},
 							)
 						});
 					}
 				}
-				QueuedEvent::Input(ev) => {
-					let TabInputEvent::Event(payload) = ev;
+				QueuedEvent::Input(payload) => {
 					self.call_app(|app, ctx| {
 						app.on_input(
 							ctx,
@@ -1432,9 +1522,43 @@ impl<A: Application> TabAppFramework<A> {
 		Ok(())
 	}
 
+	/// Plans each scheduled frame, holding back those whose predictive render time has not
+	/// come yet.
+	fn due_frames(&mut self) -> Vec<(String, Option<FramePlan>)> {
+		let now_ns = monotonic_ns();
+		let mut due = Vec::new();
+		for monitor_id in self.scheduled.drain() {
+			let plan = if self.render_mode == RenderMode::Predictive {
+				self
+					.monitors
+					.get(&monitor_id)
+					.and_then(|monitor| monitor.predictor.plan(now_ns))
+			} else {
+				None
+			};
+			match plan {
+				Some(plan) if plan.render_at_ns > now_ns => {
+					// Already held back frames keep their earlier render time.
+					self.deferred.entry(monitor_id).or_insert(plan);
+				}
+				_ => {
+					self.deferred.remove(&monitor_id);
+					due.push((monitor_id, plan));
+				}
+			}
+		}
+		self.deferred.retain(|monitor_id, plan| {
+			if plan.render_at_ns > now_ns {
+				return true;
+			}
+			due.push((monitor_id.clone(), Some(*plan)));
+			false
+		});
+		due
+	}
+
 	fn render_scheduled(&mut self) -> Result<(), FrameworkError> {
-		let targets: Vec<_> = self.scheduled.drain().collect();
-		for monitor_id in targets {
+		for (monitor_id, plan) in self.due_frames() {
 			self
 				.stats
 				.instant_log(&format!("render_scheduled begin monitor={monitor_id}"));
@@ -1458,6 +1582,7 @@ impl<A: Application> TabAppFramework<A> {
 				continue;
 			};
 			self.next_acquire_fence = None;
+			let render_started_ns = monotonic_ns();
 			self.call_app(|app, ctx| app.on_render(ctx, render_ev.clone()));
 			let acquire_fence = self.next_acquire_fence.as_ref().map(|fd| fd.as_raw_fd());
 			self.stats.instant_log(&format!(
@@ -1470,7 +1595,7 @@ impl<A: Application> TabAppFramework<A> {
 
 			match self
 				.client
-				.request_buffer(&monitor_id, buffer_idx, acquire_fence)
+				.request_buffer(&monitor_id, buffer_idx, acquire_fence, &[])
 			{
 				Ok(()) => {
 					self.stats.request_ok += 1;
@@ -1481,6 +1606,13 @@ impl<A: Application> TabAppFramework<A> {
 					if let Some(monitor_rt) = self.monitors.get_mut(&monitor_id) {
 						monitor_rt.swapchain.mark_busy(buffer_idx);
 						monitor_rt.pending_present[buffer_idx as usize] = true;
+						monitor_rt.presented[buffer_idx as usize] = None;
+						monitor_rt.target_vblank_ns[buffer_idx as usize] =
+							plan.map(|plan| plan.target_vblank_ns);
+						monitor_rt.last_submitted = Some(buffer_idx);
+						monitor_rt
+							.predictor
+							.record_render(monotonic_ns().saturating_sub(render_started_ns));
 					}
 					if self.render_mode == RenderMode::Eager {
 						// Keep requesting while another client-owned buffer exists.
@@ -1534,10 +1666,8 @@ impl<A: Application> TabAppFramework<A> {
 				if signaled {
 					monitor_rt.pending_release_fences[buffer_idx] = None;
 					self.stats.release_fence_signaled += 1;
-					let buffer = match buffer_idx {
-						0 => BufferIndex::Zero,
-						1 => BufferIndex::One,
-						_ => continue,
+					let Some(buffer) = BufferIndex::from_index(buffer_idx) else {
+						continue;
 					};
 					self.stats.instant_log(&format!(
 						"release_fence signaled monitor={} buffer={}",
@@ -1546,9 +1676,12 @@ impl<A: Application> TabAppFramework<A> {
 					monitor_rt.swapchain.mark_released(buffer);
 					if monitor_rt.pending_present[buffer_idx] {
 						monitor_rt.pending_present[buffer_idx] = false;
+						let presented = monitor_rt.take_presented(buffer);
 						presents.push(PresentEvent {
 							monitor_id: monitor_rt.monitor.id.clone(),
 							buffer_index: buffer,
+							vblank_ns: presented.map(|(vblank_ns, _)| vblank_ns),
+							timing: presented.map(|(_, timing)| timing),
 						});
 					}
 					if self.render_mode == RenderMode::Eager {
@@ -1736,26 +1869,42 @@ impl LoopStats {
 struct MonitorRuntime {
 	monitor: Monitor,
 	swapchain: TabSwapchain,
-	pending_release_fences: [Option<OwnedFd>; 2],
-	pending_present: [bool; 2],
+	pending_release_fences: Vec<Option<OwnedFd>>,
+	pending_present: Vec<bool>,
+	predictor: FramePredictor,
+	/// Newest acked buffer, shown by the next `frame_presented`.
+	last_submitted: Option<BufferIndex>,
+	/// Vblank each in-flight buffer was rendered for, in predictive mode.
+	target_vblank_ns: Vec<Option<u64>>,
+	/// Vblank and timing of each buffer once shown, until its release is reported.
+	presented: Vec<Option<(u64, PresentTiming)>>,
 }
 
 impl MonitorRuntime {
 	fn new(monitor: Monitor, swapchain: TabSwapchain) -> Self {
+		let buffer_count = swapchain.buffer_count();
 		Self {
 			monitor,
 			swapchain,
-			pending_release_fences: [None, None],
-			pending_present: [false, false],
+			pending_release_fences: (0..buffer_count).map(|_| None).collect(),
+			pending_present: vec![false; buffer_count],
+			predictor: FramePredictor::default(),
+			last_submitted: None,
+			target_vblank_ns: vec![None; buffer_count],
+			presented: vec![None; buffer_count],
 		}
 	}
+
+	fn take_presented(&mut self, buffer: BufferIndex) -> Option<(u64, PresentTiming)> {
+		self.presented[buffer as usize].take()
+	}
 }
 
 #[derive(Debug, Clone)]
 enum QueuedEvent {
 	Monitor(TabMonitorEvent),
 	Render(TabRenderEvent),
-	Input(TabInputEvent),
+	Input(InputEventPayload),
 	Session(tab_client::SessionEvent),
 }
 
@@ -17,9 +17,9 @@ pub use tab_app_framework_core::{
 	Application, AxisOrientation, AxisPhase, AxisSource, CharEvent, Config, Context, FdReadyEvent,
 	FrameworkError, GestureEvent, InitContext, InputEvent, KeyEvent, Monitor, MonitorAddedEvent,
 	MonitorRemovedEvent, MouseDownEvent, MouseMoveEvent, MouseUpEvent, PointerAxisEvent,
-	PointerDownEvent, PointerMoveEvent, PointerType, PointerUpEvent, PresentEvent, RenderEvent,
-	RenderMode, SessionCreatedPayload, SessionEvent, SessionInfo, SessionRole, TabAppFramework,
-	TouchEvent,
+	PointerDownEvent, PointerMoveEvent, PointerType, PointerUpEvent, PresentEvent, PresentTiming,
+	RenderEvent, RenderMode, SessionCreatedPayload, SessionEvent, SessionInfo, SessionRole,
+	TabAppFramework, TouchEvent,
 };
 /// Re-exported GL runtime types.
 pub use tab_app_framework_gl::{
@@ -22,6 +22,9 @@ fn main() {
 			"EGL_MESA_image_dma_buf_export",
 			"EGL_KHR_surfaceless_context",
 			"EGL_ANDROID_native_fence_sync",
+			"EGL_EXT_buffer_age",
+			"EGL_EXT_device_query",
+			"EGL_EXT_device_drm",
 		],
 	)
 	.write_bindings(gl_generator::StructGenerator, &mut egl_file)
@@ -1,14 +1,17 @@
 use std::{
 	fmt::{Debug, Display},
 	os::{fd::AsRawFd, unix::net::UnixStream},
+	path::Path,
 	sync::Arc,
 };
 
 use tab_protocol::{
-	AuthErrorPayload, AuthOkPayload, ErrorPayload, MonitorAddedPayload, MonitorRemovedPayload,
-	SessionActivePayload, SessionAwakePayload, SessionCreatedPayload, SessionInfo,
-	SessionSleepPayload, SessionStatePayload, TabMessage, TabMessageFrame, TabMessageFrameReader,
-	message_header,
+	AuthErrorPayload, AuthOkPayload, BufferIndex, ErrorPayload, FramePresentedPayload,
+	GpuMemoryPayload, GpuMemoryUsage, InputBatchPayload, InputEventPayload, MonitorAddedPayload,
+	MonitorRemovedPayload, PayloadEncoding, ProtocolError, RenderNodeInfo, SessionActivePayload,
+	SessionAwakePayload, SessionCreatedPayload, SessionInfo, SessionSleepPayload,
+	SessionStatePayload, TabMessage, TabMessageFrame, TabMessageFrameReader, binary,
+	capture::CaptureWriter, message_header,
 };
 use tokio::{io::unix::AsyncFd, task::JoinHandle};
 use tracing::{Instrument, Span};
@@ -17,7 +20,7 @@ use crate::{
 	auth::Token,
 	client_layer::client_view::{self, ChannelsClientEnd, ClientView},
 	comms::{
-		client2server::{C2SMsg, C2STx},
+		client2server::{C2SMsg, C2SRx, C2STx},
 		server2client::S2CMsg,
 	},
 	define_id_type,
@@ -34,13 +37,19 @@ pub struct Client {
 	connected_session: Option<Arc<Session>>,
 	shutdown: bool,
 	initial_monitors: Vec<Monitor>,
+	render_node: Option<RenderNodeInfo>,
+	/// Hot-path payload encoding. Requested in `auth`, in effect once `auth_ok` is sent.
+	encoding: PayloadEncoding,
+	/// Whether the client asked for `input_batch` frames in `auth`.
+	input_batch: bool,
 }
 
 impl Client {
 	pub fn wrap_socket(
 		socket: AsyncUnixStream,
 		initial_monitors: Vec<Monitor>,
-	) -> (Self, ClientView) {
+		render_node: Option<RenderNodeInfo>,
+	) -> (Self, ClientView, C2SRx) {
 		let channels = client_view::Channels::new();
 		let client = Self {
 			socket,
@@ -50,13 +59,53 @@ impl Client {
 			connected_session: None,
 			shutdown: false,
 			initial_monitors,
+			render_node,
+			encoding: PayloadEncoding::Json,
+			input_batch: false,
 		};
-		let client_view = ClientView::from_client(&client, channels.server_end);
-		(client, client_view)
+		let (client_view, messages) = ClientView::from_client(&client, channels.server_end);
+		(client, client_view, messages)
 	}
 	pub fn id(&self) -> ClientId {
 		self.id
 	}
+	/// Records every frame the client sends to `<dir>/<client id>.tabcap`, for replaying
+	/// its traffic with `SHIFT_HEADLESS_REPLAY`.
+	pub fn capture_to(&mut self, dir: &Path) {
+		let path = dir.join(format!("{}.tabcap", self.id));
+		match CaptureWriter::create(&path) {
+			Ok(capture) => {
+				tracing::info!(client.id = %self.id, "capturing client frames to {path:?}");
+				self.frame_reader.set_capture(Some(capture));
+			}
+			Err(e) => tracing::warn!("failed to create capture file {path:?}: {e}"),
+		}
+	}
+	/// Builds a `<monitor_id> <buffer_index>` frame in the negotiated encoding.
+	fn buffer_frame(
+		&self,
+		header: &str,
+		monitor_id: &str,
+		buffer: BufferIndex,
+	) -> Result<TabMessageFrame, ProtocolError> {
+		Ok(match self.encoding {
+			PayloadEncoding::Binary => {
+				TabMessageFrame::binary(header, binary::encode_buffer_payload(monitor_id, buffer)?)
+			}
+			PayloadEncoding::Json => {
+				TabMessageFrame::raw(header, format!("{monitor_id} {}", buffer as u8))
+			}
+		})
+	}
+	fn input_event_frame(&self, event: &InputEventPayload) -> TabMessageFrame {
+		match self.encoding {
+			PayloadEncoding::Binary => TabMessageFrame::binary(
+				message_header::INPUT_EVENT,
+				binary::encode_input_event(event),
+			),
+			PayloadEncoding::Json => TabMessageFrame::json(message_header::INPUT_EVENT, event),
+		}
+	}
 	#[tracing::instrument(level = "error", skip(self), fields(client.id = self.id().to_string()))]
 	async fn send_error(&self, code: &str, error: Option<impl Display + Debug>) {
 		tracing::warn!("sending error to the client");
@@ -159,7 +208,12 @@ impl Client {
 					}
 				};
 				tracing::info!(?token, "sending auth request to the server");
-				send_server_msg!(C2SMsg::Auth(token));
+				self.encoding = auth.encoding;
+				self.input_batch = auth.input_batch;
+				send_server_msg!(C2SMsg::Auth {
+					token,
+					input_ring: auth.input_ring,
+				});
 			}
 			TabMessage::SessionSwitch(session_switch_payload) => {
 				check_admin!("switch session");
@@ -185,8 +239,23 @@ impl Client {
 					monitor_id: monitor_id,
 					buffer: payload.buffer,
 					acquire_fence,
+					damage: payload.damage,
 				});
 			}
+			TabMessage::PresentMode(payload) => {
+				check_session!("set a present mode", _session);
+				send_server_msg!(C2SMsg::SetPresentMode(payload.mode));
+			}
+			TabMessage::InputCaughtUp(payload) => {
+				check_session!("acknowledge input", _session);
+				send_server_msg!(C2SMsg::InputCaughtUp {
+					socket_events: payload.socket_events,
+				});
+			}
+			TabMessage::StatsRequest => {
+				check_admin!("request stats");
+				send_server_msg!(C2SMsg::StatsRequest);
+			}
 			TabMessage::SessionCreate(session_create_req) => {
 				check_admin!("create a session");
 				send_server_msg!(C2SMsg::CreateSession(session_create_req));
@@ -213,15 +282,32 @@ impl Client {
 					dma_bufs
 				});
 			}
+			TabMessage::FramebufferLinkBatch(links) => {
+				tracing::debug!(
+					count = links.len(),
+					"received batched link framebuffer request"
+				);
+				check_session!("link framebuffers", _session);
+				for (payload, dma_bufs) in links {
+					send_server_msg!(C2SMsg::FramebufferLink { payload, dma_bufs });
+				}
+			}
 
 			TabMessage::Hello(_hello_payload) => self.handle_unknown_msg("Hello").await,
-			TabMessage::AuthOk(_auth_ok_payload) => self.handle_unknown_msg("AuthOk").await,
+			TabMessage::AuthOk { .. } => self.handle_unknown_msg("AuthOk").await,
 			TabMessage::AuthError(_auth_error_payload) => self.handle_unknown_msg("AuthError").await,
 			TabMessage::BufferRelease { .. } => self.handle_unknown_msg("BufferRelease").await,
+			TabMessage::FramePresented(_frame_presented_payload) => {
+				self.handle_unknown_msg("FramePresented").await
+			}
 			TabMessage::BufferRequestAck(_buffer_request_ack_payload) => {
 				self.handle_unknown_msg("BufferRequestAck").await
 			}
+			TabMessage::BufferRequestRejected(_buffer_request_rejected_payload) => {
+				self.handle_unknown_msg("BufferRequestRejected").await
+			}
 			TabMessage::InputEvent(_input_event_payload) => self.handle_unknown_msg("InputEvent").await,
+			TabMessage::InputBatch(_input_batch_payload) => self.handle_unknown_msg("InputBatch").await,
 			TabMessage::MonitorAdded(_monitor_added_payload) => {
 				self.handle_unknown_msg("MonitorAdded").await
 			}
@@ -242,6 +328,8 @@ impl Client {
 			}
 			TabMessage::SessionAwake(_payload) => self.handle_unknown_msg("SessionAwake").await,
 			TabMessage::SessionSleep(_payload) => self.handle_unknown_msg("SessionSleep").await,
+			TabMessage::GpuMemory(_payload) => self.handle_unknown_msg("GpuMemory").await,
+			TabMessage::Stats(_payload) => self.handle_unknown_msg("Stats").await,
 			TabMessage::Error(_error_payload) => self.handle_unknown_msg("Error").await,
 			TabMessage::Pong => self.handle_unknown_msg("Pong").await,
 			TabMessage::Unknown(tab_message_frame) => {
@@ -263,12 +351,12 @@ impl Client {
 				);
 				self.send_auth_error(e).await;
 			}
-			S2CMsg::BindToSession(session) => {
+			S2CMsg::BindToSession(session, input_ring) => {
 				tracing::info!(
 					?session,
 					"server says authentication went well, forwarding auth ok to the client"
 				);
-				let auth_ok = TabMessageFrame::json(
+				let mut auth_ok = TabMessageFrame::json(
 					message_header::AUTH_OK,
 					AuthOkPayload {
 						monitors: self
@@ -286,8 +374,14 @@ impl Client {
 								tab_protocol::SessionLifecycle::Loading
 							},
 						},
+						encoding: self.encoding,
+						input_ring: input_ring.as_ref().map(|ring| ring.info),
+						render_node: self.render_node.clone(),
 					},
 				);
+				if let Some(ring) = input_ring.as_ref() {
+					auth_ok.fds = vec![ring.memfd.as_raw_fd(), ring.wakeup.as_raw_fd()];
+				}
 				self.connected_session = Some(session);
 				let send_result = auth_ok.send_frame_to_async_fd(&self.socket).await;
 
@@ -333,12 +427,19 @@ impl Client {
 			}
 			S2CMsg::BufferRelease { buffers } => {
 				for buffer in buffers {
-					let payload = format!("{} {}", buffer.monitor_id, buffer.buffer as u8);
-					let mut frame = TabMessageFrame::raw(message_header::BUFFER_RELEASE, payload);
-					if let Some(fd) = buffer.release_fence.as_ref() {
-						frame.fds.push(fd.as_raw_fd());
-					}
-					let send_result = frame.send_frame_to_async_fd(&self.socket).await;
+					let send_result = match self.buffer_frame(
+						message_header::BUFFER_RELEASE,
+						&buffer.monitor_id.to_string(),
+						buffer.buffer,
+					) {
+						Ok(mut frame) => {
+							if let Some(fd) = buffer.release_fence.as_ref() {
+								frame.fds.push(fd.as_raw_fd());
+							}
+							frame.send_frame_to_async_fd(&self.socket).await
+						}
+						Err(e) => Err(e),
+					};
 					if let Err(e) = send_result {
 						tracing::warn!(monitor_id = %buffer.monitor_id, buffer = buffer.buffer as u8, "failed to send buffer_release: {e}");
 						break;
@@ -346,12 +447,87 @@ impl Client {
 				}
 			}
 			S2CMsg::BufferRequestAck { monitor_id, buffer } => {
-				let payload = format!("{monitor_id} {}", buffer as u8);
-				if let Err(e) = TabMessageFrame::raw(message_header::BUFFER_REQUEST_ACK, payload)
+				let send_result = match self.buffer_frame(
+					message_header::BUFFER_REQUEST_ACK,
+					&monitor_id.to_string(),
+					buffer,
+				) {
+					Ok(frame) => frame.send_frame_to_async_fd(&self.socket).await,
+					Err(e) => Err(e),
+				};
+				if let Err(e) = send_result {
+					tracing::warn!(%monitor_id, buffer = buffer as u8, "failed to send buffer_request_ack: {e}");
+				}
+			}
+			S2CMsg::BufferRequestRejected {
+				monitor_id,
+				buffer,
+				code,
+			} => {
+				let payload = format!("{monitor_id} {} {code}", buffer as u8);
+				if let Err(e) = TabMessageFrame::raw(message_header::BUFFER_REQUEST_REJECTED, payload)
 					.send_frame_to_async_fd(&self.socket)
 					.await
 				{
-					tracing::warn!(%monitor_id, buffer = buffer as u8, "failed to send buffer_request_ack: {e}");
+					tracing::warn!(%monitor_id, buffer = buffer as u8, "failed to send buffer_request_rejected: {e}");
+				}
+			}
+			S2CMsg::FramePresented { frame } => {
+				let payload = FramePresentedPayload {
+					monitor_id: frame.monitor_id.to_string(),
+					sequence: frame.sequence,
+					vblank_ns: frame.vblank_ns,
+					refresh_ns: frame.refresh_ns,
+					missed: frame.missed,
+				};
+				if let Err(e) = TabMessageFrame::json(message_header::FRAME_PRESENTED, payload)
+					.send_frame_to_async_fd(&self.socket)
+					.await
+				{
+					tracing::warn!(monitor_id = %frame.monitor_id, "failed to send frame_presented: {e}");
+				}
+			}
+			S2CMsg::GpuMemory { report } => {
+				let payload = GpuMemoryPayload {
+					total_bytes: report.total_bytes,
+					budget_bytes: report.budget_bytes,
+					skia_cache_bytes: report.skia_cache_bytes,
+					retired_import_bytes: report.retired_import_bytes,
+					client_import_bytes: report.client_import_bytes,
+					sessions: report
+						.sessions
+						.iter()
+						.map(|usage| GpuMemoryUsage {
+							id: usage.session_id.to_string(),
+							bytes: usage.bytes,
+							client_bytes: usage.client_bytes,
+							evicted: usage.evicted,
+						})
+						.collect(),
+					monitors: report
+						.monitors
+						.iter()
+						.map(|usage| GpuMemoryUsage {
+							id: usage.monitor_id.to_string(),
+							bytes: usage.bytes,
+							client_bytes: 0,
+							evicted: false,
+						})
+						.collect(),
+				};
+				if let Err(e) = TabMessageFrame::json(message_header::GPU_MEMORY, payload)
+					.send_frame_to_async_fd(&self.socket)
+					.await
+				{
+					tracing::warn!("failed to send gpu memory: {e}");
+				}
+			}
+			S2CMsg::Stats { stats } => {
+				if let Err(e) = TabMessageFrame::json(message_header::STATS, &*stats)
+					.send_frame_to_async_fd(&self.socket)
+					.await
+				{
+					tracing::warn!("failed to send stats: {e}");
 				}
 			}
 			S2CMsg::SessionAwake { session_id } => {
@@ -397,13 +573,40 @@ impl Client {
 				}
 			}
 			S2CMsg::InputEvent { event } => {
-				if let Err(e) = TabMessageFrame::json(message_header::INPUT_EVENT, event)
+				if let Err(e) = self
+					.input_event_frame(&event)
 					.send_frame_to_async_fd(&self.socket)
 					.await
 				{
 					tracing::warn!("failed to send input event: {e}");
 				}
 			}
+			S2CMsg::InputBatch { events } if !self.input_batch => {
+				for event in &events {
+					if let Err(e) = self
+						.input_event_frame(event)
+						.send_frame_to_async_fd(&self.socket)
+						.await
+					{
+						tracing::warn!("failed to send input event: {e}");
+						break;
+					}
+				}
+			}
+			S2CMsg::InputBatch { events } => {
+				let frame = match self.encoding {
+					PayloadEncoding::Binary => TabMessageFrame::binary(
+						message_header::INPUT_BATCH,
+						binary::encode_input_batch(&events),
+					),
+					PayloadEncoding::Json => {
+						TabMessageFrame::json(message_header::INPUT_BATCH, InputBatchPayload { events })
+					}
+				};
+				if let Err(e) = frame.send_frame_to_async_fd(&self.socket).await {
+					tracing::warn!("failed to send input batch: {e}");
+				}
+			}
 			S2CMsg::MonitorAdded { monitor } => {
 				let payload = MonitorAddedPayload {
 					monitor: monitor.to_protocol_info(),
@@ -443,7 +646,7 @@ impl Client {
 	async fn run(mut self) {
 		loop {
 			tokio::select! {
-					read_frame_result = self.frame_reader.read_frame_from_async_fd(&self.socket) => match read_frame_result.and_then(TabMessage::try_from) {
+					read_message_result = self.frame_reader.read_message_from_async_fd(&self.socket) => match read_message_result {
 							Ok(packet) => self.handle_packet(packet).await,
 							Err(e) => {
 									self.send_error("protocol_violation", Some(e)).await;
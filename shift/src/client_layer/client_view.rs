@@ -4,13 +4,14 @@ use crate::{
 	auth::{self, Token},
 	client_layer::client::{Client, ClientId},
 	comms::{
-		client2server::{C2SMsg, C2SRx, C2STx, C2SWeakTx},
-		server2client::{BufferRelease, S2CMsg, S2CRx, S2CTx},
+		client2server::{C2SRx, C2STx, C2SWeakTx},
+		render2server::{GpuMemoryReport, PresentedFrame},
+		server2client::{BufferRelease, InputRingHandoff, S2CMsg, S2CRx, S2CTx},
 	},
 	monitor::{Monitor, MonitorId},
 	sessions::{PendingSession, Session, SessionId},
 };
-use tab_protocol::{InputEventPayload, SessionInfo};
+use tab_protocol::{InputEventPayload, SessionInfo, StatsPayload};
 
 #[derive(Debug)]
 pub struct ChannelsServerEnd(C2SRx, S2CTx);
@@ -19,8 +20,8 @@ impl ChannelsServerEnd {
 	pub fn to_client(&self) -> &S2CTx {
 		&self.1
 	}
-	pub fn from_client(&mut self) -> &mut C2SRx {
-		&mut self.0
+	pub fn into_parts(self) -> (C2SRx, S2CTx) {
+		(self.0, self.1)
 	}
 }
 #[derive(Debug)]
@@ -52,52 +53,47 @@ impl Channels {
 #[derive(Debug)]
 pub struct ClientView {
 	id: ClientId,
-	pub(super) channels: ChannelsServerEnd,
+	to_client: S2CTx,
 	session_id: Option<SessionId>,
 }
 
 impl ClientView {
-	pub(super) fn from_client(client: &Client, channels: ChannelsServerEnd) -> ClientView {
-		Self {
+	/// The view and the receiver of the client's messages, which the server polls together
+	/// with every other client's.
+	pub(super) fn from_client(client: &Client, channels: ChannelsServerEnd) -> (ClientView, C2SRx) {
+		let (from_client, to_client) = channels.into_parts();
+		let view = Self {
 			id: client.id(),
-			channels,
+			to_client,
 			session_id: None,
-		}
+		};
+		(view, from_client)
 	}
 
 	pub fn id(&self) -> ClientId {
 		self.id
 	}
-	pub async fn read_message(&mut self) -> Option<C2SMsg> {
-		self.channels.from_client().recv().await
-	}
 	pub fn running(&self) -> bool {
-		!self.channels.1.is_closed() && self.has_messages()
-	}
-	pub fn has_messages(&self) -> bool {
-		!self.channels.0.is_closed() || !self.channels.0.is_empty()
+		!self.to_client.is_closed()
 	}
 	pub async fn notify_auth_error(&self, reason: auth::error::Error) -> bool {
-		self
-			.channels
-			.1
-			.send(S2CMsg::AuthError(reason))
-			.await
-			.is_ok()
+		self.to_client.send(S2CMsg::AuthError(reason)).await.is_ok()
 	}
-	pub async fn notify_auth_success(&mut self, session: &Arc<Session>) -> bool {
+	pub async fn notify_auth_success(
+		&mut self,
+		session: &Arc<Session>,
+		input_ring: Option<InputRingHandoff>,
+	) -> bool {
 		self.session_id = Some(session.id());
 		self
-			.channels
-			.1
-			.send(S2CMsg::BindToSession(Arc::clone(&session)))
+			.to_client
+			.send(S2CMsg::BindToSession(Arc::clone(&session), input_ring))
 			.await
 			.is_ok()
 	}
 	pub async fn notify_session_created(&mut self, token: Token, session: PendingSession) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::SessionCreated(token, session))
 			.await
 			.is_ok()
@@ -110,8 +106,7 @@ impl ClientView {
 		shutdown: bool,
 	) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::Error {
 				code,
 				error,
@@ -127,8 +122,7 @@ impl ClientView {
 
 	pub async fn notify_buffer_release(&mut self, buffers: Vec<BufferRelease>) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::BufferRelease { buffers })
 			.await
 			.is_ok()
@@ -140,17 +134,32 @@ impl ClientView {
 		buffer: tab_protocol::BufferIndex,
 	) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::BufferRequestAck { monitor_id, buffer })
 			.await
 			.is_ok()
 	}
 
+	pub async fn notify_buffer_request_rejected(
+		&mut self,
+		monitor_id: MonitorId,
+		buffer: tab_protocol::BufferIndex,
+		code: Arc<str>,
+	) -> bool {
+		self
+			.to_client
+			.send(S2CMsg::BufferRequestRejected {
+				monitor_id,
+				buffer,
+				code,
+			})
+			.await
+			.is_ok()
+	}
+
 	pub async fn notify_monitor_added(&mut self, monitor: Monitor) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::MonitorAdded { monitor })
 			.await
 			.is_ok()
@@ -158,8 +167,7 @@ impl ClientView {
 
 	pub async fn notify_monitor_removed(&mut self, monitor_id: MonitorId, name: Arc<str>) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::MonitorRemoved { monitor_id, name })
 			.await
 			.is_ok()
@@ -167,8 +175,7 @@ impl ClientView {
 
 	pub async fn notify_session_awake(&mut self, session_id: SessionId) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::SessionAwake { session_id })
 			.await
 			.is_ok()
@@ -176,8 +183,7 @@ impl ClientView {
 
 	pub async fn notify_session_active(&mut self, session_id: SessionId) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::SessionActive { session_id })
 			.await
 			.is_ok()
@@ -185,8 +191,7 @@ impl ClientView {
 
 	pub async fn notify_session_state(&mut self, session: SessionInfo) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::SessionState { session })
 			.await
 			.is_ok()
@@ -194,8 +199,7 @@ impl ClientView {
 
 	pub async fn notify_session_sleep(&mut self, session_id: SessionId) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::SessionSleep { session_id })
 			.await
 			.is_ok()
@@ -203,10 +207,37 @@ impl ClientView {
 
 	pub async fn notify_input_event(&mut self, event: InputEventPayload) -> bool {
 		self
-			.channels
-			.1
+			.to_client
 			.send(S2CMsg::InputEvent { event })
 			.await
 			.is_ok()
 	}
+
+	pub async fn notify_frame_presented(&mut self, frame: PresentedFrame) -> bool {
+		self
+			.to_client
+			.send(S2CMsg::FramePresented { frame })
+			.await
+			.is_ok()
+	}
+
+	pub async fn notify_gpu_memory(&mut self, report: Arc<GpuMemoryReport>) -> bool {
+		self
+			.to_client
+			.send(S2CMsg::GpuMemory { report })
+			.await
+			.is_ok()
+	}
+
+	pub async fn notify_stats(&mut self, stats: Arc<StatsPayload>) -> bool {
+		self.to_client.send(S2CMsg::Stats { stats }).await.is_ok()
+	}
+
+	pub async fn notify_input_batch(&mut self, events: Vec<InputEventPayload>) -> bool {
+		self
+			.to_client
+			.send(S2CMsg::InputBatch { events })
+			.await
+			.is_ok()
+	}
 }
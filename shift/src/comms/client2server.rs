@@ -1,26 +1,40 @@
 use std::os::fd::OwnedFd;
 
 use tab_protocol::{
-	BufferIndex, FramebufferLinkPayload, SessionCreatePayload, SessionReadyPayload,
-	SessionSwitchPayload,
+	BufferIndex, DamageRect, FramebufferLinkPayload, PresentMode, SessionCreatePayload,
+	SessionReadyPayload, SessionSwitchPayload,
 };
 
 use crate::{auth::Token, monitor::MonitorId};
 #[derive(Debug)]
 pub enum C2SMsg {
 	Shutdown,
-	Auth(Token),
+	Auth {
+		token: Token,
+		/// Client asked for input events through a shared-memory ring.
+		input_ring: bool,
+	},
 	CreateSession(SessionCreatePayload),
 	SwitchSession(SessionSwitchPayload),
 	SessionReady(SessionReadyPayload),
+	/// The client has read every input event sent over the socket, `socket_events` in total.
+	InputCaughtUp {
+		socket_events: u64,
+	},
+	/// An admin asked for the latency histograms.
+	StatsRequest,
+	/// Presentation mode for the client's own session.
+	SetPresentMode(PresentMode),
 	BufferRequest {
 		monitor_id: MonitorId,
 		buffer: BufferIndex,
 		acquire_fence: Option<OwnedFd>,
+		/// Empty means the whole buffer changed.
+		damage: Vec<DamageRect>,
 	},
 	FramebufferLink {
 		payload: FramebufferLinkPayload,
-		dma_bufs: [OwnedFd; 2],
+		dma_bufs: Vec<OwnedFd>,
 	},
 }
 
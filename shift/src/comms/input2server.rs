@@ -2,9 +2,18 @@ use std::sync::Arc;
 
 use tab_protocol::InputEventPayload;
 
+/// Everything one libinput dispatch produced, oldest first. Each event carries its kernel
+/// timestamp in `time_usec`.
+#[derive(Debug, Clone)]
+pub struct InputBatch {
+	pub events: Vec<InputEventPayload>,
+	/// `CLOCK_MONOTONIC` nanoseconds when the input thread read the batch from libinput.
+	pub received_ns: u64,
+}
+
 #[derive(Debug, Clone)]
 pub enum InputEvt {
-	Event(InputEventPayload),
+	Batch(InputBatch),
 	FatalError { reason: Arc<str> },
 }
 
@@ -1,13 +1,73 @@
 use std::os::fd::OwnedFd;
 use std::sync::Arc;
 
-use tab_protocol::BufferIndex;
+use tab_protocol::{BufferIndex, LatencyHistogram, RenderNodeInfo};
 
 use crate::{
 	monitor::{Monitor, MonitorId},
 	sessions::SessionId,
 };
 
+/// Timing of one presented frame on one monitor.
+#[derive(Debug, Clone)]
+pub struct PresentedFrame {
+	pub monitor_id: MonitorId,
+	/// Sessions whose buffers were composited into the frame.
+	pub sessions: Vec<SessionId>,
+	pub sequence: u64,
+	/// `CLOCK_MONOTONIC` nanoseconds.
+	pub vblank_ns: u64,
+	pub refresh_ns: u64,
+	pub missed: bool,
+}
+
+/// Frame latency of one session on one monitor since the renderer started.
+#[derive(Debug, Clone)]
+pub struct FrameLatency {
+	pub session_id: SessionId,
+	pub monitor_id: MonitorId,
+	/// Request received until the buffer could be sampled.
+	pub acquire: LatencyHistogram,
+	/// Buffer ready until composited.
+	pub composite: LatencyHistogram,
+	/// Composited until the page flip completed.
+	pub present: LatencyHistogram,
+}
+
+/// GPU memory one session accounts for.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct SessionGpuMemory {
+	pub session_id: SessionId,
+	/// Memory Shift allocated for the session, i.e. its snapshots.
+	pub bytes: u64,
+	/// Client-allocated buffers Shift holds imports of. Not counted against the budget:
+	/// dropping the imports would not free them while the client keeps its swapchain.
+	pub client_bytes: u64,
+	/// Its snapshots were dropped to stay within the budget.
+	pub evicted: bool,
+}
+
+/// GPU memory one monitor accounts for: its render targets and transition caches.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct MonitorGpuMemory {
+	pub monitor_id: MonitorId,
+	pub bytes: u64,
+}
+
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct GpuMemoryReport {
+	/// Everything Shift allocated itself; this is what the budget limits.
+	pub total_bytes: u64,
+	pub budget_bytes: Option<u64>,
+	/// Skia's cache beyond the snapshots and transition caches attributed above.
+	pub skia_cache_bytes: u64,
+	pub retired_import_bytes: u64,
+	/// Sum of the sessions' `client_bytes`.
+	pub client_import_bytes: u64,
+	pub sessions: Vec<SessionGpuMemory>,
+	pub monitors: Vec<MonitorGpuMemory>,
+}
+
 /// Events emitted by the rendering layer back into the server core.
 #[derive(Debug)]
 pub enum RenderEvt {
@@ -15,6 +75,8 @@ pub enum RenderEvt {
 	Started {
 		/// Initial monitors when shift started
 		monitors: Vec<Monitor>,
+		/// Render node of the GPU compositing, if the driver exposes it
+		render_node: Option<RenderNodeInfo>,
 	},
 	/// The user plugged in a new monitor
 	MonitorOnline { monitor: Monitor },
@@ -24,6 +86,12 @@ pub enum RenderEvt {
 	FatalError { reason: Arc<str> },
 	/// Some monitors just page flipped and are ready to be commited to again
 	PageFlip { monitors: Vec<MonitorId> },
+	/// Flips committed by a previous `PageFlip` completed.
+	FramePresented { frames: Vec<PresentedFrame> },
+	/// GPU memory changed since the last report.
+	GpuMemory(GpuMemoryReport),
+	/// Reply to `RenderCmd::CollectLatency`.
+	FrameLatency(Vec<FrameLatency>),
 	/// Renderer has accepted and applied a buffer request to its internal state.
 	BufferRequestAck {
 		session_id: SessionId,
@@ -36,6 +104,8 @@ pub enum RenderEvt {
 		monitor_id: MonitorId,
 		buffer: BufferIndex,
 		release_fence: Option<OwnedFd>,
+		/// `CLOCK_MONOTONIC` nanoseconds the release fence was attached.
+		released_ns: u64,
 	},
 	/// Renderer rejected a buffer request after inspecting local state.
 	BufferRequestRejected {
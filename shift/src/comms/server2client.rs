@@ -1,10 +1,13 @@
 use std::os::fd::OwnedFd;
 use std::sync::Arc;
 
-use tab_protocol::{BufferIndex, InputEventPayload, SessionInfo};
+use tab_protocol::{
+	BufferIndex, InputEventPayload, SessionInfo, StatsPayload, input_ring::InputRingInfo,
+};
 
 use crate::{
 	auth::{self, Token},
+	comms::render2server::{GpuMemoryReport, PresentedFrame},
 	monitor::{Monitor, MonitorId},
 	sessions::{PendingSession, Session, SessionId},
 };
@@ -16,9 +19,17 @@ pub struct BufferRelease {
 	pub release_fence: Option<OwnedFd>,
 }
 
+/// Consumer end of a session's input ring, handed to the client with `auth_ok`.
+#[derive(Debug)]
+pub struct InputRingHandoff {
+	pub info: InputRingInfo,
+	pub memfd: OwnedFd,
+	pub wakeup: OwnedFd,
+}
+
 #[derive(Debug)]
 pub enum S2CMsg {
-	BindToSession(Arc<Session>),
+	BindToSession(Arc<Session>, Option<InputRingHandoff>),
 	AuthError(auth::error::Error),
 	SessionCreated(Token, PendingSession),
 	Error {
@@ -33,6 +44,11 @@ pub enum S2CMsg {
 		monitor_id: MonitorId,
 		buffer: BufferIndex,
 	},
+	BufferRequestRejected {
+		monitor_id: MonitorId,
+		buffer: BufferIndex,
+		code: Arc<str>,
+	},
 	SessionActive {
 		session_id: SessionId,
 	},
@@ -45,9 +61,24 @@ pub enum S2CMsg {
 	SessionSleep {
 		session_id: SessionId,
 	},
+	FramePresented {
+		frame: PresentedFrame,
+	},
+	/// Renderer GPU memory, sent to admin sessions.
+	GpuMemory {
+		report: Arc<GpuMemoryReport>,
+	},
+	/// Latency histograms, in reply to an admin's `stats_request`.
+	Stats {
+		stats: Arc<StatsPayload>,
+	},
 	InputEvent {
 		event: InputEventPayload,
 	},
+	/// Input coalesced since the session's last frame, oldest first.
+	InputBatch {
+		events: Vec<InputEventPayload>,
+	},
 	MonitorAdded {
 		monitor: Monitor,
 	},
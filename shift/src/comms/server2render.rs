@@ -1,7 +1,7 @@
 use std::os::fd::OwnedFd;
 use std::time::Duration;
 
-use tab_protocol::{BufferIndex, FramebufferLinkPayload};
+use tab_protocol::{BufferIndex, DamageRect, FramebufferLinkPayload, PresentMode};
 
 use crate::{monitor::MonitorId, sessions::SessionId};
 
@@ -19,7 +19,7 @@ pub enum RenderCmd {
 	/// Ask the renderer to associate a client-provided framebuffer with internal GPU state.
 	FramebufferLink {
 		payload: FramebufferLinkPayload,
-		dma_bufs: [OwnedFd; 2],
+		dma_bufs: Vec<OwnedFd>,
 		session_id: SessionId,
 	},
 	/// Update which session should be displayed globally.
@@ -27,6 +27,14 @@ pub enum RenderCmd {
 		session_id: Option<SessionId>,
 		transition: Option<SessionTransition>,
 	},
+	/// Presentation mode a session asked for, honored while it is shown fullscreen.
+	SetPresentMode {
+		session_id: SessionId,
+		mode: PresentMode,
+	},
+	/// A session went to sleep or woke up. Sleeping sessions' snapshots may be evicted to
+	/// stay within the GPU memory budget.
+	SessionAwake { session_id: SessionId, awake: bool },
 	/// Drop all GPU resources associated with a disconnected session.
 	SessionRemoved { session_id: SessionId },
 	/// Present a framebuffer on a given monitor.
@@ -35,7 +43,13 @@ pub enum RenderCmd {
 		buffer: BufferIndex,
 		session_id: SessionId,
 		acquire_fence: Option<OwnedFd>,
+		/// `CLOCK_MONOTONIC` nanoseconds the server received the `buffer_request`.
+		requested_ns: u64,
+		/// Regions that changed since the session's previous buffer; empty means all of it.
+		damage: Vec<DamageRect>,
 	},
+	/// Report frame latency histograms with `RenderEvt::FrameLatency`.
+	CollectLatency,
 }
 
 pub type RenderCmdRx = tokio::sync::mpsc::Receiver<RenderCmd>;
@@ -0,0 +1,571 @@
+//! Synthetic sessions speaking the tab protocol over the real socket. Each one links a
+//! swapchain of placeholder buffers on every monitor and submits a frame per tick whenever
+//! it owns a free buffer, measuring how Shift answers.
+
+use std::{
+	collections::HashMap,
+	io,
+	os::{
+		fd::{AsRawFd, FromRawFd, OwnedFd},
+		unix::net::UnixStream,
+	},
+	path::Path,
+	time::Duration,
+};
+
+use tab_protocol::{
+	AuthPayload, BufferIndex, DRM_FORMAT_MOD_LINEAR, FramebufferLinkPayload, LatencyHistogram,
+	MAX_SWAPCHAIN_BUFFERS, MonitorInfo, PayloadEncoding, ProtocolError, SessionCreatePayload,
+	SessionCreatedPayload, SessionInfo, SessionReadyPayload, SessionRole, SessionSwitchPayload,
+	StatsPayload, TabMessage, TabMessageFrame, TabMessageFrameReader, binary, message_header,
+	unix_socket_utils::connect_seqpacket,
+};
+use thiserror::Error;
+use tokio::{
+	io::unix::AsyncFd,
+	task::JoinSet,
+	time::{Instant, MissedTickBehavior},
+};
+
+use super::{DRM_FORMAT_XRGB8888, HeadlessConfig, monotonic_ns};
+
+/// How long the admin waits for `session_created` and `stats`.
+pub(super) const REPLY_TIMEOUT: Duration = Duration::from_secs(1);
+
+#[derive(Debug, Error)]
+pub(super) enum ClientError {
+	#[error("io error: {0}")]
+	Io(#[from] io::Error),
+	#[error("failed to connect: {0}")]
+	Connect(#[from] nix::Error),
+	#[error("protocol error: {0}")]
+	Protocol(#[from] ProtocolError),
+	#[error("authentication failed: {0}")]
+	Auth(String),
+	#[error("unexpected: {0}")]
+	Unexpected(&'static str),
+}
+
+/// What one synthetic session measured. Latencies start at the `buffer_request`.
+#[derive(Debug, Default)]
+pub(super) struct ClientReport {
+	name: String,
+	submitted: u64,
+	/// Frame ticks with a request still in flight or no buffer to draw into.
+	skipped: u64,
+	rejected: u64,
+	presented: u64,
+	missed: u64,
+	input_events: u64,
+	/// Until `buffer_request_ack`.
+	ack: LatencyHistogram,
+	/// Until the frame's vblank, from `frame_presented`.
+	present: LatencyHistogram,
+	/// Until `buffer_release` handed the buffer back.
+	held: LatencyHistogram,
+	/// Input event timestamp until it was read from the socket.
+	input: LatencyHistogram,
+	/// Shift's own histograms, asked for by the admin at the end.
+	stats: Option<StatsPayload>,
+}
+
+impl ClientReport {
+	pub(super) fn log(&self, config: &HeadlessConfig) {
+		let seconds = config.duration.as_secs_f64();
+		tracing::info!(
+			client = %self.name,
+			submitted = self.submitted,
+			skipped = self.skipped,
+			rejected = self.rejected,
+			presented = self.presented,
+			presented_per_sec = format_args!("{:.1}", self.presented as f64 / seconds),
+			missed = self.missed,
+			ack_mean_us = self.ack.mean_us(),
+			ack_p99_us = self.ack.quantile_us(0.99),
+			present_mean_us = self.present.mean_us(),
+			present_p99_us = self.present.quantile_us(0.99),
+			held_mean_us = self.held.mean_us(),
+			input_events = self.input_events,
+			input_mean_us = self.input.mean_us(),
+			input_p99_us = self.input.quantile_us(0.99),
+			"headless client report"
+		);
+		if let Some(stats) = &self.stats {
+			log_stats(stats);
+		}
+	}
+}
+
+/// Logs Shift's per-session and per-monitor latency histograms from a `stats` reply.
+pub(super) fn log_stats(stats: &StatsPayload) {
+	for session in &stats.sessions {
+		tracing::info!(
+			session_id = %session.session_id,
+			input_mean_us = session.input.mean_us(),
+			input_p99_us = session.input.quantile_us(0.99),
+			"shift session latency"
+		);
+		for monitor in &session.monitors {
+			tracing::info!(
+				session_id = %session.session_id,
+				monitor_id = %monitor.monitor_id,
+				acquire_mean_us = monitor.acquire.mean_us(),
+				composite_mean_us = monitor.composite.mean_us(),
+				present_mean_us = monitor.present.mean_us(),
+				present_p99_us = monitor.present.quantile_us(0.99),
+				release_mean_us = monitor.release.mean_us(),
+				"shift frame latency"
+			);
+		}
+	}
+}
+
+#[derive(Debug)]
+struct Swapchain {
+	count: usize,
+	/// Slots the client owns, by [`BufferIndex`].
+	free: [bool; MAX_SWAPCHAIN_BUFFERS],
+	/// When each slot was last submitted, in `CLOCK_MONOTONIC` nanoseconds.
+	submitted_ns: [Option<u64>; MAX_SWAPCHAIN_BUFFERS],
+	next: usize,
+	inflight: Option<BufferIndex>,
+	/// Submission of the newest acked frame not presented yet.
+	unpresented_ns: Option<u64>,
+}
+
+impl Swapchain {
+	fn new(count: usize) -> Self {
+		Self {
+			count,
+			free: std::array::from_fn(|slot| slot < count),
+			submitted_ns: [None; MAX_SWAPCHAIN_BUFFERS],
+			next: 0,
+			inflight: None,
+			unpresented_ns: None,
+		}
+	}
+
+	/// Takes the next free buffer, round robin, unless a request is still in flight.
+	fn acquire(&mut self) -> Option<BufferIndex> {
+		if self.inflight.is_some() {
+			return None;
+		}
+		let slot = (0..self.count)
+			.map(|offset| (self.next + offset) % self.count)
+			.find(|slot| self.free[*slot])?;
+		self.next = slot + 1;
+		self.free[slot] = false;
+		let buffer = BufferIndex::ALL[slot];
+		self.inflight = Some(buffer);
+		Some(buffer)
+	}
+}
+
+struct SyntheticClient {
+	socket: AsyncFd<UnixStream>,
+	reader: TabMessageFrameReader,
+	encoding: PayloadEncoding,
+	session: SessionInfo,
+	swapchains: HashMap<String, Swapchain>,
+	config: HeadlessConfig,
+	report: ClientReport,
+}
+
+/// Connects the admin, which creates the other sessions, runs all of them until the
+/// configured duration is over and returns their reports, the admin's first. Idle sessions
+/// only stay connected and are left out of the reports.
+pub(super) async fn run_clients(
+	socket_path: &Path,
+	admin_token: String,
+	config: &HeadlessConfig,
+) -> Result<Vec<ClientReport>, ClientError> {
+	let deadline = Instant::now() + config.duration;
+	let mut admin = SyntheticClient::connect(socket_path, "admin", admin_token, config).await?;
+	let mut session_ids = vec![admin.session.id.clone()];
+	let mut tasks = JoinSet::new();
+	for i in 1..config.clients {
+		let name = format!("headless-{i}");
+		let created = admin.create_session(&name).await?;
+		session_ids.push(created.session.id);
+		let mut client = SyntheticClient::connect(socket_path, &name, created.token, config).await?;
+		tasks.spawn(async move {
+			client.run(deadline, Vec::new()).await?;
+			Ok::<_, ClientError>(client.report)
+		});
+	}
+	let mut idle = JoinSet::new();
+	for i in 0..config.idle_clients {
+		let name = format!("headless-idle-{i}");
+		let created = admin.create_session(&name).await?;
+		let mut client = SyntheticClient::connect(socket_path, &name, created.token, config).await?;
+		idle.spawn(async move { client.idle(deadline).await });
+	}
+	// The admin's own session stays in the rotation, so input keeps flowing to someone.
+	admin.run(deadline, session_ids).await?;
+	admin.collect_stats().await?;
+
+	let mut reports = vec![admin.report];
+	while let Some(result) = tasks.join_next().await {
+		match result {
+			Ok(Ok(report)) => reports.push(report),
+			Ok(Err(e)) => tracing::warn!("headless client failed: {e}"),
+			Err(e) => tracing::warn!("headless client task failed: {e}"),
+		}
+	}
+	while let Some(result) = idle.join_next().await {
+		match result {
+			Ok(Ok(())) => {}
+			Ok(Err(e)) => tracing::warn!("idle headless client failed: {e}"),
+			Err(e) => tracing::warn!("idle headless client task failed: {e}"),
+		}
+	}
+	Ok(reports)
+}
+
+impl SyntheticClient {
+	async fn connect(
+		socket_path: &Path,
+		name: &str,
+		token: String,
+		config: &HeadlessConfig,
+	) -> Result<Self, ClientError> {
+		let socket = connect_seqpacket(socket_path)?;
+		socket.set_nonblocking(true)?;
+		let socket = AsyncFd::new(socket)?;
+		let mut reader = TabMessageFrameReader::new();
+		let TabMessage::Hello(hello) = reader.read_message_from_async_fd(&socket).await? else {
+			return Err(ClientError::Unexpected("expected hello"));
+		};
+		let encoding = if hello.encodings.contains(&PayloadEncoding::Binary) {
+			PayloadEncoding::Binary
+		} else {
+			PayloadEncoding::Json
+		};
+		TabMessageFrame::json(
+			message_header::AUTH,
+			AuthPayload {
+				token,
+				encoding,
+				input_ring: false,
+				input_batch: true,
+			},
+		)
+		.send_frame_to_async_fd(&socket)
+		.await?;
+		let auth_ok = match reader.read_message_from_async_fd(&socket).await? {
+			TabMessage::AuthOk { payload, .. } => payload,
+			TabMessage::AuthError(payload) => return Err(ClientError::Auth(payload.error)),
+			_ => return Err(ClientError::Unexpected("expected auth_ok")),
+		};
+		let mut client = Self {
+			socket,
+			reader,
+			encoding: auth_ok.encoding,
+			session: auth_ok.session,
+			swapchains: HashMap::new(),
+			config: config.clone(),
+			report: ClientReport {
+				name: name.to_string(),
+				..Default::default()
+			},
+		};
+		for monitor in &auth_ok.monitors {
+			client.link(monitor).await?;
+		}
+		if client.session.role == SessionRole::Session {
+			client
+				.send(TabMessageFrame::json(
+					message_header::SESSION_READY,
+					SessionReadyPayload {
+						session_id: client.session.id.clone(),
+					},
+				))
+				.await?;
+		}
+		Ok(client)
+	}
+
+	async fn send(&self, frame: TabMessageFrame) -> Result<(), ClientError> {
+		frame.send_frame_to_async_fd(&self.socket).await?;
+		Ok(())
+	}
+
+	/// Links a swapchain of empty memfds; the headless renderer never reads them.
+	async fn link(&mut self, monitor: &MonitorInfo) -> Result<(), ClientError> {
+		let buffers = (0..self.config.buffers)
+			.map(|_| placeholder_buffer(0))
+			.collect::<io::Result<Vec<_>>>()?;
+		let mut frame = TabMessageFrame::json(
+			message_header::FRAMEBUFFER_LINK,
+			FramebufferLinkPayload {
+				monitor_id: monitor.id.clone(),
+				width: monitor.width,
+				height: monitor.height,
+				stride: monitor.width * 4,
+				offset: 0,
+				fourcc: DRM_FORMAT_XRGB8888 as i32,
+				modifier: Some(DRM_FORMAT_MOD_LINEAR),
+				planes: Vec::new(),
+			},
+		);
+		frame.fds = buffers.iter().map(AsRawFd::as_raw_fd).collect();
+		self.send(frame).await?;
+		self
+			.swapchains
+			.insert(monitor.id.clone(), Swapchain::new(self.config.buffers));
+		Ok(())
+	}
+
+	async fn create_session(&mut self, name: &str) -> Result<SessionCreatedPayload, ClientError> {
+		self
+			.send(TabMessageFrame::json(
+				message_header::SESSION_CREATE,
+				SessionCreatePayload {
+					role: SessionRole::Session,
+					display_name: Some(name.to_string()),
+				},
+			))
+			.await?;
+		let timeout = tokio::time::sleep(REPLY_TIMEOUT);
+		tokio::pin!(timeout);
+		loop {
+			tokio::select! {
+				message = self.reader.read_message_from_async_fd(&self.socket) => {
+					match message? {
+						TabMessage::SessionCreated(created) => return Ok(created),
+						other => self.handle_message(other).await?,
+					}
+				}
+				_ = &mut timeout => return Err(ClientError::Unexpected("no session_created")),
+			}
+		}
+	}
+
+	/// Asks for Shift's latency histograms and waits for them.
+	async fn collect_stats(&mut self) -> Result<(), ClientError> {
+		self
+			.send(TabMessageFrame::no_payload(message_header::STATS_REQUEST))
+			.await?;
+		let timeout = tokio::time::sleep(REPLY_TIMEOUT);
+		tokio::pin!(timeout);
+		while self.report.stats.is_none() {
+			tokio::select! {
+				message = self.reader.read_message_from_async_fd(&self.socket) => {
+					self.handle_message(message?).await?;
+				}
+				_ = &mut timeout => {
+					tracing::warn!("no stats reply from shift");
+					break;
+				}
+			}
+		}
+		Ok(())
+	}
+
+	/// Submits frames until `deadline`. With more than one entry in `rotation`, the client
+	/// (an admin) also switches the active session through it.
+	async fn run(&mut self, deadline: Instant, rotation: Vec<String>) -> Result<(), ClientError> {
+		let mut frame_tick = tokio::time::interval(self.config.frame_interval());
+		frame_tick.set_missed_tick_behavior(MissedTickBehavior::Skip);
+		let switch_interval = self
+			.config
+			.switch_interval
+			.filter(|_| rotation.len() > 1)
+			.unwrap_or(Duration::MAX);
+		let mut switch_at = Instant::now().checked_add(switch_interval);
+		let mut next_session = 1;
+		loop {
+			tokio::select! {
+				message = self.reader.read_message_from_async_fd(&self.socket) => {
+					self.handle_message(message?).await?;
+				}
+				_ = frame_tick.tick() => self.submit_frames().await?,
+				_ = tokio::time::sleep_until(switch_at.unwrap_or(deadline)), if switch_at.is_some() => {
+					self
+						.send(TabMessageFrame::json(
+							message_header::SESSION_SWITCH,
+							SessionSwitchPayload {
+								session_id: rotation[next_session].clone(),
+								animation: None,
+								duration: Duration::ZERO,
+							},
+						))
+						.await?;
+					next_session = (next_session + 1) % rotation.len();
+					switch_at = Instant::now().checked_add(switch_interval);
+				}
+				_ = tokio::time::sleep_until(deadline) => return Ok(()),
+			}
+		}
+	}
+
+	/// Answers whatever Shift sends until `deadline` without submitting a frame.
+	async fn idle(&mut self, deadline: Instant) -> Result<(), ClientError> {
+		loop {
+			tokio::select! {
+				message = self.reader.read_message_from_async_fd(&self.socket) => {
+					self.handle_message(message?).await?;
+				}
+				_ = tokio::time::sleep_until(deadline) => return Ok(()),
+			}
+		}
+	}
+
+	async fn submit_frames(&mut self) -> Result<(), ClientError> {
+		let mut frames = Vec::new();
+		for (monitor_id, swapchain) in &mut self.swapchains {
+			match swapchain.acquire() {
+				Some(buffer) => frames.push((monitor_id.clone(), buffer)),
+				None => self.report.skipped += 1,
+			}
+		}
+		for (monitor_id, buffer) in frames {
+			let mut frame = match self.encoding {
+				PayloadEncoding::Binary => TabMessageFrame::binary(
+					message_header::BUFFER_REQUEST,
+					binary::encode_buffer_request_payload(&monitor_id, buffer, &[])?,
+				),
+				PayloadEncoding::Json => TabMessageFrame::raw(
+					message_header::BUFFER_REQUEST,
+					format!("{monitor_id} {}", buffer as u8),
+				),
+			};
+			let fence = self.acquire_fence()?;
+			frame.fds = fence.iter().map(AsRawFd::as_raw_fd).collect();
+			if let Some(swapchain) = self.swapchains.get_mut(&monitor_id) {
+				swapchain.submitted_ns[buffer as usize] = Some(monotonic_ns());
+			}
+			self.send(frame).await?;
+			self.report.submitted += 1;
+		}
+		Ok(())
+	}
+
+	/// The acquire fence for the next frame, `None` when frames go without fences.
+	fn acquire_fence(&self) -> io::Result<Option<OwnedFd>> {
+		if self.config.gpu_time.is_zero() {
+			return Ok(None);
+		}
+		eventfd_fence(self.config.gpu_time).map(Some)
+	}
+
+	async fn handle_message(&mut self, message: TabMessage) -> Result<(), ClientError> {
+		let now_ns = monotonic_ns();
+		match message {
+			TabMessage::BufferRequestAck(payload) => {
+				let Some(swapchain) = self.swapchains.get_mut(&payload.monitor_id) else {
+					return Ok(());
+				};
+				if swapchain
+					.inflight
+					.take_if(|b| *b == payload.buffer)
+					.is_none()
+				{
+					return Ok(());
+				}
+				if let Some(submitted_ns) = swapchain.submitted_ns[payload.buffer as usize] {
+					self
+						.report
+						.ack
+						.record_ns(now_ns.saturating_sub(submitted_ns));
+					swapchain.unpresented_ns = Some(submitted_ns);
+				}
+			}
+			TabMessage::BufferRequestRejected(payload) => {
+				self.report.rejected += 1;
+				if let Some(swapchain) = self.swapchains.get_mut(&payload.monitor_id) {
+					swapchain.inflight = None;
+					swapchain.free[payload.buffer as usize] = true;
+				}
+			}
+			TabMessage::BufferRelease { payload, .. } => {
+				let Some(swapchain) = self.swapchains.get_mut(&payload.monitor_id) else {
+					return Ok(());
+				};
+				swapchain.free[payload.buffer as usize] = true;
+				if let Some(submitted_ns) = swapchain.submitted_ns[payload.buffer as usize].take() {
+					self
+						.report
+						.held
+						.record_ns(now_ns.saturating_sub(submitted_ns));
+				}
+			}
+			TabMessage::FramePresented(payload) => {
+				self.report.presented += 1;
+				self.report.missed += payload.missed as u64;
+				if let Some(submitted_ns) = self
+					.swapchains
+					.get_mut(&payload.monitor_id)
+					.and_then(|swapchain| swapchain.unpresented_ns.take())
+				{
+					self
+						.report
+						.present
+						.record_ns(payload.vblank_ns.saturating_sub(submitted_ns));
+				}
+			}
+			TabMessage::InputEvent(event) => self.record_input(&[event], now_ns),
+			TabMessage::InputBatch(batch) => self.record_input(&batch.events, now_ns),
+			TabMessage::MonitorAdded(payload) => self.link(&payload.monitor).await?,
+			TabMessage::MonitorRemoved(payload) => {
+				self.swapchains.remove(&payload.monitor_id);
+			}
+			TabMessage::Stats(stats) => self.report.stats = Some(stats),
+			TabMessage::Error(payload) => {
+				tracing::warn!(client = %self.report.name, code = %payload.code, message = ?payload.message, "shift error");
+			}
+			_ => {}
+		}
+		Ok(())
+	}
+
+	fn record_input(&mut self, events: &[tab_protocol::InputEventPayload], now_ns: u64) {
+		let now_us = now_ns / 1_000;
+		for event in events {
+			self.report.input_events += 1;
+			self
+				.report
+				.input
+				.record_us(now_us.saturating_sub(event.time_usec()));
+		}
+	}
+}
+
+/// An empty memfd of `size` bytes standing in for a dma-buf; the headless renderer never
+/// reads it.
+pub(super) fn placeholder_buffer(size: u64) -> io::Result<OwnedFd> {
+	let fd = unsafe { libc::memfd_create(c"shift-headless".as_ptr(), libc::MFD_CLOEXEC) };
+	if fd < 0 {
+		return Err(io::Error::last_os_error());
+	}
+	let buffer = unsafe { OwnedFd::from_raw_fd(fd) };
+	if size > 0 && unsafe { libc::ftruncate(buffer.as_raw_fd(), size as libc::off_t) } < 0 {
+		return Err(io::Error::last_os_error());
+	}
+	Ok(buffer)
+}
+
+/// An eventfd standing in for the sync_file a GPU would signal, written once `gpu_time`
+/// has passed.
+pub(super) fn eventfd_fence(gpu_time: Duration) -> io::Result<OwnedFd> {
+	let fd = unsafe { libc::eventfd(0, libc::EFD_CLOEXEC | libc::EFD_NONBLOCK) };
+	if fd < 0 {
+		return Err(io::Error::last_os_error());
+	}
+	let fence = unsafe { OwnedFd::from_raw_fd(fd) };
+	let signal = fence.try_clone()?;
+	tokio::spawn(async move {
+		if !gpu_time.is_zero() {
+			tokio::time::sleep(gpu_time).await;
+		}
+		let value = 1u64;
+		unsafe {
+			libc::write(
+				signal.as_raw_fd(),
+				(&value as *const u64).cast(),
+				std::mem::size_of::<u64>(),
+			);
+		}
+	});
+	Ok(fence)
+}
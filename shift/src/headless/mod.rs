@@ -0,0 +1,232 @@
+//! `SHIFT_HEADLESS=1`: the server without DRM, libinput or real sessions.
+//!
+//! [`HeadlessRenderer`] stands in for the rendering layer, a synthetic input source feeds
+//! pointer motion and [`client`] connects sessions that submit frames at a fixed rate.
+//! After the run every client logs what it measured and the admin logs Shift's own
+//! `stats`, so changes to the server loop or protocol can be compared with numbers.
+//! With `SHIFT_HEADLESS_REPLAY` the synthetic sessions give way to a recorded one, see
+//! [`replay`].
+//!
+//! To see what the server loop pays per connected client, compare the input and frame
+//! latencies of two runs that differ only in `SHIFT_HEADLESS_IDLE_CLIENTS`, e.g. 0 and 255:
+//! idle sessions stay connected without submitting, so any difference is routing cost.
+
+mod client;
+mod replay;
+
+use std::{
+	path::{Path, PathBuf},
+	sync::Arc,
+	time::Duration,
+};
+
+use tab_protocol::{DRM_FORMAT_MOD_LINEAR, FormatModifiers, InputEventPayload};
+use tokio::time::MissedTickBehavior;
+
+use crate::{
+	comms::input2server::{InputBatch, InputEvt, InputEvtTx},
+	input_layer::channels::Channels as InputChannels,
+	monitor::{Monitor, MonitorId},
+	rendering_layer::{
+		channels::Channels as RenderChannels, headless::HeadlessRenderer, monotonic_ns,
+	},
+	server_layer::ShiftServer,
+};
+
+const DRM_FORMAT_XRGB8888: u32 = 0x3432_5258;
+const DRM_FORMAT_ARGB8888: u32 = 0x3432_5241;
+
+/// What a headless run simulates, from `SHIFT_HEADLESS_*`.
+#[derive(Debug, Clone)]
+pub struct HeadlessConfig {
+	/// Sessions connected, the admin included.
+	pub clients: usize,
+	/// Further sessions that connect and link but never submit, so the cost of routing
+	/// input and frames can be measured against the number of connected clients.
+	pub idle_clients: usize,
+	pub monitors: usize,
+	pub width: i32,
+	pub height: i32,
+	pub refresh_hz: u32,
+	/// Frames each session submits per second on every monitor.
+	pub fps: u32,
+	/// Buffers in every swapchain.
+	pub buffers: usize,
+	/// Pointer events per second sent to the active session; `0` disables input.
+	pub input_hz: u32,
+	/// How long after its `buffer_request` a frame's acquire fence signals; zero sends
+	/// frames without one.
+	pub gpu_time: Duration,
+	/// The admin cycles the active session through all sessions at this interval.
+	pub switch_interval: Option<Duration>,
+	/// Ignored when replaying, which runs as long as the capture.
+	pub duration: Duration,
+	/// Capture file to replay instead of running the synthetic sessions.
+	pub replay: Option<PathBuf>,
+}
+
+impl HeadlessConfig {
+	pub fn from_env() -> Self {
+		let switch_ms = env_number("SHIFT_HEADLESS_SWITCH_MS", 0);
+		Self {
+			clients: env_number("SHIFT_HEADLESS_CLIENTS", 2).max(1) as usize,
+			idle_clients: env_number("SHIFT_HEADLESS_IDLE_CLIENTS", 0) as usize,
+			monitors: env_number("SHIFT_HEADLESS_MONITORS", 1).max(1) as usize,
+			width: env_number("SHIFT_HEADLESS_WIDTH", 1920) as i32,
+			height: env_number("SHIFT_HEADLESS_HEIGHT", 1080) as i32,
+			refresh_hz: env_number("SHIFT_HEADLESS_REFRESH_HZ", 60).max(1) as u32,
+			fps: env_number("SHIFT_HEADLESS_FPS", 60).max(1) as u32,
+			buffers: env_number("SHIFT_HEADLESS_BUFFERS", 3).clamp(
+				tab_protocol::MIN_SWAPCHAIN_BUFFERS as u64,
+				tab_protocol::MAX_SWAPCHAIN_BUFFERS as u64,
+			) as usize,
+			input_hz: env_number("SHIFT_HEADLESS_INPUT_HZ", 1000) as u32,
+			gpu_time: Duration::from_micros(env_number("SHIFT_HEADLESS_GPU_US", 0)),
+			switch_interval: (switch_ms > 0).then(|| Duration::from_millis(switch_ms)),
+			duration: Duration::from_secs(env_number("SHIFT_HEADLESS_SECONDS", 10).max(1)),
+			replay: std::env::var_os("SHIFT_HEADLESS_REPLAY")
+				.filter(|path| !path.is_empty())
+				.map(PathBuf::from),
+		}
+	}
+
+	fn refresh(&self) -> Duration {
+		Duration::from_secs(1) / self.refresh_hz
+	}
+
+	fn frame_interval(&self) -> Duration {
+		Duration::from_secs(1) / self.fps
+	}
+
+	fn create_monitors(&self) -> Vec<Monitor> {
+		let formats: Arc<[FormatModifiers]> = [DRM_FORMAT_XRGB8888, DRM_FORMAT_ARGB8888]
+			.into_iter()
+			.map(|fourcc| FormatModifiers {
+				fourcc,
+				modifiers: vec![DRM_FORMAT_MOD_LINEAR],
+			})
+			.collect();
+		(0..self.monitors)
+			.map(|i| Monitor {
+				id: MonitorId::rand(),
+				width: self.width,
+				height: self.height,
+				refresh_rate: self.refresh_hz,
+				name: format!("HEADLESS-{}", i + 1),
+				formats: Arc::clone(&formats),
+			})
+			.collect()
+	}
+}
+
+fn env_number(name: &str, default: u64) -> u64 {
+	match std::env::var(name) {
+		Ok(raw) => raw.trim().parse().unwrap_or_else(|e| {
+			tracing::warn!(value = %raw, "invalid {name}: {e}");
+			default
+		}),
+		Err(_) => default,
+	}
+}
+
+pub async fn run(socket_path: PathBuf) {
+	let config = HeadlessConfig::from_env();
+	tracing::info!(?config, "starting headless shift on {:?}", socket_path);
+
+	let (server_render_channels, rendering_render_channels) = RenderChannels::new().split();
+	let (server_input_channels, input_layer_channels) = InputChannels::new().split();
+	let mut server = match ShiftServer::bind(
+		&socket_path,
+		server_render_channels,
+		server_input_channels.into_parts(),
+	)
+	.await
+	{
+		Ok(s) => s,
+		Err(e) => {
+			tracing::error!("failed to bind ShiftServer at {:?}: {e}", socket_path);
+			return;
+		}
+	};
+	let token = server.add_admin_session();
+	let renderer = match HeadlessRenderer::new(
+		rendering_render_channels,
+		config.create_monitors(),
+		config.refresh(),
+	) {
+		Ok(r) => r,
+		Err(e) => {
+			tracing::error!("failed to init headless renderer: {e}");
+			return;
+		}
+	};
+
+	tokio::select! {
+		_ = server.run() => tracing::error!("server stopped before the clients finished"),
+		result = renderer.run() => tracing::error!("headless renderer stopped early: {result:?}"),
+		_ = synthetic_input(input_layer_channels.into_parts(), config.input_hz) => {
+			tracing::error!("input channel closed before the clients finished");
+		}
+		_ = run_sessions(&socket_path, token.to_string(), &config) => {}
+	}
+}
+
+/// Runs the synthetic sessions, or the replay, to the end and logs their reports.
+async fn run_sessions(socket_path: &Path, admin_token: String, config: &HeadlessConfig) {
+	if let Some(capture) = &config.replay {
+		match replay::run_replay(socket_path, admin_token, config, capture).await {
+			Ok(report) => report.log(),
+			Err(e) => tracing::error!("headless replay failed: {e}"),
+		}
+		return;
+	}
+	match client::run_clients(socket_path, admin_token, config).await {
+		Ok(reports) => {
+			for report in &reports {
+				report.log(config);
+			}
+		}
+		Err(e) => tracing::error!("headless client failed: {e}"),
+	}
+}
+
+/// Sends `hz` pointer motion events per second, in batches of at least a millisecond like
+/// libinput dispatches. Returns once the server is gone.
+async fn synthetic_input(events: InputEvtTx, hz: u32) {
+	if hz == 0 {
+		return std::future::pending().await;
+	}
+	let period = (Duration::from_secs(1) / hz).max(Duration::from_millis(1));
+	let per_tick = ((hz as f64 * period.as_secs_f64()).round() as usize).max(1);
+	let mut tick = tokio::time::interval(period);
+	tick.set_missed_tick_behavior(MissedTickBehavior::Skip);
+	let mut step = 0u64;
+	loop {
+		tick.tick().await;
+		let time_usec = monotonic_ns() / 1_000;
+		let batch = (0..per_tick)
+			.map(|_| {
+				step += 1;
+				// A circle, so coordinates stay on screen however long the run.
+				let (sin, cos) = (step as f64 / 200.0).sin_cos();
+				InputEventPayload::PointerMotion {
+					device: 0,
+					time_usec,
+					x: 960.0 + 400.0 * cos,
+					y: 540.0 + 400.0 * sin,
+					dx: -2.0 * sin,
+					dy: 2.0 * cos,
+					unaccel_dx: -2.0 * sin,
+					unaccel_dy: 2.0 * cos,
+				}
+			})
+			.collect();
+		let batch = InputEvt::Batch(InputBatch {
+			events: batch,
+			received_ns: monotonic_ns(),
+		});
+		if events.send(batch).await.is_err() {
+			return;
+		}
+	}
+}
@@ -0,0 +1,493 @@
+//! `SHIFT_HEADLESS_REPLAY=<file>`: drives the headless server with traffic recorded through
+//! `SHIFT_CAPTURE_DIR`.
+//!
+//! The captured frames go out on the admin session with their original spacing. Monitor ids
+//! are mapped onto the headless monitors in order of first use, dma-bufs become memfds of
+//! the same size and acquire fences eventfds, signaled right away if the original had
+//! signaled on arrival and after `SHIFT_HEADLESS_GPU_US` otherwise. What only made sense for
+//! the original session (its `auth`, session management) is left out.
+
+use std::{
+	collections::{HashMap, VecDeque},
+	os::{
+		fd::{AsRawFd, FromRawFd, IntoRawFd, OwnedFd},
+		unix::net::UnixStream,
+	},
+	path::Path,
+	time::Duration,
+};
+
+use tab_protocol::{
+	AuthPayload, BufferIndex, FramebufferLinkBatchEntry, FramebufferLinkBatchPayload,
+	LatencyHistogram, PayloadEncoding, StatsPayload, TabMessage, TabMessageFrame,
+	TabMessageFrameReader, binary,
+	capture::{CaptureReader, CaptureRecord},
+	message_header,
+	unix_socket_utils::connect_seqpacket,
+};
+use tokio::{io::unix::AsyncFd, time::Instant};
+
+use super::{
+	HeadlessConfig,
+	client::{ClientError, REPLY_TIMEOUT, eventfd_fence, log_stats, placeholder_buffer},
+	monotonic_ns,
+};
+
+/// How long replies are still collected after the last captured frame went out.
+const DRAIN_TIME: Duration = Duration::from_millis(250);
+
+/// What the replay measured. Latencies start when the frame was sent.
+#[derive(Debug, Default)]
+pub(super) struct ReplayReport {
+	records: usize,
+	sent: u64,
+	/// Records not replayable on a fresh session.
+	skipped: u64,
+	submitted: u64,
+	rejected: u64,
+	presented: u64,
+	missed: u64,
+	/// Acked frames replaced by a newer one before they were presented.
+	dropped: u64,
+	ack: LatencyHistogram,
+	/// Time between consecutive `buffer_request`s on a monitor, as captured.
+	captured_interval: LatencyHistogram,
+	/// Time between consecutive presented frames on a monitor.
+	present_interval: LatencyHistogram,
+	/// How late frames went out compared to the captured timing.
+	send_lag: LatencyHistogram,
+	stats: Option<StatsPayload>,
+}
+
+impl ReplayReport {
+	pub(super) fn log(&self) {
+		tracing::info!(
+			records = self.records,
+			sent = self.sent,
+			skipped = self.skipped,
+			submitted = self.submitted,
+			rejected = self.rejected,
+			presented = self.presented,
+			missed = self.missed,
+			dropped = self.dropped,
+			ack_mean_us = self.ack.mean_us(),
+			ack_p99_us = self.ack.quantile_us(0.99),
+			captured_interval_mean_us = self.captured_interval.mean_us(),
+			captured_interval_p99_us = self.captured_interval.quantile_us(0.99),
+			present_interval_mean_us = self.present_interval.mean_us(),
+			present_interval_p99_us = self.present_interval.quantile_us(0.99),
+			present_interval_max_us = self.present_interval.max_us,
+			send_lag_p99_us = self.send_lag.quantile_us(0.99),
+			"headless replay report"
+		);
+		if let Some(stats) = &self.stats {
+			log_stats(stats);
+		}
+	}
+}
+
+/// Frames in flight on one headless monitor.
+#[derive(Debug, Default)]
+struct MonitorFrames {
+	/// Requests waiting for an ack, with when they were sent.
+	requests: VecDeque<(BufferIndex, u64)>,
+	/// An acked frame has not been presented yet.
+	unpresented: bool,
+	last_vblank_ns: Option<u64>,
+}
+
+struct Replayer {
+	socket: AsyncFd<UnixStream>,
+	reader: TabMessageFrameReader,
+	/// Headless monitors not mapped to a captured one yet, in `auth_ok` order.
+	unmapped: VecDeque<String>,
+	/// Captured monitor id to headless monitor id, `None` for those left over.
+	monitor_map: HashMap<String, Option<String>>,
+	frames: HashMap<String, MonitorFrames>,
+	/// Last captured `buffer_request` per captured monitor.
+	captured_last_ns: HashMap<String, u64>,
+	gpu_time: Duration,
+	report: ReplayReport,
+}
+
+/// Replays the capture at `path` as the admin session and returns what it measured.
+pub(super) async fn run_replay(
+	socket_path: &Path,
+	admin_token: String,
+	config: &HeadlessConfig,
+	path: &Path,
+) -> Result<ReplayReport, ClientError> {
+	let records = CaptureReader::open(path)?.collect::<Result<Vec<_>, _>>()?;
+	tracing::info!(records = records.len(), "replaying {path:?}");
+	let mut replayer = Replayer::connect(socket_path, admin_token, config, &records).await?;
+	replayer.report.records = records.len();
+
+	let Some(first_ns) = records.first().map(|record| record.timestamp_ns) else {
+		return Ok(replayer.report);
+	};
+	let start = Instant::now();
+	let mut next = 0;
+	while let Some(record) = records.get(next) {
+		let due = start + Duration::from_nanos(record.timestamp_ns.saturating_sub(first_ns));
+		tokio::select! {
+			message = replayer.reader.read_message_from_async_fd(&replayer.socket) => {
+				replayer.handle_message(message?);
+			}
+			_ = tokio::time::sleep_until(due) => {
+				replayer
+					.report
+					.send_lag
+					.record_ns(Instant::now().saturating_duration_since(due).as_nanos() as u64);
+				replayer.replay(record).await?;
+				next += 1;
+			}
+		}
+	}
+	replayer.drain(DRAIN_TIME).await?;
+	replayer.collect_stats().await?;
+	Ok(replayer.report)
+}
+
+impl Replayer {
+	/// Authenticates with the admin token, negotiating what the captured `auth` asked for.
+	async fn connect(
+		socket_path: &Path,
+		token: String,
+		config: &HeadlessConfig,
+		records: &[CaptureRecord],
+	) -> Result<Self, ClientError> {
+		let socket = connect_seqpacket(socket_path)?;
+		socket.set_nonblocking(true)?;
+		let socket = AsyncFd::new(socket)?;
+		let mut reader = TabMessageFrameReader::new();
+		let TabMessage::Hello(hello) = reader.read_message_from_async_fd(&socket).await? else {
+			return Err(ClientError::Unexpected("expected hello"));
+		};
+		let captured_auth = records
+			.iter()
+			.find(|record| record.frame.header.0 == message_header::AUTH)
+			.and_then(|record| TabMessage::parse_message_frame(record.frame.clone()).ok())
+			.and_then(|message| match message {
+				TabMessage::Auth(auth) => Some(auth),
+				_ => None,
+			});
+		let (encoding, input_batch) = match captured_auth {
+			Some(auth) => (auth.encoding, auth.input_batch),
+			None => (PayloadEncoding::Binary, true),
+		};
+		let encoding = if hello.encodings.contains(&encoding) {
+			encoding
+		} else {
+			PayloadEncoding::Json
+		};
+		TabMessageFrame::json(
+			message_header::AUTH,
+			AuthPayload {
+				token,
+				encoding,
+				input_ring: false,
+				input_batch,
+			},
+		)
+		.send_frame_to_async_fd(&socket)
+		.await?;
+		let auth_ok = match reader.read_message_from_async_fd(&socket).await? {
+			TabMessage::AuthOk { payload, .. } => payload,
+			TabMessage::AuthError(payload) => return Err(ClientError::Auth(payload.error)),
+			_ => return Err(ClientError::Unexpected("expected auth_ok")),
+		};
+		Ok(Self {
+			socket,
+			reader,
+			unmapped: auth_ok
+				.monitors
+				.into_iter()
+				.map(|monitor| monitor.id)
+				.collect(),
+			monitor_map: HashMap::new(),
+			frames: HashMap::new(),
+			captured_last_ns: HashMap::new(),
+			gpu_time: config.gpu_time,
+			report: ReplayReport::default(),
+		})
+	}
+
+	/// Headless monitor standing in for `captured`, assigning the next free one on first
+	/// use. `None` once the capture used more monitors than `SHIFT_HEADLESS_MONITORS`.
+	fn map_monitor(&mut self, captured: &str) -> Option<String> {
+		if let Some(mapped) = self.monitor_map.get(captured) {
+			return mapped.clone();
+		}
+		let mapped = self.unmapped.pop_front();
+		if mapped.is_none() {
+			tracing::warn!(
+				monitor_id = captured,
+				"capture uses more monitors than headless has, dropping its frames"
+			);
+		}
+		self
+			.monitor_map
+			.insert(captured.to_string(), mapped.clone());
+		mapped
+	}
+
+	/// Parses `record` with `fds` standing in for the captured ones. The message owns them
+	/// from then on.
+	fn parse_with_fds(record: &CaptureRecord, fds: Vec<OwnedFd>) -> Result<TabMessage, ClientError> {
+		let mut frame = record.frame.clone();
+		frame.fds = fds.into_iter().map(IntoRawFd::into_raw_fd).collect();
+		let raw_fds = frame.fds.clone();
+		TabMessage::parse_message_frame(frame).map_err(|e| {
+			// Parsing only takes ownership of the FDs once the payload checked out.
+			for fd in raw_fds {
+				drop(unsafe { OwnedFd::from_raw_fd(fd) });
+			}
+			e.into()
+		})
+	}
+
+	async fn replay(&mut self, record: &CaptureRecord) -> Result<(), ClientError> {
+		let frame = match record.frame.header.0.as_str() {
+			message_header::AUTH
+			| message_header::SESSION_CREATE
+			| message_header::SESSION_SWITCH
+			| message_header::SESSION_READY
+			| message_header::INPUT_CAUGHT_UP
+			| message_header::STATS_REQUEST => None,
+			message_header::FRAMEBUFFER_LINK => self.framebuffer_link(record)?,
+			message_header::FRAMEBUFFER_LINK_BATCH => self.framebuffer_link_batch(record)?,
+			message_header::BUFFER_REQUEST => self.buffer_request(record)?,
+			_ if record.fds.is_empty() => Some((record.frame.clone(), Vec::new())),
+			_ => None,
+		};
+		// The placeholder FDs stay open until the frame is sent.
+		let Some((frame, _fds)) = frame else {
+			self.report.skipped += 1;
+			return Ok(());
+		};
+		frame.send_frame_to_async_fd(&self.socket).await?;
+		self.report.sent += 1;
+		Ok(())
+	}
+
+	fn framebuffer_link(
+		&mut self,
+		record: &CaptureRecord,
+	) -> Result<Option<(TabMessageFrame, Vec<OwnedFd>)>, ClientError> {
+		let buffers = record
+			.fds
+			.iter()
+			.map(|info| placeholder_buffer(info.size))
+			.collect::<std::io::Result<Vec<_>>>()?;
+		let TabMessage::FramebufferLink {
+			mut payload,
+			dma_bufs,
+		} = Self::parse_with_fds(record, buffers)?
+		else {
+			return Err(ClientError::Unexpected(
+				"framebuffer_link did not parse as one",
+			));
+		};
+		let Some(monitor_id) = self.map_monitor(&payload.monitor_id) else {
+			return Ok(None);
+		};
+		payload.monitor_id = monitor_id.clone();
+		self.frames.entry(monitor_id).or_default();
+		let mut frame = TabMessageFrame::json(message_header::FRAMEBUFFER_LINK, payload);
+		frame.fds = dma_bufs.iter().map(AsRawFd::as_raw_fd).collect();
+		Ok(Some((frame, dma_bufs)))
+	}
+
+	fn framebuffer_link_batch(
+		&mut self,
+		record: &CaptureRecord,
+	) -> Result<Option<(TabMessageFrame, Vec<OwnedFd>)>, ClientError> {
+		let buffers = record
+			.fds
+			.iter()
+			.map(|info| placeholder_buffer(info.size))
+			.collect::<std::io::Result<Vec<_>>>()?;
+		let TabMessage::FramebufferLinkBatch(links) = Self::parse_with_fds(record, buffers)? else {
+			return Err(ClientError::Unexpected(
+				"framebuffer_link_batch did not parse as one",
+			));
+		};
+		let mut entries = Vec::with_capacity(links.len());
+		let mut fds = Vec::new();
+		for (mut link, dma_bufs) in links {
+			// Links for monitors that could not be mapped are dropped with their buffers.
+			let Some(monitor_id) = self.map_monitor(&link.monitor_id) else {
+				continue;
+			};
+			link.monitor_id = monitor_id.clone();
+			self.frames.entry(monitor_id).or_default();
+			entries.push(FramebufferLinkBatchEntry {
+				link,
+				buffers: dma_bufs.len() as u32,
+			});
+			fds.extend(dma_bufs);
+		}
+		if entries.is_empty() {
+			return Ok(None);
+		}
+		let mut frame = TabMessageFrame::json(
+			message_header::FRAMEBUFFER_LINK_BATCH,
+			FramebufferLinkBatchPayload { links: entries },
+		);
+		frame.fds = fds.iter().map(AsRawFd::as_raw_fd).collect();
+		Ok(Some((frame, fds)))
+	}
+
+	fn buffer_request(
+		&mut self,
+		record: &CaptureRecord,
+	) -> Result<Option<(TabMessageFrame, Vec<OwnedFd>)>, ClientError> {
+		let fence = record
+			.fds
+			.iter()
+			.map(|info| {
+				eventfd_fence(if info.signaled {
+					Duration::ZERO
+				} else {
+					self.gpu_time
+				})
+			})
+			.collect::<std::io::Result<Vec<_>>>()?;
+		let TabMessage::BufferRequest {
+			payload,
+			acquire_fence,
+		} = Self::parse_with_fds(record, fence)?
+		else {
+			return Err(ClientError::Unexpected(
+				"buffer_request did not parse as one",
+			));
+		};
+		if let Some(last_ns) = self
+			.captured_last_ns
+			.insert(payload.monitor_id.clone(), record.timestamp_ns)
+		{
+			self
+				.report
+				.captured_interval
+				.record_ns(record.timestamp_ns.saturating_sub(last_ns));
+		}
+		let Some(monitor_id) = self.map_monitor(&payload.monitor_id) else {
+			return Ok(None);
+		};
+		// Keep the captured encoding; Shift accepts either.
+		let mut frame = if record.frame.binary.is_some() {
+			TabMessageFrame::binary(
+				message_header::BUFFER_REQUEST,
+				binary::encode_buffer_request_payload(&monitor_id, payload.buffer, &payload.damage)?,
+			)
+		} else {
+			let mut text = format!("{monitor_id} {}", payload.buffer as u8);
+			for rect in &payload.damage {
+				text.push_str(&format!(
+					" {},{},{},{}",
+					rect.x, rect.y, rect.width, rect.height
+				));
+			}
+			TabMessageFrame::raw(message_header::BUFFER_REQUEST, text)
+		};
+		let fds: Vec<OwnedFd> = acquire_fence.into_iter().collect();
+		frame.fds = fds.iter().map(AsRawFd::as_raw_fd).collect();
+		self
+			.frames
+			.entry(monitor_id)
+			.or_default()
+			.requests
+			.push_back((payload.buffer, monotonic_ns()));
+		self.report.submitted += 1;
+		Ok(Some((frame, fds)))
+	}
+
+	fn handle_message(&mut self, message: TabMessage) {
+		let now_ns = monotonic_ns();
+		match message {
+			TabMessage::BufferRequestAck(payload) => {
+				let Some(frames) = self.frames.get_mut(&payload.monitor_id) else {
+					return;
+				};
+				let Some(position) = frames
+					.requests
+					.iter()
+					.position(|(buffer, _)| *buffer == payload.buffer)
+				else {
+					return;
+				};
+				let (_, sent_ns) = frames.requests.remove(position).unwrap();
+				self.report.ack.record_ns(now_ns.saturating_sub(sent_ns));
+				if frames.unpresented {
+					self.report.dropped += 1;
+				}
+				frames.unpresented = true;
+			}
+			TabMessage::BufferRequestRejected(payload) => {
+				self.report.rejected += 1;
+				if let Some(frames) = self.frames.get_mut(&payload.monitor_id)
+					&& let Some(position) = frames
+						.requests
+						.iter()
+						.position(|(buffer, _)| *buffer == payload.buffer)
+				{
+					frames.requests.remove(position);
+				}
+			}
+			TabMessage::FramePresented(payload) => {
+				self.report.presented += 1;
+				self.report.missed += payload.missed as u64;
+				let Some(frames) = self.frames.get_mut(&payload.monitor_id) else {
+					return;
+				};
+				frames.unpresented = false;
+				if let Some(last_ns) = frames.last_vblank_ns.replace(payload.vblank_ns) {
+					self
+						.report
+						.present_interval
+						.record_ns(payload.vblank_ns.saturating_sub(last_ns));
+				}
+			}
+			TabMessage::Stats(stats) => self.report.stats = Some(stats),
+			TabMessage::Error(payload) => {
+				tracing::warn!(code = %payload.code, message = ?payload.message, "shift error during replay");
+			}
+			_ => {}
+		}
+	}
+
+	/// Keeps handling replies for `time`.
+	async fn drain(&mut self, time: Duration) -> Result<(), ClientError> {
+		let deadline = tokio::time::sleep(time);
+		tokio::pin!(deadline);
+		loop {
+			tokio::select! {
+				message = self.reader.read_message_from_async_fd(&self.socket) => {
+					self.handle_message(message?);
+				}
+				_ = &mut deadline => return Ok(()),
+			}
+		}
+	}
+
+	/// Asks for Shift's latency histograms and waits for them.
+	async fn collect_stats(&mut self) -> Result<(), ClientError> {
+		TabMessageFrame::no_payload(message_header::STATS_REQUEST)
+			.send_frame_to_async_fd(&self.socket)
+			.await?;
+		let timeout = tokio::time::sleep(REPLY_TIMEOUT);
+		tokio::pin!(timeout);
+		while self.report.stats.is_none() {
+			tokio::select! {
+				message = self.reader.read_message_from_async_fd(&self.socket) => {
+					self.handle_message(message?);
+				}
+				_ = &mut timeout => {
+					tracing::warn!("no stats reply from shift");
+					break;
+				}
+			}
+		}
+		Ok(())
+	}
+}
@@ -35,7 +35,10 @@ use tab_protocol::{
 };
 use thiserror::Error;
 
-use crate::comms::input2server::{InputEvt, InputEvtTx};
+use crate::{
+	comms::input2server::{InputBatch, InputEvt, InputEvtTx},
+	rendering_layer::monotonic_ns,
+};
 
 #[derive(Debug, Error)]
 pub enum InputError {
@@ -52,6 +55,8 @@ pub struct InputLayer {
 	tap_drag: bool,
 	tap_drag_lock: bool,
 	tap_button_map: TapButtonMap,
+	/// `SCHED_FIFO` priority for the input thread, from `SHIFT_INPUT_RT_PRIORITY`.
+	rt_priority: Option<i32>,
 }
 
 impl InputLayer {
@@ -69,6 +74,10 @@ impl InputLayer {
 			"lmr" => TapButtonMap::LeftMiddleRight,
 			_ => TapButtonMap::LeftRightMiddle,
 		};
+		let rt_priority = std::env::var("SHIFT_INPUT_RT_PRIORITY")
+			.ok()
+			.and_then(|v| v.parse::<i32>().ok())
+			.filter(|priority| *priority > 0);
 		Self {
 			event_tx,
 			seat,
@@ -76,6 +85,7 @@ impl InputLayer {
 			tap_drag,
 			tap_drag_lock,
 			tap_button_map,
+			rt_priority,
 		}
 	}
 
@@ -88,9 +98,21 @@ impl InputLayer {
 			tap_drag_lock: self.tap_drag_lock,
 			tap_button_map: self.tap_button_map,
 		};
-		tokio::task::spawn_blocking(move || run_blocking(tx, seat, input_config))
+		let rt_priority = self.rt_priority;
+		// A thread of its own rather than the blocking pool, so it can be given a real-time
+		// priority without affecting other blocking work.
+		let (result_tx, result_rx) = tokio::sync::oneshot::channel();
+		std::thread::Builder::new()
+			.name("shift-input".into())
+			.spawn(move || {
+				if let Some(priority) = rt_priority {
+					set_realtime_priority(priority);
+				}
+				let _ = result_tx.send(run_blocking(tx, seat, input_config));
+			})?;
+		result_rx
 			.await
-			.map_err(|e| io::Error::other(format!("input task join error: {e}")))?
+			.map_err(|_| io::Error::other("input thread panicked"))?
 	}
 }
 
@@ -112,6 +134,28 @@ fn env_bool(name: &str, default: bool) -> bool {
 	}
 }
 
+/// Moves the calling thread to `SCHED_FIFO`. Needs `CAP_SYS_NICE` or an `RLIMIT_RTPRIO`
+/// allowance; without either the thread keeps its normal priority.
+fn set_realtime_priority(priority: i32) {
+	let min = unsafe { libc::sched_get_priority_min(libc::SCHED_FIFO) };
+	let max = unsafe { libc::sched_get_priority_max(libc::SCHED_FIFO) };
+	let param = libc::sched_param {
+		sched_priority: priority.clamp(min, max),
+	};
+	if unsafe { libc::sched_setscheduler(0, libc::SCHED_FIFO, &param) } != 0 {
+		let err = io::Error::last_os_error();
+		tracing::warn!(
+			priority,
+			"failed to run input thread under SCHED_FIFO: {err}"
+		);
+	} else {
+		tracing::info!(
+			priority = param.sched_priority,
+			"input thread running under SCHED_FIFO"
+		);
+	}
+}
+
 fn run_blocking(
 	event_tx: InputEvtTx,
 	seat: String,
@@ -147,17 +191,24 @@ fn run_blocking(
 			});
 			return Err(e.into());
 		}
+		let received_ns = monotonic_ns();
+		let mut events = Vec::new();
 		for event in &mut input {
 			if let Event::Device(DeviceEvent::Added(added)) = &event {
 				let mut device = added.device();
 				configure_device_tap(&mut device, input_config);
 			}
-			let Some(payload) = map_event(event) else {
-				continue;
-			};
-			if event_tx.blocking_send(InputEvt::Event(payload)).is_err() {
-				return Ok(());
-			}
+			events.extend(map_event(event));
+		}
+		if events.is_empty() {
+			continue;
+		}
+		let batch = InputBatch {
+			events,
+			received_ns,
+		};
+		if event_tx.blocking_send(InputEvt::Batch(batch)).is_err() {
+			return Ok(());
 		}
 	}
 }
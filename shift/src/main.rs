@@ -11,6 +11,7 @@ use crate::{
 mod auth;
 mod client_layer;
 mod comms;
+mod headless;
 mod ids;
 mod input_layer;
 mod monitor;
@@ -36,6 +37,12 @@ async fn main() {
 		.map(PathBuf::from)
 		.unwrap_or_else(|| "/tmp/shift.sock".into());
 
+	// ---- headless: no DRM or libinput, synthetic clients ----
+	if std::env::var_os("SHIFT_HEADLESS").is_some_and(|v| v != "0") {
+		headless::run(socket_path).await;
+		return;
+	}
+
 	// ---- create inter-layer channels ----
 	let render_channels = RenderChannels::new();
 	let (server_render_channels, rendering_render_channels) = render_channels.split();
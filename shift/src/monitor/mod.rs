@@ -1,5 +1,7 @@
+use std::sync::Arc;
+
 use crate::define_id_type;
-use tab_protocol::MonitorInfo as ProtocolMonitorInfo;
+use tab_protocol::{FormatModifiers, MonitorInfo as ProtocolMonitorInfo};
 
 define_id_type!(Monitor, "mon_");
 #[derive(Debug, Clone)]
@@ -9,6 +11,8 @@ pub struct Monitor {
 	pub height: i32,
 	pub refresh_rate: u32,
 	pub name: String,
+	/// Client buffer formats the renderer can import for this monitor.
+	pub formats: Arc<[FormatModifiers]>,
 }
 
 impl Monitor {
@@ -19,6 +23,7 @@ impl Monitor {
 			height: self.height,
 			refresh_rate: self.refresh_rate as i32,
 			name: self.name.clone(),
+			formats: self.formats.to_vec(),
 		}
 	}
 }
@@ -1,16 +1,100 @@
+use std::time::Duration;
+
 use skia_safe::{
-	Canvas, FilterMode, Image, MipmapMode, Paint, Rect, SamplingOptions, TileMode, image_filters,
+	Canvas, Data, FilterMode, Image, ImageInfo, Matrix, MipmapMode, Paint, Rect, RuntimeEffect,
+	SamplingOptions, Shader, TileMode, image_filters, runtime_effect::ChildPtr,
 };
 
+/// Downsampled levels kept per frame for blurring; the coarsest is 1/64 of the frame size.
+const BLUR_PYRAMID_LEVELS: usize = 6;
+/// Blur radius, in monitor pixels, at the peak of the blur transition.
+const MAX_BLUR_RADIUS: f32 = 60.0;
+
+/// Mixes two adjacent blur pyramid levels.
+const BLUR_MIX_SKSL: &str = r#"
+uniform shader finer;
+uniform shader coarser;
+uniform float coarse_weight;
+
+half4 main(float2 p) {
+	return mix(finer.eval(p), coarser.eval(p), coarse_weight);
+}
+"#;
+
+const CROSSFADE_SKSL: &str = r#"
+uniform shader old_frame;
+uniform shader new_frame;
+uniform float progress;
+uniform float2 resolution;
+
+half4 main(float2 p) {
+	return mix(old_frame.eval(p), new_frame.eval(p), smoothstep(0.0, 1.0, progress));
+}
+"#;
+
+/// How much of its effect an animation draws. The renderer steps this down while frames run
+/// over the animation's budget.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub enum Quality {
+	#[default]
+	Full,
+	Reduced,
+	Minimal,
+}
+
+impl Quality {
+	pub fn degraded(self) -> Self {
+		match self {
+			Self::Full => Self::Reduced,
+			Self::Reduced | Self::Minimal => Self::Minimal,
+		}
+	}
+}
+
+/// Per-monitor data an animation derives once from the frames a transition starts with.
+#[derive(Default)]
+pub struct TransitionCache {
+	/// Successively halved, lightly blurred copies of the old and new frames.
+	pub old_pyramid: Vec<Image>,
+	pub new_pyramid: Vec<Image>,
+}
+
+impl TransitionCache {
+	pub fn byte_size(&self) -> u64 {
+		self
+			.old_pyramid
+			.iter()
+			.chain(&self.new_pyramid)
+			.map(|image| image.image_info().compute_min_byte_size() as u64)
+			.sum()
+	}
+}
+
+/// The frames a transition moves between, and what was prepared from them.
+pub struct TransitionFrames<'a> {
+	pub old_image: &'a Image,
+	pub new_image: &'a Image,
+	pub cache: &'a TransitionCache,
+}
+
 pub trait Animation: Send + Sync {
+	/// Time one frame of this animation may take before the renderer lowers its quality.
+	fn frame_budget(&self) -> Duration;
+
+	/// Runs once per monitor when a transition starts; everything expensive that doesn't
+	/// change with progress belongs here rather than in `draw`.
+	fn prepare(&self, _canvas: &Canvas, _old_image: &Image, _new_image: &Image) -> TransitionCache {
+		TransitionCache::default()
+	}
+
 	fn draw(
 		&self,
 		canvas: &Canvas,
-		old_image: &Image,
-		new_image: &Image,
+		frames: &TransitionFrames<'_>,
 		progress: f64,
 		width: f32,
 		height: f32,
+		quality: Quality,
 	);
 }
 
@@ -20,10 +104,14 @@ pub struct AnimationRegistry {
 }
 
 impl AnimationRegistry {
+	/// Registers the built-in animations, compiling their shaders up front.
 	pub fn new() -> Self {
 		let mut this = Self::default();
 		this.register("slide_left", Box::<SlideLeftAnimation>::default());
-		this.register("blur", Box::<BlurBlendAnimation>::default());
+		this.register("blur", Box::new(BlurBlendAnimation::new()));
+		if let Err(err) = this.register_effect("crossfade", CROSSFADE_SKSL, Duration::from_millis(2)) {
+			tracing::warn!(%err, "crossfade transition unavailable");
+		}
 		this
 	}
 
@@ -31,6 +119,28 @@ impl AnimationRegistry {
 		self.animations.insert(name.into(), animation);
 	}
 
+	/// Registers an SkSL transition. The shader gets the old and new frames as its two child
+	/// shaders and `uniform float progress; uniform float2 resolution;`, in that order.
+	pub fn register_effect(
+		&mut self,
+		name: impl Into<String>,
+		sksl: &str,
+		frame_budget: Duration,
+	) -> Result<(), String> {
+		let effect = RuntimeEffect::make_for_shader(sksl, None)?;
+		if effect.children().len() != 2 || effect.uniform_size() != 3 * size_of::<f32>() {
+			return Err("expected two child shaders, a progress and a resolution uniform".into());
+		}
+		self.register(
+			name,
+			Box::new(ShaderTransition {
+				effect,
+				frame_budget,
+			}),
+		);
+		Ok(())
+	}
+
 	pub fn get(&self, name: &str) -> Option<&dyn Animation> {
 		self.animations.get(name).map(|v| v.as_ref())
 	}
@@ -40,14 +150,18 @@ impl AnimationRegistry {
 struct SlideLeftAnimation;
 
 impl Animation for SlideLeftAnimation {
+	fn frame_budget(&self) -> Duration {
+		Duration::from_millis(2)
+	}
+
 	fn draw(
 		&self,
 		canvas: &Canvas,
-		old_image: &Image,
-		new_image: &Image,
+		frames: &TransitionFrames<'_>,
 		progress: f64,
 		width: f32,
 		height: f32,
+		_quality: Quality,
 	) {
 		let t = progress.clamp(0.0, 1.0) as f32;
 		let sampling = SamplingOptions::new(FilterMode::Linear, MipmapMode::None);
@@ -58,58 +172,266 @@ impl Animation for SlideLeftAnimation {
 		let new_left = width * (1.0 - t);
 		let old_rect = Rect::from_xywh(old_left, 0.0, width, height);
 		let new_rect = Rect::from_xywh(new_left, 0.0, width, height);
-		canvas.draw_image_rect_with_sampling_options(old_image, None, old_rect, sampling, &paint);
-		canvas.draw_image_rect_with_sampling_options(new_image, None, new_rect, sampling, &paint);
+		canvas.draw_image_rect_with_sampling_options(
+			frames.old_image,
+			None,
+			old_rect,
+			sampling,
+			&paint,
+		);
+		canvas.draw_image_rect_with_sampling_options(
+			frames.new_image,
+			None,
+			new_rect,
+			sampling,
+			&paint,
+		);
 	}
 }
 
-#[derive(Default)]
-struct BlurBlendAnimation;
+/// Blurs the old frame out, then brings the new one in blurred and sharpens it. Frames are
+/// blurred by sampling a pyramid built once per transition, so a frame costs two texture
+/// lookups per pixel whatever the radius.
+struct BlurBlendAnimation {
+	/// `None` if the mixing shader failed to compile; levels are then blended with alpha.
+	mix_effect: Option<RuntimeEffect>,
+}
+
+impl BlurBlendAnimation {
+	fn new() -> Self {
+		let mix_effect = RuntimeEffect::make_for_shader(BLUR_MIX_SKSL, None)
+			.inspect_err(|err| tracing::warn!(%err, "blur mixing shader failed to compile"))
+			.ok();
+		Self { mix_effect }
+	}
+
+	#[allow(clippy::too_many_arguments)]
+	fn draw_blurred(
+		&self,
+		canvas: &Canvas,
+		sharp: &Image,
+		pyramid: &[Image],
+		radius: f32,
+		width: f32,
+		height: f32,
+		quality: Quality,
+	) {
+		if pyramid.is_empty() {
+			// Preparing the pyramid failed: fall back to filtering every frame.
+			let radius = if quality == Quality::Full {
+				radius
+			} else {
+				0.0
+			};
+			draw_filtered_image(canvas, sharp, width, height, radius);
+			return;
+		}
+		// Level `n` of the pyramid (0 being the sharp frame) looks blurred by about 2^n pixels.
+		let position = if radius > 1.0 && quality != Quality::Minimal {
+			radius.log2().min(pyramid.len() as f32)
+		} else {
+			0.0
+		};
+		let level = |index: usize| {
+			if index == 0 {
+				sharp
+			} else {
+				&pyramid[index - 1]
+			}
+		};
+		let finer = position.floor() as usize;
+		let coarse_weight = position - finer as f32;
+		if quality != Quality::Full || coarse_weight < 0.01 {
+			draw_image_stretched(canvas, level(position.round() as usize), width, height, 1.0);
+			return;
+		}
+
+		let coarser = level(finer + 1);
+		let finer = level(finer);
+		let shader = self.mix_effect.as_ref().and_then(|effect| {
+			let children = [
+				ChildPtr::Shader(stretched_shader(finer, width, height)?),
+				ChildPtr::Shader(stretched_shader(coarser, width, height)?),
+			];
+			effect.make_shader(
+				Data::new_copy(&coarse_weight.to_ne_bytes()),
+				&children,
+				None,
+			)
+		});
+		if let Some(shader) = shader {
+			let mut paint = Paint::default();
+			paint.set_shader(shader);
+			canvas.draw_rect(Rect::from_wh(width, height), &paint);
+		} else {
+			draw_image_stretched(canvas, finer, width, height, 1.0);
+			draw_image_stretched(canvas, coarser, width, height, coarse_weight);
+		}
+	}
+}
 
 impl Animation for BlurBlendAnimation {
+	fn frame_budget(&self) -> Duration {
+		Duration::from_millis(4)
+	}
+
+	fn prepare(&self, canvas: &Canvas, old_image: &Image, new_image: &Image) -> TransitionCache {
+		TransitionCache {
+			old_pyramid: build_blur_pyramid(canvas, old_image),
+			new_pyramid: build_blur_pyramid(canvas, new_image),
+		}
+	}
+
 	fn draw(
 		&self,
 		canvas: &Canvas,
-		old_image: &Image,
-		new_image: &Image,
+		frames: &TransitionFrames<'_>,
 		progress: f64,
 		width: f32,
 		height: f32,
+		quality: Quality,
 	) {
 		let t = progress.clamp(0.0, 1.0) as f32;
-		let phase = if t < 0.5 { 0 } else { 1 };
-		let local_t = if phase == 0 { t * 2.0 } else { (t - 0.5) * 2.0 };
-
-		if phase == 0 {
+		if t < 0.5 {
 			// Blur the old frame out.
-			draw_blurred_image(canvas, old_image, width, height, 60.0 * local_t, 1.0);
+			let radius = MAX_BLUR_RADIUS * t * 2.0;
+			let pyramid = &frames.cache.old_pyramid;
+			self.draw_blurred(
+				canvas,
+				frames.old_image,
+				pyramid,
+				radius,
+				width,
+				height,
+				quality,
+			);
 		} else {
 			// Bring in the new frame blurred, then sharpen it.
-			draw_blurred_image(
+			let radius = MAX_BLUR_RADIUS * (1.0 - (t - 0.5) * 2.0);
+			let pyramid = &frames.cache.new_pyramid;
+			self.draw_blurred(
 				canvas,
-				new_image,
+				frames.new_image,
+				pyramid,
+				radius,
 				width,
 				height,
-				60.0 * (1.0 - local_t),
-				1.0,
+				quality,
 			);
 		}
 	}
 }
 
-fn draw_blurred_image(
-	canvas: &Canvas,
-	image: &Image,
-	width: f32,
-	height: f32,
-	radius: f32,
-	alpha: f32,
-) {
+/// A transition written in SkSL; see [`AnimationRegistry::register_effect`].
+struct ShaderTransition {
+	effect: RuntimeEffect,
+	frame_budget: Duration,
+}
+
+impl Animation for ShaderTransition {
+	fn frame_budget(&self) -> Duration {
+		self.frame_budget
+	}
+
+	fn draw(
+		&self,
+		canvas: &Canvas,
+		frames: &TransitionFrames<'_>,
+		progress: f64,
+		width: f32,
+		height: f32,
+		quality: Quality,
+	) {
+		let progress = progress.clamp(0.0, 1.0) as f32;
+		if quality == Quality::Minimal {
+			let image = if progress < 0.5 {
+				frames.old_image
+			} else {
+				frames.new_image
+			};
+			draw_image_stretched(canvas, image, width, height, 1.0);
+			return;
+		}
+		let uniforms = [progress, width, height]
+			.iter()
+			.flat_map(|v| v.to_ne_bytes())
+			.collect::<Vec<_>>();
+		let shader = (|| {
+			let children = [
+				ChildPtr::Shader(stretched_shader(frames.old_image, width, height)?),
+				ChildPtr::Shader(stretched_shader(frames.new_image, width, height)?),
+			];
+			self
+				.effect
+				.make_shader(Data::new_copy(&uniforms), &children, None)
+		})();
+		let Some(shader) = shader else {
+			draw_image_stretched(canvas, frames.new_image, width, height, 1.0);
+			return;
+		};
+		let mut paint = Paint::default();
+		paint.set_shader(shader);
+		canvas.draw_rect(Rect::from_wh(width, height), &paint);
+	}
+}
+
+/// Halves `image` [`BLUR_PYRAMID_LEVELS`] times, blurring slightly at each step so that
+/// stretching a level back up stays smooth. Stops early if an offscreen surface can't be made.
+fn build_blur_pyramid(canvas: &Canvas, image: &Image) -> Vec<Image> {
+	let sampling = SamplingOptions::new(FilterMode::Linear, MipmapMode::None);
+	let mut pyramid = Vec::with_capacity(BLUR_PYRAMID_LEVELS);
+	let mut source = image.clone();
+	for _ in 0..BLUR_PYRAMID_LEVELS {
+		let (width, height) = ((source.width() / 2).max(1), (source.height() / 2).max(1));
+		let Some(mut surface) =
+			canvas.new_surface(&ImageInfo::new_n32_premul((width, height), None), None)
+		else {
+			tracing::warn!(width, height, "failed to allocate blur pyramid level");
+			break;
+		};
+		let mut paint = Paint::default();
+		paint.set_image_filter(image_filters::blur((1.0, 1.0), TileMode::Clamp, None, None));
+		surface.canvas().draw_image_rect_with_sampling_options(
+			&source,
+			None,
+			Rect::from_wh(width as f32, height as f32),
+			sampling,
+			&paint,
+		);
+		source = surface.image_snapshot();
+		pyramid.push(source.clone());
+	}
+	pyramid
+}
+
+/// Shader sampling `image` scaled to cover `width`x`height`.
+fn stretched_shader(image: &Image, width: f32, height: f32) -> Option<Shader> {
+	let matrix = Matrix::scale((width / image.width() as f32, height / image.height() as f32));
+	image.to_shader(
+		(TileMode::Clamp, TileMode::Clamp),
+		SamplingOptions::new(FilterMode::Linear, MipmapMode::None),
+		&matrix,
+	)
+}
+
+fn draw_image_stretched(canvas: &Canvas, image: &Image, width: f32, height: f32, alpha: f32) {
+	let sampling = SamplingOptions::new(FilterMode::Linear, MipmapMode::None);
+	let mut paint = Paint::default();
+	paint.set_argb((255.0 * alpha.clamp(0.0, 1.0)) as u8, 255, 255, 255);
+	canvas.draw_image_rect_with_sampling_options(
+		image,
+		None,
+		Rect::from_wh(width, height),
+		sampling,
+		&paint,
+	);
+}
+
+fn draw_filtered_image(canvas: &Canvas, image: &Image, width: f32, height: f32, radius: f32) {
 	let rect = Rect::from_wh(width, height);
 	let sampling = SamplingOptions::new(FilterMode::Linear, MipmapMode::Linear);
-	let clamped_alpha = alpha.clamp(0.0, 1.0);
 	let mut paint = Paint::default();
-	paint.set_argb((255.0 * clamped_alpha) as u8, 255, 255, 255);
+	paint.set_argb(255, 255, 255, 255);
 	if radius > 0.001
 		&& let Some(filter) = image_filters::blur((radius, radius), TileMode::Clamp, None, None)
 	{
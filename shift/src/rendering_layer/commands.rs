@@ -3,18 +3,40 @@ use std::{
 	sync::Arc,
 };
 
+use tab_protocol::{BufferIndex, PlaneLayout, PresentMode};
+
 use crate::comms::server2render::RenderCmd;
 
-use super::dmabuf_import::{DmaBufTexture, ImportParams as DmaBufImportParams};
+use super::damage::Damage;
+use super::dmabuf_import::{
+	DmaBufImportError, DmaBufTexture, ImportParams as DmaBufImportParams, SkiaDmaBufTexture,
+};
 use super::state::BufferSlot;
 use super::{RenderError, RenderEvt, RenderingLayer, SlotKey};
 
+/// Imports the buffer of `key` with the GL context of its monitor current.
+fn import_slot_texture(
+	gl: &easydrm::gl::Gles2,
+	proc_loader: &dyn Fn(&str) -> *const std::ffi::c_void,
+	params: DmaBufImportParams,
+	key: SlotKey,
+) -> Result<SkiaDmaBufTexture, DmaBufImportError> {
+	DmaBufTexture::import(gl, proc_loader, params).and_then(|texture| {
+		texture.to_skia(format!(
+			"session_{}_monitor_{}_buffer_{}",
+			key.session_id,
+			key.monitor_id,
+			BufferIndex::from(key.buffer) as u8
+		))
+	})
+}
+
 impl RenderingLayer {
 	#[tracing::instrument(skip_all, fields(session_id = %session_id, monitor_id = %payload.monitor_id))]
 	pub(super) fn import_framebuffers(
 		&mut self,
 		payload: tab_protocol::FramebufferLinkPayload,
-		dma_bufs: [OwnedFd; 2],
+		dma_bufs: Vec<OwnedFd>,
 		session_id: crate::sessions::SessionId,
 	) {
 		let Ok(monitor_id) = payload.monitor_id.parse::<crate::monitor::MonitorId>() else {
@@ -35,6 +57,21 @@ impl RenderingLayer {
 				break;
 			}
 			let gl = mon.context().gl.clone();
+			// The link replaces the whole swapchain; its old imports may come right back.
+			for (_, texture) in self
+				.slots
+				.extract_if(|key, _| key.monitor_id == monitor_id && key.session_id == session_id)
+			{
+				self.import_cache.retire(texture);
+			}
+			let planes = if payload.planes.is_empty() {
+				vec![PlaneLayout {
+					offset: payload.offset,
+					stride: payload.stride,
+				}]
+			} else {
+				payload.planes.clone()
+			};
 			let proc_loader = |symbol: &str| {
 				egl_context
 					.lock()
@@ -48,17 +85,24 @@ impl RenderingLayer {
 				let params = DmaBufImportParams {
 					width: payload.width,
 					height: payload.height,
-					stride: payload.stride,
-					offset: payload.offset,
 					fourcc: payload.fourcc,
+					modifier: payload.modifier,
+					planes: planes.clone(),
 					fd,
 				};
-				match DmaBufTexture::import(&gl, &proc_loader, params).and_then(|texture| {
-					texture.to_skia(format!(
-						"session_{}_monitor_{}_buffer_{}",
-						session_id, monitor_id, idx
-					))
-				}) {
+				if let Some(texture) = params
+					.identity()
+					.and_then(|identity| self.import_cache.take(&identity))
+				{
+					imported.push((slot, texture));
+					continue;
+				}
+				match import_slot_texture(
+					&gl,
+					&proc_loader,
+					params,
+					SlotKey::new(monitor_id, session_id, slot),
+				) {
 					Ok(texture) => imported.push((slot, texture)),
 					Err(e) => {
 						tracing::warn!(%monitor_id, ?slot, "failed to import dmabuf: {e:?}");
@@ -78,6 +122,10 @@ impl RenderingLayer {
 			self.slots.insert(key, texture);
 			self.ownership.mark_slot_client_owned(key);
 		}
+		if self.ownership.current_session() == Some(session_id) {
+			self.damage.entry(monitor_id).or_default().invalidate();
+		}
+		self.gpu_budget.mark_dirty();
 	}
 
 	pub(super) async fn process_deferred_releases(&mut self, release_fence: i32) {
@@ -103,6 +151,7 @@ impl RenderingLayer {
 					monitor_id: item.monitor_id,
 					buffer: item.buffer.into(),
 					release_fence,
+					released_ns: super::presentation::monotonic_ns(),
 				})
 				.await;
 		}
@@ -126,18 +175,42 @@ impl RenderingLayer {
 				session_id,
 				transition,
 			} => {
+				if let Some(outgoing) = self.ownership.current_session()
+					&& session_id != Some(outgoing)
+				{
+					self.snapshot_session(outgoing);
+				}
 				self.active_transition = None;
+				self.transition_caches.clear();
 				if let Some(to_session_id) = session_id
 					&& let Some(transition) = transition
 				{
 					self.active_transition = super::ActiveTransition::from_cmd(to_session_id, transition);
 				}
 				self.ownership.set_current_session(session_id);
+				self.invalidate_all_monitors();
+			}
+			RenderCmd::SetPresentMode { session_id, mode } => {
+				tracing::debug!(%session_id, ?mode, "session present mode");
+				if mode == PresentMode::Vsync {
+					self.present_modes.remove(&session_id);
+				} else {
+					self.present_modes.insert(session_id, mode);
+				}
+			}
+			RenderCmd::SessionAwake { session_id, awake } => {
+				self.gpu_budget.set_awake(session_id, awake);
+			}
+			RenderCmd::CollectLatency => {
+				let frames = self.frame_latency.report();
+				self.emit_event(RenderEvt::FrameLatency(frames)).await;
 			}
 			RenderCmd::SessionRemoved { session_id } => {
+				self.present_modes.remove(&session_id);
 				self.cleanup_session_slots(session_id);
 				if self.ownership.current_session() == Some(session_id) {
 					self.ownership.set_current_session(None);
+					self.invalidate_all_monitors();
 				}
 			}
 			RenderCmd::SwapBuffers {
@@ -145,6 +218,8 @@ impl RenderingLayer {
 				buffer,
 				session_id,
 				acquire_fence,
+				requested_ns,
+				damage,
 			} => {
 				let slot = BufferSlot::from(buffer);
 				let monitor_known = self.known_monitors.contains_key(&monitor_id);
@@ -167,10 +242,13 @@ impl RenderingLayer {
 						.await;
 				} else {
 					let has_acquire_fence = acquire_fence.is_some();
-					let transition =
-						self
-							.ownership
-							.apply_swap_request(monitor_id, session_id, slot, has_acquire_fence);
+					let transition = self.ownership.apply_swap_request(
+						monitor_id,
+						session_id,
+						slot,
+						has_acquire_fence,
+						Damage::from_rects(&damage),
+					);
 					if let Some(pending) = transition.canceled_pending {
 						let pending_key = SlotKey::new(monitor_id, session_id, pending);
 						self.cancel_fence_wait(pending_key);
@@ -178,10 +256,12 @@ impl RenderingLayer {
 							.ownership
 							.queue_buffer_release(monitor_id, session_id, pending);
 					}
+					self.frame_latency.requested(slot_key, requested_ns);
 					if let Some(fence_fd) = acquire_fence {
 						self.spawn_acquire_fence_waiter(slot_key, fence_fd);
 					} else {
 						self.cancel_fence_wait(slot_key);
+						self.frame_latency.ready(slot_key);
 					}
 					if let Some(previous) = transition.previous_to_release {
 						self
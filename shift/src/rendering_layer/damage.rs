@@ -0,0 +1,299 @@
+//! Damage tracking: which monitors need a new frame and which part of it must be repainted.
+
+use std::collections::{HashMap, VecDeque};
+
+use tab_protocol::DamageRect;
+
+use super::egl;
+
+/// Frames of damage kept for repainting render targets older than the last frame.
+const MAX_BUFFER_AGE: usize = 4;
+
+/// Changed area, in buffer pixels. Multiple rectangles collapse into their bounding box.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub(super) enum Damage {
+	#[default]
+	None,
+	Rect(DamageRect),
+	Full,
+}
+
+impl Damage {
+	/// Damage announced with a buffer request; no rectangles means the whole buffer.
+	pub fn from_rects(rects: &[DamageRect]) -> Self {
+		if rects.is_empty() {
+			return Self::Full;
+		}
+		rects
+			.iter()
+			.filter(|rect| rect.width > 0 && rect.height > 0)
+			.fold(Self::None, |acc, rect| acc.union(Self::Rect(*rect)))
+	}
+
+	pub fn is_none(&self) -> bool {
+		matches!(self, Self::None)
+	}
+
+	pub fn union(self, other: Self) -> Self {
+		match (self, other) {
+			(Self::Full, _) | (_, Self::Full) => Self::Full,
+			(Self::None, damage) | (damage, Self::None) => damage,
+			(Self::Rect(a), Self::Rect(b)) => Self::Rect(a.union(b)),
+		}
+	}
+
+	/// Restricts the damage to a `width`x`height` target; covering all of it becomes `Full`.
+	pub fn clip(self, width: i32, height: i32) -> Self {
+		let Self::Rect(rect) = self else {
+			return self;
+		};
+		let x0 = rect.x.max(0);
+		let y0 = rect.y.max(0);
+		let x1 = rect.x.saturating_add(rect.width).min(width);
+		let y1 = rect.y.saturating_add(rect.height).min(height);
+		if x1 <= x0 || y1 <= y0 {
+			Self::None
+		} else if x0 == 0 && y0 == 0 && x1 == width && y1 == height {
+			Self::Full
+		} else {
+			Self::Rect(DamageRect {
+				x: x0,
+				y: y0,
+				width: x1 - x0,
+				height: y1 - y0,
+			})
+		}
+	}
+}
+
+/// Per-monitor record of what recent frames repainted, so a frame drawn into an older render
+/// target can repaint everything that changed since that target was last shown.
+#[derive(Debug, Default)]
+pub(super) struct DamageHistory {
+	frame: u64,
+	/// Damage of the most recently drawn frames, newest first.
+	recent: VecDeque<Damage>,
+	/// Frame each render target was last drawn in, for when EGL can't report buffer age.
+	target_frames: HashMap<i32, u64>,
+	size: (usize, usize),
+	force_full: bool,
+}
+
+impl DamageHistory {
+	/// Makes the next frame repaint everything, e.g. after a session switch.
+	pub fn invalidate(&mut self) {
+		self.force_full = true;
+	}
+
+	/// Whether the next frame must repaint everything, even without new client damage.
+	pub fn needs_full(&self) -> bool {
+		self.force_full || self.frame == 0
+	}
+
+	/// Age of `target_fbo`'s contents in frames, `0` if unknown.
+	pub fn target_age(&self, target_fbo: i32) -> u32 {
+		self
+			.target_frames
+			.get(&target_fbo)
+			.map(|drawn| (self.frame + 1 - drawn) as u32)
+			.unwrap_or(0)
+	}
+
+	/// Region to repaint into a `width`x`height` target whose contents are `age` frames old
+	/// when `damage` changed since the last frame.
+	pub fn repaint_region(
+		&mut self,
+		damage: Damage,
+		age: u32,
+		width: usize,
+		height: usize,
+	) -> Damage {
+		if self.size != (width, height) {
+			self.size = (width, height);
+			self.recent.clear();
+			self.target_frames.clear();
+			return Damage::Full;
+		}
+		if self.needs_full() || age == 0 || age as usize - 1 > self.recent.len() {
+			return Damage::Full;
+		}
+		self
+			.recent
+			.iter()
+			.take(age as usize - 1)
+			.fold(damage, |acc, older| acc.union(*older))
+			.clip(width as i32, height as i32)
+	}
+
+	/// Records that `damage` was drawn into `target_fbo` as the newest frame.
+	pub fn record(&mut self, target_fbo: i32, damage: Damage) {
+		self.frame += 1;
+		self.force_full = false;
+		self.target_frames.insert(target_fbo, self.frame);
+		self.recent.push_front(damage);
+		self.recent.truncate(MAX_BUFFER_AGE);
+	}
+}
+
+/// `EGL_EXT_buffer_age` of the current draw surface. `None` when rendering without an EGL
+/// surface, `Some(0)` when the age is unknown.
+pub(super) fn current_buffer_age(egl: &egl::Egl) -> Option<u32> {
+	if !(egl.GetCurrentSurface.is_loaded() && egl.QuerySurface.is_loaded()) {
+		return None;
+	}
+	unsafe {
+		let surface = egl.GetCurrentSurface(egl::DRAW as egl::types::EGLint);
+		if surface.is_null() {
+			return None;
+		}
+		let mut age = 0;
+		let queried = egl.QuerySurface(
+			egl.GetCurrentDisplay(),
+			surface,
+			egl::BUFFER_AGE_EXT as egl::types::EGLint,
+			&mut age,
+		);
+		Some(if queried == 0 { 0 } else { age.max(0) as u32 })
+	}
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	const WIDTH: usize = 1920;
+	const HEIGHT: usize = 1080;
+
+	fn rect(x: i32, y: i32, width: i32, height: i32) -> Damage {
+		Damage::Rect(DamageRect {
+			x,
+			y,
+			width,
+			height,
+		})
+	}
+
+	/// A history that has drawn one full frame into each of `targets`.
+	fn warmed_up(targets: &[i32]) -> DamageHistory {
+		let mut history = DamageHistory::default();
+		assert_eq!(
+			history.repaint_region(Damage::None, 0, WIDTH, HEIGHT),
+			Damage::Full
+		);
+		for target in targets {
+			history.record(*target, Damage::Full);
+		}
+		history
+	}
+
+	#[test]
+	fn rects_union_into_their_bounding_box() {
+		assert_eq!(Damage::from_rects(&[]), Damage::Full);
+		let rects = [
+			DamageRect {
+				x: 10,
+				y: 10,
+				width: 10,
+				height: 10,
+			},
+			DamageRect {
+				x: 100,
+				y: 50,
+				width: 20,
+				height: 5,
+			},
+			// Empty rects don't widen the box.
+			DamageRect {
+				x: 500,
+				y: 500,
+				width: 0,
+				height: 10,
+			},
+		];
+		assert_eq!(Damage::from_rects(&rects), rect(10, 10, 110, 45));
+		assert_eq!(Damage::from_rects(&rects[2..]), Damage::None);
+		assert_eq!(rect(0, 0, 1, 1).union(Damage::Full), Damage::Full);
+		assert_eq!(Damage::None.union(rect(1, 2, 3, 4)), rect(1, 2, 3, 4));
+	}
+
+	#[test]
+	fn clips_to_the_target() {
+		assert_eq!(rect(-10, -10, 30, 30).clip(100, 100), rect(0, 0, 20, 20));
+		assert_eq!(rect(90, 95, 30, 30).clip(100, 100), rect(90, 95, 10, 5));
+		assert_eq!(rect(100, 0, 10, 10).clip(100, 100), Damage::None);
+		assert_eq!(rect(-5, -5, 200, 200).clip(100, 100), Damage::Full);
+		// Rects reaching past i32::MAX saturate instead of wrapping.
+		assert_eq!(
+			rect(50, 50, i32::MAX, i32::MAX).clip(100, 100),
+			rect(50, 50, 50, 50)
+		);
+	}
+
+	#[test]
+	fn first_frame_and_resizes_repaint_everything() {
+		let mut history = warmed_up(&[1]);
+		assert!(!history.needs_full());
+		assert_eq!(
+			history.repaint_region(rect(0, 0, 10, 10), 1, WIDTH, HEIGHT),
+			rect(0, 0, 10, 10)
+		);
+		assert_eq!(
+			history.repaint_region(rect(0, 0, 10, 10), 1, WIDTH / 2, HEIGHT),
+			Damage::Full
+		);
+	}
+
+	#[test]
+	fn older_targets_repaint_what_changed_since() {
+		let mut history = warmed_up(&[1, 2]);
+		history.record(1, rect(0, 0, 10, 10));
+		history.record(2, rect(100, 100, 10, 10));
+		assert_eq!(history.target_age(1), 2);
+		assert_eq!(history.target_age(2), 1);
+		assert_eq!(history.target_age(3), 0);
+
+		// Target 1 last showed the frame before the newest one, so it also misses that
+		// frame's damage.
+		assert_eq!(
+			history.repaint_region(rect(50, 50, 10, 10), 2, WIDTH, HEIGHT),
+			rect(50, 50, 60, 60)
+		);
+		assert_eq!(
+			history.repaint_region(rect(50, 50, 10, 10), 1, WIDTH, HEIGHT),
+			rect(50, 50, 10, 10)
+		);
+	}
+
+	#[test]
+	fn unknown_or_too_old_targets_repaint_everything() {
+		let mut history = warmed_up(&[1]);
+		for _ in 0..MAX_BUFFER_AGE {
+			history.record(1, rect(0, 0, 1, 1));
+		}
+		assert_eq!(
+			history.repaint_region(rect(0, 0, 1, 1), 0, WIDTH, HEIGHT),
+			Damage::Full
+		);
+		assert_eq!(
+			history.repaint_region(rect(0, 0, 1, 1), MAX_BUFFER_AGE as u32 + 2, WIDTH, HEIGHT),
+			Damage::Full
+		);
+		assert_eq!(
+			history.repaint_region(rect(0, 0, 1, 1), MAX_BUFFER_AGE as u32 + 1, WIDTH, HEIGHT),
+			rect(0, 0, 1, 1)
+		);
+	}
+
+	#[test]
+	fn invalidate_forces_one_full_frame() {
+		let mut history = warmed_up(&[1]);
+		history.invalidate();
+		assert!(history.needs_full());
+		assert_eq!(
+			history.repaint_region(rect(0, 0, 1, 1), 1, WIDTH, HEIGHT),
+			Damage::Full
+		);
+		history.record(1, Damage::Full);
+		assert!(!history.needs_full());
+	}
+}
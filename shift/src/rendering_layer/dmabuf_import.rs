@@ -2,12 +2,12 @@
 
 use std::{
 	ffi::c_void,
-	os::fd::{IntoRawFd, OwnedFd},
+	os::fd::{AsRawFd, OwnedFd},
 };
 
 use easydrm::gl;
-use nix::unistd::close;
 use skia_safe::{Image, gpu};
+use tab_protocol::{DRM_FORMAT_MOD_LINEAR, FormatModifiers, MAX_DMABUF_PLANES, PlaneLayout};
 use thiserror::Error;
 
 use crate::rendering_layer::egl;
@@ -17,12 +17,162 @@ use crate::rendering_layer::egl;
 pub struct ImportParams {
 	pub width: i32,
 	pub height: i32,
-	pub stride: i32,
-	pub offset: i32,
 	pub fourcc: i32,
+	/// Explicit modifier, or `None` for the driver's implicit layout.
+	pub modifier: Option<u64>,
+	/// One entry per plane; all planes live in `fd`.
+	pub planes: Vec<PlaneLayout>,
 	pub fd: OwnedFd,
 }
 
+impl ImportParams {
+	/// Identity of the buffer behind `fd`, `None` if it can't be `fstat`ed.
+	pub fn identity(&self) -> Option<DmaBufIdentity> {
+		let mut stat = std::mem::MaybeUninit::<libc::stat>::uninit();
+		if unsafe { libc::fstat(self.fd.as_raw_fd(), stat.as_mut_ptr()) } != 0 {
+			return None;
+		}
+		let stat = unsafe { stat.assume_init() };
+		Some(DmaBufIdentity {
+			dev: stat.st_dev as u64,
+			ino: stat.st_ino as u64,
+			width: self.width,
+			height: self.height,
+			fourcc: self.fourcc,
+			modifier: self.modifier,
+			planes: self.planes.clone(),
+		})
+	}
+}
+
+/// What makes two imports interchangeable: the same buffer (every dma-buf has its own inode,
+/// shared by all fds to it) sampled with the same layout.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct DmaBufIdentity {
+	dev: u64,
+	ino: u64,
+	width: i32,
+	height: i32,
+	fourcc: i32,
+	modifier: Option<u64>,
+	planes: Vec<PlaneLayout>,
+}
+
+/// Sampleable formats the compositor draws client buffers with.
+const COMPOSITE_FOURCCS: [u32; 4] = [
+	u32::from_le_bytes(*b"XR24"),
+	u32::from_le_bytes(*b"AR24"),
+	u32::from_le_bytes(*b"XB24"),
+	u32::from_le_bytes(*b"AB24"),
+];
+
+const PLANE_ATTRS: [[u32; 5]; MAX_DMABUF_PLANES] = [
+	[
+		egl::DMA_BUF_PLANE0_FD_EXT,
+		egl::DMA_BUF_PLANE0_OFFSET_EXT,
+		egl::DMA_BUF_PLANE0_PITCH_EXT,
+		egl::DMA_BUF_PLANE0_MODIFIER_LO_EXT,
+		egl::DMA_BUF_PLANE0_MODIFIER_HI_EXT,
+	],
+	[
+		egl::DMA_BUF_PLANE1_FD_EXT,
+		egl::DMA_BUF_PLANE1_OFFSET_EXT,
+		egl::DMA_BUF_PLANE1_PITCH_EXT,
+		egl::DMA_BUF_PLANE1_MODIFIER_LO_EXT,
+		egl::DMA_BUF_PLANE1_MODIFIER_HI_EXT,
+	],
+	[
+		egl::DMA_BUF_PLANE2_FD_EXT,
+		egl::DMA_BUF_PLANE2_OFFSET_EXT,
+		egl::DMA_BUF_PLANE2_PITCH_EXT,
+		egl::DMA_BUF_PLANE2_MODIFIER_LO_EXT,
+		egl::DMA_BUF_PLANE2_MODIFIER_HI_EXT,
+	],
+	[
+		egl::DMA_BUF_PLANE3_FD_EXT,
+		egl::DMA_BUF_PLANE3_OFFSET_EXT,
+		egl::DMA_BUF_PLANE3_PITCH_EXT,
+		egl::DMA_BUF_PLANE3_MODIFIER_LO_EXT,
+		egl::DMA_BUF_PLANE3_MODIFIER_HI_EXT,
+	],
+];
+
+/// Queries which of [`COMPOSITE_FOURCCS`] EGL can import and with which modifiers, via
+/// `EGL_EXT_image_dma_buf_import_modifiers`. Modifiers EGL can only sample as external
+/// textures are skipped since client buffers are bound as `GL_TEXTURE_2D`. Without the
+/// extension only implicit-modifier buffers can be imported and the list is empty.
+pub fn query_import_formats(proc_resolver: &dyn Fn(&str) -> *const c_void) -> Vec<FormatModifiers> {
+	let egl = egl::Egl::load_with(|name| proc_resolver(name));
+	if !(egl.QueryDmaBufFormatsEXT.is_loaded() && egl.QueryDmaBufModifiersEXT.is_loaded()) {
+		return Vec::new();
+	}
+	let display = unsafe { egl.GetCurrentDisplay() };
+	if display.is_null() {
+		return Vec::new();
+	}
+	let mut count = 0;
+	if unsafe { egl.QueryDmaBufFormatsEXT(display, 0, std::ptr::null_mut(), &mut count) } == 0 {
+		return Vec::new();
+	}
+	let mut supported = vec![0 as egl::types::EGLint; count.max(0) as usize];
+	if unsafe { egl.QueryDmaBufFormatsEXT(display, count, supported.as_mut_ptr(), &mut count) } == 0 {
+		return Vec::new();
+	}
+	supported.truncate(count.max(0) as usize);
+
+	let mut formats = Vec::new();
+	for fourcc in COMPOSITE_FOURCCS {
+		if !supported.contains(&(fourcc as egl::types::EGLint)) {
+			continue;
+		}
+		let fourcc_arg = fourcc as egl::types::EGLint;
+		let mut count = 0;
+		let queried = unsafe {
+			egl.QueryDmaBufModifiersEXT(
+				display,
+				fourcc_arg,
+				0,
+				std::ptr::null_mut(),
+				std::ptr::null_mut(),
+				&mut count,
+			)
+		};
+		if queried == 0 {
+			continue;
+		}
+		let len = count.max(0) as usize;
+		let mut modifiers = vec![0 as egl::types::EGLuint64KHR; len];
+		let mut external_only = vec![0 as egl::types::EGLBoolean; len];
+		let queried = unsafe {
+			egl.QueryDmaBufModifiersEXT(
+				display,
+				fourcc_arg,
+				count,
+				modifiers.as_mut_ptr(),
+				external_only.as_mut_ptr(),
+				&mut count,
+			)
+		};
+		if queried == 0 {
+			continue;
+		}
+		let len = (count.max(0) as usize).min(len);
+		let mut usable = modifiers[..len]
+			.iter()
+			.zip(&external_only[..len])
+			.filter(|(_, external)| **external == 0)
+			.map(|(modifier, _)| *modifier as u64)
+			.collect::<Vec<_>>();
+		// Put linear last: any tiled layout the driver offers beats it.
+		usable.sort_by_key(|modifier| *modifier == DRM_FORMAT_MOD_LINEAR);
+		formats.push(FormatModifiers {
+			fourcc,
+			modifiers: usable,
+		});
+	}
+	formats
+}
+
 #[derive(Debug, Error)]
 pub enum DmaBufImportError {
 	#[error("required EGL extension is unavailable")]
@@ -46,13 +196,17 @@ pub struct DmaBufTexture {
 	display: egl::types::EGLDisplay,
 	image: egl::types::EGLImageKHR,
 	texture_id: gl::types::GLuint,
+	identity: Option<DmaBufIdentity>,
+	/// What the texture was imported from. Keeping the fd costs nothing while the EGL image
+	/// holds the buffer anyway.
+	params: Option<ImportParams>,
 	pub width: i32,
 	pub height: i32,
 	pub fourcc: i32,
 }
 
 impl DmaBufTexture {
-	#[tracing::instrument(skip_all, fields(width = params.width, height = params.height, fourcc = params.fourcc))]
+	#[tracing::instrument(skip_all, fields(width = params.width, height = params.height, fourcc = params.fourcc, modifier = ?params.modifier, planes = params.planes.len()))]
 	pub fn import(
 		gl: &gl::Gles2,
 		proc_resolver: &dyn Fn(&str) -> *const c_void,
@@ -72,22 +226,36 @@ impl DmaBufTexture {
 		if context.is_null() {
 			return Err(DmaBufImportError::MissingContext);
 		}
-		let raw_fd = params.fd.into_raw_fd();
-		let mut attrs = [
+		let identity = params.identity();
+		let raw_fd = params.fd.as_raw_fd();
+		let mut attrs = Vec::with_capacity(7 + params.planes.len() * 10);
+		attrs.extend([
 			egl::LINUX_DRM_FOURCC_EXT as i32,
 			params.fourcc,
-			egl::DMA_BUF_PLANE0_FD_EXT as i32,
-			raw_fd,
-			egl::DMA_BUF_PLANE0_OFFSET_EXT as i32,
-			params.offset,
-			egl::DMA_BUF_PLANE0_PITCH_EXT as i32,
-			params.stride,
 			egl::WIDTH as i32,
 			params.width,
 			egl::HEIGHT as i32,
 			params.height,
-			egl::NONE as i32,
-		];
+		]);
+		for (plane, names) in params.planes.iter().zip(PLANE_ATTRS) {
+			attrs.extend([
+				names[0] as i32,
+				raw_fd,
+				names[1] as i32,
+				plane.offset,
+				names[2] as i32,
+				plane.stride,
+			]);
+			if let Some(modifier) = params.modifier {
+				attrs.extend([
+					names[3] as i32,
+					modifier as u32 as i32,
+					names[4] as i32,
+					(modifier >> 32) as u32 as i32,
+				]);
+			}
+		}
+		attrs.push(egl::NONE as i32);
 
 		let image = unsafe {
 			egl.CreateImageKHR(
@@ -99,8 +267,6 @@ impl DmaBufTexture {
 			)
 		};
 
-		let _ = close(raw_fd);
-
 		if image.is_null() {
 			let egl_error = unsafe { egl.GetError() };
 			return Err(DmaBufImportError::ImageCreationFailed(egl_error));
@@ -156,9 +322,11 @@ impl DmaBufTexture {
 			display,
 			image,
 			texture_id: texture,
+			identity,
 			width: params.width,
 			height: params.height,
 			fourcc: params.fourcc,
+			params: Some(params),
 		})
 	}
 	fn skia_tex_info(&self) -> gpu::gl::TextureInfo {
@@ -247,4 +415,25 @@ impl SkiaDmaBufTexture {
 	pub fn gl_texture_id(&self) -> gl::types::GLuint {
 		self.source.texture_id
 	}
+
+	pub fn size(&self) -> (i32, i32) {
+		(self.source.width, self.source.height)
+	}
+
+	pub fn identity(&self) -> Option<&DmaBufIdentity> {
+		self.source.identity.as_ref()
+	}
+
+	/// Memory the imported buffer occupies, from its plane layout.
+	pub fn byte_size(&self) -> u64 {
+		let height = self.source.height.max(0) as u64;
+		match &self.source.params {
+			Some(params) => params
+				.planes
+				.iter()
+				.map(|plane| plane.stride.max(0) as u64 * height)
+				.sum(),
+			None => self.source.width.max(0) as u64 * height * 4,
+		}
+	}
 }
@@ -43,6 +43,7 @@ impl RenderingLayer {
 		match event {
 			FenceEvent::Signaled { key } => {
 				self.fence_tasks.remove(&key);
+				self.frame_latency.ready(key);
 				if let Some(previous) = self.ownership.apply_acquire_fence_signaled(key) {
 					self
 						.ownership
@@ -1,12 +1,23 @@
+//! Fence reactor: every pending fence lives in one epoll set that the renderer polls
+//! alongside its other events, so waiting costs no task or extra syscall per fence.
+
 use std::{
-	collections::HashMap,
-	io::ErrorKind,
-	os::fd::{AsFd, AsRawFd, OwnedFd},
-	sync::{Arc, Mutex},
+	collections::{HashMap, VecDeque},
+	io,
+	os::fd::{AsRawFd, FromRawFd, OwnedFd, RawFd},
+	time::{Duration, Instant},
 };
 
-use futures::future::{join_all, select_all};
-use tokio::{io::unix::AsyncFd, sync::mpsc, task::JoinHandle};
+use linux_raw_sys::ioctl::{SYNC_IOC_FILE_INFO, SYNC_IOC_MERGE};
+use tokio::io::unix::AsyncFd;
+
+use super::presentation::monotonic_ns;
+
+/// Epoll events drained per wakeup.
+const MAX_EVENTS: usize = 32;
+/// Fences inspected for their signal timestamp; merged fences with more are not timed.
+const MAX_TIMED_FENCES: usize = 8;
+const REPORT_INTERVAL: Duration = Duration::from_secs(5);
 
 #[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
 pub(super) struct FenceTaskHandle(pub u64);
@@ -18,31 +29,60 @@ pub(super) enum FenceWaitMode {
 }
 
 type TaskCallback = Box<dyn FnOnce() + Send + 'static>;
-type SharedCallback = Arc<Mutex<Option<TaskCallback>>>;
 
-struct CompletedTask {
-	handle: FenceTaskHandle,
-	callback: SharedCallback,
+struct FenceWait {
+	/// Fences still registered in the epoll set.
+	fences: Vec<OwnedFd>,
+	mode: FenceWaitMode,
+	callback: TaskCallback,
+}
+
+struct ReadyWait {
+	callback: TaskCallback,
+	/// When the last fence signaled, if the kernel reported it.
+	signaled_ns: Option<u64>,
+}
+
+#[derive(Debug, Default)]
+struct FenceStats {
+	completed: u64,
+	/// Waits whose fences had already signaled when they were scheduled.
+	immediate: u64,
+	/// `All` waits collapsed into a single fd.
+	merged: u64,
+	timed: u64,
+	latency_sum_ns: u64,
+	latency_max_ns: u64,
 }
 
 pub(super) struct FenceScheduler {
 	next_id: u64,
-	tasks: HashMap<FenceTaskHandle, JoinHandle<()>>,
-	callbacks: HashMap<FenceTaskHandle, SharedCallback>,
-	tx: mpsc::UnboundedSender<CompletedTask>,
-	rx: mpsc::UnboundedReceiver<CompletedTask>,
+	epoll: AsyncFd<OwnedFd>,
+	waits: HashMap<FenceTaskHandle, FenceWait>,
+	/// Registered fence fd → wait it belongs to. The fds stay open while registered, so
+	/// their numbers are unique.
+	registered: HashMap<RawFd, FenceTaskHandle>,
+	ready: VecDeque<ReadyWait>,
+	stats: FenceStats,
+	last_report: Instant,
 }
 
 impl FenceScheduler {
-	pub fn new() -> Self {
-		let (tx, rx) = mpsc::unbounded_channel();
-		Self {
-			next_id: 1,
-			tasks: HashMap::new(),
-			callbacks: HashMap::new(),
-			tx,
-			rx,
+	pub fn new() -> io::Result<Self> {
+		let epoll = unsafe { libc::epoll_create1(libc::EPOLL_CLOEXEC) };
+		if epoll < 0 {
+			return Err(io::Error::last_os_error());
 		}
+		let epoll = unsafe { OwnedFd::from_raw_fd(epoll) };
+		Ok(Self {
+			next_id: 1,
+			epoll: AsyncFd::new(epoll)?,
+			waits: HashMap::new(),
+			registered: HashMap::new(),
+			ready: VecDeque::new(),
+			stats: FenceStats::default(),
+			last_report: Instant::now(),
+		})
 	}
 
 	pub fn schedule(
@@ -53,10 +93,7 @@ impl FenceScheduler {
 	) -> FenceTaskHandle {
 		let handle = FenceTaskHandle(self.next_id);
 		self.next_id = self.next_id.saturating_add(1);
-		let callback = Arc::new(Mutex::new(Some(callback)));
-		let task = spawn_wait_task(handle, fences, mode, Arc::clone(&callback), self.tx.clone());
-		self.tasks.insert(handle, task);
-		self.callbacks.insert(handle, callback);
+		self.start_wait(handle, fences, mode, callback);
 		handle
 	}
 
@@ -66,116 +103,424 @@ impl FenceScheduler {
 		fences: Vec<OwnedFd>,
 		mode: FenceWaitMode,
 	) -> bool {
-		let Some(callback) = self.callbacks.get(&handle).cloned() else {
+		let Some(wait) = self.remove_wait(handle) else {
 			return false;
 		};
-		if let Some(task) = self.tasks.remove(&handle) {
-			task.abort();
-		}
-		let task = spawn_wait_task(handle, fences, mode, callback, self.tx.clone());
-		self.tasks.insert(handle, task);
+		self.start_wait(handle, fences, mode, wait.callback);
 		true
 	}
 
 	pub fn cancel(&mut self, handle: FenceTaskHandle) -> bool {
-		if let Some(task) = self.tasks.remove(&handle) {
-			task.abort();
-		}
-		self.callbacks.remove(&handle).is_some()
+		self.remove_wait(handle).is_some()
 	}
 
+	/// Waits until at least one scheduled wait completes and runs the callbacks of all
+	/// completed waits. Cancel-safe: nothing is consumed before the epoll set is drained.
+	/// Returns `false` if the epoll set can no longer be polled.
 	pub async fn recv_and_run(&mut self) -> bool {
-		let Some(completed) = self.rx.recv().await else {
-			return false;
-		};
-		self.tasks.remove(&completed.handle);
-		self.callbacks.remove(&completed.handle);
-		if let Ok(mut guard) = completed.callback.lock()
-			&& let Some(callback) = guard.take()
-		{
-			callback();
+		while self.ready.is_empty() {
+			let mut events = [libc::epoll_event { events: 0, u64: 0 }; MAX_EVENTS];
+			let count = {
+				let mut guard = match self.epoll.readable().await {
+					Ok(guard) => guard,
+					Err(err) => {
+						tracing::warn!(%err, "fence epoll readiness failed");
+						return false;
+					}
+				};
+				let count = unsafe {
+					libc::epoll_wait(
+						guard.get_inner().as_raw_fd(),
+						events.as_mut_ptr(),
+						MAX_EVENTS as i32,
+						0,
+					)
+				};
+				if count < 0 {
+					let err = io::Error::last_os_error();
+					if err.kind() == io::ErrorKind::Interrupted {
+						continue;
+					}
+					tracing::warn!(%err, "fence epoll_wait failed");
+					return false;
+				}
+				if count == 0 {
+					guard.clear_ready();
+				}
+				count as usize
+			};
+			for event in &events[..count] {
+				self.fence_signaled(event.u64 as RawFd);
+			}
+		}
+
+		let now = monotonic_ns();
+		while let Some(ready) = self.ready.pop_front() {
+			self.stats.completed += 1;
+			if let Some(signaled_ns) = ready.signaled_ns {
+				let latency = now.saturating_sub(signaled_ns);
+				self.stats.timed += 1;
+				self.stats.latency_sum_ns += latency;
+				self.stats.latency_max_ns = self.stats.latency_max_ns.max(latency);
+			}
+			(ready.callback)();
 		}
+		self.report_stats();
 		true
 	}
-}
 
-fn spawn_wait_task(
-	handle: FenceTaskHandle,
-	fences: Vec<OwnedFd>,
-	mode: FenceWaitMode,
-	callback: SharedCallback,
-	tx: mpsc::UnboundedSender<CompletedTask>,
-) -> JoinHandle<()> {
-	tokio::spawn(async move {
-		let wait_ok = wait_many_fences(fences, mode).await;
-		if wait_ok {
-			let _ = tx.send(CompletedTask { handle, callback });
+	fn start_wait(
+		&mut self,
+		handle: FenceTaskHandle,
+		fences: Vec<OwnedFd>,
+		mode: FenceWaitMode,
+		callback: TaskCallback,
+	) {
+		let fences = if mode == FenceWaitMode::All && fences.len() > 1 {
+			match merge_fences(&fences) {
+				Ok(merged) => {
+					self.stats.merged += 1;
+					vec![merged]
+				}
+				Err(err) => {
+					tracing::debug!(%err, "merging fences failed, waiting on each");
+					fences
+				}
+			}
+		} else {
+			fences
+		};
+
+		let pending = match mode {
+			FenceWaitMode::All => fences
+				.into_iter()
+				.filter(|fd| !is_signaled(fd))
+				.collect::<Vec<_>>(),
+			FenceWaitMode::Any if fences.iter().any(is_signaled) => Vec::new(),
+			FenceWaitMode::Any => fences,
+		};
+		if pending.is_empty() {
+			self.stats.immediate += 1;
+			self.ready.push_back(ReadyWait {
+				callback,
+				signaled_ns: None,
+			});
+			return;
 		}
-	})
-}
 
-async fn wait_many_fences(fences: Vec<OwnedFd>, mode: FenceWaitMode) -> bool {
-	if fences.is_empty() {
-		return true;
+		let mut registered = Vec::with_capacity(pending.len());
+		for fd in pending {
+			match epoll_ctl(&self.epoll, libc::EPOLL_CTL_ADD, &fd) {
+				Ok(()) => {
+					self.registered.insert(fd.as_raw_fd(), handle);
+					registered.push(fd);
+				}
+				// Such a wait never completes, matching a fence that never signals; the
+				// caller can still replace or cancel it.
+				Err(err) => tracing::warn!(fd = fd.as_raw_fd(), %err, "cannot watch fence fd"),
+			}
+		}
+		self.waits.insert(
+			handle,
+			FenceWait {
+				fences: registered,
+				mode,
+				callback,
+			},
+		);
 	}
 
-	match mode {
-		FenceWaitMode::Any => {
-			let waiters = fences
-				.into_iter()
-				.map(|fd| Box::pin(wait_one_fence(fd)))
-				.collect::<Vec<_>>();
-			let (result, _idx, _rest) = select_all(waiters).await;
-			result
+	fn fence_signaled(&mut self, fd: RawFd) {
+		let Some(handle) = self.registered.get(&fd).copied() else {
+			return;
+		};
+		let Some(wait) = self.waits.get_mut(&handle) else {
+			return;
+		};
+		let Some(index) = wait.fences.iter().position(|fence| fence.as_raw_fd() == fd) else {
+			return;
+		};
+		if wait.mode == FenceWaitMode::All && wait.fences.len() > 1 {
+			let fence = wait.fences.swap_remove(index);
+			self.registered.remove(&fd);
+			let _ = epoll_ctl(&self.epoll, libc::EPOLL_CTL_DEL, &fence);
+			return;
 		}
-		FenceWaitMode::All => {
-			let results = join_all(fences.into_iter().map(wait_one_fence)).await;
-			results.into_iter().all(|ok| ok)
+		let signaled_ns = signal_timestamp_ns(&wait.fences[index]);
+		if let Some(wait) = self.remove_wait(handle) {
+			self.ready.push_back(ReadyWait {
+				callback: wait.callback,
+				signaled_ns,
+			});
 		}
 	}
-}
 
-async fn wait_one_fence(fd: OwnedFd) -> bool {
-	let raw_fd = fd.as_fd().as_raw_fd();
-	let afd = match AsyncFd::new(fd) {
-		Ok(afd) => {
-			tracing::debug!(fd = raw_fd, "waiting on fence fd");
-			afd
+	fn remove_wait(&mut self, handle: FenceTaskHandle) -> Option<FenceWait> {
+		let mut wait = self.waits.remove(&handle)?;
+		for fence in wait.fences.drain(..) {
+			self.registered.remove(&fence.as_raw_fd());
+			let _ = epoll_ctl(&self.epoll, libc::EPOLL_CTL_DEL, &fence);
 		}
-		Err(err) => {
-			tracing::warn!(fd = raw_fd, %err, "failed to create AsyncFd for fence");
-			return false;
+		Some(wait)
+	}
+
+	fn report_stats(&mut self) {
+		if self.last_report.elapsed() < REPORT_INTERVAL {
+			return;
 		}
+		self.last_report = Instant::now();
+		let stats = std::mem::take(&mut self.stats);
+		tracing::debug!(
+			completed = stats.completed,
+			immediate = stats.immediate,
+			merged = stats.merged,
+			avg_latency_us = stats.latency_sum_ns / stats.timed.max(1) / 1000,
+			max_latency_us = stats.latency_max_ns / 1000,
+			"fence waits"
+		);
+	}
+}
+
+fn epoll_ctl(epoll: &AsyncFd<OwnedFd>, op: libc::c_int, fd: &OwnedFd) -> io::Result<()> {
+	let mut event = libc::epoll_event {
+		events: libc::EPOLLIN as u32,
+		u64: fd.as_raw_fd() as u64,
 	};
+	let result =
+		unsafe { libc::epoll_ctl(epoll.get_ref().as_raw_fd(), op, fd.as_raw_fd(), &mut event) };
+	if result < 0 {
+		Err(io::Error::last_os_error())
+	} else {
+		Ok(())
+	}
+}
+
+/// `struct sync_merge_data` from `linux/sync_file.h`.
+#[repr(C)]
+struct SyncMergeData {
+	name: [u8; 32],
+	fd2: i32,
+	fence: i32,
+	flags: u32,
+	pad: u32,
+}
+
+/// `struct sync_fence_info` from `linux/sync_file.h`.
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct SyncFenceInfo {
+	obj_name: [u8; 32],
+	driver_name: [u8; 32],
+	status: i32,
+	flags: u32,
+	timestamp_ns: u64,
+}
+
+/// `struct sync_file_info` from `linux/sync_file.h`.
+#[repr(C)]
+struct SyncFileInfo {
+	name: [u8; 32],
+	status: i32,
+	flags: u32,
+	num_fences: u32,
+	pad: u32,
+	sync_fence_info: u64,
+}
 
-	loop {
-		let mut guard = match afd.readable().await {
-			Ok(guard) => guard,
-			Err(_) => return false,
+/// Folds `fences` into one sync_file that signals once all of them have.
+fn merge_fences(fences: &[OwnedFd]) -> io::Result<OwnedFd> {
+	let (first, rest) = fences
+		.split_first()
+		.ok_or_else(|| io::Error::from(io::ErrorKind::InvalidInput))?;
+	let mut merged = first.try_clone()?;
+	for fence in rest {
+		let mut data = SyncMergeData {
+			name: [0; 32],
+			fd2: fence.as_raw_fd(),
+			fence: -1,
+			flags: 0,
+			pad: 0,
 		};
-		match guard.try_io(|inner| {
-			let raw = inner.as_raw_fd();
-			let mut poll_fd = nix::libc::pollfd {
-				fd: raw,
-				events: (nix::libc::POLLIN | nix::libc::POLLERR | nix::libc::POLLHUP) as i16,
-				revents: 0,
-			};
-			let result = unsafe { nix::libc::poll(&mut poll_fd as *mut nix::libc::pollfd, 1, 0) };
-			if result > 0
-				&& (poll_fd.revents & (nix::libc::POLLIN | nix::libc::POLLERR | nix::libc::POLLHUP) as i16)
-					!= 0
-			{
-				Ok(())
-			} else {
-				Err(std::io::Error::new(
-					ErrorKind::WouldBlock,
-					"fence not signaled yet",
-				))
-			}
-		}) {
-			Ok(Ok(())) => return true,
-			Ok(Err(_)) => return false,
-			Err(_) => continue,
+		data.name[..5].copy_from_slice(b"shift");
+		let result = unsafe { libc::ioctl(merged.as_raw_fd(), SYNC_IOC_MERGE as _, &mut data) };
+		if result < 0 {
+			return Err(io::Error::last_os_error());
 		}
+		merged = unsafe { OwnedFd::from_raw_fd(data.fence) };
+	}
+	Ok(merged)
+}
+
+/// `SYNC_IOC_FILE_INFO` with room for `fences`; `None` if `fd` is not a sync_file or has more
+/// fences than fit.
+fn file_info(fd: &OwnedFd, fences: &mut [SyncFenceInfo]) -> Option<SyncFileInfo> {
+	let mut info = SyncFileInfo {
+		name: [0; 32],
+		status: 0,
+		flags: 0,
+		num_fences: fences.len() as u32,
+		pad: 0,
+		sync_fence_info: fences.as_mut_ptr() as u64,
+	};
+	let result = unsafe { libc::ioctl(fd.as_raw_fd(), SYNC_IOC_FILE_INFO as _, &mut info) };
+	(result >= 0).then_some(info)
+}
+
+/// Whether the fence has signaled, including with an error. Anything that is not a
+/// sync_file is left to epoll.
+fn is_signaled(fd: &OwnedFd) -> bool {
+	file_info(fd, &mut []).is_some_and(|info| info.status != 0)
+}
+
+/// `CLOCK_MONOTONIC` time at which the last fence in `fd` signaled.
+fn signal_timestamp_ns(fd: &OwnedFd) -> Option<u64> {
+	let mut fences = [SyncFenceInfo {
+		obj_name: [0; 32],
+		driver_name: [0; 32],
+		status: 0,
+		flags: 0,
+		timestamp_ns: 0,
+	}; MAX_TIMED_FENCES];
+	let info = file_info(fd, &mut fences)?;
+	if info.status == 0 {
+		return None;
+	}
+	fences[..info.num_fences as usize]
+		.iter()
+		.map(|fence| fence.timestamp_ns)
+		.max()
+		.filter(|timestamp| *timestamp > 0)
+}
+
+#[cfg(test)]
+mod tests {
+	use std::sync::{
+		Arc,
+		atomic::{AtomicUsize, Ordering},
+	};
+
+	use super::*;
+
+	/// How long a wait that must not complete gets before the test moves on.
+	const PENDING: Duration = Duration::from_millis(50);
+
+	/// A pipe stands in for a fence: epoll reports it readable once written to. It isn't a
+	/// sync_file, so merging fails and `All` waits fall back to waiting on each fd.
+	fn fence() -> (OwnedFd, OwnedFd) {
+		let mut fds = [0; 2];
+		assert_eq!(unsafe { libc::pipe2(fds.as_mut_ptr(), libc::O_CLOEXEC) }, 0);
+		unsafe { (OwnedFd::from_raw_fd(fds[0]), OwnedFd::from_raw_fd(fds[1])) }
+	}
+
+	fn signal(fence: &OwnedFd) {
+		assert_eq!(
+			unsafe { libc::write(fence.as_raw_fd(), b"x".as_ptr().cast(), 1) },
+			1
+		);
+	}
+
+	fn counter() -> (Arc<AtomicUsize>, impl Fn() -> TaskCallback) {
+		let count = Arc::new(AtomicUsize::new(0));
+		let make = {
+			let count = Arc::clone(&count);
+			move || {
+				let count = Arc::clone(&count);
+				Box::new(move || {
+					count.fetch_add(1, Ordering::SeqCst);
+				}) as TaskCallback
+			}
+		};
+		(count, make)
+	}
+
+	async fn completes(scheduler: &mut FenceScheduler) -> bool {
+		tokio::time::timeout(PENDING, scheduler.recv_and_run())
+			.await
+			.is_ok_and(|polled| polled)
+	}
+
+	#[tokio::test]
+	async fn waits_without_fences_complete_immediately() {
+		let mut scheduler = FenceScheduler::new().unwrap();
+		let (count, callback) = counter();
+		scheduler.schedule(Vec::new(), FenceWaitMode::All, callback());
+		assert!(completes(&mut scheduler).await);
+		assert_eq!(count.load(Ordering::SeqCst), 1);
+		assert_eq!(scheduler.stats.immediate, 1);
+	}
+
+	#[tokio::test]
+	async fn all_waits_for_every_fence() {
+		let mut scheduler = FenceScheduler::new().unwrap();
+		let (count, callback) = counter();
+		let (first, first_signal) = fence();
+		let (second, second_signal) = fence();
+		scheduler.schedule(vec![first, second], FenceWaitMode::All, callback());
+		assert_eq!(scheduler.stats.merged, 0);
+
+		signal(&first_signal);
+		assert!(!completes(&mut scheduler).await);
+		assert_eq!(count.load(Ordering::SeqCst), 0);
+
+		signal(&second_signal);
+		assert!(completes(&mut scheduler).await);
+		assert_eq!(count.load(Ordering::SeqCst), 1);
+		assert!(scheduler.registered.is_empty());
+	}
+
+	#[tokio::test]
+	async fn any_completes_on_the_first_fence() {
+		let mut scheduler = FenceScheduler::new().unwrap();
+		let (count, callback) = counter();
+		let (first, _first_signal) = fence();
+		let (second, second_signal) = fence();
+		scheduler.schedule(vec![first, second], FenceWaitMode::Any, callback());
+
+		signal(&second_signal);
+		assert!(completes(&mut scheduler).await);
+		assert_eq!(count.load(Ordering::SeqCst), 1);
+		assert!(scheduler.waits.is_empty());
+		assert!(scheduler.registered.is_empty());
+	}
+
+	#[tokio::test]
+	async fn a_fence_that_never_signals_never_completes() {
+		let mut scheduler = FenceScheduler::new().unwrap();
+		let (count, callback) = counter();
+		let (fence, _signal) = fence();
+		scheduler.schedule(vec![fence], FenceWaitMode::All, callback());
+		assert!(!completes(&mut scheduler).await);
+		assert!(!completes(&mut scheduler).await);
+		assert_eq!(count.load(Ordering::SeqCst), 0);
+	}
+
+	#[tokio::test]
+	async fn cancelled_waits_never_run() {
+		let mut scheduler = FenceScheduler::new().unwrap();
+		let (count, callback) = counter();
+		let (fence, signal_fd) = fence();
+		let handle = scheduler.schedule(vec![fence], FenceWaitMode::All, callback());
+		// Even a fence that already signaled is dropped with its wait.
+		signal(&signal_fd);
+		assert!(scheduler.cancel(handle));
+		assert!(!scheduler.cancel(handle));
+		assert!(!completes(&mut scheduler).await);
+		assert_eq!(count.load(Ordering::SeqCst), 0);
+	}
+
+	#[tokio::test]
+	async fn reschedule_keeps_the_callback_and_swaps_the_fences() {
+		let mut scheduler = FenceScheduler::new().unwrap();
+		let (count, callback) = counter();
+		let (old, old_signal) = fence();
+		let (new, new_signal) = fence();
+		let handle = scheduler.schedule(vec![old], FenceWaitMode::All, callback());
+		signal(&old_signal);
+		assert!(scheduler.reschedule(handle, vec![new], FenceWaitMode::All));
+		assert!(!completes(&mut scheduler).await);
+		signal(&new_signal);
+		assert!(completes(&mut scheduler).await);
+		assert_eq!(count.load(Ordering::SeqCst), 1);
+		assert!(!scheduler.reschedule(handle, Vec::new(), FenceWaitMode::All));
 	}
 }
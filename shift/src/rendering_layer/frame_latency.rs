@@ -0,0 +1,138 @@
+//! Per-session, per-monitor frame latency: how long a buffer waits for its acquire fence, to
+//! be composited, and for the page flip that shows it.
+
+use std::collections::HashMap;
+
+use tab_protocol::LatencyHistogram;
+
+use crate::{comms::render2server::FrameLatency, monitor::MonitorId, sessions::SessionId};
+
+use super::{SlotKey, presentation::monotonic_ns};
+
+#[derive(Debug)]
+struct RequestTiming {
+	requested_ns: u64,
+	ready_ns: Option<u64>,
+}
+
+#[derive(Debug, Default)]
+struct Histograms {
+	acquire: LatencyHistogram,
+	composite: LatencyHistogram,
+	present: LatencyHistogram,
+}
+
+#[derive(Debug, Default)]
+pub(super) struct FrameLatencyTracker {
+	/// Requested buffers not composited yet. A newer request for the same slot replaces its
+	/// entry.
+	requests: HashMap<SlotKey, RequestTiming>,
+	/// Sessions whose new buffer went into the frame committed on each monitor, with the time
+	/// it was composited, until that frame is presented.
+	composited: HashMap<MonitorId, Vec<(SessionId, u64)>>,
+	histograms: HashMap<(SessionId, MonitorId), Histograms>,
+}
+
+impl FrameLatencyTracker {
+	/// A `buffer_request` the server received at `requested_ns` was accepted.
+	pub fn requested(&mut self, key: SlotKey, requested_ns: u64) {
+		self.requests.insert(
+			key,
+			RequestTiming {
+				requested_ns,
+				ready_ns: None,
+			},
+		);
+	}
+
+	/// The buffer behind `key` can be sampled: its acquire fence signaled, or it had none.
+	pub fn ready(&mut self, key: SlotKey) {
+		let Some(timing) = self.requests.get_mut(&key) else {
+			return;
+		};
+		if timing.ready_ns.is_some() {
+			return;
+		}
+		let now_ns = monotonic_ns();
+		timing.ready_ns = Some(now_ns);
+		self
+			.histograms
+			.entry((key.session_id, key.monitor_id))
+			.or_default()
+			.acquire
+			.record_ns(now_ns.saturating_sub(timing.requested_ns));
+	}
+
+	/// The frame committed on `monitor_id` was composited at `composited_ns` from `keys`.
+	/// Buffers already shown in an earlier frame are not counted again.
+	pub fn composited(
+		&mut self,
+		monitor_id: MonitorId,
+		keys: impl IntoIterator<Item = SlotKey>,
+		composited_ns: u64,
+	) {
+		let mut sessions = Vec::new();
+		for key in keys {
+			let Some(ready_ns) = self.requests.get(&key).and_then(|timing| timing.ready_ns) else {
+				continue;
+			};
+			self.requests.remove(&key);
+			self
+				.histograms
+				.entry((key.session_id, monitor_id))
+				.or_default()
+				.composite
+				.record_ns(composited_ns.saturating_sub(ready_ns));
+			sessions.push((key.session_id, composited_ns));
+		}
+		if sessions.is_empty() {
+			self.composited.remove(&monitor_id);
+		} else {
+			self.composited.insert(monitor_id, sessions);
+		}
+	}
+
+	/// The frame committed on `monitor_id` flipped at `vblank_ns`.
+	pub fn presented(&mut self, monitor_id: MonitorId, vblank_ns: u64) {
+		for (session_id, composited_ns) in self.composited.remove(&monitor_id).unwrap_or_default() {
+			self
+				.histograms
+				.entry((session_id, monitor_id))
+				.or_default()
+				.present
+				.record_ns(vblank_ns.saturating_sub(composited_ns));
+		}
+	}
+
+	pub fn report(&self) -> Vec<FrameLatency> {
+		self
+			.histograms
+			.iter()
+			.map(|((session_id, monitor_id), histograms)| FrameLatency {
+				session_id: *session_id,
+				monitor_id: *monitor_id,
+				acquire: histograms.acquire,
+				composite: histograms.composite,
+				present: histograms.present,
+			})
+			.collect()
+	}
+
+	pub fn forget_monitor(&mut self, monitor_id: MonitorId) {
+		self.requests.retain(|key, _| key.monitor_id != monitor_id);
+		self.composited.remove(&monitor_id);
+		self
+			.histograms
+			.retain(|(_, monitor), _| *monitor != monitor_id);
+	}
+
+	pub fn forget_session(&mut self, session_id: SessionId) {
+		self.requests.retain(|key, _| key.session_id != session_id);
+		for sessions in self.composited.values_mut() {
+			sessions.retain(|(session, _)| *session != session_id);
+		}
+		self
+			.histograms
+			.retain(|(session, _), _| *session != session_id);
+	}
+}
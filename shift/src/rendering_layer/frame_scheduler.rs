@@ -0,0 +1,156 @@
+//! Vblank-aligned frame pacing: when to start compositing and how close to the deadline
+//! frames end up.
+
+use std::time::{Duration, Instant};
+
+use crate::comms::render2server::PresentedFrame;
+
+/// Time reserved before the predicted vblank for composition and the commit.
+const DEFAULT_MARGIN: Duration = Duration::from_millis(3);
+const REPORT_INTERVAL: Duration = Duration::from_secs(5);
+
+#[derive(Debug, Default)]
+struct FrameStats {
+	commits: u64,
+	/// Commits that finished after the predicted vblank.
+	late_commits: u64,
+	/// Flips that landed one or more refreshes later than planned.
+	missed: u64,
+	min_slack_ns: Option<i64>,
+	slack_sum_ns: i64,
+}
+
+#[derive(Debug)]
+pub(super) struct FrameScheduler {
+	margin_ns: u64,
+	stats: FrameStats,
+	last_report: Instant,
+}
+
+impl FrameScheduler {
+	/// Reads the margin from `SHIFT_RENDER_MARGIN_US`.
+	pub fn from_env() -> Self {
+		let margin = std::env::var("SHIFT_RENDER_MARGIN_US")
+			.ok()
+			.and_then(|v| v.parse::<u64>().ok())
+			.map(Duration::from_micros)
+			.unwrap_or(DEFAULT_MARGIN);
+		Self {
+			margin_ns: margin.as_nanos() as u64,
+			stats: FrameStats::default(),
+			last_report: Instant::now(),
+		}
+	}
+
+	/// When to start compositing for a vblank predicted at `next_vblank_ns`. Without a
+	/// prediction (no flip observed yet) the frame starts right away.
+	pub fn start_ns(&self, next_vblank_ns: Option<u64>, now_ns: u64) -> u64 {
+		next_vblank_ns
+			.map(|vblank| vblank.saturating_sub(self.margin_ns))
+			.unwrap_or(now_ns)
+	}
+
+	/// Records a finished commit against the vblank it was aiming for.
+	pub fn record_commit(&mut self, target_vblank_ns: Option<u64>, now_ns: u64) {
+		let Some(vblank) = target_vblank_ns else {
+			return;
+		};
+		let slack = vblank as i64 - now_ns as i64;
+		let stats = &mut self.stats;
+		stats.commits += 1;
+		stats.late_commits += u64::from(slack < 0);
+		stats.slack_sum_ns += slack;
+		stats.min_slack_ns = Some(stats.min_slack_ns.map_or(slack, |min| min.min(slack)));
+		tracing::trace!(slack_us = slack / 1000, "frame committed");
+	}
+
+	pub fn record_presented(&mut self, frames: &[PresentedFrame]) {
+		self.stats.missed += frames.iter().filter(|frame| frame.missed).count() as u64;
+		if self.last_report.elapsed() < REPORT_INTERVAL {
+			return;
+		}
+		self.last_report = Instant::now();
+		let stats = std::mem::take(&mut self.stats);
+		if stats.commits == 0 {
+			return;
+		}
+		tracing::debug!(
+			commits = stats.commits,
+			late_commits = stats.late_commits,
+			missed = stats.missed,
+			margin_us = self.margin_ns / 1000,
+			avg_slack_us = stats.slack_sum_ns / stats.commits as i64 / 1000,
+			min_slack_us = stats.min_slack_ns.unwrap_or_default() / 1000,
+			"frame pacing"
+		);
+	}
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+	use crate::monitor::MonitorId;
+
+	const REFRESH: u64 = 16_666_667;
+	const MARGIN: u64 = 3_000_000;
+
+	fn scheduler() -> FrameScheduler {
+		FrameScheduler {
+			margin_ns: MARGIN,
+			stats: FrameStats::default(),
+			last_report: Instant::now(),
+		}
+	}
+
+	#[test]
+	fn starts_a_margin_before_the_predicted_vblank() {
+		let scheduler = scheduler();
+		let vblank = 100 * REFRESH;
+		assert_eq!(
+			scheduler.start_ns(Some(vblank), vblank - REFRESH),
+			vblank - MARGIN
+		);
+		// A start time already in the past is returned as is; the caller renders right away.
+		assert_eq!(
+			scheduler.start_ns(Some(vblank), vblank - 1_000),
+			vblank - MARGIN
+		);
+		assert_eq!(scheduler.start_ns(Some(1_000), 0), 0);
+	}
+
+	#[test]
+	fn starts_right_away_without_a_prediction() {
+		assert_eq!(scheduler().start_ns(None, 42), 42);
+	}
+
+	#[test]
+	fn tracks_slack_against_the_deadline() {
+		let mut scheduler = scheduler();
+		let vblank = 100 * REFRESH;
+		scheduler.record_commit(Some(vblank), vblank - 2_000_000);
+		scheduler.record_commit(Some(vblank + REFRESH), vblank + REFRESH + 500_000);
+		// Commits without a target don't count.
+		scheduler.record_commit(None, vblank);
+
+		let stats = &scheduler.stats;
+		assert_eq!(stats.commits, 2);
+		assert_eq!(stats.late_commits, 1);
+		assert_eq!(stats.min_slack_ns, Some(-500_000));
+		assert_eq!(stats.slack_sum_ns, 1_500_000);
+	}
+
+	#[test]
+	fn counts_missed_flips() {
+		let mut scheduler = scheduler();
+		let frame = |missed| PresentedFrame {
+			monitor_id: MonitorId::rand(),
+			sessions: Vec::new(),
+			sequence: 1,
+			vblank_ns: REFRESH,
+			refresh_ns: REFRESH,
+			missed,
+		};
+		scheduler.record_presented(&[frame(false), frame(true), frame(true)]);
+		assert_eq!(scheduler.stats.missed, 2);
+	}
+}
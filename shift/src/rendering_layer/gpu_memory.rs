@@ -0,0 +1,388 @@
+//! GPU memory accounting per session and monitor, and eviction of what Shift allocated for
+//! sleeping sessions once the total exceeds the budget set with `SHIFT_GPU_BUDGET_MB`.
+//!
+//! Only memory Shift allocates counts against the budget: render targets, snapshots,
+//! transition caches, Skia's cache and retired imports, which Shift alone keeps alive. The
+//! client buffers behind live imports are reported next to it but never "reclaimed", since
+//! the client's swapchain keeps them allocated whatever Shift does with its import.
+
+use std::{
+	collections::{HashMap, HashSet},
+	time::{Duration, Instant},
+};
+
+use crate::{
+	comms::render2server::{GpuMemoryReport, MonitorGpuMemory, SessionGpuMemory},
+	monitor::MonitorId,
+	sessions::SessionId,
+};
+
+use super::{RenderEvt, RenderingLayer};
+
+/// How often usage is recomputed (and the budget enforced) while nothing forces it.
+pub(super) const CHECK_INTERVAL: Duration = Duration::from_secs(2);
+/// Share of the budget Skia's own cache may use before it starts purging by itself.
+const SKIA_CACHE_SHARE: u64 = 4;
+
+pub(super) struct GpuBudget {
+	/// `None` when unlimited; usage is still tracked and reported.
+	budget_bytes: Option<u64>,
+	asleep: HashSet<SessionId>,
+	/// Sessions whose snapshots were dropped to stay within the budget.
+	evicted: HashSet<SessionId>,
+	last_check: Instant,
+	/// Set when something changed that may push usage over the budget.
+	dirty: bool,
+	last_report: Option<GpuMemoryReport>,
+}
+
+impl GpuBudget {
+	pub fn from_env() -> Self {
+		let budget_bytes = std::env::var("SHIFT_GPU_BUDGET_MB")
+			.ok()
+			.and_then(|v| v.parse::<u64>().ok())
+			.filter(|mb| *mb > 0)
+			.map(|mb| mb * 1024 * 1024);
+		Self {
+			budget_bytes,
+			asleep: HashSet::new(),
+			evicted: HashSet::new(),
+			last_check: Instant::now(),
+			dirty: true,
+			last_report: None,
+		}
+	}
+
+	/// Limit for Skia's resource cache, so scratch targets and pyramids stay a fraction of
+	/// the budget instead of Skia's fixed default.
+	pub fn skia_cache_limit(&self) -> Option<usize> {
+		self
+			.budget_bytes
+			.map(|budget| (budget / SKIA_CACHE_SHARE) as usize)
+	}
+
+	pub fn set_awake(&mut self, session_id: SessionId, awake: bool) {
+		if awake {
+			self.asleep.remove(&session_id);
+			// It is snapshotted again as soon as it draws.
+			self.evicted.remove(&session_id);
+		} else {
+			self.asleep.insert(session_id);
+		}
+		self.dirty = true;
+	}
+
+	pub fn mark_dirty(&mut self) {
+		self.dirty = true;
+	}
+
+	pub fn forget_session(&mut self, session_id: SessionId) {
+		self.asleep.remove(&session_id);
+		self.evicted.remove(&session_id);
+	}
+
+	/// Sleeping sessions, largest first, whose snapshots free `excess_bytes` out of `usage`.
+	/// `protected` sessions are never picked.
+	fn pick_evictions(
+		&self,
+		usage: impl IntoIterator<Item = (SessionId, u64)>,
+		protected: &HashSet<SessionId>,
+		excess_bytes: u64,
+	) -> Vec<(SessionId, u64)> {
+		let mut candidates = usage
+			.into_iter()
+			.filter(|(session_id, _)| self.asleep.contains(session_id) && !protected.contains(session_id))
+			.collect::<Vec<_>>();
+		candidates.sort_by_key(|(_, bytes)| std::cmp::Reverse(*bytes));
+
+		let mut freed = 0;
+		candidates
+			.into_iter()
+			.take_while(|(_, bytes)| {
+				let needed = freed < excess_bytes;
+				freed += bytes;
+				needed
+			})
+			.collect()
+	}
+}
+
+impl RenderingLayer {
+	/// Recomputes GPU memory usage when due, frees what it can while it is over budget and
+	/// reports changes to the server.
+	pub(super) async fn update_gpu_memory(&mut self) {
+		let budget = &mut self.gpu_budget;
+		if !budget.dirty && budget.last_check.elapsed() < CHECK_INTERVAL {
+			return;
+		}
+		budget.dirty = false;
+		budget.last_check = Instant::now();
+
+		// Without this, retired imports only expire when the next link or retire touches the
+		// cache, which on an idle desktop may be never.
+		if !self.import_cache.is_empty() && self.drm.make_current().is_ok() {
+			self.import_cache.expire();
+		}
+		let mut report = self.gpu_memory_report();
+		if let Some(budget_bytes) = self.gpu_budget.budget_bytes
+			&& report.total_bytes > budget_bytes
+		{
+			let excess_bytes = report.total_bytes - budget_bytes;
+			self.import_cache.clear();
+			self.evict_sleeping_sessions(excess_bytes);
+			// Dropped snapshots go back to Skia's cache as scratch textures; release them too.
+			self
+				.gr
+				.purge_unlocked_resources_bytes(excess_bytes as usize, true);
+			report = self.gpu_memory_report();
+			if report.total_bytes > budget_bytes {
+				tracing::warn!(
+					total_bytes = report.total_bytes,
+					budget_bytes,
+					"GPU memory over budget with nothing left to evict"
+				);
+			}
+		}
+		if self.gpu_budget.last_report.as_ref() == Some(&report) {
+			return;
+		}
+		self.gpu_budget.last_report = Some(report.clone());
+		self.emit_event(RenderEvt::GpuMemory(report)).await;
+	}
+
+	fn gpu_memory_report(&self) -> GpuMemoryReport {
+		let mut sessions: HashMap<SessionId, SessionGpuMemory> = HashMap::new();
+		let mut client_import_bytes = 0;
+		for (key, texture) in &self.slots {
+			let bytes = texture.byte_size();
+			session_usage(&mut sessions, key.session_id).client_bytes += bytes;
+			client_import_bytes += bytes;
+		}
+		for session_id in &self.gpu_budget.evicted {
+			session_usage(&mut sessions, *session_id).evicted = true;
+		}
+		let mut skia_attributed = 0;
+		for (session_id, bytes) in self.snapshots.bytes_by_session() {
+			session_usage(&mut sessions, session_id).bytes += bytes;
+			skia_attributed += bytes;
+		}
+
+		let mut monitors: HashMap<MonitorId, u64> = HashMap::new();
+		for mon in self.drm.monitors() {
+			let context = mon.context();
+			let target_bytes = context.width as u64 * context.height as u64 * 4;
+			*monitors.entry(context.id).or_default() +=
+				target_bytes * context.surfaces_by_fbo.len() as u64;
+		}
+		for (monitor_id, cache) in &self.transition_caches {
+			let bytes = cache.byte_size();
+			*monitors.entry(*monitor_id).or_default() += bytes;
+			skia_attributed += bytes;
+		}
+
+		let skia_cache_bytes =
+			(self.gr.resource_cache_usage().resource_bytes as u64).saturating_sub(skia_attributed);
+		build_report(
+			self.gpu_budget.budget_bytes,
+			sessions,
+			monitors,
+			skia_cache_bytes,
+			self.import_cache.byte_size(),
+			client_import_bytes,
+		)
+	}
+
+	/// Drops the snapshots of sleeping sessions, largest first, until `excess_bytes` are freed.
+	/// Switching to such a session cuts over until it has drawn and been snapshotted again.
+	fn evict_sleeping_sessions(&mut self, excess_bytes: u64) {
+		let mut protected = HashSet::new();
+		protected.extend(self.ownership.current_session());
+		if let Some(transition) = &self.active_transition {
+			protected.insert(transition.from_session_id);
+			protected.insert(transition.to_session_id);
+		}
+		let evictions =
+			self
+				.gpu_budget
+				.pick_evictions(self.snapshots.bytes_by_session(), &protected, excess_bytes);
+		for (session_id, bytes) in evictions {
+			self.snapshots.forget_session(session_id);
+			self.gpu_budget.evicted.insert(session_id);
+			tracing::info!(%session_id, bytes, "evicted sleeping session's snapshots");
+		}
+	}
+}
+
+/// Sorts the usage for stable reports and totals what counts against the budget; client
+/// bytes are reported but not part of `total_bytes`.
+fn build_report(
+	budget_bytes: Option<u64>,
+	sessions: HashMap<SessionId, SessionGpuMemory>,
+	monitors: HashMap<MonitorId, u64>,
+	skia_cache_bytes: u64,
+	retired_import_bytes: u64,
+	client_import_bytes: u64,
+) -> GpuMemoryReport {
+	let mut sessions = sessions.into_values().collect::<Vec<_>>();
+	sessions.sort_by_key(|usage| usage.session_id.to_string());
+	let mut monitors = monitors
+		.into_iter()
+		.map(|(monitor_id, bytes)| MonitorGpuMemory { monitor_id, bytes })
+		.collect::<Vec<_>>();
+	monitors.sort_by_key(|usage| usage.monitor_id.to_string());
+	let total_bytes = sessions.iter().map(|usage| usage.bytes).sum::<u64>()
+		+ monitors.iter().map(|usage| usage.bytes).sum::<u64>()
+		+ skia_cache_bytes
+		+ retired_import_bytes;
+	GpuMemoryReport {
+		total_bytes,
+		budget_bytes,
+		skia_cache_bytes,
+		retired_import_bytes,
+		client_import_bytes,
+		sessions,
+		monitors,
+	}
+}
+
+fn session_usage(
+	sessions: &mut HashMap<SessionId, SessionGpuMemory>,
+	session_id: SessionId,
+) -> &mut SessionGpuMemory {
+	sessions
+		.entry(session_id)
+		.or_insert_with(|| SessionGpuMemory {
+			session_id,
+			bytes: 0,
+			client_bytes: 0,
+			evicted: false,
+		})
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	const MB: u64 = 1024 * 1024;
+
+	fn budget(budget_mb: u64) -> GpuBudget {
+		GpuBudget {
+			budget_bytes: Some(budget_mb * MB),
+			asleep: HashSet::new(),
+			evicted: HashSet::new(),
+			last_check: Instant::now(),
+			dirty: false,
+			last_report: None,
+		}
+	}
+
+	#[test]
+	fn skia_gets_a_share_of_the_budget() {
+		assert_eq!(budget(400).skia_cache_limit(), Some((100 * MB) as usize));
+		let unlimited = GpuBudget {
+			budget_bytes: None,
+			..budget(1)
+		};
+		assert_eq!(unlimited.skia_cache_limit(), None);
+	}
+
+	#[test]
+	fn waking_up_clears_the_eviction() {
+		let mut budget = budget(100);
+		let session = SessionId::rand();
+		budget.set_awake(session, false);
+		assert!(budget.dirty);
+		budget.evicted.insert(session);
+
+		budget.set_awake(session, true);
+		assert!(!budget.asleep.contains(&session));
+		assert!(!budget.evicted.contains(&session));
+
+		budget.set_awake(session, false);
+		budget.evicted.insert(session);
+		budget.forget_session(session);
+		assert!(budget.asleep.is_empty() && budget.evicted.is_empty());
+	}
+
+	#[test]
+	fn evicts_sleeping_sessions_largest_first_until_enough_is_freed() {
+		let mut budget = budget(100);
+		let [small, large, medium, awake] = std::array::from_fn(|_| SessionId::rand());
+		for session in [small, large, medium] {
+			budget.set_awake(session, false);
+		}
+		let usage = vec![
+			(small, 10 * MB),
+			(large, 40 * MB),
+			(medium, 20 * MB),
+			(awake, 80 * MB),
+		];
+
+		let picked = budget.pick_evictions(usage.clone(), &HashSet::new(), 50 * MB);
+		assert_eq!(picked, vec![(large, 40 * MB), (medium, 20 * MB)]);
+
+		let picked = budget.pick_evictions(usage.clone(), &HashSet::new(), 40 * MB);
+		assert_eq!(picked, vec![(large, 40 * MB)]);
+
+		let picked = budget.pick_evictions(usage, &HashSet::new(), 0);
+		assert!(picked.is_empty());
+	}
+
+	#[test]
+	fn never_evicts_protected_sessions() {
+		let mut budget = budget(100);
+		let [current, asleep] = std::array::from_fn(|_| SessionId::rand());
+		budget.set_awake(current, false);
+		budget.set_awake(asleep, false);
+		let usage = vec![(current, 40 * MB), (asleep, 10 * MB)];
+
+		let picked = budget.pick_evictions(usage, &HashSet::from([current]), 100 * MB);
+		assert_eq!(picked, vec![(asleep, 10 * MB)]);
+	}
+
+	fn session_memory(session_id: SessionId, bytes: u64, client_bytes: u64) -> SessionGpuMemory {
+		SessionGpuMemory {
+			session_id,
+			bytes,
+			client_bytes,
+			evicted: false,
+		}
+	}
+
+	#[test]
+	fn total_counts_what_shift_allocated() {
+		let session = SessionId::rand();
+		let sessions = HashMap::from([(session, session_memory(session, 3 * MB, 50 * MB))]);
+		let monitor = MonitorId::rand();
+		let monitors = HashMap::from([(monitor, 8 * MB)]);
+
+		let report = build_report(Some(100 * MB), sessions, monitors, 2 * MB, MB, 50 * MB);
+		// Client buffers are reported but not counted.
+		assert_eq!(report.total_bytes, 14 * MB);
+		assert_eq!(report.client_import_bytes, 50 * MB);
+		assert_eq!(report.budget_bytes, Some(100 * MB));
+		assert_eq!(
+			report.monitors,
+			vec![MonitorGpuMemory {
+				monitor_id: monitor,
+				bytes: 8 * MB
+			}]
+		);
+	}
+
+	#[test]
+	fn reports_are_sorted() {
+		let sessions = (0..8)
+			.map(|_| SessionId::rand())
+			.map(|session_id| (session_id, session_memory(session_id, MB, 0)))
+			.collect();
+		let report = build_report(None, sessions, HashMap::new(), 0, 0, 0);
+		assert_eq!(report.total_bytes, 8 * MB);
+		assert!(
+			report
+				.sessions
+				.windows(2)
+				.all(|pair| pair[0].session_id.to_string() <= pair[1].session_id.to_string())
+		);
+	}
+}
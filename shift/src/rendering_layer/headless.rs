@@ -0,0 +1,325 @@
+//! Stand-in for the rendering layer without DRM or a GPU, used by `SHIFT_HEADLESS`.
+//!
+//! Buffers are never imported, but ownership, acquire fences and frame latency go through
+//! the same bookkeeping as on hardware, and every monitor "flips" on a fixed vblank timer.
+//! The server and its clients see the event flow of a real renderer that composites for
+//! free.
+
+use std::{
+	collections::{HashMap, HashSet},
+	os::fd::OwnedFd,
+	time::Duration,
+};
+
+use tokio::{sync::mpsc, time::MissedTickBehavior};
+use tracing::warn;
+
+use crate::{
+	comms::{
+		render2server::{PresentedFrame, RenderEvt, RenderEvtTx},
+		server2render::{RenderCmd, RenderCmdRx},
+	},
+	monitor::{Monitor, MonitorId},
+	sessions::SessionId,
+};
+
+use super::{
+	RenderError,
+	channels::RenderingEnd,
+	damage::Damage,
+	fence_scheduler::{FenceScheduler, FenceTaskHandle, FenceWaitMode},
+	frame_latency::FrameLatencyTracker,
+	ownership::OwnershipManager,
+	presentation::monotonic_ns,
+	state::{BufferSlot, FenceEvent, SlotKey},
+};
+
+pub struct HeadlessRenderer {
+	command_rx: RenderCmdRx,
+	event_tx: RenderEvtTx,
+	monitors: Vec<Monitor>,
+	refresh: Duration,
+	ownership: OwnershipManager,
+	/// Slots of every linked swapchain; the dma-bufs themselves are closed right away.
+	linked: HashSet<SlotKey>,
+	fence_event_tx: mpsc::UnboundedSender<FenceEvent>,
+	fence_event_rx: mpsc::UnboundedReceiver<FenceEvent>,
+	fence_scheduler: FenceScheduler,
+	fence_tasks: HashMap<SlotKey, FenceTaskHandle>,
+	frame_latency: FrameLatencyTracker,
+	/// Frames committed at the last vblank with the sessions shown, presented at the next.
+	committed: Vec<(MonitorId, Vec<SessionId>)>,
+	sequences: HashMap<MonitorId, u64>,
+}
+
+impl HeadlessRenderer {
+	pub fn new(
+		channels: RenderingEnd,
+		monitors: Vec<Monitor>,
+		refresh: Duration,
+	) -> Result<Self, RenderError> {
+		let (command_rx, event_tx) = channels.into_parts();
+		let (fence_event_tx, fence_event_rx) = mpsc::unbounded_channel();
+		Ok(Self {
+			command_rx,
+			event_tx,
+			monitors,
+			refresh,
+			ownership: OwnershipManager::new(),
+			linked: HashSet::new(),
+			fence_event_tx,
+			fence_event_rx,
+			fence_scheduler: FenceScheduler::new().map_err(RenderError::FenceReactor)?,
+			fence_tasks: HashMap::new(),
+			frame_latency: FrameLatencyTracker::default(),
+			committed: Vec::new(),
+			sequences: HashMap::new(),
+		})
+	}
+
+	#[tracing::instrument(skip_all)]
+	pub async fn run(mut self) -> Result<(), RenderError> {
+		self
+			.emit_event(RenderEvt::Started {
+				monitors: self.monitors.clone(),
+				render_node: None,
+			})
+			.await;
+		let mut vblank = tokio::time::interval(self.refresh);
+		vblank.set_missed_tick_behavior(MissedTickBehavior::Skip);
+		loop {
+			tokio::select! {
+				cmd = self.command_rx.recv() => {
+					let Some(cmd) = cmd else {
+						warn!("server→renderer channel closed, shutting down headless renderer");
+						break;
+					};
+					if !self.handle_command(cmd).await {
+						break;
+					}
+				}
+				fence_evt = self.fence_event_rx.recv() => {
+					if let Some(FenceEvent::Signaled { key }) = fence_evt {
+						self.fence_tasks.remove(&key);
+						self.frame_latency.ready(key);
+						if let Some(previous) = self.ownership.apply_acquire_fence_signaled(key) {
+							self
+								.ownership
+								.queue_buffer_release(key.monitor_id, key.session_id, previous);
+						}
+					}
+				}
+				scheduler_ok = self.fence_scheduler.recv_and_run() => {
+					if !scheduler_ok {
+						warn!("fence reactor failed");
+					}
+				}
+				_ = vblank.tick() => self.vblank().await,
+			}
+		}
+		Ok(())
+	}
+
+	async fn emit_event(&self, event: RenderEvt) {
+		if let Err(e) = self.event_tx.send(event).await {
+			warn!("failed to send renderer event to server: {e}");
+		}
+	}
+
+	fn cancel_fence_wait(&mut self, key: SlotKey) {
+		if let Some(handle) = self.fence_tasks.remove(&key) {
+			self.fence_scheduler.cancel(handle);
+		}
+	}
+
+	fn wait_for_acquire_fence(&mut self, key: SlotKey, fence: OwnedFd) {
+		self.cancel_fence_wait(key);
+		let tx = self.fence_event_tx.clone();
+		let handle = self.fence_scheduler.schedule(
+			vec![fence],
+			FenceWaitMode::All,
+			Box::new(move || {
+				let _ = tx.send(FenceEvent::Signaled { key });
+			}),
+		);
+		self.fence_tasks.insert(key, handle);
+	}
+
+	fn forget_slots(&mut self, filter: impl Fn(&SlotKey) -> bool) {
+		let keys = self
+			.linked
+			.extract_if(|key| filter(key))
+			.collect::<Vec<_>>();
+		for key in keys {
+			self.cancel_fence_wait(key);
+		}
+	}
+
+	/// Presents what the previous vblank committed, then commits every monitor whose
+	/// current session has new content and releases the buffers that replaced.
+	async fn vblank(&mut self) {
+		let vblank_ns = monotonic_ns();
+		let refresh_ns = self.refresh.as_nanos() as u64;
+		let mut frames = Vec::new();
+		for (monitor_id, sessions) in std::mem::take(&mut self.committed) {
+			self.frame_latency.presented(monitor_id, vblank_ns);
+			let sequence = self.sequences.entry(monitor_id).or_default();
+			*sequence += 1;
+			frames.push(PresentedFrame {
+				monitor_id,
+				sessions,
+				sequence: *sequence,
+				vblank_ns,
+				refresh_ns,
+				missed: false,
+			});
+		}
+		if !frames.is_empty() {
+			self.emit_event(RenderEvt::FramePresented { frames }).await;
+		}
+
+		let mut flipped = Vec::new();
+		for monitor_id in self.monitors.iter().map(|mon| mon.id).collect::<Vec<_>>() {
+			if !self.ownership.has_damage(monitor_id) {
+				continue;
+			}
+			self.ownership.take_damage(monitor_id);
+			let key = self.ownership.current_slot_key(monitor_id);
+			self.frame_latency.composited(monitor_id, key, vblank_ns);
+			self.committed.push((
+				monitor_id,
+				self.ownership.current_session().into_iter().collect(),
+			));
+			flipped.push(monitor_id);
+		}
+		for item in self.ownership.take_deferred_releases() {
+			let key = SlotKey::new(item.monitor_id, item.session_id, item.buffer);
+			self.ownership.mark_slot_client_owned(key);
+			self
+				.emit_event(RenderEvt::BufferConsumed {
+					session_id: item.session_id,
+					monitor_id: item.monitor_id,
+					buffer: item.buffer.into(),
+					release_fence: None,
+					released_ns: monotonic_ns(),
+				})
+				.await;
+		}
+		self
+			.emit_event(RenderEvt::PageFlip { monitors: flipped })
+			.await;
+	}
+
+	/// Returns `false` once the renderer should stop.
+	async fn handle_command(&mut self, cmd: RenderCmd) -> bool {
+		match cmd {
+			RenderCmd::Shutdown => return false,
+			RenderCmd::FramebufferLink {
+				payload,
+				dma_bufs,
+				session_id,
+			} => {
+				let Some(monitor_id) = payload
+					.monitor_id
+					.parse::<MonitorId>()
+					.ok()
+					.filter(|id| self.monitors.iter().any(|mon| mon.id == *id))
+				else {
+					warn!(monitor_id = %payload.monitor_id, "framebuffer link for unknown monitor");
+					return true;
+				};
+				self.forget_slots(|key| key.monitor_id == monitor_id && key.session_id == session_id);
+				for idx in 0..dma_bufs.len() {
+					let Some(slot) = BufferSlot::from_index(idx) else {
+						continue;
+					};
+					let key = SlotKey::new(monitor_id, session_id, slot);
+					self.linked.insert(key);
+					self.ownership.mark_slot_client_owned(key);
+				}
+			}
+			RenderCmd::SetActiveSession { session_id, .. } => {
+				self.ownership.set_current_session(session_id);
+				let monitor_ids = self.monitors.iter().map(|mon| mon.id).collect::<Vec<_>>();
+				self.ownership.ensure_current_session_monitors(&monitor_ids);
+			}
+			RenderCmd::SetPresentMode { .. } | RenderCmd::SessionAwake { .. } => {}
+			RenderCmd::SessionRemoved { session_id } => {
+				self.forget_slots(|key| key.session_id == session_id);
+				self.ownership.cleanup_session(session_id);
+				self.frame_latency.forget_session(session_id);
+				for (_, sessions) in &mut self.committed {
+					sessions.retain(|session| *session != session_id);
+				}
+				if self.ownership.current_session() == Some(session_id) {
+					self.ownership.set_current_session(None);
+				}
+			}
+			RenderCmd::CollectLatency => {
+				let frames = self.frame_latency.report();
+				self.emit_event(RenderEvt::FrameLatency(frames)).await;
+			}
+			RenderCmd::SwapBuffers {
+				monitor_id,
+				buffer,
+				session_id,
+				acquire_fence,
+				requested_ns,
+				damage,
+			} => {
+				let slot_key = SlotKey::new(monitor_id, session_id, BufferSlot::from(buffer));
+				if !self.linked.contains(&slot_key) {
+					let monitor_known = self.monitors.iter().any(|mon| mon.id == monitor_id);
+					self
+						.emit_event(RenderEvt::BufferRequestRejected {
+							session_id,
+							monitor_id,
+							buffer,
+							reason: if monitor_known {
+								"unlinked_buffer"
+							} else {
+								"unknown_monitor"
+							}
+							.into(),
+						})
+						.await;
+					return true;
+				}
+				let transition = self.ownership.apply_swap_request(
+					monitor_id,
+					session_id,
+					slot_key.buffer,
+					acquire_fence.is_some(),
+					Damage::from_rects(&damage),
+				);
+				if let Some(pending) = transition.canceled_pending {
+					self.cancel_fence_wait(SlotKey::new(monitor_id, session_id, pending));
+					self
+						.ownership
+						.queue_buffer_release(monitor_id, session_id, pending);
+				}
+				self.frame_latency.requested(slot_key, requested_ns);
+				match acquire_fence {
+					Some(fence) => self.wait_for_acquire_fence(slot_key, fence),
+					None => {
+						self.cancel_fence_wait(slot_key);
+						self.frame_latency.ready(slot_key);
+					}
+				}
+				if let Some(previous) = transition.previous_to_release {
+					self
+						.ownership
+						.queue_buffer_release(monitor_id, session_id, previous);
+				}
+				self
+					.emit_event(RenderEvt::BufferRequestAck {
+						session_id,
+						monitor_id,
+						buffer,
+					})
+					.await;
+			}
+		}
+		true
+	}
+}
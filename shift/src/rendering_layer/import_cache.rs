@@ -0,0 +1,230 @@
+//! Imported client buffers that outlived their slot, kept so that linking the same dma-bufs
+//! again (a re-link, a monitor coming back, a compositor reconnecting) reuses the EGLImage,
+//! texture and Skia image instead of importing from scratch.
+
+use std::{
+	collections::VecDeque,
+	time::{Duration, Instant},
+};
+
+use super::dmabuf_import::{DmaBufIdentity, SkiaDmaBufTexture};
+
+/// Retired imports kept at most; the oldest go first.
+const MAX_RETIRED: usize = 32;
+/// Retired imports keep their dma-buf alive, so they are not kept around indefinitely. The
+/// periodic GPU memory check expires them even while nothing else touches the cache.
+const MAX_RETIRED_AGE: Duration = Duration::from_secs(30);
+
+/// What the cache needs to know about an import.
+pub(super) trait CachedImport {
+	type Identity: PartialEq;
+
+	/// `None` for imports that can't be matched to a later link, which aren't kept.
+	fn identity(&self) -> Option<&Self::Identity>;
+	fn byte_size(&self) -> u64;
+}
+
+impl CachedImport for SkiaDmaBufTexture {
+	type Identity = DmaBufIdentity;
+
+	fn identity(&self) -> Option<&DmaBufIdentity> {
+		SkiaDmaBufTexture::identity(self)
+	}
+
+	fn byte_size(&self) -> u64 {
+		SkiaDmaBufTexture::byte_size(self)
+	}
+}
+
+struct Retired<T> {
+	texture: T,
+	retired_at: Instant,
+}
+
+pub(super) struct ImportCache<T = SkiaDmaBufTexture> {
+	retired: VecDeque<Retired<T>>,
+	hits: u64,
+	misses: u64,
+}
+
+impl<T> Default for ImportCache<T> {
+	fn default() -> Self {
+		Self {
+			retired: VecDeque::new(),
+			hits: 0,
+			misses: 0,
+		}
+	}
+}
+
+impl<T: CachedImport> ImportCache<T> {
+	/// Takes back a retired import of the buffer `identity` describes.
+	pub fn take(&mut self, identity: &T::Identity) -> Option<T> {
+		self.expire();
+		let index = self
+			.retired
+			.iter()
+			.position(|retired| retired.texture.identity() == Some(identity));
+		let Some(index) = index else {
+			self.misses += 1;
+			return None;
+		};
+		self.hits += 1;
+		tracing::debug!(
+			hits = self.hits,
+			misses = self.misses,
+			"reusing dma-buf import"
+		);
+		self.retired.remove(index).map(|retired| retired.texture)
+	}
+
+	/// Keeps `texture` for reuse after its slot went away. Needs the GL context current;
+	/// evicted imports are destroyed right away.
+	pub fn retire(&mut self, texture: T) {
+		if texture.identity().is_none() {
+			return;
+		}
+		self.retired.push_back(Retired {
+			texture,
+			retired_at: Instant::now(),
+		});
+		while self.retired.len() > MAX_RETIRED {
+			self.retired.pop_front();
+		}
+		self.expire();
+	}
+
+	/// Memory the retired imports keep alive.
+	pub fn byte_size(&self) -> u64 {
+		self
+			.retired
+			.iter()
+			.map(|retired| retired.texture.byte_size())
+			.sum()
+	}
+
+	pub fn is_empty(&self) -> bool {
+		self.retired.is_empty()
+	}
+
+	/// Destroys every retired import. Needs the GL context current.
+	pub fn clear(&mut self) {
+		self.retired.clear();
+	}
+
+	/// Destroys the imports retired more than [`MAX_RETIRED_AGE`] ago. Needs the GL context
+	/// current.
+	pub fn expire(&mut self) {
+		while self
+			.retired
+			.front()
+			.is_some_and(|retired| retired.retired_at.elapsed() >= MAX_RETIRED_AGE)
+		{
+			self.retired.pop_front();
+		}
+	}
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	#[derive(Debug, PartialEq)]
+	struct FakeImport {
+		id: Option<u64>,
+		bytes: u64,
+	}
+
+	impl CachedImport for FakeImport {
+		type Identity = u64;
+
+		fn identity(&self) -> Option<&u64> {
+			self.id.as_ref()
+		}
+
+		fn byte_size(&self) -> u64 {
+			self.bytes
+		}
+	}
+
+	fn import(id: u64) -> FakeImport {
+		FakeImport {
+			id: Some(id),
+			bytes: 1024 * id,
+		}
+	}
+
+	#[test]
+	fn takes_back_matching_imports_once() {
+		let mut cache = ImportCache::default();
+		cache.retire(import(1));
+		cache.retire(import(2));
+		assert_eq!(cache.byte_size(), 3 * 1024);
+
+		assert_eq!(cache.take(&2), Some(import(2)));
+		assert_eq!(cache.take(&2), None);
+		assert_eq!(cache.take(&3), None);
+		assert_eq!((cache.hits, cache.misses), (1, 2));
+		assert_eq!(cache.byte_size(), 1024);
+	}
+
+	#[test]
+	fn skips_imports_without_an_identity() {
+		let mut cache = ImportCache::default();
+		cache.retire(FakeImport {
+			id: None,
+			bytes: 4096,
+		});
+		assert_eq!(cache.byte_size(), 0);
+	}
+
+	#[test]
+	fn evicts_the_oldest_past_the_limit() {
+		let mut cache = ImportCache::default();
+		for id in 0..MAX_RETIRED as u64 + 2 {
+			cache.retire(import(id));
+		}
+		assert_eq!(cache.retired.len(), MAX_RETIRED);
+		assert_eq!(cache.take(&0), None);
+		assert_eq!(cache.take(&1), None);
+		assert_eq!(cache.take(&2), Some(import(2)));
+	}
+
+	#[test]
+	fn expires_imports_retired_too_long_ago() {
+		let mut cache = ImportCache::default();
+		cache.retire(import(1));
+		cache.retire(import(2));
+		let Some(long_ago) = Instant::now().checked_sub(MAX_RETIRED_AGE) else {
+			return;
+		};
+		cache.retired[0].retired_at = long_ago;
+
+		assert_eq!(cache.take(&1), None);
+		assert_eq!(cache.retired.len(), 1);
+		assert_eq!(cache.byte_size(), 2 * 1024);
+	}
+
+	#[test]
+	fn expire_runs_without_a_take() {
+		let mut cache = ImportCache::default();
+		cache.retire(import(1));
+		let Some(long_ago) = Instant::now().checked_sub(MAX_RETIRED_AGE) else {
+			return;
+		};
+		cache.retired[0].retired_at = long_ago;
+
+		cache.expire();
+		assert!(cache.is_empty());
+		assert_eq!(cache.byte_size(), 0);
+	}
+
+	#[test]
+	fn clear_drops_everything() {
+		let mut cache = ImportCache::default();
+		cache.retire(import(1));
+		cache.clear();
+		assert_eq!(cache.byte_size(), 0);
+		assert_eq!(cache.take(&1), None);
+	}
+}
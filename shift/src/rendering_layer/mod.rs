@@ -3,23 +3,36 @@
 mod animation;
 pub mod channels;
 mod commands;
+mod damage;
 pub mod dmabuf_import;
 mod egl;
 mod fence_runtime;
 mod fence_scheduler;
+mod frame_latency;
+mod frame_scheduler;
+mod gpu_memory;
+pub mod headless;
+mod import_cache;
 mod ownership;
+mod presentation;
 mod render_core;
+mod render_node;
+mod snapshots;
 mod state;
 mod surface_cache;
 
+pub(crate) use presentation::monotonic_ns;
+
 use easydrm::EasyDRM;
 use skia_safe::gpu;
 use std::{
 	collections::HashMap,
+	sync::Arc,
 	time::{Duration, Instant as StdInstant},
 };
 #[cfg(debug_assertions)]
 use std::{fs, time::Instant};
+use tab_protocol::{FormatModifiers, PresentMode, RenderNodeInfo};
 use thiserror::Error;
 use tokio::sync::mpsc;
 use tracing::warn;
@@ -33,14 +46,26 @@ use crate::{
 	monitor::{Monitor as ServerLayerMonitor, MonitorId},
 	sessions::SessionId,
 };
-use animation::AnimationRegistry;
+use animation::{AnimationRegistry, Quality, TransitionCache};
 use channels::RenderingEnd;
+use damage::DamageHistory;
 use dmabuf_import::SkiaDmaBufTexture;
 use fence_scheduler::{FenceScheduler, FenceTaskHandle, FenceWaitMode};
+use frame_latency::FrameLatencyTracker;
+use frame_scheduler::FrameScheduler;
+use gpu_memory::GpuBudget;
+use import_cache::ImportCache;
 use ownership::OwnershipManager;
+use presentation::PresentationTracker;
+use snapshots::SnapshotCache;
 use state::{FenceEvent, SlotKey};
 use surface_cache::{MonitorRenderState, current_framebuffer_binding};
 
+/// Back-off before retrying a monitor a render pass could not draw.
+const RENDER_RETRY_INTERVAL: Duration = Duration::from_millis(2);
+/// Frames in a row over budget before a transition's quality is lowered.
+const OVER_BUDGET_FRAMES: u32 = 3;
+
 #[derive(Debug, Error)]
 pub enum RenderError {
 	#[error("easydrm error: {0}")]
@@ -55,6 +80,9 @@ pub enum RenderError {
 	#[error("skia surface creation failed")]
 	SkiaSurface,
 
+	#[error("fence reactor setup failed: {0}")]
+	FenceReactor(std::io::Error),
+
 	#[cfg(debug_assertions)]
 	#[error("open fd guard exceeded: {count} > {limit}")]
 	OpenFdGuardExceeded { count: usize, limit: usize },
@@ -68,12 +96,34 @@ pub struct RenderingLayer {
 	known_monitors: HashMap<MonitorId, ServerLayerMonitor>,
 	ownership: OwnershipManager,
 	slots: HashMap<SlotKey, SkiaDmaBufTexture>,
+	/// Imports whose slot went away, reused when the same buffers are linked again.
+	import_cache: ImportCache,
 	fence_event_tx: mpsc::UnboundedSender<FenceEvent>,
 	fence_event_rx: mpsc::UnboundedReceiver<FenceEvent>,
 	fence_scheduler: FenceScheduler,
 	fence_tasks: HashMap<SlotKey, FenceTaskHandle>,
 	animations: AnimationRegistry,
 	active_transition: Option<ActiveTransition>,
+	/// What the running transition's animation prepared for each monitor.
+	transition_caches: HashMap<MonitorId, TransitionCache>,
+	snapshots: SnapshotCache,
+	gpu_budget: GpuBudget,
+	/// Non-vsync presentation modes sessions asked for.
+	present_modes: HashMap<SessionId, PresentMode>,
+	/// Mode each monitor was last presented with.
+	monitor_present_modes: HashMap<MonitorId, PresentMode>,
+	/// Monitors a pass left wanting a frame (e.g. `make_current` failed), and when to try
+	/// them again.
+	render_retry_after_ns: HashMap<MonitorId, u64>,
+	presentation: PresentationTracker,
+	frame_latency: FrameLatencyTracker,
+	frame_scheduler: FrameScheduler,
+	damage: HashMap<MonitorId, DamageHistory>,
+	egl: egl::Egl,
+	/// Formats and modifiers EGL can import, advertised on every monitor.
+	import_formats: Arc<[FormatModifiers]>,
+	/// Advertised to clients so they allocate on the GPU shift composites on.
+	render_node: Option<RenderNodeInfo>,
 	#[cfg(debug_assertions)]
 	fd_guard_limit: usize,
 	#[cfg(debug_assertions)]
@@ -87,6 +137,9 @@ struct ActiveTransition {
 	animation: String,
 	started_at: StdInstant,
 	duration: Duration,
+	quality: Quality,
+	/// Consecutive frames that took longer than the animation's budget.
+	over_budget_frames: u32,
 }
 
 impl ActiveTransition {
@@ -100,9 +153,31 @@ impl ActiveTransition {
 			animation: transition.animation,
 			started_at: StdInstant::now(),
 			duration: transition.duration,
+			quality: Quality::default(),
+			over_budget_frames: 0,
 		})
 	}
 
+	/// Lowers the animation's quality once frames keep exceeding `budget`.
+	fn record_frame_cost(&mut self, cost: Duration, budget: Duration) {
+		if cost <= budget {
+			self.over_budget_frames = 0;
+			return;
+		}
+		self.over_budget_frames += 1;
+		if self.over_budget_frames >= OVER_BUDGET_FRAMES && self.quality != Quality::Minimal {
+			self.quality = self.quality.degraded();
+			self.over_budget_frames = 0;
+			tracing::debug!(
+				animation = %self.animation,
+				cost_us = cost.as_micros() as u64,
+				budget_us = budget.as_micros() as u64,
+				quality = ?self.quality,
+				"transition over budget, lowering quality"
+			);
+		}
+	}
+
 	fn progress(&self, now: StdInstant) -> f64 {
 		if self.duration.is_zero() {
 			return 1.0;
@@ -123,9 +198,19 @@ impl RenderingLayer {
 			.map_err(|_| RenderError::SkiaGlInterface)?;
 		let interface = gpu::gl::Interface::new_load_with(|s| drm.get_proc_address(s))
 			.ok_or(RenderError::SkiaGlInterface)?;
-		let gr =
+		let mut gr =
 			gpu::direct_contexts::make_gl(interface, None).ok_or(RenderError::SkiaDirectContext)?;
+		let gpu_budget = GpuBudget::from_env();
+		if let Some(limit) = gpu_budget.skia_cache_limit() {
+			gr.set_resource_cache_limit(limit);
+		}
 		let (fence_event_tx, fence_event_rx) = mpsc::unbounded_channel();
+		let import_formats: Arc<[FormatModifiers]> =
+			dmabuf_import::query_import_formats(&|s| drm.get_proc_address(s)).into();
+		tracing::info!(formats = ?import_formats, "dma-buf import formats");
+		let render_node = render_node::query_render_node(&|s| drm.get_proc_address(s));
+		tracing::info!(?render_node, "render node");
+		let egl = egl::Egl::load_with(|s| drm.get_proc_address(s));
 
 		Ok(Self {
 			drm,
@@ -135,12 +220,26 @@ impl RenderingLayer {
 			known_monitors: HashMap::new(),
 			ownership: OwnershipManager::new(),
 			slots: HashMap::new(),
+			import_cache: ImportCache::default(),
 			fence_event_tx,
 			fence_event_rx,
-			fence_scheduler: FenceScheduler::new(),
+			fence_scheduler: FenceScheduler::new().map_err(RenderError::FenceReactor)?,
 			fence_tasks: HashMap::new(),
 			animations: AnimationRegistry::new(),
 			active_transition: None,
+			transition_caches: HashMap::new(),
+			snapshots: SnapshotCache::from_env(),
+			gpu_budget,
+			present_modes: HashMap::new(),
+			monitor_present_modes: HashMap::new(),
+			render_retry_after_ns: HashMap::new(),
+			presentation: PresentationTracker::default(),
+			frame_latency: FrameLatencyTracker::default(),
+			frame_scheduler: FrameScheduler::from_env(),
+			damage: HashMap::new(),
+			egl,
+			import_formats,
+			render_node,
 			#[cfg(debug_assertions)]
 			fd_guard_limit: std::env::var("SHIFT_MAX_OPEN_FDS")
 				.ok()
@@ -161,46 +260,55 @@ impl RenderingLayer {
 		self
 			.emit_event(RenderEvt::Started {
 				monitors: current.clone(),
+				render_node: self.render_node.clone(),
 			})
 			.await;
 		self.known_monitors = current.into_iter().map(|m| (m.id, m)).collect();
 
-		'e: loop {
+		loop {
 			#[cfg(debug_assertions)]
 			self.check_open_fd_guard()?;
-			let committed_any = self.render_and_commit().await?;
+			self.update_gpu_memory().await;
+			let now_ns = presentation::monotonic_ns();
+			let next_render_ns = self.next_render_ns();
+			if next_render_ns.is_some_and(|start| start <= now_ns) {
+				self.render_and_commit().await?;
+				continue;
+			}
+			// Sleep until the next frame is due, or indefinitely while idle.
+			let render_timer = next_render_ns
+				.map(|start| tokio::time::Instant::now() + Duration::from_nanos(start - now_ns));
 
-			'l: loop {
-				tokio::select! {
-					cmd = command_rx.recv() => {
-						if let Some(cmd) = cmd {
-							if !self.handle_command(cmd).await? {
-								break 'e;
-							}
-						} else {
-							warn!("server→renderer channel closed, shutting down renderer");
-							break 'e;
-						}
-					}
-					result = self.drm.poll_events_async() => {
-						result?;
-						self.sync_monitors().await;
-						break 'l;
-					}
-					fence_evt = self.fence_event_rx.recv() => {
-						if let Some(fence_evt) = fence_evt {
-							self.handle_fence_event(fence_evt).await;
+			tokio::select! {
+				cmd = command_rx.recv() => {
+					if let Some(cmd) = cmd {
+						if !self.handle_command(cmd).await? {
+							break;
 						}
+					} else {
+						warn!("server→renderer channel closed, shutting down renderer");
+						break;
 					}
-					scheduler_ok = self.fence_scheduler.recv_and_run() => {
-						if !scheduler_ok {
-							warn!("fence scheduler channel closed");
-						}
+				}
+				result = self.drm.poll_events_async() => {
+					result?;
+					self.emit_presentation_feedback().await;
+					self.sync_monitors().await;
+				}
+				fence_evt = self.fence_event_rx.recv() => {
+					if let Some(fence_evt) = fence_evt {
+						self.handle_fence_event(fence_evt).await;
 					}
-					_ = tokio::time::sleep(Duration::from_millis(2)), if !committed_any => {
-						break 'l;
+				}
+				scheduler_ok = self.fence_scheduler.recv_and_run() => {
+					if !scheduler_ok {
+						warn!("fence reactor failed");
 					}
 				}
+				_ = tokio::time::sleep_until(render_timer.unwrap_or_else(tokio::time::Instant::now)),
+					if render_timer.is_some() => {}
+				// Wakes an idle loop for the GPU memory check, which expires retired imports.
+				_ = tokio::time::sleep(gpu_memory::CHECK_INTERVAL), if !self.import_cache.is_empty() => {}
 			}
 		}
 
@@ -246,7 +354,7 @@ impl RenderingLayer {
 		self
 			.drm
 			.monitors()
-			.map(MonitorRenderState::get_server_layer_monitor)
+			.map(|mon| MonitorRenderState::get_server_layer_monitor(mon, &self.import_formats))
 			.collect()
 	}
 
@@ -281,8 +389,24 @@ impl RenderingLayer {
 		self.known_monitors = current_map;
 	}
 
+	/// Forces the next frame on every monitor to repaint fully.
+	fn invalidate_all_monitors(&mut self) {
+		for history in self.damage.values_mut() {
+			history.invalidate();
+		}
+	}
+
 	fn cleanup_monitor_slots(&mut self, monitor_id: MonitorId) {
-		self.slots.retain(|key, _| key.monitor_id != monitor_id);
+		self.presentation.forget_monitor(monitor_id);
+		self.frame_latency.forget_monitor(monitor_id);
+		self.damage.remove(&monitor_id);
+		self.transition_caches.remove(&monitor_id);
+		self.snapshots.forget_monitor(monitor_id);
+		self.monitor_present_modes.remove(&monitor_id);
+		self.render_retry_after_ns.remove(&monitor_id);
+		for (_, texture) in self.slots.extract_if(|key, _| key.monitor_id == monitor_id) {
+			self.import_cache.retire(texture);
+		}
 		self.ownership.cleanup_monitor(monitor_id);
 		let remove = self
 			.fence_tasks
@@ -296,7 +420,12 @@ impl RenderingLayer {
 	}
 
 	fn cleanup_session_slots(&mut self, session_id: SessionId) {
-		self.slots.retain(|key, _| key.session_id != session_id);
+		for (_, texture) in self.slots.extract_if(|key, _| key.session_id == session_id) {
+			self.import_cache.retire(texture);
+		}
+		self.snapshots.forget_session(session_id);
+		self.gpu_budget.forget_session(session_id);
+		self.frame_latency.forget_session(session_id);
 		self.ownership.cleanup_session(session_id);
 		let remove = self
 			.fence_tasks
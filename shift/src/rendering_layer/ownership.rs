@@ -2,6 +2,7 @@ use std::collections::HashMap;
 
 use crate::{monitor::MonitorId, sessions::SessionId};
 
+use super::damage::Damage;
 use super::state::{BufferSlot, DeferredRelease, MonitorSurfaceState, SlotKey, SlotOwner};
 
 pub(super) struct SwapApplyResult {
@@ -97,6 +98,7 @@ impl OwnershipManager {
 		session_id: SessionId,
 		slot: BufferSlot,
 		has_acquire_fence: bool,
+		damage: Damage,
 	) -> SwapApplyResult {
 		let canceled_pending = self
 			.monitor_state
@@ -108,13 +110,23 @@ impl OwnershipManager {
 
 		let state = self.state_entry(monitor_id, session_id);
 		let previous = state.current_buffer;
+		// A replaced pending buffer was never shown, so its damage carries over.
+		let damage = if state.pending_buffer.is_some() {
+			state.pending_damage.union(damage)
+		} else {
+			damage
+		};
 		state.pending_buffer = Some(slot);
+		state.pending_damage = damage;
 
 		let previous_to_release = if has_acquire_fence {
 			None
 		} else {
 			state.current_buffer = Some(slot);
 			state.pending_buffer = None;
+			state.damage = state
+				.damage
+				.union(std::mem::take(&mut state.pending_damage));
 			previous.filter(|prev| *prev != slot)
 		};
 
@@ -132,9 +144,31 @@ impl OwnershipManager {
 		let previous = state.current_buffer;
 		state.current_buffer = Some(key.buffer);
 		state.pending_buffer = None;
+		state.damage = state
+			.damage
+			.union(std::mem::take(&mut state.pending_damage));
 		previous.filter(|prev| *prev != key.buffer)
 	}
 
+	/// Whether the current session has shown new content on `monitor_id` since the last
+	/// [`take_damage`](Self::take_damage).
+	pub fn has_damage(&self, monitor_id: MonitorId) -> bool {
+		self
+			.current_session
+			.and_then(|session_id| self.monitor_state.get(&(monitor_id, session_id)))
+			.is_some_and(|state| !state.damage.is_none())
+	}
+
+	pub fn take_damage(&mut self, monitor_id: MonitorId) -> Damage {
+		let Some(session_id) = self.current_session else {
+			return Damage::None;
+		};
+		self
+			.state_mut(monitor_id, session_id)
+			.map(|state| std::mem::take(&mut state.damage))
+			.unwrap_or_default()
+	}
+
 	pub fn queue_buffer_release(
 		&mut self,
 		monitor_id: MonitorId,
@@ -153,6 +187,10 @@ impl OwnershipManager {
 		});
 	}
 
+	pub fn has_deferred_releases(&self) -> bool {
+		!self.deferred_releases.is_empty()
+	}
+
 	pub fn take_deferred_releases(&mut self) -> Vec<DeferredRelease> {
 		self.deferred_releases.drain(..).collect()
 	}
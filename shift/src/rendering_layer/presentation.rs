@@ -0,0 +1,123 @@
+//! Presentation feedback: per-monitor flip sequence numbers and vblank timing.
+
+use std::collections::HashMap;
+
+use crate::{comms::render2server::PresentedFrame, monitor::MonitorId, sessions::SessionId};
+
+#[derive(Debug, Default)]
+struct MonitorTiming {
+	sequence: u64,
+	last_vblank_ns: Option<u64>,
+	refresh_ns: u64,
+}
+
+#[derive(Debug)]
+struct PendingPresent {
+	monitor_id: MonitorId,
+	sessions: Vec<SessionId>,
+	committed_ns: u64,
+	refresh_ns: u64,
+}
+
+/// Tracks committed frames until their flip completes.
+#[derive(Debug, Default)]
+pub(super) struct PresentationTracker {
+	monitors: HashMap<MonitorId, MonitorTiming>,
+	pending: Vec<PendingPresent>,
+}
+
+impl PresentationTracker {
+	/// Records a commit on `monitor_id` showing content from `sessions`.
+	pub fn committed(&mut self, monitor_id: MonitorId, sessions: Vec<SessionId>, vrefresh: u32) {
+		let refresh_ns = if vrefresh > 0 {
+			1_000_000_000 / vrefresh as u64
+		} else {
+			0
+		};
+		self
+			.pending
+			.retain(|pending| pending.monitor_id != monitor_id);
+		self.pending.push(PendingPresent {
+			monitor_id,
+			sessions,
+			committed_ns: monotonic_ns(),
+			refresh_ns,
+		});
+	}
+
+	/// Completes the pending frames whose monitor has flipped, stamping them with the
+	/// current time. Called right after DRM events were dispatched, so that is within the
+	/// event latency of the real vblank.
+	pub fn complete(&mut self, flipped: impl Fn(MonitorId) -> bool) -> Vec<PresentedFrame> {
+		if self.pending.is_empty() {
+			return Vec::new();
+		}
+		let vblank_ns = monotonic_ns();
+		let mut frames = Vec::new();
+		let monitors = &mut self.monitors;
+		self.pending.retain_mut(|pending| {
+			if !flipped(pending.monitor_id) {
+				return true;
+			}
+			let timing = monitors.entry(pending.monitor_id).or_default();
+			timing.sequence += 1;
+			let missed = match timing.last_vblank_ns {
+				Some(last) if pending.refresh_ns > 0 => {
+					let refresh = pending.refresh_ns;
+					// First vblank after the commit, on the grid set by the previous flip.
+					let cycles = pending
+						.committed_ns
+						.saturating_sub(last)
+						.div_ceil(refresh)
+						.max(1);
+					vblank_ns > last + cycles * refresh + refresh / 2
+				}
+				_ => false,
+			};
+			timing.last_vblank_ns = Some(vblank_ns);
+			timing.refresh_ns = pending.refresh_ns;
+			frames.push(PresentedFrame {
+				monitor_id: pending.monitor_id,
+				sessions: std::mem::take(&mut pending.sessions),
+				sequence: timing.sequence,
+				vblank_ns,
+				refresh_ns: pending.refresh_ns,
+				missed,
+			});
+			false
+		});
+		frames
+	}
+
+	/// Predicted first vblank on `monitor_id` after `now_ns`, extrapolated from the last
+	/// observed flip. `None` until a flip has been seen.
+	pub fn next_vblank_ns(&self, monitor_id: MonitorId, now_ns: u64) -> Option<u64> {
+		let timing = self.monitors.get(&monitor_id)?;
+		let last = timing.last_vblank_ns?;
+		let refresh = timing.refresh_ns;
+		if refresh == 0 {
+			return None;
+		}
+		let cycles = now_ns.saturating_sub(last) / refresh + 1;
+		Some(last + cycles * refresh)
+	}
+
+	pub fn forget_monitor(&mut self, monitor_id: MonitorId) {
+		self.monitors.remove(&monitor_id);
+		self
+			.pending
+			.retain(|pending| pending.monitor_id != monitor_id);
+	}
+}
+
+/// `CLOCK_MONOTONIC` in nanoseconds, the clock DRM and libinput timestamps use.
+pub(crate) fn monotonic_ns() -> u64 {
+	let mut ts = libc::timespec {
+		tv_sec: 0,
+		tv_nsec: 0,
+	};
+	unsafe {
+		libc::clock_gettime(libc::CLOCK_MONOTONIC, &mut ts);
+	}
+	ts.tv_sec as u64 * 1_000_000_000 + ts.tv_nsec as u64
+}
@@ -1,11 +1,26 @@
 use easydrm::gl::{COLOR_BUFFER_BIT, DEPTH_BUFFER_BIT};
-use skia_safe::{FilterMode, MipmapMode, Paint, SamplingOptions};
+use skia_safe::{BlendMode, ClipOp, FilterMode, MipmapMode, Paint, SamplingOptions};
 use std::collections::HashMap;
+use tab_protocol::PresentMode;
 use tracing::warn;
 
+use super::animation::TransitionFrames;
+use super::damage::{self, Damage, DamageHistory};
+use super::ownership::OwnershipManager;
+use super::presentation::monotonic_ns;
 use super::state::SlotOwner;
-use super::{RenderError, RenderEvt, RenderingLayer, current_framebuffer_binding};
+use super::{
+	RENDER_RETRY_INTERVAL, RenderError, RenderEvt, RenderingLayer, current_framebuffer_binding,
+};
 use super::{SkiaDmaBufTexture, SlotKey};
+use crate::{monitor::MonitorId, sessions::SessionId};
+
+#[derive(Debug, Clone, Copy)]
+struct PendingFrame {
+	monitor_id: MonitorId,
+	vblank_ns: Option<u64>,
+	start_ns: u64,
+}
 
 impl RenderingLayer {
 	fn slot_image(
@@ -27,7 +42,168 @@ impl RenderingLayer {
 			.draw_image_rect_with_sampling_options(image, None, rect, sampling, &paint);
 	}
 
-	pub(super) fn draw_ready_monitors(&mut self) -> Result<(), RenderError> {
+	/// Copies `region` of a monitor-sized client buffer 1:1 into the target. `Src` blending
+	/// overwrites every pixel, so the target needs no clear and its old contents are never read.
+	fn draw_image_passthrough(
+		context: &mut super::MonitorRenderState,
+		image: &skia_safe::Image,
+		region: Damage,
+	) {
+		if region.is_none() {
+			return;
+		}
+		let sampling = SamplingOptions::new(FilterMode::Nearest, MipmapMode::None);
+		let mut paint = Paint::default();
+		paint.set_blend_mode(BlendMode::Src);
+		let canvas = context.canvas();
+		canvas.save();
+		if let Damage::Rect(rect) = region {
+			let clip = skia_safe::Rect::from_xywh(
+				rect.x as f32,
+				rect.y as f32,
+				rect.width as f32,
+				rect.height as f32,
+			);
+			canvas.clip_rect(clip, ClipOp::Intersect, false);
+		}
+		canvas.draw_image_with_sampling_options(image, (0.0, 0.0), sampling, Some(&paint));
+		canvas.restore();
+	}
+
+	fn needs_frame(
+		transitioning: bool,
+		history: Option<&DamageHistory>,
+		ownership: &OwnershipManager,
+		monitor_id: MonitorId,
+	) -> bool {
+		transitioning
+			|| history.is_none_or(DamageHistory::needs_full)
+			|| ownership.has_damage(monitor_id)
+	}
+
+	/// Monitors that can take a new frame and have something to show, with the vblank each
+	/// one is predicted to flip on and the time its composite should start.
+	fn pending_frames(&self, now_ns: u64) -> impl Iterator<Item = PendingFrame> + '_ {
+		self
+			.drm
+			.monitors()
+			.filter(|mon| mon.can_render())
+			.map(|mon| mon.context().id)
+			.filter(|monitor_id| {
+				Self::needs_frame(
+					self.active_transition.is_some(),
+					self.damage.get(monitor_id),
+					&self.ownership,
+					*monitor_id,
+				)
+			})
+			.map(move |monitor_id| {
+				let vblank_ns = self.presentation.next_vblank_ns(monitor_id, now_ns);
+				// Without vsync the flip doesn't wait for vblank, so neither does the composite.
+				let start_ns = match self.present_mode(monitor_id) {
+					PresentMode::Vsync => self.frame_scheduler.start_ns(vblank_ns, now_ns),
+					PresentMode::AdaptiveSync | PresentMode::Async => now_ns,
+				};
+				let retry_ns = self.render_retry_after_ns.get(&monitor_id).copied();
+				let start_ns = start_ns.max(retry_ns.unwrap_or(0));
+				PendingFrame {
+					monitor_id,
+					vblank_ns,
+					start_ns,
+				}
+			})
+	}
+
+	/// Mode `monitor_id` presents with: what the current session asked for while its buffer
+	/// covers the whole monitor and no transition runs, vsync otherwise. It only moves the
+	/// composite deadline; the flip itself is vsynced in every mode, since easydrm's swap
+	/// exposes neither `VRR_ENABLED` nor async page flips.
+	fn present_mode(&self, monitor_id: MonitorId) -> PresentMode {
+		if self.active_transition.is_some() {
+			return PresentMode::Vsync;
+		}
+		let Some(mode) = self
+			.ownership
+			.current_session()
+			.and_then(|session_id| self.present_modes.get(&session_id))
+		else {
+			return PresentMode::Vsync;
+		};
+		let fullscreen = self
+			.ownership
+			.current_slot_key(monitor_id)
+			.and_then(|key| self.slots.get(&key))
+			.zip(
+				self
+					.drm
+					.monitors()
+					.find(|mon| mon.context().id == monitor_id),
+			)
+			.is_some_and(|(texture, mon)| {
+				let (width, height) = mon.active_mode().size();
+				texture.size() == (width as i32, height as i32)
+			});
+		if fullscreen {
+			*mode
+		} else {
+			PresentMode::Vsync
+		}
+	}
+
+	/// Logs monitors whose presentation mode changed with this commit.
+	fn track_present_modes(&mut self, monitor_ids: &[MonitorId]) {
+		for monitor_id in monitor_ids {
+			let mode = self.present_mode(*monitor_id);
+			let previous = self.monitor_present_modes.insert(*monitor_id, mode);
+			if previous.unwrap_or_default() != mode {
+				tracing::debug!(%monitor_id, ?mode, "presentation mode changed");
+			}
+		}
+	}
+
+	/// `CLOCK_MONOTONIC` time at which the next render pass should start, or `None` when
+	/// nothing is waiting to be shown. Monitors with new content are paced to their predicted
+	/// vblank; pending buffer releases are processed right away.
+	pub(super) fn next_render_ns(&self) -> Option<u64> {
+		let now_ns = monotonic_ns();
+		if self.ownership.has_deferred_releases() {
+			return Some(now_ns);
+		}
+		self
+			.pending_frames(now_ns)
+			.map(|frame| frame.start_ns)
+			.min()
+	}
+
+	/// Monitors whose composite is due at `now_ns`, most urgent vblank first. Monitors are
+	/// paced independently, so a fast panel is never held back to a slow one's cadence and a
+	/// slow one is not redrawn early.
+	fn due_monitors(&self, now_ns: u64) -> Vec<MonitorId> {
+		let mut due = self
+			.pending_frames(now_ns)
+			.filter(|frame| frame.start_ns <= now_ns)
+			.collect::<Vec<_>>();
+		due.sort_by_key(|frame| frame.vblank_ns);
+		due.into_iter().map(|frame| frame.monitor_id).collect()
+	}
+
+	/// Backs off the monitors of a pass's `due` set that still want a frame right after it,
+	/// so a failing one is not retried in a busy loop. Monitors that became due meanwhile,
+	/// or are waiting on their flip, keep their own deadline.
+	fn schedule_retries(&mut self, due: &[MonitorId]) {
+		let after_ns = monotonic_ns();
+		let still_due = self.due_monitors(after_ns);
+		for monitor_id in due {
+			if still_due.contains(monitor_id) {
+				let retry_ns = after_ns + RENDER_RETRY_INTERVAL.as_nanos() as u64;
+				self.render_retry_after_ns.insert(*monitor_id, retry_ns);
+			} else {
+				self.render_retry_after_ns.remove(monitor_id);
+			}
+		}
+	}
+
+	pub(super) fn draw_ready_monitors(&mut self, due: &[MonitorId]) -> Result<(), RenderError> {
 		let monitor_ids: Vec<_> = self.drm.monitors().map(|mon| mon.context().id).collect();
 		self.ownership.ensure_current_session_monitors(&monitor_ids);
 		let now = std::time::Instant::now();
@@ -37,27 +213,82 @@ impl RenderingLayer {
 			.map(|transition| transition.progress(now) >= 1.0)
 			.unwrap_or(false);
 
-		for mon in self.drm.monitors_mut() {
+		for monitor_id in due {
+			let Some(mon) = self
+				.drm
+				.monitors_mut()
+				.find(|mon| mon.context().id == *monitor_id)
+			else {
+				continue;
+			};
 			if !mon.can_render() {
 				continue;
 			}
+			let monitor_id = *monitor_id;
+			let history = self.damage.entry(monitor_id).or_default();
+			// Nothing new to show: leave the previous frame on screen and skip the flip.
+			if !Self::needs_frame(
+				transition_snapshot.is_some(),
+				Some(history),
+				&self.ownership,
+				monitor_id,
+			) {
+				continue;
+			}
 			if let Err(e) = mon.make_current() {
 				warn!(monitor_id = %mon.context().id, "make_current failed: {e:?}");
 				continue;
 			}
 
-			unsafe {
-				mon.gl().ClearColor(0.0, 0.0, 0.0, 1.0);
-				mon.gl().Clear(COLOR_BUFFER_BIT | DEPTH_BUFFER_BIT);
-			}
-
-			let monitor_id = mon.context().id;
 			let mode = mon.active_mode();
 			let (w, h) = (mode.size().0 as usize, mode.size().1 as usize);
+			let client_damage = self.ownership.take_damage(monitor_id);
+			let frame_damage = if transition_snapshot.is_some() || history.needs_full() {
+				Damage::Full
+			} else {
+				client_damage
+			};
+
+			// Steady state: a single session whose buffer matches the mode is copied straight
+			// into the target instead of being composited over a cleared frame.
+			let passthrough = if transition_snapshot.is_none() {
+				self
+					.ownership
+					.current_slot_key(monitor_id)
+					.filter(|key| self.ownership.owner(*key) == Some(SlotOwner::ShiftOwned))
+					.and_then(|key| Self::slot_image(&mut self.slots, &mut self.gr, key))
+					.filter(|image| image.width() as usize == w && image.height() as usize == h)
+			} else {
+				None
+			};
+
+			if passthrough.is_none() {
+				unsafe {
+					mon.gl().ClearColor(0.0, 0.0, 0.0, 1.0);
+					mon.gl().Clear(COLOR_BUFFER_BIT | DEPTH_BUFFER_BIT);
+				}
+			}
+
 			let context = mon.context_mut();
 			let target_fbo = current_framebuffer_binding(&context.gl);
 			context.ensure_surface_target(&mut self.gr, w, h, target_fbo)?;
 
+			if let Some(image) = passthrough {
+				let age =
+					damage::current_buffer_age(&self.egl).unwrap_or_else(|| history.target_age(target_fbo));
+				let region = history.repaint_region(frame_damage, age, w, h);
+				Self::draw_image_passthrough(context, &image, region);
+				history.record(target_fbo, frame_damage);
+				let current_session = self.ownership.current_session();
+				self
+					.snapshots
+					.refresh(&mut self.gr, monitor_id, current_session, &image);
+				context.flush(&mut self.gr);
+				continue;
+			}
+			// Composited frames are scaled or animated, so they always repaint everything.
+			history.record(target_fbo, Damage::Full);
+
 			let mut drew = false;
 			if let Some(transition) = transition_snapshot.as_ref()
 				&& let Some(animation) = self.animations.get(&transition.animation)
@@ -68,25 +299,42 @@ impl RenderingLayer {
 				let new_key = self
 					.ownership
 					.current_slot_key_for_session(monitor_id, transition.to_session_id);
+				// Sessions whose buffers aren't ours right now animate from their snapshot.
 				let old_image = old_key
 					.filter(|key| self.ownership.owner(*key) == Some(SlotOwner::ShiftOwned))
-					.and_then(|key| Self::slot_image(&mut self.slots, &mut self.gr, key));
+					.and_then(|key| Self::slot_image(&mut self.slots, &mut self.gr, key))
+					.or_else(|| self.snapshots.image(monitor_id, transition.from_session_id));
 				let new_image = new_key
 					.filter(|key| self.ownership.owner(*key) == Some(SlotOwner::ShiftOwned))
-					.and_then(|key| Self::slot_image(&mut self.slots, &mut self.gr, key));
+					.and_then(|key| Self::slot_image(&mut self.slots, &mut self.gr, key))
+					.or_else(|| self.snapshots.image(monitor_id, transition.to_session_id));
 				match (old_image, new_image) {
 					(Some(old_image), Some(new_image)) => {
 						let width = context.width as f32;
 						let height = context.height as f32;
+						let cache = self
+							.transition_caches
+							.entry(monitor_id)
+							.or_insert_with(|| animation.prepare(context.canvas(), &old_image, &new_image));
+						let frames = TransitionFrames {
+							old_image: &old_image,
+							new_image: &new_image,
+							cache,
+						};
+						let started = std::time::Instant::now();
 						animation.draw(
 							context.canvas(),
-							&old_image,
-							&new_image,
+							&frames,
 							transition.progress(now),
 							width,
 							height,
+							transition.quality,
 						);
-						drew = true;
+						context.flush(&mut self.gr);
+						if let Some(active) = self.active_transition.as_mut() {
+							active.record_frame_cost(started.elapsed(), animation.frame_budget());
+						}
+						continue;
 					}
 					(_, Some(new_image)) => {
 						Self::draw_image_fullscreen(context, &new_image);
@@ -103,6 +351,17 @@ impl RenderingLayer {
 					.and_then(|key| Self::slot_image(&mut self.slots, &mut self.gr, key));
 				if let Some(image) = image {
 					Self::draw_image_fullscreen(context, &image);
+					let current_session = self.ownership.current_session();
+					self
+						.snapshots
+						.refresh(&mut self.gr, monitor_id, current_session, &image);
+				} else if let Some(snapshot) = self
+					.ownership
+					.current_session()
+					.and_then(|session_id| self.snapshots.image(monitor_id, session_id))
+				{
+					// Until the session submits a frame, keep showing what it showed last.
+					Self::draw_image_fullscreen(context, &snapshot);
 				}
 			}
 
@@ -111,13 +370,94 @@ impl RenderingLayer {
 
 		if transition_done {
 			self.active_transition = None;
+			self.transition_caches.clear();
+			self.invalidate_all_monitors();
 		}
 
 		Ok(())
 	}
 
+	/// Snapshots what `session_id` currently shows on every monitor, e.g. right before it
+	/// stops being the current session.
+	pub(super) fn snapshot_session(&mut self, session_id: SessionId) {
+		if self.drm.make_current().is_err() {
+			return;
+		}
+		let monitor_ids = self.known_monitors.keys().copied().collect::<Vec<_>>();
+		for monitor_id in monitor_ids {
+			let image = self
+				.ownership
+				.current_slot_key_for_session(monitor_id, session_id)
+				.filter(|key| self.ownership.owner(*key) == Some(SlotOwner::ShiftOwned))
+				.and_then(|key| Self::slot_image(&mut self.slots, &mut self.gr, key));
+			if let Some(image) = image {
+				self
+					.snapshots
+					.capture(&mut self.gr, monitor_id, session_id, &image);
+			}
+		}
+		self.gr.flush_and_submit();
+	}
+
+	/// Remembers which sessions are visible in the frame just committed on `monitor_id`,
+	/// composited at `composited_ns`.
+	fn track_presentation(&mut self, monitor_id: MonitorId, composited_ns: u64) {
+		let mut sessions = Vec::with_capacity(2);
+		if let Some(key) = self.ownership.current_slot_key(monitor_id) {
+			sessions.push(key.session_id);
+		}
+		if let Some(transition) = self.active_transition.as_ref() {
+			for session_id in [transition.from_session_id, transition.to_session_id] {
+				if !sessions.contains(&session_id) {
+					sessions.push(session_id);
+				}
+			}
+		}
+		let vrefresh = self
+			.drm
+			.monitors()
+			.find(|mon| mon.context().id == monitor_id)
+			.map(|mon| mon.active_mode().vrefresh())
+			.unwrap_or(0);
+		let keys = sessions
+			.iter()
+			.filter_map(|session_id| {
+				self
+					.ownership
+					.current_slot_key_for_session(monitor_id, *session_id)
+			})
+			.collect::<Vec<_>>();
+		self
+			.frame_latency
+			.composited(monitor_id, keys, composited_ns);
+		self.presentation.committed(monitor_id, sessions, vrefresh);
+	}
+
+	/// Emits timing for every committed frame whose monitor finished flipping.
+	pub(super) async fn emit_presentation_feedback(&mut self) {
+		let drm = &self.drm;
+		let frames = self.presentation.complete(|monitor_id| {
+			drm
+				.monitors()
+				.find(|mon| mon.context().id == monitor_id)
+				.is_some_and(|mon| mon.can_render())
+		});
+		if !frames.is_empty() {
+			for frame in &frames {
+				self
+					.frame_latency
+					.presented(frame.monitor_id, frame.vblank_ns);
+			}
+			self.frame_scheduler.record_presented(&frames);
+			self.emit_event(RenderEvt::FramePresented { frames }).await;
+		}
+	}
+
 	pub(super) async fn render_and_commit(&mut self) -> Result<bool, RenderError> {
-		self.draw_ready_monitors()?;
+		let started_ns = monotonic_ns();
+		let due = self.due_monitors(started_ns);
+		self.draw_ready_monitors(&due)?;
+		let composited_ns = monotonic_ns();
 
 		let page_flipped_monitors = self
 			.drm
@@ -126,16 +466,26 @@ impl RenderingLayer {
 			.map(|m| m.context().id)
 			.collect::<Vec<_>>();
 
+		self.track_present_modes(&page_flipped_monitors);
 		let swap_result = self.drm.swap_buffers_with_result()?;
 		let committed_any = !swap_result.committed_connectors.is_empty();
 		self
 			.process_deferred_releases(swap_result.render_fence)
 			.await;
+		if committed_any {
+			let committed_ns = monotonic_ns();
+			for monitor_id in &page_flipped_monitors {
+				let target = self.presentation.next_vblank_ns(*monitor_id, started_ns);
+				self.frame_scheduler.record_commit(target, committed_ns);
+				self.track_presentation(*monitor_id, composited_ns);
+			}
+		}
 		self
 			.emit_event(RenderEvt::PageFlip {
 				monitors: page_flipped_monitors,
 			})
 			.await;
+		self.schedule_retries(&due);
 
 		Ok(committed_any)
 	}
@@ -0,0 +1,62 @@
+//! The DRM render node of the GPU shift composites on, advertised to clients so they allocate
+//! their buffers on the same device instead of probing for one.
+
+use std::{
+	ffi::{CStr, c_void},
+	os::unix::fs::MetadataExt,
+	path::{Path, PathBuf},
+};
+
+use tab_protocol::RenderNodeInfo;
+
+use crate::rendering_layer::egl;
+
+/// `EGL_DRM_RENDER_NODE_FILE_EXT` from `EGL_EXT_device_drm_render_node`, newer than the
+/// registry the bindings are generated from.
+const DRM_RENDER_NODE_FILE_EXT: egl::types::EGLint = 0x3377;
+
+/// Looks up the render node behind the current EGL display. `None` when the driver doesn't
+/// expose its device, in which case clients fall back to probing.
+pub fn query_render_node(proc_resolver: &dyn Fn(&str) -> *const c_void) -> Option<RenderNodeInfo> {
+	let egl = egl::Egl::load_with(|name| proc_resolver(name));
+	if !(egl.QueryDisplayAttribEXT.is_loaded() && egl.QueryDeviceStringEXT.is_loaded()) {
+		return None;
+	}
+	let display = unsafe { egl.GetCurrentDisplay() };
+	if display.is_null() {
+		return None;
+	}
+	let mut attrib: egl::types::EGLAttrib = 0;
+	if unsafe { egl.QueryDisplayAttribEXT(display, egl::DEVICE_EXT as _, &mut attrib) } == 0 {
+		return None;
+	}
+	let device = attrib as egl::types::EGLDeviceEXT;
+	let device_string = |name: egl::types::EGLint| {
+		let ptr = unsafe { egl.QueryDeviceStringEXT(device, name) };
+		(!ptr.is_null())
+			.then(|| unsafe { CStr::from_ptr(ptr) })
+			.and_then(|s| s.to_str().ok())
+			.map(PathBuf::from)
+	};
+	let path = device_string(DRM_RENDER_NODE_FILE_EXT).or_else(|| {
+		device_string(egl::DRM_DEVICE_FILE_EXT as _).map(|card| render_node_of(&card).unwrap_or(card))
+	})?;
+	let dev = std::fs::metadata(&path).ok()?.rdev();
+	Some(RenderNodeInfo {
+		path: path.to_string_lossy().into_owned(),
+		dev,
+	})
+}
+
+/// Maps a primary node (`/dev/dri/cardN`) to the render node of the same GPU through sysfs.
+fn render_node_of(card: &Path) -> Option<PathBuf> {
+	let rdev = std::fs::metadata(card).ok()?.rdev();
+	let (major, minor) = (libc::major(rdev), libc::minor(rdev));
+	let drm_dir = format!("/sys/dev/char/{major}:{minor}/device/drm");
+	std::fs::read_dir(drm_dir)
+		.ok()?
+		.filter_map(Result::ok)
+		.map(|entry| entry.file_name())
+		.find(|name| name.to_string_lossy().starts_with("renderD"))
+		.map(|name| Path::new("/dev/dri").join(name))
+}
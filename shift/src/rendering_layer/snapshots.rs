@@ -0,0 +1,162 @@
+//! Downscaled copies of the last frame each session showed on each monitor, kept so that a
+//! switch to a session whose buffers aren't available (client-owned, or the session is
+//! asleep) still has something to show and animate from.
+
+use std::{
+	collections::HashMap,
+	time::{Duration, Instant},
+};
+
+use skia_safe::{
+	AlphaType, ColorType, FilterMode, Image, ImageInfo, MipmapMode, Paint, Rect, SamplingOptions,
+	Surface, gpu,
+};
+
+use crate::{monitor::MonitorId, sessions::SessionId};
+
+const DEFAULT_SCALE: f32 = 0.5;
+/// Minimum age of a snapshot before the renderer replaces it with the current frame.
+const REFRESH_INTERVAL: Duration = Duration::from_secs(1);
+
+struct Snapshot {
+	/// Reused across refreshes of the same size.
+	surface: Surface,
+	image: Image,
+	captured_at: Instant,
+}
+
+pub(super) struct SnapshotCache {
+	/// Snapshot size relative to the frame; `0` disables snapshots.
+	scale: f32,
+	/// `RGB565` when compact snapshots are enabled, halving their memory.
+	color_type: ColorType,
+	snapshots: HashMap<(MonitorId, SessionId), Snapshot>,
+}
+
+impl SnapshotCache {
+	/// Reads the scale from `SHIFT_SNAPSHOT_SCALE` and `SHIFT_SNAPSHOT_COMPACT=1` for 16-bit
+	/// snapshots.
+	pub fn from_env() -> Self {
+		let scale = std::env::var("SHIFT_SNAPSHOT_SCALE")
+			.ok()
+			.and_then(|v| v.parse::<f32>().ok())
+			.unwrap_or(DEFAULT_SCALE)
+			.clamp(0.0, 1.0);
+		let compact = std::env::var("SHIFT_SNAPSHOT_COMPACT").is_ok_and(|v| v == "1");
+		Self {
+			scale,
+			color_type: if compact {
+				ColorType::RGB565
+			} else {
+				ColorType::RGBA8888
+			},
+			snapshots: HashMap::new(),
+		}
+	}
+
+	pub fn image(&self, monitor_id: MonitorId, session_id: SessionId) -> Option<Image> {
+		self
+			.snapshots
+			.get(&(monitor_id, session_id))
+			.map(|snapshot| snapshot.image.clone())
+	}
+
+	/// Recaptures the snapshot of `session_id` from a newly drawn `frame` once the previous
+	/// one is [`REFRESH_INTERVAL`] old.
+	pub fn refresh(
+		&mut self,
+		gr: &mut gpu::DirectContext,
+		monitor_id: MonitorId,
+		session_id: Option<SessionId>,
+		frame: &Image,
+	) {
+		let Some(session_id) = session_id else {
+			return;
+		};
+		let stale = self
+			.snapshots
+			.get(&(monitor_id, session_id))
+			.is_none_or(|snapshot| snapshot.captured_at.elapsed() >= REFRESH_INTERVAL);
+		if stale {
+			self.capture(gr, monitor_id, session_id, frame);
+		}
+	}
+
+	/// Copies `frame` into the snapshot of `session_id` on `monitor_id`. The copy is recorded
+	/// on `gr` and runs with its next flush.
+	pub fn capture(
+		&mut self,
+		gr: &mut gpu::DirectContext,
+		monitor_id: MonitorId,
+		session_id: SessionId,
+		frame: &Image,
+	) {
+		if self.scale <= 0.0 {
+			return;
+		}
+		let width = ((frame.width() as f32 * self.scale).round() as i32).max(1);
+		let height = ((frame.height() as f32 * self.scale).round() as i32).max(1);
+		let reusable = self
+			.snapshots
+			.remove(&(monitor_id, session_id))
+			.map(|snapshot| snapshot.surface)
+			.filter(|surface| surface.width() == width && surface.height() == height);
+		let surface = reusable.or_else(|| {
+			let info = ImageInfo::new((width, height), self.color_type, AlphaType::Opaque, None);
+			gpu::surfaces::render_target(
+				gr,
+				gpu::Budgeted::Yes,
+				&info,
+				None,
+				gpu::SurfaceOrigin::TopLeft,
+				None,
+				false,
+				None,
+			)
+		});
+		let Some(mut surface) = surface else {
+			tracing::warn!(%monitor_id, width, height, "failed to allocate session snapshot");
+			return;
+		};
+		let sampling = SamplingOptions::new(FilterMode::Linear, MipmapMode::None);
+		surface.canvas().draw_image_rect_with_sampling_options(
+			frame,
+			None,
+			Rect::from_wh(width as f32, height as f32),
+			sampling,
+			&Paint::default(),
+		);
+		let image = surface.image_snapshot();
+		self.snapshots.insert(
+			(monitor_id, session_id),
+			Snapshot {
+				surface,
+				image,
+				captured_at: Instant::now(),
+			},
+		);
+	}
+
+	/// Memory the snapshots of each session take, across monitors.
+	pub fn bytes_by_session(&self) -> HashMap<SessionId, u64> {
+		let bytes_per_pixel = self.color_type.bytes_per_pixel() as u64;
+		let mut bytes = HashMap::new();
+		for ((_, session_id), snapshot) in &self.snapshots {
+			let pixels = snapshot.surface.width() as u64 * snapshot.surface.height() as u64;
+			*bytes.entry(*session_id).or_default() += pixels * bytes_per_pixel;
+		}
+		bytes
+	}
+
+	pub fn forget_monitor(&mut self, monitor_id: MonitorId) {
+		self
+			.snapshots
+			.retain(|(monitor, _), _| *monitor != monitor_id);
+	}
+
+	pub fn forget_session(&mut self, session_id: SessionId) {
+		self
+			.snapshots
+			.retain(|(_, session), _| *session != session_id);
+	}
+}
@@ -1,11 +1,16 @@
 use tab_protocol::BufferIndex;
 
+use super::damage::Damage;
 use crate::{monitor::MonitorId, sessions::SessionId};
 
 #[derive(Default, Debug)]
 pub(super) struct MonitorSurfaceState {
 	pub current_buffer: Option<BufferSlot>,
 	pub pending_buffer: Option<BufferSlot>,
+	/// Damage of buffers that became current since the monitor was last drawn.
+	pub damage: Damage,
+	/// Damage carried by `pending_buffer`, applied once its acquire fence signals.
+	pub pending_damage: Damage,
 }
 
 #[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
@@ -29,6 +34,8 @@ impl SlotKey {
 pub(super) enum BufferSlot {
 	Zero,
 	One,
+	Two,
+	Three,
 }
 
 #[derive(Debug)]
@@ -54,6 +61,8 @@ impl BufferSlot {
 		match idx {
 			0 => Some(Self::Zero),
 			1 => Some(Self::One),
+			2 => Some(Self::Two),
+			3 => Some(Self::Three),
 			_ => None,
 		}
 	}
@@ -64,6 +73,8 @@ impl From<BufferIndex> for BufferSlot {
 		match value {
 			BufferIndex::Zero => BufferSlot::Zero,
 			BufferIndex::One => BufferSlot::One,
+			BufferIndex::Two => BufferSlot::Two,
+			BufferIndex::Three => BufferSlot::Three,
 		}
 	}
 }
@@ -73,6 +84,8 @@ impl From<BufferSlot> for BufferIndex {
 		match value {
 			BufferSlot::Zero => BufferIndex::Zero,
 			BufferSlot::One => BufferIndex::One,
+			BufferSlot::Two => BufferIndex::Two,
+			BufferSlot::Three => BufferIndex::Three,
 		}
 	}
 }
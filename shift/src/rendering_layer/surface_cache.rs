@@ -1,9 +1,10 @@
-use std::collections::HashMap;
+use std::{collections::HashMap, sync::Arc};
 
 use easydrm::{Monitor, MonitorContextCreationRequest, gl};
 use skia_safe::{
 	self as skia, FilterMode, MipmapMode, Paint, SamplingOptions, gpu, gpu::gl::FramebufferInfo,
 };
+use tab_protocol::FormatModifiers;
 
 use crate::monitor::{Monitor as ServerLayerMonitor, MonitorId};
 
@@ -68,13 +69,17 @@ impl MonitorRenderState {
 		gr.flush(None);
 	}
 
-	pub fn get_server_layer_monitor(monitor: &Monitor<Self>) -> ServerLayerMonitor {
+	pub fn get_server_layer_monitor(
+		monitor: &Monitor<Self>,
+		formats: &Arc<[FormatModifiers]>,
+	) -> ServerLayerMonitor {
 		crate::monitor::Monitor {
 			height: monitor.size().1 as _,
 			width: monitor.size().0 as _,
 			id: monitor.context().id,
 			name: format!("Monitor {}", u32::from(monitor.connector_id())),
 			refresh_rate: monitor.active_mode().vrefresh(),
+			formats: formats.clone(),
 		}
 	}
 
@@ -0,0 +1,289 @@
+//! Buffer bookkeeping of every session swapchain on every monitor: who owns each slot and
+//! which buffer request is in flight. Keyed by `(session, monitor)` with a dense slot array,
+//! so the per-event paths never scan other sessions' state.
+
+use std::collections::HashMap;
+
+use tab_protocol::{BufferIndex, MAX_SWAPCHAIN_BUFFERS};
+
+use crate::{client_layer::client::ClientId, monitor::MonitorId, sessions::SessionId};
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(super) enum BufferOwner {
+	Client,
+	Shift,
+}
+
+#[derive(Debug, Clone, Copy)]
+pub(super) struct PendingBufferRequest {
+	pub client_id: ClientId,
+	pub buffer: BufferIndex,
+}
+
+#[derive(Debug, Default)]
+struct Swapchain {
+	/// Indexed by [`BufferIndex`]; `None` for slots that aren't linked.
+	owners: [Option<BufferOwner>; MAX_SWAPCHAIN_BUFFERS],
+	/// At most one request per swapchain is forwarded to the renderer at a time.
+	pending: Option<PendingBufferRequest>,
+}
+
+#[derive(Debug, Default)]
+pub(super) struct BufferTable {
+	swapchains: HashMap<(SessionId, MonitorId), Swapchain>,
+	/// Swapchains with a request in flight, per session.
+	inflight: HashMap<SessionId, usize>,
+}
+
+impl BufferTable {
+	/// Resets the swapchain of `session_id` on `monitor_id` to `buffer_count` client-owned
+	/// slots, dropping a request still in flight.
+	pub fn link(&mut self, session_id: SessionId, monitor_id: MonitorId, buffer_count: usize) {
+		let swapchain = self.swapchains.entry((session_id, monitor_id)).or_default();
+		if swapchain.pending.take().is_some() {
+			release_inflight(&mut self.inflight, session_id);
+		}
+		for (slot, owner) in swapchain.owners.iter_mut().enumerate() {
+			*owner = (slot < buffer_count).then_some(BufferOwner::Client);
+		}
+	}
+
+	pub fn owner(
+		&self,
+		session_id: SessionId,
+		monitor_id: MonitorId,
+		buffer: BufferIndex,
+	) -> Option<BufferOwner> {
+		self
+			.swapchains
+			.get(&(session_id, monitor_id))
+			.and_then(|swapchain| swapchain.owners[buffer as usize])
+	}
+
+	/// Linked slots of the swapchain and their owners, for diagnostics.
+	pub fn owners(&self, session_id: SessionId, monitor_id: MonitorId) -> Vec<(u8, BufferOwner)> {
+		let Some(swapchain) = self.swapchains.get(&(session_id, monitor_id)) else {
+			return Vec::new();
+		};
+		BufferIndex::ALL
+			.into_iter()
+			.filter_map(|buffer| Some((buffer as u8, swapchain.owners[buffer as usize]?)))
+			.collect()
+	}
+
+	pub fn set_owner(
+		&mut self,
+		session_id: SessionId,
+		monitor_id: MonitorId,
+		buffer: BufferIndex,
+		owner: BufferOwner,
+	) {
+		self
+			.swapchains
+			.entry((session_id, monitor_id))
+			.or_default()
+			.owners[buffer as usize] = Some(owner);
+	}
+
+	pub fn has_pending(&self, session_id: SessionId, monitor_id: MonitorId) -> bool {
+		self
+			.swapchains
+			.get(&(session_id, monitor_id))
+			.is_some_and(|swapchain| swapchain.pending.is_some())
+	}
+
+	/// Records a request forwarded to the renderer. Callers check [`Self::has_pending`] first.
+	pub fn begin_request(
+		&mut self,
+		session_id: SessionId,
+		monitor_id: MonitorId,
+		request: PendingBufferRequest,
+	) {
+		let swapchain = self.swapchains.entry((session_id, monitor_id)).or_default();
+		if swapchain.pending.replace(request).is_none() {
+			*self.inflight.entry(session_id).or_default() += 1;
+		}
+	}
+
+	/// Completes the request in flight for `buffer`, if that is the one the renderer answered.
+	pub fn finish_request(
+		&mut self,
+		session_id: SessionId,
+		monitor_id: MonitorId,
+		buffer: BufferIndex,
+	) -> Option<PendingBufferRequest> {
+		let swapchain = self.swapchains.get_mut(&(session_id, monitor_id))?;
+		let pending = swapchain
+			.pending
+			.take_if(|pending| pending.buffer == buffer)?;
+		release_inflight(&mut self.inflight, session_id);
+		Some(pending)
+	}
+
+	pub fn has_inflight_for_session(&self, session_id: SessionId) -> bool {
+		self.inflight.contains_key(&session_id)
+	}
+
+	/// Requests in flight across all sessions.
+	pub fn inflight_count(&self) -> usize {
+		self.inflight.values().sum()
+	}
+
+	pub fn forget_monitor(&mut self, monitor_id: MonitorId) {
+		let inflight = &mut self.inflight;
+		self.swapchains.retain(|(session_id, monitor), swapchain| {
+			if *monitor != monitor_id {
+				return true;
+			}
+			if swapchain.pending.is_some() {
+				release_inflight(inflight, *session_id);
+			}
+			false
+		});
+	}
+
+	pub fn forget_session(&mut self, session_id: SessionId) {
+		self
+			.swapchains
+			.retain(|(session, _), _| *session != session_id);
+		self.inflight.remove(&session_id);
+	}
+}
+
+fn release_inflight(inflight: &mut HashMap<SessionId, usize>, session_id: SessionId) {
+	if let Some(count) = inflight.get_mut(&session_id) {
+		*count -= 1;
+		if *count == 0 {
+			inflight.remove(&session_id);
+		}
+	}
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	const BUFFERS: usize = 3;
+
+	fn request(buffer: BufferIndex) -> PendingBufferRequest {
+		PendingBufferRequest {
+			client_id: ClientId::rand(),
+			buffer,
+		}
+	}
+
+	#[test]
+	fn link_hands_every_slot_to_the_client() {
+		let (session, monitor) = (SessionId::rand(), MonitorId::rand());
+		let mut table = BufferTable::default();
+		table.link(session, monitor, BUFFERS);
+
+		assert_eq!(
+			table.owners(session, monitor),
+			[
+				(0, BufferOwner::Client),
+				(1, BufferOwner::Client),
+				(2, BufferOwner::Client)
+			]
+		);
+		assert_eq!(table.owner(session, monitor, BufferIndex::Three), None);
+		assert_eq!(
+			table.owner(SessionId::rand(), monitor, BufferIndex::Zero),
+			None
+		);
+	}
+
+	#[test]
+	fn routes_requests_to_their_own_swapchain() {
+		let (first, second) = (SessionId::rand(), SessionId::rand());
+		let (left, right) = (MonitorId::rand(), MonitorId::rand());
+		let mut table = BufferTable::default();
+		for session in [first, second] {
+			for monitor in [left, right] {
+				table.link(session, monitor, BUFFERS);
+			}
+		}
+
+		table.begin_request(first, left, request(BufferIndex::One));
+		assert!(table.has_pending(first, left));
+		assert!(!table.has_pending(first, right));
+		assert!(!table.has_pending(second, left));
+		assert!(table.has_inflight_for_session(first));
+		assert!(!table.has_inflight_for_session(second));
+
+		// Only the buffer in flight completes it.
+		assert!(
+			table
+				.finish_request(first, left, BufferIndex::Zero)
+				.is_none()
+		);
+		assert!(
+			table
+				.finish_request(second, left, BufferIndex::One)
+				.is_none()
+		);
+		let done = table.finish_request(first, left, BufferIndex::One).unwrap();
+		assert_eq!(done.buffer, BufferIndex::One);
+		assert!(!table.has_inflight_for_session(first));
+		assert_eq!(table.inflight_count(), 0);
+	}
+
+	#[test]
+	fn counts_inflight_requests_per_session() {
+		let session = SessionId::rand();
+		let (left, right) = (MonitorId::rand(), MonitorId::rand());
+		let mut table = BufferTable::default();
+		table.begin_request(session, left, request(BufferIndex::Zero));
+		table.begin_request(session, right, request(BufferIndex::Zero));
+		// Replacing a request doesn't count it twice.
+		table.begin_request(session, right, request(BufferIndex::One));
+		assert_eq!(table.inflight_count(), 2);
+
+		// Relinking drops the request in flight.
+		table.link(session, left, BUFFERS);
+		assert_eq!(table.inflight_count(), 1);
+		table.finish_request(session, right, BufferIndex::One);
+		assert_eq!(table.inflight_count(), 0);
+		assert!(!table.has_inflight_for_session(session));
+	}
+
+	#[test]
+	fn forgetting_releases_inflight_requests() {
+		let (first, second) = (SessionId::rand(), SessionId::rand());
+		let (left, right) = (MonitorId::rand(), MonitorId::rand());
+		let mut table = BufferTable::default();
+		for session in [first, second] {
+			table.link(session, left, BUFFERS);
+			table.link(session, right, BUFFERS);
+			table.begin_request(session, left, request(BufferIndex::Zero));
+			table.begin_request(session, right, request(BufferIndex::Zero));
+		}
+
+		table.forget_monitor(left);
+		assert_eq!(table.inflight_count(), 2);
+		assert!(table.owners(first, left).is_empty());
+		assert!(!table.owners(first, right).is_empty());
+
+		table.forget_session(first);
+		assert_eq!(table.inflight_count(), 1);
+		assert!(!table.has_inflight_for_session(first));
+		assert!(table.owners(first, right).is_empty());
+		assert!(table.has_pending(second, right));
+	}
+
+	#[test]
+	fn set_owner_tracks_buffer_hand_offs() {
+		let (session, monitor) = (SessionId::rand(), MonitorId::rand());
+		let mut table = BufferTable::default();
+		table.link(session, monitor, BUFFERS);
+		table.set_owner(session, monitor, BufferIndex::Two, BufferOwner::Shift);
+		assert_eq!(
+			table.owner(session, monitor, BufferIndex::Two),
+			Some(BufferOwner::Shift)
+		);
+		assert_eq!(
+			table.owner(session, monitor, BufferIndex::One),
+			Some(BufferOwner::Client)
+		);
+	}
+}
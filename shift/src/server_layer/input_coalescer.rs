@@ -0,0 +1,607 @@
+//! Frame-aligned coalescing of continuous input.
+//!
+//! Continuous streams (pointer motion, scroll, touch motion, tablet axes, pad rings and strips,
+//! swipe and pinch updates) are folded between client frames into the newest queued event of
+//! the same device and kind, so every delta still reaches the session, just in fewer events.
+//! An event only moves back past queued events it is independent of: the other contacts and
+//! the frame of the last touch frame group, or the other axis of a diagonal scroll. Discrete
+//! events (keys, buttons, touch down/up, gesture begin/end, ...) are never folded and flush the
+//! queue in order.
+
+use tab_protocol::{AxisPhase, InputEventPayload};
+
+use crate::sessions::SessionId;
+
+/// Queue length at which the batch is delivered even if the session is mid-frame.
+const MAX_PENDING_EVENTS: usize = 256;
+
+#[derive(Debug, Default)]
+pub struct InputCoalescer {
+	session_id: Option<SessionId>,
+	events: Vec<InputEventPayload>,
+}
+
+impl InputCoalescer {
+	/// Queues `event` for `session_id`. Returns `true` when the queue must be flushed right
+	/// away instead of at the session's next frame.
+	pub fn push(&mut self, session_id: SessionId, event: InputEventPayload) -> bool {
+		if self.session_id != Some(session_id) {
+			self.events.clear();
+			self.session_id = Some(session_id);
+		}
+		if !is_continuous(&event) {
+			self.events.push(event);
+			return true;
+		}
+		// Folding into an older event moves this one ahead of everything queued in between, so
+		// the search stops at the first event it has to stay behind.
+		let mut frames_passed = 0;
+		for pending in self.events.iter_mut().rev() {
+			if same_stream(pending, &event) {
+				if merge(pending, &event) {
+					return false;
+				}
+				break;
+			}
+			if !may_pass(&event, pending, &mut frames_passed) {
+				break;
+			}
+		}
+		self.events.push(event);
+		self.events.len() >= MAX_PENDING_EVENTS
+	}
+
+	/// Session the queued events belong to, if any are queued.
+	pub fn session_id(&self) -> Option<SessionId> {
+		self.session_id.filter(|_| !self.events.is_empty())
+	}
+
+	/// Takes everything queued since the last flush, oldest first.
+	pub fn take(&mut self) -> Option<(SessionId, Vec<InputEventPayload>)> {
+		if self.events.is_empty() {
+			return None;
+		}
+		Some((self.session_id?, std::mem::take(&mut self.events)))
+	}
+
+	pub fn clear(&mut self) {
+		self.events.clear();
+		self.session_id = None;
+	}
+}
+
+fn is_continuous(event: &InputEventPayload) -> bool {
+	use InputEventPayload as E;
+	matches!(
+		event,
+		E::PointerMotion { .. }
+			| E::PointerMotionAbsolute { .. }
+			| E::PointerAxis { .. }
+			| E::TouchMotion { .. }
+			| E::TouchFrame { .. }
+			| E::TabletToolAxis { .. }
+			| E::TablePadRing { .. }
+			| E::TablePadStrip { .. }
+			| E::GestureSwipeUpdate { .. }
+			| E::GesturePinchUpdate { .. }
+	)
+}
+
+/// Whether both events belong to the same device and kind (and axis, contact, tool, ...).
+fn same_stream(lhs: &InputEventPayload, rhs: &InputEventPayload) -> bool {
+	use InputEventPayload as E;
+	match (lhs, rhs) {
+		(E::PointerMotion { device: a, .. }, E::PointerMotion { device: b, .. })
+		| (E::PointerMotionAbsolute { device: a, .. }, E::PointerMotionAbsolute { device: b, .. })
+		| (E::GestureSwipeUpdate { device: a, .. }, E::GestureSwipeUpdate { device: b, .. })
+		| (E::GesturePinchUpdate { device: a, .. }, E::GesturePinchUpdate { device: b, .. }) => a == b,
+		(
+			E::PointerAxis {
+				device: a,
+				orientation: ao,
+				source: as_,
+				..
+			},
+			E::PointerAxis {
+				device: b,
+				orientation: bo,
+				source: bs,
+				..
+			},
+		) => a == b && ao == bo && as_ == bs,
+		(
+			E::TouchMotion {
+				device: a,
+				contact: ac,
+				..
+			},
+			E::TouchMotion {
+				device: b,
+				contact: bc,
+				..
+			},
+		) => a == b && ac.id == bc.id,
+		(E::TouchFrame { .. }, E::TouchFrame { .. }) => true,
+		(
+			E::TabletToolAxis {
+				device: a,
+				tool: at,
+				..
+			},
+			E::TabletToolAxis {
+				device: b,
+				tool: bt,
+				..
+			},
+		) => a == b && at.serial == bt.serial && at.tool_type == bt.tool_type,
+		(
+			E::TablePadRing {
+				device: a,
+				ring: ar,
+				..
+			},
+			E::TablePadRing {
+				device: b,
+				ring: br,
+				..
+			},
+		) => a == b && ar == br,
+		(
+			E::TablePadStrip {
+				device: a,
+				strip: as_,
+				..
+			},
+			E::TablePadStrip {
+				device: b,
+				strip: bs,
+				..
+			},
+		) => a == b && as_ == bs,
+		_ => false,
+	}
+}
+
+/// Whether `event` may be folded into an event queued before `queued`. Touch motion may pass
+/// other contacts of its device and one touch frame, which folds it into the previous frame
+/// group; scroll may pass the other axis of the same device and source.
+fn may_pass(
+	event: &InputEventPayload,
+	queued: &InputEventPayload,
+	frames_passed: &mut u32,
+) -> bool {
+	use InputEventPayload as E;
+	match (event, queued) {
+		(E::TouchMotion { device: a, .. }, E::TouchMotion { device: b, .. }) => a == b,
+		(E::TouchMotion { .. }, E::TouchFrame { .. }) => {
+			*frames_passed += 1;
+			*frames_passed == 1
+		}
+		(
+			E::PointerAxis {
+				device: a,
+				source: as_,
+				..
+			},
+			E::PointerAxis {
+				device: b,
+				source: bs,
+				..
+			},
+		) => a == b && as_ == bs,
+		_ => false,
+	}
+}
+
+fn add_opt<T: std::ops::Add<Output = T>>(lhs: Option<T>, rhs: Option<T>) -> Option<T> {
+	match (lhs, rhs) {
+		(Some(a), Some(b)) => Some(a + b),
+		(a, b) => a.or(b),
+	}
+}
+
+/// Folds `next` into `pending`, which must be in the same stream. Relative fields are summed,
+/// absolute ones take the newer value. Returns `false` if the pair can't be folded (a scroll
+/// phase boundary), in which case `pending` is left untouched.
+fn merge(pending: &mut InputEventPayload, next: &InputEventPayload) -> bool {
+	use InputEventPayload as E;
+	match (pending, next) {
+		(
+			E::PointerMotion {
+				time_usec,
+				x,
+				y,
+				dx,
+				dy,
+				unaccel_dx,
+				unaccel_dy,
+				..
+			},
+			E::PointerMotion {
+				time_usec: n_time,
+				x: n_x,
+				y: n_y,
+				dx: n_dx,
+				dy: n_dy,
+				unaccel_dx: n_unaccel_dx,
+				unaccel_dy: n_unaccel_dy,
+				..
+			},
+		) => {
+			*time_usec = *n_time;
+			*x = *n_x;
+			*y = *n_y;
+			*dx += n_dx;
+			*dy += n_dy;
+			*unaccel_dx += n_unaccel_dx;
+			*unaccel_dy += n_unaccel_dy;
+		}
+		(pending @ E::PointerMotionAbsolute { .. }, next @ E::PointerMotionAbsolute { .. })
+		| (pending @ E::TouchMotion { .. }, next @ E::TouchMotion { .. })
+		| (pending @ E::TouchFrame { .. }, next @ E::TouchFrame { .. })
+		| (pending @ E::TablePadRing { .. }, next @ E::TablePadRing { .. })
+		| (pending @ E::TablePadStrip { .. }, next @ E::TablePadStrip { .. }) => {
+			*pending = next.clone();
+		}
+		(
+			E::PointerAxis {
+				time_usec,
+				delta,
+				delta_discrete,
+				phase,
+				..
+			},
+			E::PointerAxis {
+				time_usec: n_time,
+				delta: n_delta,
+				delta_discrete: n_discrete,
+				phase: n_phase,
+				..
+			},
+		) => {
+			// Keep `Started`/`Ended` visible to the client: only fold movement into an
+			// event that hasn't finished its scroll sequence.
+			if *n_phase != AxisPhase::Moved || matches!(phase, AxisPhase::Ended | AxisPhase::Cancelled) {
+				return false;
+			}
+			*time_usec = *n_time;
+			*delta += n_delta;
+			*delta_discrete = add_opt(*delta_discrete, *n_discrete);
+		}
+		(
+			E::TabletToolAxis {
+				time_usec, axes, ..
+			},
+			E::TabletToolAxis {
+				time_usec: n_time,
+				axes: n_axes,
+				..
+			},
+		) => {
+			let wheel_delta = add_opt(axes.wheel_delta, n_axes.wheel_delta);
+			*time_usec = *n_time;
+			*axes = n_axes.clone();
+			axes.wheel_delta = wheel_delta;
+		}
+		(
+			E::GestureSwipeUpdate {
+				time_usec,
+				fingers,
+				dx,
+				dy,
+				..
+			},
+			E::GestureSwipeUpdate {
+				time_usec: n_time,
+				fingers: n_fingers,
+				dx: n_dx,
+				dy: n_dy,
+				..
+			},
+		) => {
+			*time_usec = *n_time;
+			*fingers = *n_fingers;
+			*dx += n_dx;
+			*dy += n_dy;
+		}
+		(
+			E::GesturePinchUpdate {
+				time_usec,
+				fingers,
+				dx,
+				dy,
+				scale,
+				rotation,
+				..
+			},
+			E::GesturePinchUpdate {
+				time_usec: n_time,
+				fingers: n_fingers,
+				dx: n_dx,
+				dy: n_dy,
+				scale: n_scale,
+				rotation: n_rotation,
+				..
+			},
+		) => {
+			// libinput reports the pinch scale relative to the gesture start, but the
+			// rotation as a per-event delta.
+			*time_usec = *n_time;
+			*fingers = *n_fingers;
+			*dx += n_dx;
+			*dy += n_dy;
+			*scale = *n_scale;
+			*rotation += n_rotation;
+		}
+		_ => return false,
+	}
+	true
+}
+
+#[cfg(test)]
+mod tests {
+	use tab_protocol::{AxisOrientation, AxisSource, KeyState, TouchContact};
+
+	use super::*;
+
+	fn motion(device: u32, time_usec: u64, dx: f64) -> InputEventPayload {
+		InputEventPayload::PointerMotion {
+			device,
+			time_usec,
+			x: 0.0,
+			y: 0.0,
+			dx,
+			dy: 0.0,
+			unaccel_dx: dx,
+			unaccel_dy: 0.0,
+		}
+	}
+
+	fn scroll(time_usec: u64, delta: f64, phase: AxisPhase) -> InputEventPayload {
+		InputEventPayload::PointerAxis {
+			device: 1,
+			time_usec,
+			orientation: AxisOrientation::Vertical,
+			delta,
+			delta_discrete: None,
+			source: AxisSource::Finger,
+			phase,
+		}
+	}
+
+	fn axis(time_usec: u64, orientation: AxisOrientation, delta: f64) -> InputEventPayload {
+		InputEventPayload::PointerAxis {
+			device: 1,
+			time_usec,
+			orientation,
+			delta,
+			delta_discrete: None,
+			source: AxisSource::Finger,
+			phase: AxisPhase::Moved,
+		}
+	}
+
+	fn contact(id: i32, x: f64) -> TouchContact {
+		TouchContact {
+			id,
+			x,
+			y: 0.0,
+			x_transformed: x,
+			y_transformed: 0.0,
+		}
+	}
+
+	/// Pushes `events` like the server does, delivering the queue whenever `push` asks to.
+	fn deliver(
+		coalescer: &mut InputCoalescer,
+		events: Vec<InputEventPayload>,
+	) -> Vec<InputEventPayload> {
+		let session = SessionId::rand();
+		let mut delivered = Vec::new();
+		for event in events {
+			if coalescer.push(session, event) {
+				delivered.extend(coalescer.take().unwrap().1);
+			}
+		}
+		delivered.extend(
+			coalescer
+				.take()
+				.map(|(_, events)| events)
+				.unwrap_or_default(),
+		);
+		delivered
+	}
+
+	fn key(time_usec: u64) -> InputEventPayload {
+		InputEventPayload::Key {
+			device: 2,
+			time_usec,
+			key: 30,
+			state: KeyState::Pressed,
+		}
+	}
+
+	fn dx(event: &InputEventPayload) -> f64 {
+		match event {
+			InputEventPayload::PointerMotion { dx, .. } => *dx,
+			_ => panic!("not a pointer motion"),
+		}
+	}
+
+	#[test]
+	fn folds_consecutive_motion() {
+		let session = SessionId::rand();
+		let mut coalescer = InputCoalescer::default();
+		assert!(!coalescer.push(session, motion(1, 10, 1.0)));
+		assert!(!coalescer.push(session, motion(1, 20, 2.0)));
+
+		let (_, events) = coalescer.take().unwrap();
+		assert_eq!(events.len(), 1);
+		assert_eq!(dx(&events[0]), 3.0);
+		assert_eq!(events[0].time_usec(), 20);
+	}
+
+	#[test]
+	fn never_folds_across_other_devices() {
+		let session = SessionId::rand();
+		let mut coalescer = InputCoalescer::default();
+		coalescer.push(session, motion(1, 10, 1.0));
+		coalescer.push(session, motion(2, 20, 5.0));
+		coalescer.push(session, motion(1, 30, 2.0));
+
+		let (_, events) = coalescer.take().unwrap();
+		let times: Vec<_> = events.iter().map(|e| e.time_usec()).collect();
+		assert_eq!(times, [10, 20, 30]);
+	}
+
+	#[test]
+	fn discrete_events_flush_and_keep_their_place() {
+		let session = SessionId::rand();
+		let mut coalescer = InputCoalescer::default();
+		coalescer.push(session, motion(1, 10, 1.0));
+		assert!(coalescer.push(session, key(20)));
+		coalescer.push(session, motion(1, 30, 2.0));
+
+		let (_, events) = coalescer.take().unwrap();
+		let times: Vec<_> = events.iter().map(|e| e.time_usec()).collect();
+		assert_eq!(times, [10, 20, 30]);
+		assert_eq!(dx(&events[2]), 2.0);
+	}
+
+	#[test]
+	fn keeps_scroll_phase_boundaries() {
+		let session = SessionId::rand();
+		let mut coalescer = InputCoalescer::default();
+		coalescer.push(session, scroll(10, 1.0, AxisPhase::Started));
+		coalescer.push(session, scroll(20, 1.0, AxisPhase::Moved));
+		coalescer.push(session, scroll(30, 0.0, AxisPhase::Ended));
+		coalescer.push(session, scroll(40, 1.0, AxisPhase::Moved));
+
+		let (_, events) = coalescer.take().unwrap();
+		let times: Vec<_> = events.iter().map(|e| e.time_usec()).collect();
+		assert_eq!(times, [20, 30, 40]);
+	}
+
+	fn touch_down(id: i32, time_usec: u64) -> InputEventPayload {
+		InputEventPayload::TouchDown {
+			device: 3,
+			time_usec,
+			contact: contact(id, 0.0),
+		}
+	}
+
+	fn touch_motion(id: i32, time_usec: u64, x: f64) -> InputEventPayload {
+		InputEventPayload::TouchMotion {
+			device: 3,
+			time_usec,
+			contact: contact(id, x),
+		}
+	}
+
+	fn touch_up(id: i32, time_usec: u64) -> InputEventPayload {
+		InputEventPayload::TouchUp {
+			device: 3,
+			time_usec,
+			contact_id: id,
+		}
+	}
+
+	fn frame(time_usec: u64) -> InputEventPayload {
+		InputEventPayload::TouchFrame { time_usec }
+	}
+
+	#[test]
+	fn folds_two_finger_touch_frame_by_frame() {
+		// What libinput reports for two fingers moving together, then lifting one by one.
+		let mut events = vec![touch_down(0, 0), touch_down(1, 0), frame(0)];
+		for t in 1..=4 {
+			let x = t as f64;
+			events.extend([touch_motion(0, t, x), touch_motion(1, t, -x), frame(t)]);
+		}
+		events.extend([
+			touch_up(0, 5),
+			frame(5),
+			touch_motion(1, 6, -6.0),
+			frame(6),
+			touch_up(1, 7),
+			frame(7),
+		]);
+
+		let delivered = deliver(&mut InputCoalescer::default(), events);
+		assert_eq!(
+			delivered,
+			[
+				touch_down(0, 0),
+				touch_down(1, 0),
+				frame(0),
+				touch_motion(0, 4, 4.0),
+				touch_motion(1, 4, -4.0),
+				frame(4),
+				touch_up(0, 5),
+				frame(5),
+				touch_motion(1, 6, -6.0),
+				frame(6),
+				touch_up(1, 7),
+				frame(7),
+			]
+		);
+	}
+
+	#[test]
+	fn folds_touch_into_the_previous_frame_only() {
+		// Contact 1 only moved in the second frame, so contact 0's next report has nothing
+		// to fold into there and must not jump back over it.
+		let events = vec![
+			touch_motion(0, 1, 1.0),
+			frame(1),
+			touch_motion(1, 2, 2.0),
+			frame(2),
+			touch_motion(0, 3, 3.0),
+			frame(3),
+		];
+
+		let delivered = deliver(&mut InputCoalescer::default(), events.clone());
+		assert_eq!(delivered, events);
+	}
+
+	#[test]
+	fn folds_diagonal_scroll_per_axis() {
+		let mut events = Vec::new();
+		for t in 1..=5 {
+			events.push(axis(t, AxisOrientation::Vertical, 1.0));
+			events.push(axis(t, AxisOrientation::Horizontal, 2.0));
+		}
+
+		let delivered = deliver(&mut InputCoalescer::default(), events);
+		assert_eq!(
+			delivered,
+			[
+				axis(5, AxisOrientation::Vertical, 5.0),
+				axis(5, AxisOrientation::Horizontal, 10.0),
+			]
+		);
+	}
+
+	#[test]
+	fn switching_sessions_drops_the_old_queue() {
+		let (first, second) = (SessionId::rand(), SessionId::rand());
+		let mut coalescer = InputCoalescer::default();
+		coalescer.push(first, motion(1, 10, 1.0));
+		coalescer.push(second, motion(1, 20, 2.0));
+
+		let (session, events) = coalescer.take().unwrap();
+		assert_eq!(session, second);
+		assert_eq!(events.len(), 1);
+		assert_eq!(coalescer.session_id(), None);
+	}
+
+	#[test]
+	fn delivers_a_full_queue() {
+		let session = SessionId::rand();
+		let mut coalescer = InputCoalescer::default();
+		for i in 0..MAX_PENDING_EVENTS as u64 - 1 {
+			assert!(!coalescer.push(session, motion(1 + (i % 2) as u32, i, 1.0)));
+		}
+		assert!(coalescer.push(session, motion(2, 1_000, 1.0)));
+	}
+}
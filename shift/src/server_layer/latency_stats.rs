@@ -0,0 +1,126 @@
+//! The server's half of the latency histograms: input delivery per session and buffer
+//! release per session and monitor. Frame stages come from the renderer and are merged in
+//! when an admin asks for `stats`.
+
+use std::collections::{BTreeMap, HashMap};
+
+use tab_protocol::{
+	InputEventPayload, LatencyHistogram, MonitorLatencyStats, SessionLatencyStats, StatsPayload,
+};
+
+use crate::{
+	client_layer::client::ClientId, comms::render2server::FrameLatency, monitor::MonitorId,
+	sessions::SessionId,
+};
+
+#[derive(Debug, Default)]
+pub(super) struct LatencyStats {
+	input: HashMap<SessionId, LatencyHistogram>,
+	release: HashMap<(SessionId, MonitorId), LatencyHistogram>,
+	/// Admins waiting for the renderer's histograms to answer their `stats_request`.
+	waiting: Vec<ClientId>,
+}
+
+impl LatencyStats {
+	/// Records `events` handed to `session_id` at `now_us`, against their libinput timestamps.
+	pub fn record_input(&mut self, session_id: SessionId, events: &[InputEventPayload], now_us: u64) {
+		let histogram = self.input.entry(session_id).or_default();
+		for event in events {
+			histogram.record_us(now_us.saturating_sub(event.time_usec()));
+		}
+	}
+
+	pub fn record_release(
+		&mut self,
+		session_id: SessionId,
+		monitor_id: MonitorId,
+		released_ns: u64,
+		now_ns: u64,
+	) {
+		self
+			.release
+			.entry((session_id, monitor_id))
+			.or_default()
+			.record_ns(now_ns.saturating_sub(released_ns));
+	}
+
+	/// Queues `client_id` for the next report. Returns whether the renderer has to be asked,
+	/// i.e. no other request is already waiting for it.
+	pub fn request(&mut self, client_id: ClientId) -> bool {
+		if !self.waiting.contains(&client_id) {
+			self.waiting.push(client_id);
+		}
+		self.waiting.len() == 1
+	}
+
+	/// Combines the renderer's `frames` with the server's histograms into the reply for every
+	/// waiting admin.
+	pub fn complete(&mut self, frames: Vec<FrameLatency>) -> (Vec<ClientId>, StatsPayload) {
+		let mut sessions: BTreeMap<String, SessionLatencyStats> = BTreeMap::new();
+		let mut monitors: BTreeMap<(String, String), MonitorLatencyStats> = BTreeMap::new();
+		for frame in frames {
+			let stats = monitor_stats(&mut monitors, frame.session_id, frame.monitor_id);
+			stats.acquire = frame.acquire;
+			stats.composite = frame.composite;
+			stats.present = frame.present;
+		}
+		for ((session_id, monitor_id), histogram) in &self.release {
+			monitor_stats(&mut monitors, *session_id, *monitor_id).release = *histogram;
+		}
+		for (session_id, histogram) in &self.input {
+			session_stats(&mut sessions, session_id.to_string()).input = *histogram;
+		}
+		for ((session_id, _), stats) in monitors {
+			session_stats(&mut sessions, session_id)
+				.monitors
+				.push(stats);
+		}
+		let payload = StatsPayload {
+			sessions: sessions.into_values().collect(),
+		};
+		(std::mem::take(&mut self.waiting), payload)
+	}
+
+	pub fn forget_client(&mut self, client_id: ClientId) {
+		self.waiting.retain(|waiting| *waiting != client_id);
+	}
+
+	pub fn forget_monitor(&mut self, monitor_id: MonitorId) {
+		self
+			.release
+			.retain(|(_, monitor), _| *monitor != monitor_id);
+	}
+
+	pub fn forget_session(&mut self, session_id: SessionId) {
+		self.input.remove(&session_id);
+		self
+			.release
+			.retain(|(session, _), _| *session != session_id);
+	}
+}
+
+fn session_stats(
+	sessions: &mut BTreeMap<String, SessionLatencyStats>,
+	session_id: String,
+) -> &mut SessionLatencyStats {
+	sessions
+		.entry(session_id.clone())
+		.or_insert_with(|| SessionLatencyStats {
+			session_id,
+			..Default::default()
+		})
+}
+
+fn monitor_stats(
+	monitors: &mut BTreeMap<(String, String), MonitorLatencyStats>,
+	session_id: SessionId,
+	monitor_id: MonitorId,
+) -> &mut MonitorLatencyStats {
+	let monitor_id = monitor_id.to_string();
+	monitors
+		.entry((session_id.to_string(), monitor_id.clone()))
+		.or_insert_with(|| MonitorLatencyStats {
+			monitor_id,
+			..Default::default()
+		})
+}
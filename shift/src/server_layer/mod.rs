@@ -1,3 +1,6 @@
+mod buffer_table;
+mod input_coalescer;
+mod latency_stats;
 mod server;
 
 pub use server::BindError;
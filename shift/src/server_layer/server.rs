@@ -7,10 +7,11 @@ use std::{
 	path::{Path, PathBuf},
 	process::Command,
 	sync::Arc,
+	task::{Poll, ready},
 	time::Duration,
 };
 
-use futures::future::select_all;
+use futures::stream::{BoxStream, SelectAll, StreamExt};
 use tab_protocol::TabMessageFrame;
 use thiserror::Error;
 use tokio::{
@@ -30,47 +31,97 @@ use crate::{
 		client_view::{self, ClientView},
 	},
 	comms::{
-		client2server::C2SMsg,
-		input2server::{InputEvt, InputEvtRx},
-		render2server::{RenderEvt, RenderEvtRx},
-		server2client::BufferRelease,
+		client2server::{C2SMsg, C2SRx},
+		input2server::{InputBatch, InputEvt, InputEvtRx},
+		render2server::{FrameLatency, GpuMemoryReport, RenderEvt, RenderEvtRx},
+		server2client::{BufferRelease, InputRingHandoff},
 		server2render::{RenderCmd, RenderCmdTx, SessionTransition},
 	},
 	monitor::{Monitor, MonitorId},
-	rendering_layer::channels::ServerEnd as RenderServerChannels,
+	rendering_layer::{channels::ServerEnd as RenderServerChannels, monotonic_ns},
+	server_layer::{
+		buffer_table::{BufferOwner, BufferTable, PendingBufferRequest},
+		input_coalescer::InputCoalescer,
+		latency_stats::LatencyStats,
+	},
 	sessions::{PendingSession, Role, Session, SessionId},
 };
-use tab_protocol::{InputEventPayload, SessionInfo, SessionLifecycle, SessionRole};
+use tab_protocol::input_ring::{INPUT_RING_DEFAULT_CAPACITY, InputRing};
+use tab_protocol::{InputEventPayload, RenderNodeInfo, SessionInfo, SessionLifecycle, SessionRole};
 
-#[derive(Debug, Clone, Copy)]
-struct PendingFlip {
-	session_id: SessionId,
-	monitor_id: MonitorId,
-	buffer: tab_protocol::BufferIndex,
+/// How long input took from the kernel to the input thread, and from there to the server,
+/// over one stats interval.
+#[derive(Debug, Default)]
+struct InputDelayStats {
+	events: u64,
+	batches: u64,
+	read_delay_total_us: u64,
+	read_delay_max_us: u64,
+	queue_delay_total_us: u64,
+	queue_delay_max_us: u64,
 }
 
-#[derive(Debug, Clone, Copy)]
-struct PendingBufferRequest {
-	client_id: ClientId,
-	session_id: SessionId,
-	monitor_id: MonitorId,
-	buffer: tab_protocol::BufferIndex,
-}
+impl InputDelayStats {
+	fn record(&mut self, batch: &InputBatch) {
+		let handled_ns = monotonic_ns();
+		let queue_delay_us = handled_ns.saturating_sub(batch.received_ns) / 1_000;
+		self.batches += 1;
+		self.queue_delay_total_us += queue_delay_us;
+		self.queue_delay_max_us = self.queue_delay_max_us.max(queue_delay_us);
+		let received_us = batch.received_ns / 1_000;
+		for event in &batch.events {
+			let read_delay_us = received_us.saturating_sub(event.time_usec());
+			self.events += 1;
+			self.read_delay_total_us += read_delay_us;
+			self.read_delay_max_us = self.read_delay_max_us.max(read_delay_us);
+		}
+	}
 
-#[derive(Debug, Clone, Copy, PartialEq, Eq)]
-enum BufferOwner {
-	Client,
-	Shift,
+	fn log_and_reset(&mut self) {
+		if self.events > 0 {
+			tracing::trace!(
+				events = self.events,
+				batches = self.batches,
+				read_delay_avg_us = self.read_delay_total_us / self.events,
+				read_delay_max_us = self.read_delay_max_us,
+				queue_delay_avg_us = self.queue_delay_total_us / self.batches,
+				queue_delay_max_us = self.queue_delay_max_us,
+				"input delay per second"
+			);
+		}
+		*self = Self::default();
+	}
 }
+
 struct ConnectedClient {
 	client_view: ClientView,
 	join_handle: TokioJoinHandle<()>,
+	/// Producer end of the session's input ring, if the client asked for one.
+	input_ring: Option<InputRing>,
+	/// Input events sent over the socket; the ring is resumed once the client read them all.
+	socket_input_events: u64,
 }
 impl Drop for ConnectedClient {
 	fn drop(&mut self) {
 		self.join_handle.abort();
 	}
 }
+
+/// One client's messages; yields `None` once after its task dropped the sender, then ends.
+type ClientMessages = BoxStream<'static, (ClientId, Option<C2SMsg>)>;
+
+fn client_messages(client_id: ClientId, mut messages: C2SRx) -> ClientMessages {
+	let mut closed = false;
+	futures::stream::poll_fn(move |cx| {
+		if closed {
+			return Poll::Ready(None);
+		}
+		let message = ready!(messages.poll_recv(cx));
+		closed = message.is_none();
+		Poll::Ready(Some((client_id, message)))
+	})
+	.boxed()
+}
 pub struct ShiftServer {
 	listener: Option<UnixListener>,
 	current_session: Option<SessionId>,
@@ -79,15 +130,21 @@ pub struct ShiftServer {
 	loading_sessions: HashSet<SessionId>,
 	awake_sessions: HashSet<SessionId>,
 	awake_until: HashMap<SessionId, Instant>,
+	/// Latest renderer GPU memory report, sent to admins as they connect.
+	gpu_memory: Option<Arc<GpuMemoryReport>>,
 	connected_clients: HashMap<ClientId, ConnectedClient>,
+	/// Messages from every connected client, polled as one stream so that routing a message
+	/// costs the same however many clients are connected.
+	client_messages: SelectAll<ClientMessages>,
+	/// Client authenticated as each session, kept in step with `connected_clients`.
+	session_clients: HashMap<SessionId, ClientId>,
 	render_commands: RenderCmdTx,
 	render_events: RenderEvtRx,
 	input_events: InputEvtRx,
 	monitors: HashMap<MonitorId, Monitor>,
-	pending_buffer_requests: Vec<PendingBufferRequest>,
-	waiting_flip: Vec<PendingFlip>,
-	front_buffers: HashMap<(SessionId, MonitorId), tab_protocol::BufferIndex>,
-	buffer_ownership: HashMap<(SessionId, MonitorId, tab_protocol::BufferIndex), BufferOwner>,
+	/// Render node the renderer composites on, advertised in `auth_ok`.
+	render_node: Option<RenderNodeInfo>,
+	buffers: BufferTable,
 	swap_buffers_received: u64,
 	frame_done_emitted: u64,
 	debug_second_session_cmd: Option<String>,
@@ -95,7 +152,11 @@ pub struct ShiftServer {
 	debug_admin_session_id: Option<SessionId>,
 	debug_second_session_id: Option<SessionId>,
 	debug_auto_switch_interval: Option<Duration>,
-	pending_input_motion: Option<(SessionId, InputEventPayload)>,
+	/// `SHIFT_CAPTURE_DIR`: every client's incoming frames are recorded to a file here.
+	capture_dir: Option<PathBuf>,
+	input_coalescer: InputCoalescer,
+	input_delay: InputDelayStats,
+	latency: LatencyStats,
 }
 #[derive(Error, Debug)]
 pub enum BindError {
@@ -130,6 +191,14 @@ impl ShiftServer {
 					None
 				}
 			});
+		let capture_dir = std::env::var_os("SHIFT_CAPTURE_DIR")
+			.filter(|dir| !dir.is_empty())
+			.map(PathBuf::from);
+		if let Some(dir) = &capture_dir
+			&& let Err(e) = std::fs::create_dir_all(dir)
+		{
+			tracing::warn!("failed to create SHIFT_CAPTURE_DIR {dir:?}: {e}");
+		}
 		Ok(Self {
 			listener: Some(listener),
 			current_session: Default::default(),
@@ -138,15 +207,16 @@ impl ShiftServer {
 			loading_sessions: Default::default(),
 			awake_sessions: Default::default(),
 			awake_until: Default::default(),
+			gpu_memory: None,
 			connected_clients: Default::default(),
+			client_messages: SelectAll::new(),
+			session_clients: Default::default(),
 			render_commands,
 			render_events,
 			input_events,
 			monitors: Default::default(),
-			pending_buffer_requests: Default::default(),
-			waiting_flip: Default::default(),
-			front_buffers: Default::default(),
-			buffer_ownership: Default::default(),
+			render_node: None,
+			buffers: Default::default(),
 			swap_buffers_received: 0,
 			frame_done_emitted: 0,
 			debug_second_session_cmd,
@@ -154,7 +224,10 @@ impl ShiftServer {
 			debug_admin_session_id: None,
 			debug_second_session_id: None,
 			debug_auto_switch_interval,
-			pending_input_motion: None,
+			capture_dir,
+			input_coalescer: Default::default(),
+			input_delay: Default::default(),
+			latency: Default::default(),
 		})
 	}
 
@@ -235,26 +308,34 @@ impl ShiftServer {
 	}
 
 	async fn notify_session_awake_change(&mut self, session_id: SessionId, awake: bool) {
-		let target_clients = self
-			.connected_clients
-			.iter()
-			.filter_map(|(id, client)| {
-				(client.client_view.authenticated_session() == Some(session_id)).then_some(*id)
-			})
-			.collect::<Vec<_>>();
-		for id in target_clients {
-			let Some(client) = self.connected_clients.get_mut(&id) else {
-				continue;
-			};
-			let notified = if awake {
-				client.client_view.notify_session_awake(session_id).await
-			} else {
-				client.client_view.notify_session_sleep(session_id).await
-			};
-			if !notified {
-				tracing::warn!(%id, %session_id, awake, "failed to notify session awake state");
-			}
+		if let Err(e) = self
+			.render_commands
+			.send(RenderCmd::SessionAwake { session_id, awake })
+			.await
+		{
+			tracing::error!("failed to forward SessionAwake to renderer: {e}");
 		}
+		let Some((id, client)) = self.client_for_session(session_id) else {
+			return;
+		};
+		let notified = if awake {
+			client.client_view.notify_session_awake(session_id).await
+		} else {
+			client.client_view.notify_session_sleep(session_id).await
+		};
+		if !notified {
+			tracing::warn!(%id, %session_id, awake, "failed to notify session awake state");
+		}
+	}
+
+	/// The client authenticated as `session_id`.
+	fn client_for_session(
+		&mut self,
+		session_id: SessionId,
+	) -> Option<(ClientId, &mut ConnectedClient)> {
+		let client_id = *self.session_clients.get(&session_id)?;
+		let client = self.connected_clients.get_mut(&client_id)?;
+		Some((client_id, client))
 	}
 
 	async fn prune_expired_awake_sessions(&mut self) {
@@ -365,12 +446,47 @@ impl ShiftServer {
 		}
 	}
 
+	/// Answers the admins waiting on `stats_request` with the renderer's `frames` merged into
+	/// the server's own histograms.
+	async fn reply_stats(&mut self, frames: Vec<FrameLatency>) {
+		let (clients, stats) = self.latency.complete(frames);
+		let stats = Arc::new(stats);
+		for client_id in clients {
+			if let Some(client) = self.connected_clients.get_mut(&client_id)
+				&& !client.client_view.notify_stats(Arc::clone(&stats)).await
+			{
+				tracing::warn!(%client_id, "failed to send stats");
+			}
+		}
+	}
+
+	async fn notify_admins_gpu_memory(&mut self, report: Arc<GpuMemoryReport>) {
+		let admin_client_ids = self
+			.connected_clients
+			.iter()
+			.filter_map(|(id, client)| {
+				let session_id = client.client_view.authenticated_session()?;
+				let session = self.active_sessions.get(&session_id)?;
+				(session.role() == Role::Admin).then_some(*id)
+			})
+			.collect::<Vec<_>>();
+		for id in admin_client_ids {
+			let Some(client) = self.connected_clients.get_mut(&id) else {
+				continue;
+			};
+			if !client
+				.client_view
+				.notify_gpu_memory(Arc::clone(&report))
+				.await
+			{
+				tracing::warn!(%id, "failed to notify gpu memory");
+			}
+		}
+	}
+
 	#[tracing::instrument(level= "info", skip(self), fields(connected_clients=self.connected_clients.len(), active_sessions=self.active_sessions.len(), pending_sessions = self.pending_sessions.len(), current_session = ?self.current_session))]
 	pub fn add_initial_session(&mut self) -> Token {
-		let (token, session) = PendingSession::admin(Some("Admin".into()));
-		let id = session.id();
-		self.pending_sessions.insert(token.clone(), session);
-
+		let token = self.add_admin_session();
 		let mut admin_command = std::env::var("ADMIN_LAUNCH_CMD")
 			.ok()
 			.map(|admin_launch_cmd| {
@@ -392,12 +508,26 @@ impl ShiftServer {
 				panic!("Failed to start admin session process: {e}");
 			}
 		}
+		token
+	}
+
+	/// Registers the admin session Shift starts with, without launching a process for it.
+	pub fn add_admin_session(&mut self) -> Token {
+		let (token, session) = PendingSession::admin(Some("Admin".into()));
+		let id = session.id();
+		self.pending_sessions.insert(token.clone(), session);
 		tracing::info!(?token, %id, "added initial admin session");
 		token
 	}
+
 	pub async fn start(mut self) {
 		self.add_initial_session();
+		self.run().await;
+	}
 
+	/// Serves clients until the renderer goes away. Unlike [`Self::start`], the initial admin
+	/// session is left to the caller.
+	pub async fn run(mut self) {
 		let listener = self.listener.take().unwrap();
 		let mut stats_tick = tokio::time::interval(std::time::Duration::from_secs(1));
 		let mut debug_auto_switch_tick = self.debug_auto_switch_interval.map(tokio::time::interval);
@@ -409,11 +539,15 @@ impl ShiftServer {
 				active_sessions = self.active_sessions.len(),
 				pending_sessions = self.pending_sessions.len(),
 				current_session = ?self.current_session,
-				waiting_flip = self.waiting_flip.len(),
+				inflight_buffer_requests = self.buffers.inflight_count(),
 			);
 			let _span = span.enter();
 			tokio::select! {
-					client_message = Self::read_clients_messages(&mut self.connected_clients) => self.handle_client_message(client_message.0, client_message.1).await,
+					Some((client_id, message)) = self.client_messages.next(), if !self.client_messages.is_empty() => match message {
+						Some(message) => self.handle_client_message(client_id, message).await,
+						// The client's task ended without a `Shutdown`.
+						None => self.disconnect_client(client_id).await,
+					},
 					accept_result = listener.accept() => self.handle_accept(accept_result).await,
 						_ = stats_tick.tick() => {
 								self.prune_expired_awake_sessions().await;
@@ -426,6 +560,7 @@ impl ShiftServer {
 							}
 							self.swap_buffers_received = 0;
 							self.frame_done_emitted = 0;
+							self.input_delay.log_and_reset();
 					}
 					render_event = self.render_events.recv() => {
 							if let Some(event) = render_event {
@@ -443,7 +578,7 @@ impl ShiftServer {
 						}
 					}
 					_ = input_flush_tick.tick() => {
-						self.flush_pending_input_motion().await;
+						self.flush_input_batch(false).await;
 					}
 					_ = async {
 						if let Some(tick) = &mut debug_auto_switch_tick {
@@ -464,7 +599,7 @@ impl ShiftServer {
 			C2SMsg::Shutdown => {
 				self.disconnect_client(client_id).await;
 			}
-			C2SMsg::Auth(token) => {
+			C2SMsg::Auth { token, input_ring } => {
 				let Some(pending_session) = self.pending_sessions.remove(&token) else {
 					if let Some(client) = self.connected_clients.get_mut(&client_id) {
 						client
@@ -480,9 +615,14 @@ impl ShiftServer {
 						tracing::warn!("tried handling message from a non-existing client");
 						return;
 					};
+					let handoff = if input_ring {
+						Self::create_input_ring(connected_client)
+					} else {
+						None
+					};
 					connected_client
 						.client_view
-						.notify_auth_success(&session)
+						.notify_auth_success(&session, handoff)
 						.await
 				};
 				if !notify_succeeded {
@@ -493,6 +633,7 @@ impl ShiftServer {
 				self
 					.active_sessions
 					.insert(session.id(), Arc::clone(&session));
+				self.session_clients.insert(session.id(), client_id);
 				if session.role() == Role::Normal && !session.ready() {
 					self.loading_sessions.insert(session.id());
 					self
@@ -531,6 +672,12 @@ impl ShiftServer {
 						for info in session_infos {
 							client.client_view.notify_session_state(info).await;
 						}
+						if let Some(report) = &self.gpu_memory {
+							client
+								.client_view
+								.notify_gpu_memory(Arc::clone(report))
+								.await;
+						}
 					}
 				}
 				if session.role() == Role::Normal {
@@ -753,7 +900,9 @@ impl ShiftServer {
 				monitor_id,
 				buffer,
 				acquire_fence,
+				damage,
 			} => {
+				let requested_ns = monotonic_ns();
 				let Some(connected_client) = self.connected_clients.get(&client_id) else {
 					tracing::warn!("tried handling message from a non-existing client");
 					return;
@@ -776,64 +925,38 @@ impl ShiftServer {
 					if let Some(client) = self.connected_clients.get_mut(&client_id) {
 						client
 							.client_view
-							.notify_error(
-								"session_sleeping".into(),
-								Some("session is not awake".into()),
-								false,
-							)
+							.notify_buffer_request_rejected(monitor_id, buffer, "session_sleeping".into())
 							.await;
 					}
 					return;
 				}
-				let owner_key = (client_session.id(), monitor_id, buffer);
 				let current_owner = self
-					.buffer_ownership
-					.get(&owner_key)
-					.copied()
+					.buffers
+					.owner(client_session.id(), monitor_id, buffer)
 					.unwrap_or(BufferOwner::Client);
 				if current_owner != BufferOwner::Client {
-					let other_buffer = if buffer == tab_protocol::BufferIndex::Zero {
-						tab_protocol::BufferIndex::One
-					} else {
-						tab_protocol::BufferIndex::Zero
-					};
-					let other_owner = self
-						.buffer_ownership
-						.get(&(client_session.id(), monitor_id, other_buffer))
-						.copied()
-						.unwrap_or(BufferOwner::Client);
+					let linked_owners = self.buffers.owners(client_session.id(), monitor_id);
 					tracing::warn!(
 						session_id = %client_session.id(),
 						%monitor_id,
 						requested = buffer as u8,
 						requested_owner = ?current_owner,
-						other = other_buffer as u8,
-						other_owner = ?other_owner,
+						linked_owners = ?linked_owners,
 						"incoming buffer request for non client-owned buffer"
 					);
 					if let Some(client) = self.connected_clients.get_mut(&client_id) {
 						client
 							.client_view
-							.notify_error(
-								"ownership_violation".into(),
-								Some("requested buffer is not client-owned".into()),
-								false,
-							)
+							.notify_buffer_request_rejected(monitor_id, buffer, "ownership_violation".into())
 							.await;
 					}
 					return;
 				}
-				if self.pending_buffer_requests.iter().any(|pending| {
-					pending.session_id == client_session.id() && pending.monitor_id == monitor_id
-				}) {
+				if self.buffers.has_pending(client_session.id(), monitor_id) {
 					if let Some(client) = self.connected_clients.get_mut(&client_id) {
 						client
 							.client_view
-							.notify_error(
-								"buffer_request_inflight".into(),
-								Some("monitor already has an in-flight buffer request".into()),
-								false,
-							)
+							.notify_buffer_request_rejected(monitor_id, buffer, "buffer_request_inflight".into())
 							.await;
 					}
 					return;
@@ -845,6 +968,8 @@ impl ShiftServer {
 						buffer,
 						session_id: client_session.id(),
 						acquire_fence,
+						requested_ns,
+						damage,
 					})
 					.await
 				{
@@ -855,16 +980,58 @@ impl ShiftServer {
 						client.client_view.notify_error(code, detail, true).await;
 					}
 				} else {
-					self.pending_buffer_requests.push(PendingBufferRequest {
-						client_id,
-						session_id: client_session.id(),
+					self.buffers.begin_request(
+						client_session.id(),
 						monitor_id,
-						buffer,
-					});
+						PendingBufferRequest { client_id, buffer },
+					);
+				}
+			}
+			C2SMsg::InputCaughtUp { socket_events } => {
+				let Some(client) = self.connected_clients.get_mut(&client_id) else {
+					return;
+				};
+				// Anything sent since the client counted is still unread.
+				if socket_events == client.socket_input_events
+					&& let Some(ring) = client.input_ring.as_mut()
+					&& ring.is_overflowed()
+				{
+					tracing::debug!(%client_id, "client caught up, input goes through the ring again");
+					ring.resume();
+				}
+			}
+			C2SMsg::StatsRequest => {
+				if !self.latency.request(client_id) {
+					return;
+				}
+				if let Err(e) = self.render_commands.send(RenderCmd::CollectLatency).await {
+					tracing::error!("failed to ask renderer for frame latency: {e}");
+					self.reply_stats(Vec::new()).await;
+				}
+			}
+			C2SMsg::SetPresentMode(mode) => {
+				let Some(client) = self.connected_clients.get_mut(&client_id) else {
+					tracing::warn!("tried handling message from a non-existing client");
+					return;
+				};
+				let Some(session_id) = client.client_view.authenticated_session() else {
+					client
+						.client_view
+						.notify_error("forbidden".into(), None, false)
+						.await;
+					return;
+				};
+				if let Err(e) = self
+					.render_commands
+					.send(RenderCmd::SetPresentMode { session_id, mode })
+					.await
+				{
+					tracing::error!("failed to forward SetPresentMode to renderer: {e}");
 				}
 			}
 			C2SMsg::FramebufferLink { payload, dma_bufs } => {
 				let monitor_id_raw = payload.monitor_id.clone();
+				let buffer_count = dma_bufs.len();
 				let session_id = {
 					let Some(client) = self.connected_clients.get_mut(&client_id) else {
 						tracing::warn!("tried handling message from a non-existing client");
@@ -898,29 +1065,19 @@ impl ShiftServer {
 					let Ok(monitor_id) = monitor_id_raw.parse::<MonitorId>() else {
 						return;
 					};
-					self.waiting_flip.retain(|pending| {
-						!(pending.session_id == session_id && pending.monitor_id == monitor_id)
-					});
-					self.pending_buffer_requests.retain(|pending| {
-						!(pending.session_id == session_id && pending.monitor_id == monitor_id)
-					});
-					self.front_buffers.remove(&(session_id, monitor_id));
-					self.buffer_ownership.insert(
-						(session_id, monitor_id, tab_protocol::BufferIndex::Zero),
-						BufferOwner::Client,
-					);
-					self.buffer_ownership.insert(
-						(session_id, monitor_id, tab_protocol::BufferIndex::One),
-						BufferOwner::Client,
-					);
+					self.buffers.link(session_id, monitor_id, buffer_count);
 				}
 			}
 		}
 	}
 	async fn handle_render_event(&mut self, event: RenderEvt) {
 		match event {
-			RenderEvt::Started { monitors } => {
+			RenderEvt::Started {
+				monitors,
+				render_node,
+			} => {
 				self.monitors = monitors.into_iter().map(|m| (m.id, m)).collect();
+				self.render_node = render_node;
 			}
 			RenderEvt::MonitorOnline { monitor } => {
 				tracing::info!(?monitor, "renderer reports monitor online");
@@ -932,34 +1089,21 @@ impl ShiftServer {
 				if let Some(monitor) = self.monitors.remove(&monitor_id) {
 					self.broadcast_monitor_removed(&monitor).await;
 				}
-				self
-					.waiting_flip
-					.retain(|pending| pending.monitor_id != monitor_id);
-				self
-					.pending_buffer_requests
-					.retain(|pending| pending.monitor_id != monitor_id);
-				self.front_buffers.retain(|(_, mon), _| *mon != monitor_id);
-				self
-					.buffer_ownership
-					.retain(|(_, mon, _), _| *mon != monitor_id);
+				self.buffers.forget_monitor(monitor_id);
+				self.latency.forget_monitor(monitor_id);
 			}
 			RenderEvt::BufferRequestAck {
 				session_id,
 				monitor_id,
 				buffer,
 			} => {
-				let Some(pos) = self.pending_buffer_requests.iter().position(|pending| {
-					pending.session_id == session_id
-						&& pending.monitor_id == monitor_id
-						&& pending.buffer == buffer
-				}) else {
+				let Some(pending) = self.buffers.finish_request(session_id, monitor_id, buffer) else {
 					tracing::warn!(%session_id, %monitor_id, buffer = buffer as u8, "renderer acked unknown pending request");
 					return;
 				};
-				let pending = self.pending_buffer_requests.remove(pos);
 				self
-					.buffer_ownership
-					.insert((session_id, monitor_id, buffer), BufferOwner::Shift);
+					.buffers
+					.set_owner(session_id, monitor_id, buffer, BufferOwner::Shift);
 				self.swap_buffers_received = self.swap_buffers_received.saturating_add(1);
 
 				let mut should_disconnect = false;
@@ -975,6 +1119,7 @@ impl ShiftServer {
 				if should_disconnect {
 					self.disconnect_client(pending.client_id).await;
 				}
+				self.flush_input_batch(false).await;
 			}
 			RenderEvt::BufferRequestRejected {
 				session_id,
@@ -982,19 +1127,14 @@ impl ShiftServer {
 				buffer,
 				reason,
 			} => {
-				let Some(pos) = self.pending_buffer_requests.iter().position(|pending| {
-					pending.session_id == session_id
-						&& pending.monitor_id == monitor_id
-						&& pending.buffer == buffer
-				}) else {
+				let Some(pending) = self.buffers.finish_request(session_id, monitor_id, buffer) else {
 					tracing::warn!(%session_id, %monitor_id, buffer = buffer as u8, %reason, "renderer rejected unknown pending request");
 					return;
 				};
-				let pending = self.pending_buffer_requests.remove(pos);
 				if let Some(client) = self.connected_clients.get_mut(&pending.client_id) {
 					client
 						.client_view
-						.notify_error("buffer_request_rejected".into(), Some(reason), false)
+						.notify_buffer_request_rejected(monitor_id, buffer, reason)
 						.await;
 				}
 			}
@@ -1003,15 +1143,12 @@ impl ShiftServer {
 				monitor_id,
 				buffer,
 				release_fence,
+				released_ns,
 			} => {
 				self
-					.buffer_ownership
-					.insert((session_id, monitor_id, buffer), BufferOwner::Client);
-				let Some((_id, client)) = self
-					.connected_clients
-					.iter_mut()
-					.find(|(_, c)| c.client_view.authenticated_session() == Some(session_id))
-				else {
+					.buffers
+					.set_owner(session_id, monitor_id, buffer, BufferOwner::Client);
+				let Some((_id, client)) = self.client_for_session(session_id) else {
 					return;
 				};
 				if !client
@@ -1026,6 +1163,9 @@ impl ShiftServer {
 					tracing::warn!(%session_id, %monitor_id, buffer = buffer as u8, "failed to send early buffer_release");
 				} else {
 					self.frame_done_emitted = self.frame_done_emitted.saturating_add(1);
+					self
+						.latency
+						.record_release(session_id, monitor_id, released_ns, monotonic_ns());
 				}
 			}
 			RenderEvt::FatalError { reason } => {
@@ -1034,37 +1174,48 @@ impl ShiftServer {
 			}
 			RenderEvt::PageFlip { monitors } => {
 				let _ = monitors;
+				self.flush_input_batch(false).await;
+			}
+			RenderEvt::GpuMemory(report) => {
+				tracing::debug!(
+					total_bytes = report.total_bytes,
+					budget_bytes = ?report.budget_bytes,
+					"renderer gpu memory"
+				);
+				let report = Arc::new(report);
+				self.gpu_memory = Some(Arc::clone(&report));
+				self.notify_admins_gpu_memory(report).await;
+			}
+			RenderEvt::FrameLatency(frames) => {
+				self.reply_stats(frames).await;
+			}
+			RenderEvt::FramePresented { frames } => {
+				for frame in frames {
+					for session_id in &frame.sessions {
+						let Some((_id, client)) = self.client_for_session(*session_id) else {
+							continue;
+						};
+						client
+							.client_view
+							.notify_frame_presented(frame.clone())
+							.await;
+					}
+				}
 			}
 		}
 	}
 
 	async fn handle_input_event(&mut self, event: InputEvt) {
 		match event {
-			InputEvt::Event(input_event) => {
+			InputEvt::Batch(batch) => {
+				self.input_delay.record(&batch);
 				let Some(active_session_id) = self.current_session else {
 					return;
 				};
-				if Self::is_coalescable_motion(&input_event) {
-					match self.pending_input_motion.as_ref() {
-						Some((pending_session, pending_event))
-							if *pending_session == active_session_id
-								&& Self::same_motion_kind(pending_event, &input_event) =>
-						{
-							self.pending_input_motion = Some((active_session_id, input_event));
-						}
-						Some(_) => {
-							self.flush_pending_input_motion().await;
-							self.pending_input_motion = Some((active_session_id, input_event));
-						}
-						None => {
-							self.pending_input_motion = Some((active_session_id, input_event));
-						}
+				for input_event in batch.events {
+					if self.input_coalescer.push(active_session_id, input_event) {
+						self.flush_input_batch(true).await;
 					}
-				} else {
-					self.flush_pending_input_motion().await;
-					self
-						.forward_input_event_to_session(active_session_id, input_event)
-						.await;
 				}
 			}
 			InputEvt::FatalError { reason } => {
@@ -1073,82 +1224,102 @@ impl ShiftServer {
 		}
 	}
 
-	fn is_coalescable_motion(event: &InputEventPayload) -> bool {
-		matches!(
-			event,
-			InputEventPayload::PointerMotion { .. } | InputEventPayload::PointerMotionAbsolute { .. }
-		)
-	}
-
-	fn same_motion_kind(lhs: &InputEventPayload, rhs: &InputEventPayload) -> bool {
-		matches!(
-			(lhs, rhs),
-			(
-				InputEventPayload::PointerMotion { .. },
-				InputEventPayload::PointerMotion { .. }
-			) | (
-				InputEventPayload::PointerMotionAbsolute { .. },
-				InputEventPayload::PointerMotionAbsolute { .. }
-			)
-		)
-	}
-
-	async fn flush_pending_input_motion(&mut self) {
-		let Some((session_id, event)) = self.pending_input_motion.take() else {
+	/// Delivers the coalesced input batch. Unless `force` is set this waits until the session
+	/// has no buffer request in flight, so it sees at most one batch per frame.
+	async fn flush_input_batch(&mut self, force: bool) {
+		let Some(session_id) = self.input_coalescer.session_id() else {
 			return;
 		};
 		if self.current_session != Some(session_id) {
+			self.input_coalescer.clear();
 			return;
 		}
-		if self.has_inflight_buffer_request_for_session(session_id) {
-			self.pending_input_motion = Some((session_id, event));
+		if !force && self.has_inflight_buffer_request_for_session(session_id) {
 			return;
 		}
-		self.forward_input_event_to_session(session_id, event).await;
+		let Some((session_id, events)) = self.input_coalescer.take() else {
+			return;
+		};
+		self
+			.forward_input_batch_to_session(session_id, events)
+			.await;
 	}
 
 	fn has_inflight_buffer_request_for_session(&self, session_id: SessionId) -> bool {
-		self
-			.pending_buffer_requests
-			.iter()
-			.any(|pending| pending.session_id == session_id)
+		self.buffers.has_inflight_for_session(session_id)
 	}
 
-	async fn forward_input_event_to_session(
+	/// Creates the input ring for `client`, keeping the producer end and returning the FDs
+	/// for `auth_ok`. Falls back to socket delivery if the ring can't be set up.
+	fn create_input_ring(client: &mut ConnectedClient) -> Option<InputRingHandoff> {
+		let ring = match InputRing::create(INPUT_RING_DEFAULT_CAPACITY) {
+			Ok(ring) => ring,
+			Err(e) => {
+				tracing::warn!("failed to create input ring, using the socket: {e}");
+				return None;
+			}
+		};
+		let fds = ring
+			.memfd()
+			.try_clone_to_owned()
+			.and_then(|memfd| Ok((memfd, ring.wakeup_fd().try_clone_to_owned()?)));
+		let (memfd, wakeup) = match fds {
+			Ok(fds) => fds,
+			Err(e) => {
+				tracing::warn!("failed to share input ring, using the socket: {e}");
+				return None;
+			}
+		};
+		let handoff = InputRingHandoff {
+			info: ring.info(),
+			memfd,
+			wakeup,
+		};
+		client.input_ring = Some(ring);
+		Some(handoff)
+	}
+
+	async fn forward_input_batch_to_session(
 		&mut self,
 		session_id: SessionId,
-		event: InputEventPayload,
+		mut events: Vec<InputEventPayload>,
 	) {
-		let Some((_id, client)) = self
-			.connected_clients
-			.iter_mut()
-			.find(|(_, c)| c.client_view.authenticated_session() == Some(session_id))
-		else {
+		let Some(client_id) = self.session_clients.get(&session_id) else {
+			return;
+		};
+		let Some(client) = self.connected_clients.get_mut(client_id) else {
 			return;
 		};
-		if !client.client_view.notify_input_event(event).await {
-			tracing::warn!(%session_id, "failed to send input event to active session");
+		self
+			.latency
+			.record_input(session_id, &events, monotonic_ns() / 1_000);
+		// A batch goes through the ring whole or not at all. Once one was refused the ring
+		// refuses everything until the client reported with `input_caught_up` that it read all
+		// input sent over the socket, so nothing sent there is overtaken.
+		if let Some(ring) = client.input_ring.as_mut() {
+			let overflowed = ring.is_overflowed();
+			match ring.push_batch(&events) {
+				Ok(()) => return,
+				Err(e) if !overflowed => {
+					tracing::warn!(%session_id, "{e}, sending input over the socket until the client catches up");
+				}
+				Err(_) => {}
+			}
 		}
-	}
-	async fn read_clients_messages(
-		connected_clients: &mut HashMap<ClientId, ConnectedClient>,
-	) -> (ClientId, C2SMsg) {
-		connected_clients.retain(|_, c| c.client_view.has_messages());
-		let futures = connected_clients
-			.iter_mut()
-			.map(|c| {
-				Box::pin(async {
-					let Some(msg) = c.1.client_view.read_message().await else {
-						return pending().await;
-					};
-					(*c.0, msg)
-				})
-			})
-			.collect::<Vec<_>>();
-		if futures.is_empty() {
-			return pending().await;
+		let count = events.len() as u64;
+		let sent = match events.len() {
+			0 => return,
+			1 => {
+				let event = events.pop().expect("length checked above");
+				client.client_view.notify_input_event(event).await
+			}
+			_ => client.client_view.notify_input_batch(events).await,
+		};
+		if sent {
+			client.socket_input_events += count;
+		} else {
+			tracing::warn!(%session_id, "failed to send input events to active session");
 		}
-		select_all(futures).await.0
 	}
 	#[tracing::instrument(level= "info", skip(self, accept_result), fields(connected_clients=self.connected_clients.len(), active_sessions=self.active_sessions.len(), pending_sessions = self.pending_sessions.len(), current_session = ?self.current_session))]
 	async fn handle_accept(&mut self, accept_result: io::Result<(UnixStream, SocketAddr)>) {
@@ -1166,7 +1337,7 @@ impl ShiftServer {
                     };
                 }
 
-				let hellopkt = TabMessageFrame::hello("shift 0.1.0-alpha");
+				let hellopkt = TabMessageFrame::hello("shift 0.1.0-alpha", self.render_node.clone());
 				let client_async_fd = or_continue!(
 					client_socket.into_std().and_then(AsyncFd::new),
 					"failed to accept connection: AsyncFd creation from client_socket failed: {}"
@@ -1176,15 +1347,26 @@ impl ShiftServer {
 					hellopkt.send_frame_to_async_fd(&client_async_fd).await,
 					"failed to send hello packet: {}"
 				);
-				let (new_client, mut new_client_view) =
-					Client::wrap_socket(client_async_fd, self.monitors.values().cloned().collect());
+				let (mut new_client, mut new_client_view, messages) = Client::wrap_socket(
+					client_async_fd,
+					self.monitors.values().cloned().collect(),
+					self.render_node.clone(),
+				);
+				if let Some(dir) = &self.capture_dir {
+					new_client.capture_to(dir);
+				}
 				let client_id = new_client_view.id();
+				self
+					.client_messages
+					.push(client_messages(client_id, messages));
 
 				self.connected_clients.insert(
 					new_client_view.id(),
 					ConnectedClient {
 						client_view: new_client_view,
 						join_handle: new_client.spawn().await,
+						input_ring: None,
+						socket_input_events: 0,
 					},
 				);
 				tracing::info!(%client_id, "client successfully connected");
@@ -1224,23 +1406,15 @@ impl ShiftServer {
 		let Some(client) = self.connected_clients.remove(&client_id) else {
 			return;
 		};
+		self.latency.forget_client(client_id);
 		if let Some(session_id) = client.client_view.authenticated_session() {
 			self.active_sessions.remove(&session_id);
 			self.loading_sessions.remove(&session_id);
 			self.awake_sessions.remove(&session_id);
 			self.awake_until.remove(&session_id);
-			self
-				.pending_buffer_requests
-				.retain(|pending| pending.client_id != client_id && pending.session_id != session_id);
-			self
-				.waiting_flip
-				.retain(|pending| pending.session_id != session_id);
-			self
-				.front_buffers
-				.retain(|(sess, _), _| *sess != session_id);
-			self
-				.buffer_ownership
-				.retain(|(sess, _, _), _| *sess != session_id);
+			self.session_clients.remove(&session_id);
+			self.buffers.forget_session(session_id);
+			self.latency.forget_session(session_id);
 			if let Err(e) = self
 				.render_commands
 				.send(RenderCmd::SessionRemoved { session_id })
@@ -1259,7 +1433,7 @@ impl ShiftServer {
 		next: Option<SessionId>,
 		transition: Option<SessionTransition>,
 	) {
-		self.pending_input_motion = None;
+		self.input_coalescer.clear();
 		self.current_session = next;
 		self.prune_expired_awake_sessions().await;
 		self.set_awake_sessions(next.into_iter()).await;
@@ -0,0 +1,104 @@
+//! Cost of turning protocol input into the C event structs `tab_client_next_event(s)` hand
+//! out. The socket and handle bookkeeping around it are covered by the tab-protocol benches
+//! and Shift's headless mode.
+
+use std::hint::black_box;
+
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use tab_client::bench_support::{BatchTranslator, input_from_payload};
+use tab_protocol::{
+	AxisOrientation, AxisPhase, AxisSource, ButtonState, InputEventPayload, KeyState, TouchContact,
+};
+
+/// One event of each kind a desktop session sees most.
+fn sample_events() -> Vec<(&'static str, InputEventPayload)> {
+	vec![
+		(
+			"pointer_motion",
+			InputEventPayload::PointerMotion {
+				device: 3,
+				time_usec: 1_000,
+				x: 1280.5,
+				y: 720.25,
+				dx: 1.5,
+				dy: -0.75,
+				unaccel_dx: 1.0,
+				unaccel_dy: -0.5,
+			},
+		),
+		(
+			"pointer_button",
+			InputEventPayload::PointerButton {
+				device: 3,
+				time_usec: 1_000,
+				button: 272,
+				state: ButtonState::Pressed,
+			},
+		),
+		(
+			"pointer_axis",
+			InputEventPayload::PointerAxis {
+				device: 3,
+				time_usec: 1_000,
+				orientation: AxisOrientation::Vertical,
+				delta: 15.0,
+				delta_discrete: Some(1),
+				source: AxisSource::Wheel,
+				phase: AxisPhase::Moved,
+			},
+		),
+		(
+			"key",
+			InputEventPayload::Key {
+				device: 1,
+				time_usec: 1_000,
+				key: 30,
+				state: KeyState::Pressed,
+			},
+		),
+		(
+			"touch_motion",
+			InputEventPayload::TouchMotion {
+				device: 5,
+				time_usec: 1_000,
+				contact: TouchContact {
+					id: 0,
+					x: 400.0,
+					y: 300.0,
+					x_transformed: 0.3125,
+					y_transformed: 0.2083,
+				},
+			},
+		),
+	]
+}
+
+fn input_event(c: &mut Criterion) {
+	let mut group = c.benchmark_group("c_bindings/input_from_payload");
+	for (name, event) in sample_events() {
+		group.bench_with_input(BenchmarkId::from_parameter(name), &event, |b, event| {
+			b.iter(|| input_from_payload(black_box(event)));
+		});
+	}
+	group.finish();
+}
+
+fn input_batch(c: &mut Criterion) {
+	let kinds = sample_events()
+		.into_iter()
+		.map(|(_, event)| event)
+		.collect::<Vec<_>>();
+	let mut translator = BatchTranslator::default();
+	let mut group = c.benchmark_group("c_bindings/input_batch");
+	for size in [1usize, 8, 32, 128] {
+		let events = kinds.iter().cycle().take(size).cloned().collect::<Vec<_>>();
+		group.throughput(Throughput::Elements(size as u64));
+		group.bench_with_input(BenchmarkId::from_parameter(size), &events, |b, events| {
+			b.iter(|| translator.translate(black_box(events)).count);
+		});
+	}
+	group.finish();
+}
+
+criterion_group!(benches, input_event, input_batch);
+criterion_main!(benches);
@@ -6,6 +6,8 @@
 #   TabClient_LIBRARY
 #   TabClient_VERSION (optional if pkg-config is available)
 #   TabClient::TabClient (imported target)
+#   TabClient_CXX_FOUND (tab_client.hpp is present next to tab_client.h)
+#   TabClient::TabClientCxx (TabClient::TabClient plus the header-only C++20 wrappers in tab_client.hpp)
 #
 # Hints:
 #   TAB_CLIENT_ROOT  - root of the repository (defaults to parent of this file)
@@ -54,6 +56,19 @@ if (TabClient_FOUND)
             INTERFACE_INCLUDE_DIRECTORIES "${TabClient_INCLUDE_DIR}"
         )
     endif ()
+
+    if (EXISTS "${TabClient_INCLUDE_DIR}/tab_client.hpp")
+        set(TabClient_CXX_FOUND TRUE)
+        if (NOT TARGET TabClient::TabClientCxx)
+            add_library(TabClient::TabClientCxx INTERFACE IMPORTED)
+            set_target_properties(TabClient::TabClientCxx PROPERTIES
+                INTERFACE_LINK_LIBRARIES TabClient::TabClient
+                INTERFACE_COMPILE_FEATURES cxx_std_20
+            )
+        endif ()
+    else ()
+        set(TabClient_CXX_FOUND FALSE)
+    endif ()
 endif ()
 
 # Helper to create a Cargo build target for tab-client.
@@ -12,12 +12,27 @@ extern "C" {
 #include <stddef.h>
 
 #define TAB_PROTOCOL_VERSION "tab/v3.0.0"
+#define TAB_MIN_SWAPCHAIN_BUFFERS 2
+#define TAB_MAX_SWAPCHAIN_BUFFERS 4
+#define TAB_MAX_DMABUF_PLANES 4
+#define TAB_MAX_DAMAGE_RECTS 16
+#define TAB_LATENCY_BUCKETS 24
+#define TAB_DRM_FORMAT_MOD_INVALID 0x00ffffffffffffffULL
+/* Monitor handles are stable for the lifetime of a connection and never reused. */
+#define TAB_INVALID_MONITOR_HANDLE UINT32_MAX
 
 /* ============================================================================
  * OPAQUE HANDLE
  * ============================================================================
  */
 
+/* A handle belongs to the thread that connected it. Only tab_client_acquire_frame(_h),
+ * tab_client_get_monitor_handle, tab_client_get_monitor_info and tab_client_take_error
+ * may also be called from other threads, as may tab_client_request_buffer* while async
+ * buffer requests are enabled; a render thread per monitor can then run its frame loop
+ * while the owning thread polls events. tab_client_disconnect must not overlap any call.
+ * Any other call made from another thread fails (tab_client_take_error says why), and so
+ * does tab_client_disconnect, which then leaves the connection open. */
 typedef struct TabClientHandle TabClientHandle;
 
 /* ============================================================================
@@ -347,6 +362,15 @@ typedef struct {
     TabInputEventData data;
 } TabInputEvent;
 
+/* Shared-memory input ring granted at auth; see tab_client_get_input_ring.
+ * The fds are owned by the handle. */
+typedef struct {
+    int memfd;
+    int eventfd;
+    uint32_t capacity;
+    uint32_t slot_size;
+} TabInputRing;
+
 /* ============================================================================
  * MONITORS
  * ============================================================================
@@ -358,6 +382,7 @@ typedef struct {
     int32_t height;
     int32_t refresh_rate;
     const char *name;
+    uint32_t handle;
 } TabMonitorInfo;
 
 /* ============================================================================
@@ -370,6 +395,16 @@ typedef enum {
     TAB_SESSION_ROLE_SESSION = 1,
 } TabSessionRole;
 
+/* Honored only while the session is active and fullscreen; vsync otherwise.
+ * VRR and tearing flips are not applied yet: ADAPTIVE_SYNC and ASYNC only make Shift
+ * composite a new buffer right away instead of at the predicted vblank, and the page flip
+ * still waits for vblank. */
+typedef enum {
+    TAB_PRESENT_MODE_VSYNC = 0,
+    TAB_PRESENT_MODE_ADAPTIVE_SYNC = 1,
+    TAB_PRESENT_MODE_ASYNC = 2,
+} TabPresentMode;
+
 typedef enum {
     TAB_SESSION_LIFECYCLE_PENDING = 0,
     TAB_SESSION_LIFECYCLE_LOADING = 1,
@@ -384,6 +419,57 @@ typedef struct {
     TabSessionLifecycle state;
 } TabSessionInfo;
 
+typedef struct {
+    const char *id;
+    uint64_t bytes;        /* allocated by Shift, counted against the budget */
+    uint64_t client_bytes; /* client buffers Shift holds imports of, not budgeted */
+    bool evicted;          /* snapshots dropped to stay within the budget */
+} TabGpuMemoryUsage;
+
+/* Renderer GPU memory; only admin sessions receive reports. total_bytes is what
+ * Shift allocated itself and what the budget limits. */
+typedef struct {
+    uint64_t total_bytes;
+    uint64_t budget_bytes; /* 0 when unlimited */
+    uint64_t skia_cache_bytes;
+    uint64_t retired_import_bytes;
+    uint64_t client_import_bytes;
+    TabGpuMemoryUsage *sessions;
+    size_t session_count;
+    TabGpuMemoryUsage *monitors;
+    size_t monitor_count;
+} TabGpuMemory;
+
+/* Latency histogram. Bucket 0 counts samples under 1us, bucket i samples in
+ * [2^(i-1), 2^i) us; the last bucket is unbounded. Counts only grow. */
+typedef struct {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[TAB_LATENCY_BUCKETS];
+} TabLatencyHistogram;
+
+typedef struct {
+    const char *monitor_id;
+    TabLatencyHistogram acquire;   /* buffer_request received -> acquire fence signaled */
+    TabLatencyHistogram composite; /* buffer ready -> composited */
+    TabLatencyHistogram present;   /* composited -> page flip */
+    TabLatencyHistogram release;   /* release fence -> buffer_release sent */
+} TabMonitorLatencyStats;
+
+typedef struct {
+    const char *session_id;
+    TabLatencyHistogram input; /* libinput timestamp -> handed to the session */
+    TabMonitorLatencyStats *monitors;
+    size_t monitor_count;
+} TabSessionLatencyStats;
+
+/* Shift's latency histograms; only admin sessions may request them. */
+typedef struct {
+    TabSessionLatencyStats *sessions;
+    size_t session_count;
+} TabStats;
+
 /* ============================================================================
  * EVENTS
  * ============================================================================
@@ -405,21 +491,62 @@ typedef enum {
     TAB_EVENT_SESSION_AWAKE = 6,
     TAB_EVENT_SESSION_SLEEP = 7,
     TAB_EVENT_SESSION_ACTIVE = 8,
+    TAB_EVENT_BUFFER_ACK = 9,
+    TAB_EVENT_BUFFER_REJECTED = 10,
+    TAB_EVENT_INPUT_BATCH = 11,
+    TAB_EVENT_FRAME_PRESENTED = 12,
 } TabEventType;
 
 typedef struct {
     const char *monitor_id;
     uint32_t buffer_index;
     int32_t release_fence_fd;
+    uint32_t monitor_handle;
 } TabBufferRelease;
 
+typedef struct {
+    const char *monitor_id;
+    uint32_t buffer_index;
+    uint32_t monitor_handle;
+} TabBufferAck;
+
+typedef struct {
+    const char *monitor_id;
+    uint32_t buffer_index;
+    const char *code;
+    uint32_t monitor_handle;
+} TabBufferRejected;
+
+/* Sent after each page flip that showed this session's content. Times are
+ * CLOCK_MONOTONIC nanoseconds; the next vblank is expected at
+ * vblank_ns + refresh_ns. missed is set when the flip landed at least one
+ * refresh after the vblank following its commit. */
+typedef struct {
+    const char *monitor_id;
+    uint32_t monitor_handle;
+    uint64_t sequence;
+    uint64_t vblank_ns;
+    uint64_t refresh_ns;
+    bool missed;
+} TabFramePresented;
+
 typedef struct {
     const char *monitor_id;
     const char *name;
+    uint32_t monitor_handle;
 } TabMonitorRemoved;
 
+/* Input Shift coalesced since the session's last frame, oldest first. Motion, scroll and
+ * gesture deltas are already summed per device. */
+typedef struct {
+    const TabInputEvent *events;
+    size_t count;
+} TabInputBatch;
+
 typedef union {
     TabBufferRelease buffer_released;
+    TabBufferAck buffer_ack;
+    TabBufferRejected buffer_rejected;
     TabMonitorInfo monitor_added;
     TabMonitorRemoved monitor_removed;
     TabSessionInfo session_state;
@@ -428,6 +555,8 @@ typedef union {
     const char *session_active;
     TabInputEvent input;
     const char *session_created_token;
+    TabInputBatch input_batch;
+    TabFramePresented frame_presented;
 } TabEventData;
 
 typedef struct {
@@ -440,13 +569,31 @@ typedef struct {
  * ============================================================================
  */
 
+typedef struct {
+    int offset;
+    int stride;
+} TabDmabufPlane;
+
 typedef struct {
     int fd;
     int stride;
     int offset;
     uint32_t fourcc;
+    /* DRM format modifier, TAB_DRM_FORMAT_MOD_INVALID for an implicit layout. */
+    uint64_t modifier;
+    /* Planes in use; all of them live in `fd`. planes[0] matches stride/offset. */
+    uint32_t plane_count;
+    TabDmabufPlane planes[TAB_MAX_DMABUF_PLANES];
 } TabDmabuf;
 
+/* Region of the buffer that changed since the previous request, in buffer pixels. */
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+} TabDamageRect;
+
 typedef struct {
     uint32_t framebuffer;
     uint32_t texture;
@@ -455,6 +602,22 @@ typedef struct {
     uint32_t buffer_index;
     TabDmabuf dmabuf;
 } TabFrameTarget;
+
+/* ============================================================================
+ * CONNECTION OPTIONS
+ * ============================================================================
+ */
+
+typedef struct {
+    /* Per-monitor swapchain depth, TAB_MIN_SWAPCHAIN_BUFFERS..TAB_MAX_SWAPCHAIN_BUFFERS. */
+    uint32_t swapchain_buffers;
+    /* Ask Shift for a shared-memory input ring instead of socket input events. */
+    bool input_ring;
+    /* Render on a GPU other than Shift's display GPU, in linear buffers Shift copies to
+     * scanout. Defaults to allocating on the render node Shift advertises. */
+    bool cross_gpu;
+} TabConnectOptions;
+
 /* ============================================================================
  * API
  * ============================================================================
@@ -462,6 +625,19 @@ typedef struct {
 
 TabClientHandle *tab_client_connect(const char *socket_path, const char *token);
 TabClientHandle *tab_client_connect_default(const char *token);
+/* buffer_count is the per-monitor swapchain depth, between
+ * TAB_MIN_SWAPCHAIN_BUFFERS and TAB_MAX_SWAPCHAIN_BUFFERS. */
+TabClientHandle *tab_client_connect_with_buffers(
+    const char *socket_path,
+    const char *token,
+    uint32_t buffer_count
+);
+/* options may be NULL for the defaults. */
+TabClientHandle *tab_client_connect_with_options(
+    const char *socket_path,
+    const char *token,
+    const TabConnectOptions *options
+);
 void tab_client_disconnect(TabClientHandle *handle);
 
 void tab_client_string_free(const char *s);
@@ -473,10 +649,24 @@ char *tab_client_get_protocol_name(TabClientHandle *handle);
 size_t tab_client_get_monitor_count(TabClientHandle *handle);
 char *tab_client_get_monitor_id(TabClientHandle *handle, size_t index);
 TabMonitorInfo tab_client_get_monitor_info(TabClientHandle *handle, const char *monitor_id);
+uint32_t tab_client_get_monitor_handle(TabClientHandle *handle, const char *monitor_id);
 void tab_client_free_monitor_info(TabMonitorInfo *info);
 TabSessionInfo tab_client_get_session(TabClientHandle *handle);
 void tab_client_free_session_info(TabSessionInfo *session_info);
+/* Copies the latest GPU memory report; false if none arrived yet. Free with
+ * tab_client_free_gpu_memory. */
+bool tab_client_get_gpu_memory(TabClientHandle *handle, TabGpuMemory *out);
+void tab_client_free_gpu_memory(TabGpuMemory *memory);
+/* Asks Shift for its latency histograms; the reply is stored by tab_client_poll_events. */
+bool tab_client_request_stats(TabClientHandle *handle);
+/* Copies the latest stats reply; false if none arrived yet. Free with tab_client_free_stats. */
+bool tab_client_get_stats(TabClientHandle *handle, TabStats *out);
+void tab_client_free_stats(TabStats *stats);
 bool tab_client_send_ready(TabClientHandle *handle);
+/* Asks Shift to present this session's frames with `mode` (see TabPresentMode): it
+ * changes when Shift composites, not how it flips, since VRR and tearing flips are not
+ * applied. Returns false if the request could not be sent. */
+bool tab_client_set_present_mode(TabClientHandle *handle, TabPresentMode mode);
 bool tab_client_session_create(
     TabClientHandle *handle,
     TabSessionRole role,
@@ -491,7 +681,12 @@ bool tab_client_session_switch(
 
 size_t tab_client_poll_events(TabClientHandle *handle);
 bool tab_client_next_event(TabClientHandle *handle, TabEvent *event);
+/* Also releases the event array of a TAB_EVENT_INPUT_BATCH. */
 void tab_client_free_event_strings(TabEvent *event);
+/* Drains up to capacity events without per-event allocations. Strings, input
+ * batches and release fences are owned by the handle and stay valid until the next
+ * tab_client_poll_events; do not call tab_client_free_event_strings on them. */
+size_t tab_client_next_events(TabClientHandle *handle, TabEvent *events, size_t capacity);
 
 TabAcquireResult tab_client_acquire_frame(
     TabClientHandle *handle,
@@ -505,6 +700,47 @@ bool tab_client_request_buffer(
     int acquire_fence_fd
 );
 
+/* Handle-based variants of the per-frame calls; no string lookups. */
+TabAcquireResult tab_client_acquire_frame_h(
+    TabClientHandle *handle,
+    uint32_t monitor,
+    TabFrameTarget *target
+);
+bool tab_client_request_buffer_h(
+    TabClientHandle *handle,
+    uint32_t monitor,
+    int acquire_fence_fd
+);
+/* Like tab_client_request_buffer, but only `damage` changed since the previous
+ * request on this monitor. A NULL or empty list means the whole buffer changed;
+ * more than TAB_MAX_DAMAGE_RECTS rectangles are merged. Rectangles with a negative size
+ * or edges past INT32_MAX are ignored. */
+bool tab_client_request_buffer_damage(
+    TabClientHandle *handle,
+    const char *monitor_id,
+    int acquire_fence_fd,
+    const TabDamageRect *damage,
+    size_t damage_count
+);
+bool tab_client_request_buffer_damage_h(
+    TabClientHandle *handle,
+    uint32_t monitor,
+    int acquire_fence_fd,
+    const TabDamageRect *damage,
+    size_t damage_count
+);
+/* When enabled, tab_client_request_buffer returns once the request is sent and
+ * the outcome is reported as TAB_EVENT_BUFFER_ACK / TAB_EVENT_BUFFER_REJECTED,
+ * and it may be called from any thread. */
+void tab_client_set_async_buffer_requests(TabClientHandle *handle, bool enabled);
+
+/* Returns false if no input ring was granted. Poll ring->eventfd next to the
+ * socket; tab_client_poll_events drains the ring into TAB_EVENT_INPUT events. */
+bool tab_client_get_input_ring(TabClientHandle *handle, TabInputRing *ring);
+/* Pops the next event straight from the input ring without any syscall.
+ * Returns false when the ring is empty or none was granted. */
+bool tab_client_input_ring_next(TabClientHandle *handle, TabInputEvent *event);
+
 int tab_client_get_swap_fd(TabClientHandle *handle);
 int tab_client_get_socket_fd(TabClientHandle *handle);
 int tab_client_drm_fd(TabClientHandle *handle);
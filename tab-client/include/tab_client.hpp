@@ -0,0 +1,337 @@
+/* NOLINTBEGIN */
+#ifndef TAB_CLIENT_HPP
+#define TAB_CLIENT_HPP
+
+/* Header-only C++20 wrappers over tab_client.h. Every call forwards inline to the C
+ * API; the types only add ownership, so nothing is copied or allocated on top of what
+ * the C calls already do. Strings are exposed as std::string_view into the memory the
+ * C API returned. Functions taking `const char *` need NUL-terminated strings, as the
+ * C calls do. */
+
+#include "tab_client.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace tab {
+
+/* ============================================================================
+ * STRINGS
+ * ============================================================================
+ */
+
+/* View of a string owned by the C API; empty for NULL. */
+inline std::string_view view(const char *s) noexcept {
+    return s ? std::string_view(s) : std::string_view();
+}
+
+/* A string returned by the C API, released with tab_client_string_free. */
+class String {
+public:
+    String() noexcept = default;
+    explicit String(char *s) noexcept : s_(s) {}
+    String(String &&other) noexcept : s_(std::exchange(other.s_, nullptr)) {}
+    String &operator=(String &&other) noexcept {
+        if (this != &other) {
+            tab_client_string_free(s_);
+            s_ = std::exchange(other.s_, nullptr);
+        }
+        return *this;
+    }
+    String(const String &) = delete;
+    String &operator=(const String &) = delete;
+    ~String() { tab_client_string_free(s_); }
+
+    std::string_view view() const noexcept { return tab::view(s_); }
+    const char *c_str() const noexcept { return s_; }
+    explicit operator bool() const noexcept { return s_ != nullptr; }
+    /* Gives up ownership; free the result with tab_client_string_free. */
+    char *release() noexcept { return std::exchange(s_, nullptr); }
+
+private:
+    char *s_ = nullptr;
+};
+
+/* ============================================================================
+ * OWNED STRUCTS
+ * ============================================================================
+ */
+
+/* A C struct whose strings and arrays are released by `Free`. The free functions clear
+ * what they release, so a moved-from value is simply marked as not owning. */
+template <typename T, void (*Free)(T *)>
+class Owned {
+public:
+    Owned() noexcept = default;
+    explicit Owned(const T &value) noexcept : value_(value), owned_(true) {}
+    Owned(Owned &&other) noexcept
+        : value_(other.value_), owned_(std::exchange(other.owned_, false)) {}
+    Owned &operator=(Owned &&other) noexcept {
+        if (this != &other) {
+            reset();
+            value_ = other.value_;
+            owned_ = std::exchange(other.owned_, false);
+        }
+        return *this;
+    }
+    Owned(const Owned &) = delete;
+    Owned &operator=(const Owned &) = delete;
+    ~Owned() { reset(); }
+
+    const T &operator*() const noexcept { return value_; }
+    const T *operator->() const noexcept { return &value_; }
+    const T &get() const noexcept { return value_; }
+
+private:
+    void reset() noexcept {
+        if (owned_) {
+            Free(&value_);
+            owned_ = false;
+        }
+    }
+
+    T value_{};
+    bool owned_ = false;
+};
+
+using MonitorInfo = Owned<TabMonitorInfo, tab_client_free_monitor_info>;
+using SessionInfo = Owned<TabSessionInfo, tab_client_free_session_info>;
+using GpuMemory = Owned<TabGpuMemory, tab_client_free_gpu_memory>;
+using Stats = Owned<TabStats, tab_client_free_stats>;
+/* An event from tab_client_next_event. Events drained with Client::next_events are
+ * owned by the handle and stay plain TabEvents. */
+using Event = Owned<TabEvent, tab_client_free_event_strings>;
+
+/* ============================================================================
+ * ACCESSORS
+ * ============================================================================
+ */
+
+/* The monitor an event refers to; empty for events without one. */
+inline std::string_view monitor_id(const TabEvent &event) noexcept {
+    switch (event.event_type) {
+    case TAB_EVENT_BUFFER_RELEASED:
+        return view(event.data.buffer_released.monitor_id);
+    case TAB_EVENT_BUFFER_ACK:
+        return view(event.data.buffer_ack.monitor_id);
+    case TAB_EVENT_BUFFER_REJECTED:
+        return view(event.data.buffer_rejected.monitor_id);
+    case TAB_EVENT_MONITOR_ADDED:
+        return view(event.data.monitor_added.id);
+    case TAB_EVENT_MONITOR_REMOVED:
+        return view(event.data.monitor_removed.monitor_id);
+    case TAB_EVENT_FRAME_PRESENTED:
+        return view(event.data.frame_presented.monitor_id);
+    default:
+        return {};
+    }
+}
+
+/* The session an event refers to, or the token of a created session; empty for events
+ * without one. */
+inline std::string_view session_id(const TabEvent &event) noexcept {
+    switch (event.event_type) {
+    case TAB_EVENT_SESSION_STATE:
+        return view(event.data.session_state.id);
+    case TAB_EVENT_SESSION_AWAKE:
+        return view(event.data.session_awake);
+    case TAB_EVENT_SESSION_SLEEP:
+        return view(event.data.session_sleep);
+    case TAB_EVENT_SESSION_ACTIVE:
+        return view(event.data.session_active);
+    case TAB_EVENT_SESSION_CREATED:
+        return view(event.data.session_created_token);
+    default:
+        return {};
+    }
+}
+
+inline std::span<const TabInputEvent> input_events(const TabInputBatch &batch) noexcept {
+    return batch.events ? std::span(batch.events, batch.count) : std::span<const TabInputEvent>();
+}
+
+inline std::span<const TabGpuMemoryUsage> sessions(const TabGpuMemory &memory) noexcept {
+    return memory.sessions ? std::span<const TabGpuMemoryUsage>(memory.sessions, memory.session_count)
+                           : std::span<const TabGpuMemoryUsage>();
+}
+
+inline std::span<const TabGpuMemoryUsage> monitors(const TabGpuMemory &memory) noexcept {
+    return memory.monitors ? std::span<const TabGpuMemoryUsage>(memory.monitors, memory.monitor_count)
+                           : std::span<const TabGpuMemoryUsage>();
+}
+
+inline std::span<const TabSessionLatencyStats> sessions(const TabStats &stats) noexcept {
+    return stats.sessions ? std::span<const TabSessionLatencyStats>(stats.sessions, stats.session_count)
+                          : std::span<const TabSessionLatencyStats>();
+}
+
+inline std::span<const TabMonitorLatencyStats> monitors(const TabSessionLatencyStats &session) noexcept {
+    return session.monitors
+               ? std::span<const TabMonitorLatencyStats>(session.monitors, session.monitor_count)
+               : std::span<const TabMonitorLatencyStats>();
+}
+
+/* ============================================================================
+ * CLIENT
+ * ============================================================================
+ */
+
+/* Owns a connection; disconnects when destroyed. A failed connect yields an empty
+ * Client, which tests false. Which calls may come from other threads is listed at
+ * TabClientHandle. */
+class Client {
+public:
+    Client() noexcept = default;
+    explicit Client(TabClientHandle *handle) noexcept : handle_(handle) {}
+    Client(Client &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Client &operator=(Client &&other) noexcept {
+        if (this != &other) {
+            tab_client_disconnect(handle_);
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+    ~Client() { tab_client_disconnect(handle_); }
+
+    /* socket_path may be NULL for the default socket. */
+    static Client connect(const char *socket_path, const char *token) noexcept {
+        return Client(tab_client_connect(socket_path, token));
+    }
+    static Client connect(
+        const char *socket_path,
+        const char *token,
+        const TabConnectOptions &options
+    ) noexcept {
+        return Client(tab_client_connect_with_options(socket_path, token, &options));
+    }
+    static Client connect_default(const char *token) noexcept {
+        return Client(tab_client_connect_default(token));
+    }
+
+    TabClientHandle *get() const noexcept { return handle_; }
+    explicit operator bool() const noexcept { return handle_ != nullptr; }
+    /* Gives up ownership; disconnect the result with tab_client_disconnect. */
+    TabClientHandle *release() noexcept { return std::exchange(handle_, nullptr); }
+
+    String take_error() noexcept { return String(tab_client_take_error(handle_)); }
+    String server_name() noexcept { return String(tab_client_get_server_name(handle_)); }
+    String protocol_name() noexcept { return String(tab_client_get_protocol_name(handle_)); }
+
+    std::size_t monitor_count() noexcept { return tab_client_get_monitor_count(handle_); }
+    String monitor_id(std::size_t index) noexcept {
+        return String(tab_client_get_monitor_id(handle_, index));
+    }
+    MonitorInfo monitor_info(const char *monitor_id) noexcept {
+        return MonitorInfo(tab_client_get_monitor_info(handle_, monitor_id));
+    }
+    uint32_t monitor_handle(const char *monitor_id) noexcept {
+        return tab_client_get_monitor_handle(handle_, monitor_id);
+    }
+
+    SessionInfo session() noexcept { return SessionInfo(tab_client_get_session(handle_)); }
+    std::optional<GpuMemory> gpu_memory() noexcept {
+        TabGpuMemory memory{};
+        if (!tab_client_get_gpu_memory(handle_, &memory)) {
+            return std::nullopt;
+        }
+        return GpuMemory(memory);
+    }
+    bool request_stats() noexcept { return tab_client_request_stats(handle_); }
+    std::optional<Stats> stats() noexcept {
+        TabStats stats{};
+        if (!tab_client_get_stats(handle_, &stats)) {
+            return std::nullopt;
+        }
+        return Stats(stats);
+    }
+
+    bool send_ready() noexcept { return tab_client_send_ready(handle_); }
+    bool set_present_mode(TabPresentMode mode) noexcept {
+        return tab_client_set_present_mode(handle_, mode);
+    }
+    bool session_create(TabSessionRole role, const char *display_name) noexcept {
+        return tab_client_session_create(handle_, role, display_name);
+    }
+    bool session_switch(const char *session_id, const char *animation, uint32_t duration_ms) noexcept {
+        return tab_client_session_switch(handle_, session_id, animation, duration_ms);
+    }
+
+    std::size_t poll_events() noexcept { return tab_client_poll_events(handle_); }
+    std::optional<Event> next_event() noexcept {
+        TabEvent event{};
+        if (!tab_client_next_event(handle_, &event)) {
+            return std::nullopt;
+        }
+        return Event(event);
+    }
+    /* Drains queued events into `events` and returns the filled part. Their strings and
+     * input batches are owned by the handle and stay valid until the next poll_events. */
+    std::span<TabEvent> next_events(std::span<TabEvent> events) noexcept {
+        return events.first(tab_client_next_events(handle_, events.data(), events.size()));
+    }
+
+    TabAcquireResult acquire_frame(uint32_t monitor, TabFrameTarget &target) noexcept {
+        return tab_client_acquire_frame_h(handle_, monitor, &target);
+    }
+    TabAcquireResult acquire_frame(const char *monitor_id, TabFrameTarget &target) noexcept {
+        return tab_client_acquire_frame(handle_, monitor_id, &target);
+    }
+    bool request_buffer(uint32_t monitor, int acquire_fence_fd) noexcept {
+        return tab_client_request_buffer_h(handle_, monitor, acquire_fence_fd);
+    }
+    bool request_buffer(const char *monitor_id, int acquire_fence_fd) noexcept {
+        return tab_client_request_buffer(handle_, monitor_id, acquire_fence_fd);
+    }
+    /* An empty `damage` means the whole buffer changed. */
+    bool request_buffer(
+        uint32_t monitor,
+        int acquire_fence_fd,
+        std::span<const TabDamageRect> damage
+    ) noexcept {
+        return tab_client_request_buffer_damage_h(
+            handle_, monitor, acquire_fence_fd, damage.data(), damage.size()
+        );
+    }
+    bool request_buffer(
+        const char *monitor_id,
+        int acquire_fence_fd,
+        std::span<const TabDamageRect> damage
+    ) noexcept {
+        return tab_client_request_buffer_damage(
+            handle_, monitor_id, acquire_fence_fd, damage.data(), damage.size()
+        );
+    }
+    void set_async_buffer_requests(bool enabled) noexcept {
+        tab_client_set_async_buffer_requests(handle_, enabled);
+    }
+
+    std::optional<TabInputRing> input_ring() noexcept {
+        TabInputRing ring{};
+        if (!tab_client_get_input_ring(handle_, &ring)) {
+            return std::nullopt;
+        }
+        return ring;
+    }
+    bool input_ring_next(TabInputEvent &event) noexcept {
+        return tab_client_input_ring_next(handle_, &event);
+    }
+
+    int swap_fd() noexcept { return tab_client_get_swap_fd(handle_); }
+    int socket_fd() noexcept { return tab_client_get_socket_fd(handle_); }
+    int drm_fd() noexcept { return tab_client_drm_fd(handle_); }
+
+private:
+    TabClientHandle *handle_ = nullptr;
+};
+
+} // namespace tab
+
+#endif /* TAB_CLIENT_HPP */
+
+/* NOLINTEND */
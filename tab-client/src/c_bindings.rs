@@ -1,18 +1,26 @@
 #![allow(non_camel_case_types)]
 
 use std::{
-	cell::RefCell,
+	cell::{RefCell, UnsafeCell},
 	collections::{HashMap, VecDeque},
 	env,
 	ffi::{CStr, CString},
-	os::raw::{c_char, c_int},
+	os::{
+		fd::{AsRawFd, FromRawFd, OwnedFd},
+		raw::{c_char, c_int},
+	},
 	ptr,
 	rc::Rc,
+	sync::{
+		Arc, Mutex, RwLock,
+		atomic::{AtomicBool, Ordering},
+	},
+	thread::{self, ThreadId},
 	time::Duration,
 };
 
 use crate::{
-	TabClient,
+	BufferSubmitter, TabClient,
 	config::TabClientConfig,
 	error::TabClientError,
 	events::{InputEvent, MonitorEvent, RenderEvent, SessionEvent},
@@ -20,8 +28,8 @@ use crate::{
 	swapchain::TabSwapchain,
 };
 use tab_protocol::{
-	AxisOrientation, AxisPhase, AxisSource, BufferIndex, ButtonState, InputEventPayload, KeyState,
-	SwitchState, SwitchType, TipState,
+	AxisOrientation, AxisPhase, AxisSource, BufferIndex, ButtonState, DamageRect, InputEventPayload,
+	KeyState, SwitchState, SwitchType, TipState,
 };
 
 #[repr(C)]
@@ -31,6 +39,26 @@ pub struct TabDmabuf {
 	pub stride: c_int,
 	pub offset: c_int,
 	pub fourcc: c_int,
+	/// `DRM_FORMAT_MOD_INVALID` when the driver chose an implicit layout.
+	pub modifier: u64,
+	pub plane_count: u32,
+	pub planes: [TabDmabufPlane; tab_protocol::MAX_DMABUF_PLANES],
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct TabDmabufPlane {
+	pub offset: c_int,
+	pub stride: c_int,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabDamageRect {
+	pub x: i32,
+	pub y: i32,
+	pub width: i32,
+	pub height: i32,
 }
 
 #[repr(C)]
@@ -44,12 +72,67 @@ pub struct TabFrameTarget {
 	pub dmabuf: TabDmabuf,
 }
 
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct TabConnectOptions {
+	pub swapchain_buffers: u32,
+	pub input_ring: bool,
+	pub cross_gpu: bool,
+}
+
+impl Default for TabConnectOptions {
+	fn default() -> Self {
+		Self {
+			swapchain_buffers: tab_protocol::MIN_SWAPCHAIN_BUFFERS as u32,
+			input_ring: false,
+			cross_gpu: false,
+		}
+	}
+}
+
+#[repr(C)]
+pub struct TabInputRing {
+	pub memfd: c_int,
+	pub eventfd: c_int,
+	pub capacity: u32,
+	pub slot_size: u32,
+}
+
 #[repr(C)]
 #[derive(Debug, Clone, Copy)]
 pub struct TabBufferRelease {
 	pub monitor_id: *mut c_char,
 	pub buffer_index: u32,
 	pub release_fence_fd: c_int,
+	pub monitor_handle: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabBufferAck {
+	pub monitor_id: *mut c_char,
+	pub buffer_index: u32,
+	pub monitor_handle: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabBufferRejected {
+	pub monitor_id: *mut c_char,
+	pub buffer_index: u32,
+	pub code: *mut c_char,
+	pub monitor_handle: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabFramePresented {
+	pub monitor_id: *mut c_char,
+	pub monitor_handle: u32,
+	pub sequence: u64,
+	pub vblank_ns: u64,
+	pub refresh_ns: u64,
+	pub missed: bool,
 }
 
 #[repr(C)]
@@ -60,6 +143,7 @@ pub struct TabMonitorInfo {
 	pub height: i32,
 	pub refresh_rate: i32,
 	pub name: *mut c_char,
+	pub handle: u32,
 }
 
 #[repr(C)]
@@ -67,8 +151,12 @@ pub struct TabMonitorInfo {
 pub struct TabMonitorRemoved {
 	pub monitor_id: *mut c_char,
 	pub name: *mut c_char,
+	pub monitor_handle: u32,
 }
 
+/// Value used for `monitor_handle` fields that do not refer to a known monitor.
+pub const TAB_INVALID_MONITOR_HANDLE: u32 = u32::MAX;
+
 #[repr(C)]
 #[derive(Debug, Clone, Copy)]
 pub enum TabAcquireResult {
@@ -89,6 +177,10 @@ pub enum TabEventType {
 	TAB_EVENT_SESSION_AWAKE = 6,
 	TAB_EVENT_SESSION_SLEEP = 7,
 	TAB_EVENT_SESSION_ACTIVE = 8,
+	TAB_EVENT_BUFFER_ACK = 9,
+	TAB_EVENT_BUFFER_REJECTED = 10,
+	TAB_EVENT_INPUT_BATCH = 11,
+	TAB_EVENT_FRAME_PRESENTED = 12,
 }
 
 #[repr(C)]
@@ -98,6 +190,74 @@ pub enum TabSessionRole {
 	TAB_SESSION_ROLE_SESSION = 1,
 }
 
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub enum TabPresentMode {
+	TAB_PRESENT_MODE_VSYNC = 0,
+	TAB_PRESENT_MODE_ADAPTIVE_SYNC = 1,
+	TAB_PRESENT_MODE_ASYNC = 2,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabGpuMemoryUsage {
+	pub id: *mut c_char,
+	pub bytes: u64,
+	pub client_bytes: u64,
+	pub evicted: bool,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabGpuMemory {
+	pub total_bytes: u64,
+	/// `0` when unlimited.
+	pub budget_bytes: u64,
+	pub skia_cache_bytes: u64,
+	pub retired_import_bytes: u64,
+	pub client_import_bytes: u64,
+	pub sessions: *mut TabGpuMemoryUsage,
+	pub session_count: usize,
+	pub monitors: *mut TabGpuMemoryUsage,
+	pub monitor_count: usize,
+}
+
+/// Power-of-two microsecond buckets, see `tab_protocol::latency`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabLatencyHistogram {
+	pub count: u64,
+	pub sum_us: u64,
+	pub max_us: u64,
+	pub buckets: [u64; tab_protocol::latency::LATENCY_BUCKETS],
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabMonitorLatencyStats {
+	pub monitor_id: *mut c_char,
+	pub acquire: TabLatencyHistogram,
+	pub composite: TabLatencyHistogram,
+	pub present: TabLatencyHistogram,
+	pub release: TabLatencyHistogram,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabSessionLatencyStats {
+	pub session_id: *mut c_char,
+	pub input: TabLatencyHistogram,
+	pub monitors: *mut TabMonitorLatencyStats,
+	pub monitor_count: usize,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct TabStats {
+	pub sessions: *mut TabSessionLatencyStats,
+	pub session_count: usize,
+}
+
 #[repr(C)]
 #[derive(Debug, Clone, Copy)]
 pub enum TabSessionLifecycle {
@@ -127,6 +287,8 @@ pub struct TabEvent {
 #[derive(Clone, Copy)]
 pub union TabEventData {
 	pub buffer_released: TabBufferRelease,
+	pub buffer_ack: TabBufferAck,
+	pub buffer_rejected: TabBufferRejected,
 	pub monitor_added: TabMonitorInfo,
 	pub monitor_removed: TabMonitorRemoved,
 	pub session_state: TabSessionInfo,
@@ -135,6 +297,8 @@ pub union TabEventData {
 	pub session_active: *mut c_char,
 	pub input: TabInputEvent,
 	pub session_created_token: *mut c_char,
+	pub input_batch: TabInputBatch,
+	pub frame_presented: TabFramePresented,
 }
 
 #[repr(C)]
@@ -450,35 +614,149 @@ pub struct TabInputEvent {
 	pub data: TabInputEventData,
 }
 
+/// Input Shift coalesced since the session's last frame, oldest first.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct TabInputBatch {
+	pub events: *mut TabInputEvent,
+	pub count: usize,
+}
+
 struct MonitorEntry {
+	handle: u32,
 	state: MonitorState,
 	swapchain: TabSwapchain,
 	pending: Option<BufferIndex>,
 }
 
+/// Render events name their monitor with the id interned in [`FrameState::monitor_handles`],
+/// so queueing one per frame doesn't copy the string.
 enum PendingEvent {
-	BufferReleased(String, BufferIndex, Option<c_int>),
+	BufferReleased(Arc<str>, BufferIndex, Option<c_int>),
+	BufferAcked(Arc<str>, BufferIndex),
+	BufferRejected(Arc<str>, BufferIndex, String),
+	FramePresented {
+		monitor_id: Arc<str>,
+		sequence: u64,
+		vblank_ns: u64,
+		refresh_ns: u64,
+		missed: bool,
+	},
 	MonitorAdded(MonitorState),
-	MonitorRemoved { monitor_id: String, name: String },
+	MonitorRemoved {
+		monitor_id: String,
+		name: String,
+	},
 	SessionState(tab_protocol::SessionInfo),
 	SessionActive(String),
 	SessionAwake(String),
 	SessionSleep(String),
 	SessionCreated(String),
 	Input(InputEventPayload),
+	InputBatch(Vec<InputEventPayload>),
 }
 
-pub struct TabClientHandle {
+/// Each monitor's swapchain sits behind its own lock, so render threads working on different
+/// monitors never wait on each other.
+type SharedMonitor = Arc<Mutex<MonitorEntry>>;
+
+/// What `tab_client_acquire_frame*` and async `tab_client_request_buffer*` touch. Safe to use
+/// from any thread while the owner thread dispatches events.
+struct FrameState {
+	/// Monitor entries indexed by their `uint32_t` handle. Handles are never reused
+	/// within a connection, so a removed monitor leaves a `None` hole.
+	monitors: RwLock<Vec<Option<SharedMonitor>>>,
+	monitor_handles: RwLock<HashMap<Arc<str>, u32>>,
+	submitter: BufferSubmitter,
+	async_buffer_requests: AtomicBool,
+	last_error: Mutex<Option<CString>>,
+}
+
+impl FrameState {
+	fn monitor_handle(&self, id: &str) -> Option<u32> {
+		self.monitor_handles.read().unwrap().get(id).copied()
+	}
+
+	/// The interned id of a known monitor; ids Shift hasn't announced are copied.
+	fn monitor_id(&self, id: &str) -> Arc<str> {
+		self
+			.monitor_handles
+			.read()
+			.unwrap()
+			.get_key_value(id)
+			.map_or_else(|| Arc::from(id), |(id, _)| Arc::clone(id))
+	}
+
+	fn monitor(&self, monitor: u32) -> Option<SharedMonitor> {
+		self.monitors.read().unwrap().get(monitor as usize)?.clone()
+	}
+
+	fn record_error(&self, err: impl ToString) {
+		if let Ok(cs) = CString::new(err.to_string()) {
+			*self.last_error.lock().unwrap() = Some(cs);
+		}
+	}
+}
+
+/// State confined to the thread that owns the handle: the connection, the event queue and
+/// the monitor list event dispatch maintains.
+struct HandleOwner {
 	client: TabClient,
 	events: Rc<RefCell<VecDeque<PendingEvent>>>,
-	monitors: HashMap<String, MonitorEntry>,
 	monitor_order: Vec<String>,
-	last_error: Option<CString>,
+	event_arena: EventArena,
+	frames: Arc<FrameState>,
+}
+
+// Render threads reach `FrameState` through a raw handle, so nothing else checks this.
+const _: fn() = assert_send_sync::<FrameState>;
+fn assert_send_sync<T: Send + Sync>() {}
+
+pub struct TabClientHandle {
+	/// Only accessed from `owner_thread`, through [`owner`].
+	owner: UnsafeCell<HandleOwner>,
+	owner_thread: ThreadId,
+	frames: Arc<FrameState>,
+}
+
+impl TabClientHandle {
+	/// Whether the calling thread is the one that connected, recording an error if not.
+	fn on_owner_thread(&self) -> bool {
+		if thread::current().id() == self.owner_thread {
+			return true;
+		}
+		self
+			.frames
+			.record_error("called from a thread other than the one that connected");
+		false
+	}
+}
+
+/// The owner-thread half of `handle`. Every call other than the per-frame ones goes through
+/// here and fails when made from any other thread.
+unsafe fn owner<'a>(handle: *mut TabClientHandle) -> Option<&'a mut HandleOwner> {
+	let handle = unsafe { handle.as_ref() }?;
+	if !handle.on_owner_thread() {
+		return None;
+	}
+	Some(unsafe { &mut *handle.owner.get() })
+}
+
+/// The half of `handle` that render threads share.
+unsafe fn frames<'a>(handle: *mut TabClientHandle) -> Option<&'a FrameState> {
+	unsafe { handle.as_ref().map(|handle| &*handle.frames) }
 }
 
 impl TabClientHandle {
 	fn new(mut client: TabClient) -> Result<Self, TabClientError> {
 		let queue = Rc::new(RefCell::new(VecDeque::new()));
+		let frames = Arc::new(FrameState {
+			monitors: RwLock::default(),
+			monitor_handles: RwLock::default(),
+			submitter: client.buffer_submitter()?,
+			async_buffer_requests: AtomicBool::new(false),
+			last_error: Mutex::new(None),
+		});
 
 		{
 			let q = queue.clone();
@@ -497,6 +775,7 @@ impl TabClientHandle {
 		}
 		{
 			let q = queue.clone();
+			let frames = Arc::clone(&frames);
 			client.on_render_event(move |evt| {
 				let mut guard = q.borrow_mut();
 				match evt {
@@ -505,10 +784,35 @@ impl TabClientHandle {
 						buffer,
 						release_fence_fd,
 					} => guard.push_back(PendingEvent::BufferReleased(
-						monitor_id.clone(),
+						frames.monitor_id(monitor_id),
 						*buffer,
 						*release_fence_fd,
 					)),
+					RenderEvent::BufferAcked { monitor_id, buffer } => guard.push_back(
+						PendingEvent::BufferAcked(frames.monitor_id(monitor_id), *buffer),
+					),
+					RenderEvent::BufferRejected {
+						monitor_id,
+						buffer,
+						code,
+					} => guard.push_back(PendingEvent::BufferRejected(
+						frames.monitor_id(monitor_id),
+						*buffer,
+						code.clone(),
+					)),
+					RenderEvent::FramePresented {
+						monitor_id,
+						sequence,
+						vblank_ns,
+						refresh_ns,
+						missed,
+					} => guard.push_back(PendingEvent::FramePresented {
+						monitor_id: frames.monitor_id(monitor_id),
+						sequence: *sequence,
+						vblank_ns: *vblank_ns,
+						refresh_ns: *refresh_ns,
+						missed: *missed,
+					}),
 				}
 			});
 		}
@@ -537,63 +841,93 @@ impl TabClientHandle {
 		}
 		{
 			let q = queue.clone();
-			client.on_input_event(move |evt| {
+			// Input is moved into the queue; batches are the hot path.
+			client.set_input_sink(move |evt| {
 				let mut guard = q.borrow_mut();
 				match evt {
-					InputEvent::Event(event) => guard.push_back(PendingEvent::Input(event.clone())),
+					InputEvent::Event(event) => guard.push_back(PendingEvent::Input(event)),
+					InputEvent::Batch(events) => guard.push_back(PendingEvent::InputBatch(events)),
 				}
 			});
 		}
 
-		let mut handle = Self {
+		let mut owner = HandleOwner {
 			client,
 			events: queue,
-			monitors: HashMap::new(),
 			monitor_order: Vec::new(),
-			last_error: None,
+			event_arena: EventArena::default(),
+			frames: Arc::clone(&frames),
 		};
 
-		let monitor_ids: Vec<String> = handle
-			.client
-			.monitors()
-			.map(|m| m.info.id.clone())
-			.collect();
+		let monitor_ids: Vec<String> = owner.client.monitors().map(|m| m.info.id.clone()).collect();
 		for id in monitor_ids {
-			if let Some(state) = handle.client.monitor(&id).cloned() {
-				handle.insert_monitor(state)?;
+			if let Some(state) = owner.client.monitor(&id).cloned() {
+				owner.insert_monitor(state)?;
 			}
 		}
 
-		Ok(handle)
+		Ok(Self {
+			owner: UnsafeCell::new(owner),
+			owner_thread: thread::current().id(),
+			frames,
+		})
 	}
+}
 
-	fn insert_monitor(&mut self, state: MonitorState) -> Result<(), TabClientError> {
+impl HandleOwner {
+	fn insert_monitor(&mut self, state: MonitorState) -> Result<u32, TabClientError> {
 		let id = state.info.id.clone();
-		if self.monitors.contains_key(&id) {
-			return Ok(());
+		if let Some(handle) = self.frames.monitor_handle(&id) {
+			return Ok(handle);
 		}
 		let swapchain = self.client.create_swapchain(&id)?;
-		self.monitor_order.push(id.clone());
-		self.monitors.insert(
-			id,
-			MonitorEntry {
-				state,
-				swapchain,
-				pending: None,
-			},
-		);
-		Ok(())
+		// The entry goes in before its id resolves, so a lookup by id always finds one.
+		let mut monitors = self.frames.monitors.write().unwrap();
+		let handle = u32::try_from(monitors.len())
+			.ok()
+			.filter(|handle| *handle != TAB_INVALID_MONITOR_HANDLE)
+			.ok_or(TabClientError::Unexpected("monitor handles exhausted"))?;
+		monitors.push(Some(Arc::new(Mutex::new(MonitorEntry {
+			handle,
+			state,
+			swapchain,
+			pending: None,
+		}))));
+		drop(monitors);
+		self
+			.frames
+			.monitor_handles
+			.write()
+			.unwrap()
+			.insert(Arc::from(id.as_str()), handle);
+		self.monitor_order.push(id);
+		Ok(handle)
 	}
 
-	fn remove_monitor(&mut self, id: &str) {
-		self.monitors.remove(id);
+	fn remove_monitor(&mut self, id: &str) -> Option<u32> {
+		let handle = self.frames.monitor_handles.write().unwrap().remove(id)?;
+		if let Some(slot) = self
+			.frames
+			.monitors
+			.write()
+			.unwrap()
+			.get_mut(handle as usize)
+		{
+			*slot = None;
+		}
 		self.monitor_order.retain(|item| item != id);
+		Some(handle)
 	}
 
-	fn record_error(&mut self, err: impl ToString) {
-		if let Ok(cs) = CString::new(err.to_string()) {
-			self.last_error = Some(cs);
-		}
+	fn monitor_by_id(&self, id: &str) -> Option<SharedMonitor> {
+		self
+			.frames
+			.monitor_handle(id)
+			.and_then(|monitor| self.frames.monitor(monitor))
+	}
+
+	fn record_error(&self, err: impl ToString) {
+		self.frames.record_error(err);
 	}
 }
 
@@ -603,6 +937,151 @@ fn dup_string(s: &str) -> *mut c_char {
 		.unwrap_or(ptr::null_mut())
 }
 
+const EVENT_ARENA_CHUNK_SIZE: usize = 4096;
+
+/// Bump allocator backing the strings and input batches handed out by `tab_client_next_events`.
+///
+/// Chunks are never moved or freed on reset, so pointers stay valid until the next
+/// `tab_client_poll_events` and a warmed-up arena drains events without allocating.
+#[derive(Default)]
+struct EventArena {
+	chunks: Vec<Box<[u8]>>,
+	chunk: usize,
+	offset: usize,
+	fences: Vec<OwnedFd>,
+	/// Event buffers handed out since the last reset; their capacity is kept across resets.
+	input_batches: Vec<Vec<TabInputEvent>>,
+	input_batch: usize,
+}
+
+impl EventArena {
+	fn reset(&mut self) {
+		self.chunk = 0;
+		self.offset = 0;
+		self.fences.clear();
+		self.input_batch = 0;
+	}
+
+	fn alloc_input_batch(&mut self, events: &[InputEventPayload]) -> TabInputBatch {
+		if self.input_batch == self.input_batches.len() {
+			self.input_batches.push(Vec::new());
+		}
+		let converted = &mut self.input_batches[self.input_batch];
+		self.input_batch += 1;
+		converted.clear();
+		converted.extend(events.iter().map(tab_input_from_payload));
+		TabInputBatch {
+			events: converted.as_mut_ptr(),
+			count: converted.len(),
+		}
+	}
+
+	fn alloc_str(&mut self, s: &str) -> *mut c_char {
+		let bytes = s.as_bytes();
+		if bytes.contains(&0) {
+			return ptr::null_mut();
+		}
+		let needed = bytes.len() + 1;
+		loop {
+			if self.chunk == self.chunks.len() {
+				let size = needed.max(EVENT_ARENA_CHUNK_SIZE);
+				self.chunks.push(vec![0u8; size].into_boxed_slice());
+			}
+			let chunk = &mut self.chunks[self.chunk];
+			if chunk.len() - self.offset >= needed {
+				let start = self.offset;
+				chunk[start..start + bytes.len()].copy_from_slice(bytes);
+				chunk[start + bytes.len()] = 0;
+				self.offset += needed;
+				return chunk[start..].as_mut_ptr() as *mut c_char;
+			}
+			self.chunk += 1;
+			self.offset = 0;
+		}
+	}
+}
+
+/// Where the strings and fds of a translated `TabEvent` live.
+enum EventStrings<'a> {
+	/// Heap strings and fds owned by the caller, released by `tab_client_free_event_strings`.
+	Owned,
+	/// Borrowed from the handle's arena until the next `tab_client_poll_events`.
+	Borrowed(&'a mut EventArena),
+}
+
+impl EventStrings<'_> {
+	fn string(&mut self, s: &str) -> *mut c_char {
+		match self {
+			EventStrings::Owned => dup_string(s),
+			EventStrings::Borrowed(arena) => arena.alloc_str(s),
+		}
+	}
+
+	fn fence(&mut self, fd: Option<c_int>) -> c_int {
+		match (self, fd) {
+			(_, None) => -1,
+			(EventStrings::Owned, Some(fd)) => fd,
+			(EventStrings::Borrowed(arena), Some(fd)) => {
+				arena.fences.push(unsafe { OwnedFd::from_raw_fd(fd) });
+				fd
+			}
+		}
+	}
+
+	fn input_batch(&mut self, events: &[InputEventPayload]) -> TabInputBatch {
+		match self {
+			EventStrings::Owned => {
+				let converted = Box::leak(
+					events
+						.iter()
+						.map(tab_input_from_payload)
+						.collect::<Box<[_]>>(),
+				);
+				TabInputBatch {
+					events: converted.as_mut_ptr(),
+					count: converted.len(),
+				}
+			}
+			EventStrings::Borrowed(arena) => arena.alloc_input_batch(events),
+		}
+	}
+}
+
+/// The event translation behind `tab_client_next_event(s)`, reachable from `benches/`
+/// without a connected handle. Not part of the C or Rust API.
+#[doc(hidden)]
+pub mod bench_support {
+	use tab_protocol::InputEventPayload;
+
+	use super::{EventArena, EventStrings, TabInputBatch, TabInputEvent};
+
+	pub fn input_from_payload(payload: &InputEventPayload) -> TabInputEvent {
+		super::tab_input_from_payload(payload)
+	}
+
+	/// Translates input batches into an arena the way `tab_client_next_events` does, reset
+	/// before every batch like `tab_client_poll_events` resets the handle's.
+	#[derive(Default)]
+	pub struct BatchTranslator {
+		arena: EventArena,
+	}
+
+	impl BatchTranslator {
+		pub fn translate(&mut self, events: &[InputEventPayload]) -> TabInputBatch {
+			self.arena.reset();
+			EventStrings::Borrowed(&mut self.arena).input_batch(events)
+		}
+	}
+}
+
+/// Borrows a C string as `&str` without copying it.
+fn cstr_ref<'a>(ptr: *const c_char) -> Option<&'a str> {
+	if ptr.is_null() {
+		return None;
+	}
+	unsafe { CStr::from_ptr(ptr) }.to_str().ok()
+}
+
 fn cstring_to_string(ptr: *const c_char) -> Option<String> {
 	if ptr.is_null() {
 		return None;
@@ -617,13 +1096,22 @@ fn resolve_token(token: *const c_char) -> Option<String> {
 	cstring_to_string(token).or_else(|| env::var("SHIFT_SESSION_TOKEN").ok())
 }
 
-fn monitor_info_to_c(state: &MonitorState) -> TabMonitorInfo {
+fn monitor_info_to_c(handle: u32, state: &MonitorState) -> TabMonitorInfo {
+	monitor_info_to_c_with(handle, state, &mut EventStrings::Owned)
+}
+
+fn monitor_info_to_c_with(
+	handle: u32,
+	state: &MonitorState,
+	strings: &mut EventStrings,
+) -> TabMonitorInfo {
 	TabMonitorInfo {
-		id: dup_string(&state.info.id),
+		id: strings.string(&state.info.id),
 		width: state.info.width,
 		height: state.info.height,
 		refresh_rate: state.info.refresh_rate,
-		name: dup_string(&state.info.name),
+		name: strings.string(&state.info.name),
+		handle,
 	}
 }
 
@@ -644,13 +1132,20 @@ fn tab_session_lifecycle(lifecycle: tab_protocol::SessionLifecycle) -> TabSessio
 }
 
 fn tab_session_info_to_c(session: &tab_protocol::SessionInfo) -> TabSessionInfo {
+	tab_session_info_to_c_with(session, &mut EventStrings::Owned)
+}
+
+fn tab_session_info_to_c_with(
+	session: &tab_protocol::SessionInfo,
+	strings: &mut EventStrings,
+) -> TabSessionInfo {
 	TabSessionInfo {
-		id: dup_string(&session.id),
+		id: strings.string(&session.id),
 		role: tab_session_role(session.role),
 		display_name: session
 			.display_name
 			.as_deref()
-			.map(dup_string)
+			.map(|name| strings.string(name))
 			.unwrap_or(ptr::null_mut()),
 		state: tab_session_lifecycle(session.state),
 	}
@@ -1179,12 +1674,46 @@ fn tab_input_from_payload(payload: &InputEventPayload) -> TabInputEvent {
 pub unsafe extern "C" fn tab_client_connect(
 	socket_path: *const c_char,
 	token: *const c_char,
+) -> *mut TabClientHandle {
+	unsafe {
+		tab_client_connect_with_buffers(
+			socket_path,
+			token,
+			tab_protocol::MIN_SWAPCHAIN_BUFFERS as u32,
+		)
+	}
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_connect_with_buffers(
+	socket_path: *const c_char,
+	token: *const c_char,
+	buffer_count: u32,
+) -> *mut TabClientHandle {
+	let options = TabConnectOptions {
+		swapchain_buffers: buffer_count,
+		..TabConnectOptions::default()
+	};
+	unsafe { tab_client_connect_with_options(socket_path, token, &options) }
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_connect_with_options(
+	socket_path: *const c_char,
+	token: *const c_char,
+	options: *const TabConnectOptions,
 ) -> *mut TabClientHandle {
 	let token = match resolve_token(token) {
 		Some(t) => t,
 		None => return ptr::null_mut(),
 	};
-	let mut config = TabClientConfig::new(token);
+	let options = unsafe { options.as_ref() }.copied().unwrap_or_default();
+	let mut config = TabClientConfig::new(token)
+		.swapchain_buffers(options.swapchain_buffers as usize)
+		.input_ring(options.input_ring)
+		.cross_gpu(options.cross_gpu)
+		// The handle sets up every monitor right away anyway.
+		.preallocate_swapchains(true);
 	if let Some(path) = cstring_to_string(socket_path) {
 		config = config.socket_path(path);
 	}
@@ -1212,7 +1741,10 @@ pub unsafe extern "C" fn tab_client_connect_default(token: *const c_char) -> *mu
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_disconnect(handle: *mut TabClientHandle) {
 	unsafe {
-		if !handle.is_null() {
+		// Dropping the connection anywhere else would race the owner thread; leak it instead.
+		if let Some(owner) = handle.as_ref()
+			&& owner.on_owner_thread()
+		{
 			drop(Box::from_raw(handle));
 		}
 	}
@@ -1230,11 +1762,11 @@ pub unsafe extern "C" fn tab_client_string_free(s: *mut c_char) {
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_take_error(handle: *mut TabClientHandle) -> *mut c_char {
 	unsafe {
-		let handle = match handle.as_mut() {
+		let handle = match frames(handle) {
 			Some(h) => h,
 			None => return ptr::null_mut(),
 		};
-		if let Some(err) = handle.last_error.take() {
+		if let Some(err) = handle.last_error.lock().unwrap().take() {
 			err.into_raw()
 		} else {
 			ptr::null_mut()
@@ -1244,7 +1776,56 @@ pub unsafe extern "C" fn tab_client_take_error(handle: *mut TabClientHandle) ->
 
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_get_socket_fd(handle: *mut TabClientHandle) -> c_int {
-	unsafe { handle.as_ref().map(|h| h.client.socket_fd()).unwrap_or(-1) }
+	unsafe { owner(handle).map(|h| h.client.socket_fd()).unwrap_or(-1) }
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_get_input_ring(
+	handle: *mut TabClientHandle,
+	ring: *mut TabInputRing,
+) -> bool {
+	unsafe {
+		let (Some(handle), Some(out)) = (owner(handle), ring.as_mut()) else {
+			return false;
+		};
+		let Some(input_ring) = handle.client.input_ring_mut() else {
+			return false;
+		};
+		let info = input_ring.info();
+		*out = TabInputRing {
+			memfd: input_ring.memfd().as_raw_fd(),
+			eventfd: input_ring.wakeup_fd().as_raw_fd(),
+			capacity: info.capacity,
+			slot_size: info.slot_size,
+		};
+		true
+	}
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_input_ring_next(
+	handle: *mut TabClientHandle,
+	event: *mut TabInputEvent,
+) -> bool {
+	unsafe {
+		let (Some(handle), false) = (owner(handle), event.is_null()) else {
+			return false;
+		};
+		let Some(input_ring) = handle.client.input_ring_mut() else {
+			return false;
+		};
+		match input_ring.pop() {
+			Ok(Some(payload)) => {
+				event.write(tab_input_from_payload(&payload));
+				true
+			}
+			Ok(None) => false,
+			Err(err) => {
+				handle.record_error(err);
+				false
+			}
+		}
+	}
 }
 
 #[unsafe(no_mangle)]
@@ -1254,12 +1835,12 @@ pub unsafe extern "C" fn tab_client_get_swap_fd(_handle: *mut TabClientHandle) -
 
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_drm_fd(handle: *mut TabClientHandle) -> c_int {
-	unsafe { handle.as_ref().map(|h| h.client.drm_fd()).unwrap_or(-1) }
+	unsafe { owner(handle).map(|h| h.client.drm_fd()).unwrap_or(-1) }
 }
 
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_get_monitor_count(handle: *mut TabClientHandle) -> usize {
-	unsafe { handle.as_ref().map(|h| h.monitor_order.len()).unwrap_or(0) }
+	unsafe { owner(handle).map(|h| h.monitor_order.len()).unwrap_or(0) }
 }
 
 #[unsafe(no_mangle)]
@@ -1268,7 +1849,7 @@ pub unsafe extern "C" fn tab_client_get_monitor_id(
 	index: usize,
 ) -> *mut c_char {
 	unsafe {
-		let handle = match handle.as_ref() {
+		let handle = match owner(handle) {
 			Some(h) => h,
 			None => return ptr::null_mut(),
 		};
@@ -1280,13 +1861,26 @@ pub unsafe extern "C" fn tab_client_get_monitor_id(
 	}
 }
 
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_get_monitor_handle(
+	handle: *mut TabClientHandle,
+	monitor_id: *const c_char,
+) -> u32 {
+	unsafe {
+		frames(handle)
+			.zip(cstr_ref(monitor_id))
+			.and_then(|(h, id)| h.monitor_handle(id))
+			.unwrap_or(TAB_INVALID_MONITOR_HANDLE)
+	}
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_get_monitor_info(
 	handle: *mut TabClientHandle,
 	monitor_id: *const c_char,
 ) -> TabMonitorInfo {
 	unsafe {
-		let handle = match handle.as_ref() {
+		let handle = match frames(handle) {
 			Some(h) => h,
 			None => {
 				return TabMonitorInfo {
@@ -1295,10 +1889,11 @@ pub unsafe extern "C" fn tab_client_get_monitor_info(
 					height: 0,
 					refresh_rate: 0,
 					name: ptr::null_mut(),
+					handle: TAB_INVALID_MONITOR_HANDLE,
 				};
 			}
 		};
-		let id = match cstring_to_string(monitor_id) {
+		let id = match cstr_ref(monitor_id) {
 			Some(id) => id,
 			None => {
 				return TabMonitorInfo {
@@ -1307,17 +1902,25 @@ pub unsafe extern "C" fn tab_client_get_monitor_info(
 					height: 0,
 					refresh_rate: 0,
 					name: ptr::null_mut(),
+					handle: TAB_INVALID_MONITOR_HANDLE,
 				};
 			}
 		};
-		match handle.monitors.get(&id) {
-			Some(entry) => monitor_info_to_c(&entry.state),
+		match handle
+			.monitor_handle(id)
+			.and_then(|monitor| handle.monitor(monitor))
+		{
+			Some(entry) => {
+				let entry = entry.lock().unwrap();
+				monitor_info_to_c(entry.handle, &entry.state)
+			}
 			None => TabMonitorInfo {
 				id: ptr::null_mut(),
 				width: 0,
 				height: 0,
 				refresh_rate: 0,
 				name: ptr::null_mut(),
+				handle: TAB_INVALID_MONITOR_HANDLE,
 			},
 		}
 	}
@@ -1343,10 +1946,11 @@ pub unsafe extern "C" fn tab_client_free_monitor_info(info: *mut TabMonitorInfo)
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_poll_events(handle: *mut TabClientHandle) -> usize {
 	unsafe {
-		let handle = match handle.as_mut() {
+		let handle = match owner(handle) {
 			Some(h) => h,
 			None => return 0,
 		};
+		handle.event_arena.reset();
 		match handle.client.dispatch_events() {
 			Ok(()) => (),
 			Err(err) => {
@@ -1358,13 +1962,180 @@ pub unsafe extern "C" fn tab_client_poll_events(handle: *mut TabClientHandle) ->
 	}
 }
 
+impl HandleOwner {
+	/// Applies the side effects of `evt` and returns its C representation, with strings, fences
+	/// and input batches placed by `strings`.
+	///
+	/// Returns `None` if the event could not be delivered; it is requeued in that case.
+	fn translate_event(&mut self, evt: PendingEvent, strings: &mut EventStrings) -> Option<TabEvent> {
+		match evt {
+			PendingEvent::BufferReleased(monitor_id, buffer, release_fence_fd) => {
+				let monitor_handle = self
+					.monitor_by_id(&monitor_id)
+					.map(|entry| {
+						let mut entry = entry.lock().unwrap();
+						entry.swapchain.mark_released(buffer);
+						entry.handle
+					})
+					.unwrap_or(TAB_INVALID_MONITOR_HANDLE);
+				Some(TabEvent {
+					event_type: TabEventType::TAB_EVENT_BUFFER_RELEASED,
+					data: TabEventData {
+						buffer_released: TabBufferRelease {
+							monitor_id: strings.string(&monitor_id),
+							buffer_index: buffer as u32,
+							release_fence_fd: strings.fence(release_fence_fd),
+							monitor_handle,
+						},
+					},
+				})
+			}
+			PendingEvent::BufferAcked(monitor_id, buffer) => Some(TabEvent {
+				event_type: TabEventType::TAB_EVENT_BUFFER_ACK,
+				data: TabEventData {
+					buffer_ack: TabBufferAck {
+						monitor_id: strings.string(&monitor_id),
+						buffer_index: buffer as u32,
+						monitor_handle: self
+							.frames
+							.monitor_handle(&monitor_id)
+							.unwrap_or(TAB_INVALID_MONITOR_HANDLE),
+					},
+				},
+			}),
+			PendingEvent::BufferRejected(monitor_id, buffer, code) => {
+				// Only an ownership violation means Shift still holds the buffer; for every
+				// other rejection it never left the client and can be acquired again.
+				let monitor_handle = self
+					.frames
+					.monitor_handle(&monitor_id)
+					.unwrap_or(TAB_INVALID_MONITOR_HANDLE);
+				if code != "ownership_violation"
+					&& let Some(entry) = self.frames.monitor(monitor_handle)
+				{
+					entry.lock().unwrap().swapchain.mark_released(buffer);
+				}
+				Some(TabEvent {
+					event_type: TabEventType::TAB_EVENT_BUFFER_REJECTED,
+					data: TabEventData {
+						buffer_rejected: TabBufferRejected {
+							monitor_id: strings.string(&monitor_id),
+							buffer_index: buffer as u32,
+							code: strings.string(&code),
+							monitor_handle,
+						},
+					},
+				})
+			}
+			PendingEvent::FramePresented {
+				monitor_id,
+				sequence,
+				vblank_ns,
+				refresh_ns,
+				missed,
+			} => Some(TabEvent {
+				event_type: TabEventType::TAB_EVENT_FRAME_PRESENTED,
+				data: TabEventData {
+					frame_presented: TabFramePresented {
+						monitor_handle: self
+							.frames
+							.monitor_handle(&monitor_id)
+							.unwrap_or(TAB_INVALID_MONITOR_HANDLE),
+						monitor_id: strings.string(&monitor_id),
+						sequence,
+						vblank_ns,
+						refresh_ns,
+						missed,
+					},
+				},
+			}),
+			PendingEvent::MonitorRemoved { monitor_id, name } => {
+				let monitor_handle = self
+					.remove_monitor(&monitor_id)
+					.unwrap_or(TAB_INVALID_MONITOR_HANDLE);
+				Some(TabEvent {
+					event_type: TabEventType::TAB_EVENT_MONITOR_REMOVED,
+					data: TabEventData {
+						monitor_removed: TabMonitorRemoved {
+							monitor_id: strings.string(&monitor_id),
+							name: strings.string(&name),
+							monitor_handle,
+						},
+					},
+				})
+			}
+			PendingEvent::MonitorAdded(state) => {
+				match self.insert_monitor(state.clone()) {
+					Ok(monitor_handle) => Some(TabEvent {
+						event_type: TabEventType::TAB_EVENT_MONITOR_ADDED,
+						data: TabEventData {
+							monitor_added: monitor_info_to_c_with(monitor_handle, &state, strings),
+						},
+					}),
+					Err(err) => {
+						self.record_error(err);
+						// requeue and signal failure
+						self
+							.events
+							.borrow_mut()
+							.push_front(PendingEvent::MonitorAdded(state));
+						None
+					}
+				}
+			}
+			PendingEvent::SessionAwake(session_id) => Some(TabEvent {
+				event_type: TabEventType::TAB_EVENT_SESSION_AWAKE,
+				data: TabEventData {
+					session_awake: strings.string(&session_id),
+				},
+			}),
+			PendingEvent::SessionActive(session_id) => Some(TabEvent {
+				event_type: TabEventType::TAB_EVENT_SESSION_ACTIVE,
+				data: TabEventData {
+					session_active: strings.string(&session_id),
+				},
+			}),
+			PendingEvent::SessionSleep(session_id) => Some(TabEvent {
+				event_type: TabEventType::TAB_EVENT_SESSION_SLEEP,
+				data: TabEventData {
+					session_sleep: strings.string(&session_id),
+				},
+			}),
+			PendingEvent::SessionState(session) => Some(TabEvent {
+				event_type: TabEventType::TAB_EVENT_SESSION_STATE,
+				data: TabEventData {
+					session_state: tab_session_info_to_c_with(&session, strings),
+				},
+			}),
+			PendingEvent::SessionCreated(token) => Some(TabEvent {
+				event_type: TabEventType::TAB_EVENT_SESSION_CREATED,
+				data: TabEventData {
+					session_created_token: strings.string(&token),
+				},
+			}),
+			PendingEvent::Input(input) => Some(TabEvent {
+				event_type: TabEventType::TAB_EVENT_INPUT,
+				data: TabEventData {
+					input: tab_input_from_payload(&input),
+				},
+			}),
+			PendingEvent::InputBatch(events) => Some(TabEvent {
+				event_type: TabEventType::TAB_EVENT_INPUT_BATCH,
+				data: TabEventData {
+					input_batch: strings.input_batch(&events),
+				},
+			}),
+		}
+	}
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_next_event(
 	handle: *mut TabClientHandle,
 	event: *mut TabEvent,
 ) -> bool {
 	unsafe {
-		let handle = match handle.as_mut() {
+		let handle = match owner(handle) {
 			Some(h) => h,
 			None => return false,
 		};
@@ -1375,74 +2146,49 @@ pub unsafe extern "C" fn tab_client_next_event(
 		let Some(evt) = pending else {
 			return false;
 		};
-		match evt {
-			PendingEvent::BufferReleased(monitor_id, buffer, release_fence_fd) => {
-				if let Some(entry) = handle.monitors.get_mut(&monitor_id) {
-					entry.swapchain.mark_released(buffer);
-				}
-				(*event).event_type = TabEventType::TAB_EVENT_BUFFER_RELEASED;
-				(*event).data.buffer_released = TabBufferRelease {
-					monitor_id: dup_string(&monitor_id),
-					buffer_index: buffer as u32,
-					release_fence_fd: release_fence_fd.unwrap_or(-1),
-				};
-				true
-			}
-			PendingEvent::MonitorRemoved { monitor_id, name } => {
-				handle.remove_monitor(&monitor_id);
-				(*event).event_type = TabEventType::TAB_EVENT_MONITOR_REMOVED;
-				(*event).data.monitor_removed = TabMonitorRemoved {
-					monitor_id: dup_string(&monitor_id),
-					name: dup_string(&name),
-				};
-				true
-			}
-			PendingEvent::MonitorAdded(state) => {
-				if let Err(err) = handle.insert_monitor(state.clone()) {
-					handle.record_error(err);
-					// requeue and signal failure
-					handle
-						.events
-						.borrow_mut()
-						.push_front(PendingEvent::MonitorAdded(state));
-					false
-				} else {
-					(*event).event_type = TabEventType::TAB_EVENT_MONITOR_ADDED;
-					(*event).data.monitor_added = monitor_info_to_c(&state);
-					true
-				}
-			}
-			PendingEvent::SessionAwake(session_id) => {
-				(*event).event_type = TabEventType::TAB_EVENT_SESSION_AWAKE;
-				(*event).data.session_awake = dup_string(&session_id);
-				true
-			}
-			PendingEvent::SessionActive(session_id) => {
-				(*event).event_type = TabEventType::TAB_EVENT_SESSION_ACTIVE;
-				(*event).data.session_active = dup_string(&session_id);
-				true
-			}
-			PendingEvent::SessionSleep(session_id) => {
-				(*event).event_type = TabEventType::TAB_EVENT_SESSION_SLEEP;
-				(*event).data.session_sleep = dup_string(&session_id);
-				true
-			}
-			PendingEvent::SessionState(session) => {
-				(*event).event_type = TabEventType::TAB_EVENT_SESSION_STATE;
-				(*event).data.session_state = tab_session_info_to_c(&session);
-				true
-			}
-			PendingEvent::SessionCreated(token) => {
-				(*event).event_type = TabEventType::TAB_EVENT_SESSION_CREATED;
-				(*event).data.session_created_token = dup_string(&token);
-				true
-			}
-			PendingEvent::Input(input) => {
-				(*event).event_type = TabEventType::TAB_EVENT_INPUT;
-				(*event).data.input = tab_input_from_payload(&input);
-				true
-			}
+		let Some(translated) = handle.translate_event(evt, &mut EventStrings::Owned) else {
+			return false;
+		};
+		event.write(translated);
+		true
+	}
+}
+
+/// Drains up to `capacity` queued events into `events` and returns how many were written.
+///
+/// Strings, input batches and release fences in the returned events are owned by the handle and stay
+/// valid until the next `tab_client_poll_events`; do not pass them to
+/// `tab_client_free_event_strings`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_next_events(
+	handle: *mut TabClientHandle,
+	events: *mut TabEvent,
+	capacity: usize,
+) -> usize {
+	unsafe {
+		let handle = match owner(handle) {
+			Some(h) => h,
+			None => return 0,
+		};
+		if events.is_null() || capacity == 0 {
+			return 0;
 		}
+		let mut arena = std::mem::take(&mut handle.event_arena);
+		let mut strings = EventStrings::Borrowed(&mut arena);
+		let mut written = 0;
+		while written < capacity {
+			let pending = handle.events.borrow_mut().pop_front();
+			let Some(evt) = pending else {
+				break;
+			};
+			let Some(translated) = handle.translate_event(evt, &mut strings) else {
+				break;
+			};
+			events.add(written).write(translated);
+			written += 1;
+		}
+		handle.event_arena = arena;
+		written
 	}
 }
 
@@ -1463,6 +2209,28 @@ pub unsafe extern "C" fn tab_client_free_event_strings(event: *mut TabEvent) {
 					(*event).data.buffer_released.release_fence_fd = -1;
 				}
 			}
+			TabEventType::TAB_EVENT_BUFFER_ACK => {
+				if !(*event).data.buffer_ack.monitor_id.is_null() {
+					drop(CString::from_raw((*event).data.buffer_ack.monitor_id));
+					(*event).data.buffer_ack.monitor_id = ptr::null_mut();
+				}
+			}
+			TabEventType::TAB_EVENT_BUFFER_REJECTED => {
+				if !(*event).data.buffer_rejected.monitor_id.is_null() {
+					drop(CString::from_raw((*event).data.buffer_rejected.monitor_id));
+					(*event).data.buffer_rejected.monitor_id = ptr::null_mut();
+				}
+				if !(*event).data.buffer_rejected.code.is_null() {
+					drop(CString::from_raw((*event).data.buffer_rejected.code));
+					(*event).data.buffer_rejected.code = ptr::null_mut();
+				}
+			}
+			TabEventType::TAB_EVENT_FRAME_PRESENTED => {
+				if !(*event).data.frame_presented.monitor_id.is_null() {
+					drop(CString::from_raw((*event).data.frame_presented.monitor_id));
+					(*event).data.frame_presented.monitor_id = ptr::null_mut();
+				}
+			}
 			TabEventType::TAB_EVENT_MONITOR_REMOVED => {
 				if !(*event).data.monitor_removed.monitor_id.is_null() {
 					drop(CString::from_raw((*event).data.monitor_removed.monitor_id));
@@ -1511,6 +2279,17 @@ pub unsafe extern "C" fn tab_client_free_event_strings(event: *mut TabEvent) {
 				let mut info = (*event).data.monitor_added;
 				tab_client_free_monitor_info(&mut info as *mut _);
 			}
+			TabEventType::TAB_EVENT_INPUT_BATCH => {
+				let batch = &mut (*event).data.input_batch;
+				if !batch.events.is_null() {
+					drop(Box::from_raw(ptr::slice_from_raw_parts_mut(
+						batch.events,
+						batch.count,
+					)));
+					batch.events = ptr::null_mut();
+					batch.count = 0;
+				}
+			}
 			_ => {}
 		}
 	}
@@ -1523,18 +2302,28 @@ pub unsafe extern "C" fn tab_client_acquire_frame(
 	target: *mut TabFrameTarget,
 ) -> TabAcquireResult {
 	unsafe {
-		let handle = match handle.as_mut() {
-			Some(h) => h,
-			None => return TabAcquireResult::TAB_ACQUIRE_ERROR,
+		let Some(h) = frames(handle) else {
+			return TabAcquireResult::TAB_ACQUIRE_ERROR;
 		};
-		let id = match cstring_to_string(monitor_id) {
-			Some(id) => id,
-			None => return TabAcquireResult::TAB_ACQUIRE_ERROR,
+		let Some(monitor) = cstr_ref(monitor_id).and_then(|id| h.monitor_handle(id)) else {
+			return TabAcquireResult::TAB_ACQUIRE_ERROR;
 		};
-		let entry = match handle.monitors.get_mut(&id) {
-			Some(entry) => entry,
-			None => return TabAcquireResult::TAB_ACQUIRE_ERROR,
+		tab_client_acquire_frame_h(handle, monitor, target)
+	}
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_acquire_frame_h(
+	handle: *mut TabClientHandle,
+	monitor: u32,
+	target: *mut TabFrameTarget,
+) -> TabAcquireResult {
+	unsafe {
+		let Some(entry) = frames(handle).and_then(|frames| frames.monitor(monitor)) else {
+			return TabAcquireResult::TAB_ACQUIRE_ERROR;
 		};
+		let mut entry = entry.lock().unwrap();
+		let entry = &mut *entry;
 		let Some((buffer, index)) = entry.swapchain.acquire_next() else {
 			return TabAcquireResult::TAB_ACQUIRE_NO_BUFFERS;
 		};
@@ -1548,11 +2337,24 @@ pub unsafe extern "C" fn tab_client_acquire_frame(
 		(*target).width = buffer.width();
 		(*target).height = buffer.height();
 		(*target).buffer_index = index as u32;
+		let layout = buffer.planes();
+		let mut planes = [TabDmabufPlane::default(); tab_protocol::MAX_DMABUF_PLANES];
+		for (dst, src) in planes.iter_mut().zip(&layout) {
+			*dst = TabDmabufPlane {
+				offset: src.offset,
+				stride: src.stride,
+			};
+		}
 		(*target).dmabuf = TabDmabuf {
 			fd,
 			stride: buffer.stride(),
 			offset: buffer.offset(),
 			fourcc: buffer.fourcc(),
+			modifier: buffer
+				.modifier()
+				.unwrap_or(tab_protocol::DRM_FORMAT_MOD_INVALID),
+			plane_count: layout.len() as u32,
+			planes,
 		};
 		TabAcquireResult::TAB_ACQUIRE_OK
 	}
@@ -1565,18 +2367,74 @@ pub unsafe extern "C" fn tab_client_request_buffer(
 	acquire_fence_fd: c_int,
 ) -> bool {
 	unsafe {
-		let handle = match handle.as_mut() {
-			Some(h) => h,
-			None => return false,
+		let Some(h) = frames(handle) else {
+			return false;
 		};
-		let id = match cstring_to_string(monitor_id) {
-			Some(id) => id,
-			None => return false,
+		let Some(monitor) = cstr_ref(monitor_id).and_then(|id| h.monitor_handle(id)) else {
+			return false;
 		};
-		let entry = match handle.monitors.get_mut(&id) {
-			Some(entry) => entry,
-			None => return false,
+		tab_client_request_buffer_h(handle, monitor, acquire_fence_fd)
+	}
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_request_buffer_damage(
+	handle: *mut TabClientHandle,
+	monitor_id: *const c_char,
+	acquire_fence_fd: c_int,
+	damage: *const TabDamageRect,
+	damage_count: usize,
+) -> bool {
+	unsafe {
+		let Some(h) = frames(handle) else {
+			return false;
 		};
+		let Some(monitor) = cstr_ref(monitor_id).and_then(|id| h.monitor_handle(id)) else {
+			return false;
+		};
+		tab_client_request_buffer_damage_h(handle, monitor, acquire_fence_fd, damage, damage_count)
+	}
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_request_buffer_h(
+	handle: *mut TabClientHandle,
+	monitor: u32,
+	acquire_fence_fd: c_int,
+) -> bool {
+	unsafe { tab_client_request_buffer_damage_h(handle, monitor, acquire_fence_fd, ptr::null(), 0) }
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_request_buffer_damage_h(
+	handle: *mut TabClientHandle,
+	monitor: u32,
+	acquire_fence_fd: c_int,
+	damage: *const TabDamageRect,
+	damage_count: usize,
+) -> bool {
+	unsafe {
+		let damage = if damage.is_null() || damage_count == 0 {
+			Vec::new()
+		} else {
+			std::slice::from_raw_parts(damage, damage_count)
+				.iter()
+				.map(|rect| DamageRect {
+					x: rect.x,
+					y: rect.y,
+					width: rect.width,
+					height: rect.height,
+				})
+				.collect()
+		};
+		let Some(frames) = frames(handle) else {
+			return false;
+		};
+		let Some(entry) = frames.monitor(monitor) else {
+			return false;
+		};
+		let mut entry = entry.lock().unwrap();
+		let entry = &mut *entry;
 		let buffer = match entry.pending.take() {
 			Some(idx) => idx,
 			None => return false,
@@ -1586,7 +2444,29 @@ pub unsafe extern "C" fn tab_client_request_buffer(
 		} else {
 			None
 		};
-		if let Err(err) = handle.client.request_buffer(&id, buffer, acquire_fence) {
+		let id = entry.state.info.id.as_str();
+		// Turning async requests off from the owner thread while this runs is harmless: the
+		// blocking path below checks the calling thread before touching owner state.
+		if frames.async_buffer_requests.load(Ordering::Relaxed) {
+			// The buffer is treated as Shift-owned until TAB_EVENT_BUFFER_ACK or
+			// TAB_EVENT_BUFFER_REJECTED says otherwise. The entry stays locked until it is
+			// marked busy, so a reply dispatched meanwhile on the owner thread waits for it.
+			if let Err(err) = frames.submitter.submit(id, buffer, acquire_fence, &damage) {
+				entry.swapchain.rollback();
+				frames.record_error(err);
+				return false;
+			}
+			entry.swapchain.mark_busy(buffer);
+			return true;
+		}
+		// Blocking requests read the reply off the socket, which only the owner thread may do.
+		let Some(handle) = owner(handle) else {
+			return false;
+		};
+		if let Err(err) = handle
+			.client
+			.request_buffer(id, buffer, acquire_fence, &damage)
+		{
 			let err_text = err.to_string();
 			let ownership_related = err_text.contains("ownership_violation")
 				|| err_text.contains("buffer_request_inflight")
@@ -1604,6 +2484,20 @@ pub unsafe extern "C" fn tab_client_request_buffer(
 	}
 }
 
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_set_async_buffer_requests(
+	handle: *mut TabClientHandle,
+	enabled: bool,
+) {
+	unsafe {
+		if let Some(frames) = frames(handle) {
+			frames
+				.async_buffer_requests
+				.store(enabled, Ordering::Relaxed);
+		}
+	}
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_get_server_name(_handle: *mut TabClientHandle) -> *mut c_char {
 	ptr::null_mut()
@@ -1619,7 +2513,7 @@ pub unsafe extern "C" fn tab_client_get_protocol_name(
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_get_session(handle: *mut TabClientHandle) -> TabSessionInfo {
 	unsafe {
-		let Some(handle) = handle.as_ref() else {
+		let Some(handle) = owner(handle) else {
 			return TabSessionInfo {
 				id: ptr::null_mut(),
 				role: TabSessionRole::TAB_SESSION_ROLE_SESSION,
@@ -1648,10 +2542,204 @@ pub unsafe extern "C" fn tab_client_free_session_info(info: *mut TabSessionInfo)
 	}
 }
 
+fn gpu_memory_usage_to_c(
+	usage: &[tab_protocol::GpuMemoryUsage],
+) -> (*mut TabGpuMemoryUsage, usize) {
+	if usage.is_empty() {
+		return (ptr::null_mut(), 0);
+	}
+	let entries = usage
+		.iter()
+		.map(|entry| TabGpuMemoryUsage {
+			id: dup_string(&entry.id),
+			bytes: entry.bytes,
+			client_bytes: entry.client_bytes,
+			evicted: entry.evicted,
+		})
+		.collect::<Box<[_]>>();
+	let count = entries.len();
+	(Box::into_raw(entries).cast(), count)
+}
+
+unsafe fn free_gpu_memory_usage(entries: *mut TabGpuMemoryUsage, count: usize) {
+	unsafe {
+		if entries.is_null() {
+			return;
+		}
+		let entries = Box::from_raw(ptr::slice_from_raw_parts_mut(entries, count));
+		for entry in entries.iter() {
+			if !entry.id.is_null() {
+				drop(CString::from_raw(entry.id));
+			}
+		}
+	}
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_get_gpu_memory(
+	handle: *mut TabClientHandle,
+	out: *mut TabGpuMemory,
+) -> bool {
+	unsafe {
+		let Some(handle) = owner(handle) else {
+			return false;
+		};
+		let Some(out) = out.as_mut() else {
+			return false;
+		};
+		let Some(report) = handle.client.gpu_memory() else {
+			return false;
+		};
+		let (sessions, session_count) = gpu_memory_usage_to_c(&report.sessions);
+		let (monitors, monitor_count) = gpu_memory_usage_to_c(&report.monitors);
+		*out = TabGpuMemory {
+			total_bytes: report.total_bytes,
+			budget_bytes: report.budget_bytes.unwrap_or(0),
+			skia_cache_bytes: report.skia_cache_bytes,
+			retired_import_bytes: report.retired_import_bytes,
+			client_import_bytes: report.client_import_bytes,
+			sessions,
+			session_count,
+			monitors,
+			monitor_count,
+		};
+		true
+	}
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_free_gpu_memory(memory: *mut TabGpuMemory) {
+	unsafe {
+		let Some(memory) = memory.as_mut() else {
+			return;
+		};
+		free_gpu_memory_usage(memory.sessions, memory.session_count);
+		free_gpu_memory_usage(memory.monitors, memory.monitor_count);
+		memory.sessions = ptr::null_mut();
+		memory.session_count = 0;
+		memory.monitors = ptr::null_mut();
+		memory.monitor_count = 0;
+	}
+}
+
+fn latency_histogram_to_c(histogram: &tab_protocol::LatencyHistogram) -> TabLatencyHistogram {
+	TabLatencyHistogram {
+		count: histogram.count,
+		sum_us: histogram.sum_us,
+		max_us: histogram.max_us,
+		buckets: histogram.buckets,
+	}
+}
+
+/// Leaks `entries` as a C array, null when empty.
+fn boxed_array_to_c<T>(entries: Box<[T]>) -> (*mut T, usize) {
+	if entries.is_empty() {
+		return (ptr::null_mut(), 0);
+	}
+	let count = entries.len();
+	(Box::into_raw(entries).cast(), count)
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_request_stats(handle: *mut TabClientHandle) -> bool {
+	unsafe {
+		let Some(handle) = owner(handle) else {
+			return false;
+		};
+		if let Err(err) = handle.client.request_stats() {
+			handle.record_error(err);
+			return false;
+		}
+		true
+	}
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_get_stats(
+	handle: *mut TabClientHandle,
+	out: *mut TabStats,
+) -> bool {
+	unsafe {
+		let Some(handle) = owner(handle) else {
+			return false;
+		};
+		let Some(out) = out.as_mut() else {
+			return false;
+		};
+		let Some(stats) = handle.client.stats() else {
+			return false;
+		};
+		let sessions = stats
+			.sessions
+			.iter()
+			.map(|session| {
+				let monitors = session
+					.monitors
+					.iter()
+					.map(|monitor| TabMonitorLatencyStats {
+						monitor_id: dup_string(&monitor.monitor_id),
+						acquire: latency_histogram_to_c(&monitor.acquire),
+						composite: latency_histogram_to_c(&monitor.composite),
+						present: latency_histogram_to_c(&monitor.present),
+						release: latency_histogram_to_c(&monitor.release),
+					})
+					.collect::<Box<[_]>>();
+				let (monitors, monitor_count) = boxed_array_to_c(monitors);
+				TabSessionLatencyStats {
+					session_id: dup_string(&session.session_id),
+					input: latency_histogram_to_c(&session.input),
+					monitors,
+					monitor_count,
+				}
+			})
+			.collect::<Box<[_]>>();
+		let (sessions, session_count) = boxed_array_to_c(sessions);
+		*out = TabStats {
+			sessions,
+			session_count,
+		};
+		true
+	}
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_free_stats(stats: *mut TabStats) {
+	unsafe {
+		let Some(stats) = stats.as_mut() else {
+			return;
+		};
+		if !stats.sessions.is_null() {
+			let sessions = Box::from_raw(ptr::slice_from_raw_parts_mut(
+				stats.sessions,
+				stats.session_count,
+			));
+			for session in sessions.iter() {
+				if !session.session_id.is_null() {
+					drop(CString::from_raw(session.session_id));
+				}
+				if session.monitors.is_null() {
+					continue;
+				}
+				let monitors = Box::from_raw(ptr::slice_from_raw_parts_mut(
+					session.monitors,
+					session.monitor_count,
+				));
+				for monitor in monitors.iter() {
+					if !monitor.monitor_id.is_null() {
+						drop(CString::from_raw(monitor.monitor_id));
+					}
+				}
+			}
+		}
+		stats.sessions = ptr::null_mut();
+		stats.session_count = 0;
+	}
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_send_ready(handle: *mut TabClientHandle) -> bool {
 	unsafe {
-		let Some(handle) = handle.as_mut() else {
+		let Some(handle) = owner(handle) else {
 			return false;
 		};
 		if let Err(err) = handle.client.send_ready() {
@@ -1662,6 +2750,28 @@ pub unsafe extern "C" fn tab_client_send_ready(handle: *mut TabClientHandle) ->
 	}
 }
 
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn tab_client_set_present_mode(
+	handle: *mut TabClientHandle,
+	mode: TabPresentMode,
+) -> bool {
+	unsafe {
+		let Some(handle) = owner(handle) else {
+			return false;
+		};
+		let mode = match mode {
+			TabPresentMode::TAB_PRESENT_MODE_VSYNC => tab_protocol::PresentMode::Vsync,
+			TabPresentMode::TAB_PRESENT_MODE_ADAPTIVE_SYNC => tab_protocol::PresentMode::AdaptiveSync,
+			TabPresentMode::TAB_PRESENT_MODE_ASYNC => tab_protocol::PresentMode::Async,
+		};
+		if let Err(err) = handle.client.set_present_mode(mode) {
+			handle.record_error(err);
+			return false;
+		}
+		true
+	}
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn tab_client_session_create(
 	handle: *mut TabClientHandle,
@@ -1669,7 +2779,7 @@ pub unsafe extern "C" fn tab_client_session_create(
 	display_name: *const c_char,
 ) -> bool {
 	unsafe {
-		let Some(handle) = handle.as_mut() else {
+		let Some(handle) = owner(handle) else {
 			return false;
 		};
 		let role = match role {
@@ -1693,7 +2803,7 @@ pub unsafe extern "C" fn tab_client_session_switch(
 	duration_ms: u32,
 ) -> bool {
 	unsafe {
-		let Some(handle) = handle.as_mut() else {
+		let Some(handle) = owner(handle) else {
 			return false;
 		};
 		let Some(session_id) = cstring_to_string(session_id) else {
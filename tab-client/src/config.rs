@@ -1,6 +1,6 @@
 use std::path::{Path, PathBuf};
 
-use tab_protocol::DEFAULT_SOCKET_PATH;
+use tab_protocol::{DEFAULT_SOCKET_PATH, MIN_SWAPCHAIN_BUFFERS};
 
 /// Builder-style configuration for establishing a Tab connection.
 #[derive(Debug, Clone)]
@@ -8,6 +8,11 @@ pub struct TabClientConfig {
 	socket_path: PathBuf,
 	token: String,
 	render_node: Option<PathBuf>,
+	swapchain_buffers: usize,
+	binary_encoding: bool,
+	input_ring: bool,
+	cross_gpu: bool,
+	preallocate_swapchains: bool,
 }
 
 impl TabClientConfig {
@@ -16,6 +21,11 @@ impl TabClientConfig {
 			socket_path: PathBuf::from(DEFAULT_SOCKET_PATH),
 			token: token.into(),
 			render_node: None,
+			swapchain_buffers: MIN_SWAPCHAIN_BUFFERS,
+			binary_encoding: true,
+			input_ring: false,
+			cross_gpu: false,
+			preallocate_swapchains: false,
 		}
 	}
 
@@ -29,6 +39,52 @@ impl TabClientConfig {
 		self
 	}
 
+	/// Number of buffers allocated per monitor swapchain.
+	///
+	/// Must be between [`tab_protocol::MIN_SWAPCHAIN_BUFFERS`] and
+	/// [`tab_protocol::MAX_SWAPCHAIN_BUFFERS`]; checked when connecting.
+	pub fn swapchain_buffers(mut self, count: usize) -> Self {
+		self.swapchain_buffers = count;
+		self
+	}
+
+	/// Request binary payloads for input and buffer messages when the server offers them.
+	///
+	/// Enabled by default; servers that don't advertise it keep using JSON.
+	pub fn binary_encoding(mut self, enabled: bool) -> Self {
+		self.binary_encoding = enabled;
+		self
+	}
+
+	/// Receive input events through a shared-memory ring instead of the socket.
+	///
+	/// Off by default. When Shift grants it, poll [`crate::TabClient::input_ring_fd`]
+	/// alongside the socket; [`crate::TabClient::dispatch_events`] drains the ring.
+	pub fn input_ring(mut self, enabled: bool) -> Self {
+		self.input_ring = enabled;
+		self
+	}
+
+	/// Render on a GPU other than the one Shift displays with.
+	///
+	/// Off by default, which allocates on Shift's render node. When enabled, buffers come from
+	/// the configured node (or the first other GPU) with a linear layout, so the display GPU
+	/// can import them and copy them to scanout while compositing.
+	pub fn cross_gpu(mut self, enabled: bool) -> Self {
+		self.cross_gpu = enabled;
+		self
+	}
+
+	/// Allocate and link a swapchain for every monitor while connecting.
+	///
+	/// Off by default. The links go out batched, together with the connect, and
+	/// [`crate::TabClient::create_swapchain`] hands the prepared swapchains out afterwards, so
+	/// the first frame can be rendered right after `auth_ok`.
+	pub fn preallocate_swapchains(mut self, enabled: bool) -> Self {
+		self.preallocate_swapchains = enabled;
+		self
+	}
+
 	pub fn token(&self) -> &str {
 		&self.token
 	}
@@ -40,4 +96,24 @@ impl TabClientConfig {
 	pub fn render_node_path(&self) -> Option<&Path> {
 		self.render_node.as_deref()
 	}
+
+	pub fn swapchain_buffer_count(&self) -> usize {
+		self.swapchain_buffers
+	}
+
+	pub fn binary_encoding_enabled(&self) -> bool {
+		self.binary_encoding
+	}
+
+	pub fn input_ring_enabled(&self) -> bool {
+		self.input_ring
+	}
+
+	pub fn cross_gpu_enabled(&self) -> bool {
+		self.cross_gpu || std::env::var("TAB_CLIENT_CROSS_GPU").is_ok_and(|v| v == "1")
+	}
+
+	pub fn preallocate_swapchains_enabled(&self) -> bool {
+		self.preallocate_swapchains
+	}
 }
@@ -26,6 +26,10 @@ pub enum TabClientError {
 	GbmInit(String),
 	#[error("monitor has invalid dimensions")]
 	InvalidMonitorDimensions,
+	#[error("unsupported swapchain depth {0} (expected {min}..={max} buffers)", min = tab_protocol::MIN_SWAPCHAIN_BUFFERS, max = tab_protocol::MAX_SWAPCHAIN_BUFFERS)]
+	InvalidSwapchainDepth(usize),
+	#[error("swapchain buffers for monitor {0} do not share one layout")]
+	MixedSwapchainLayout(String),
 	#[error("unknown monitor: {0}")]
 	UnknownMonitor(String),
 	#[error("failed to export dma-buf fd: {0}")]
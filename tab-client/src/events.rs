@@ -17,6 +17,27 @@ pub enum RenderEvent {
 		buffer: BufferIndex,
 		release_fence_fd: Option<RawFd>,
 	},
+	/// Shift accepted a request sent with [`crate::TabClient::submit_buffer`];
+	/// the buffer is now Shift-owned.
+	BufferAcked {
+		monitor_id: String,
+		buffer: BufferIndex,
+	},
+	/// Shift refused a request sent with [`crate::TabClient::submit_buffer`].
+	BufferRejected {
+		monitor_id: String,
+		buffer: BufferIndex,
+		code: String,
+	},
+	/// A frame containing this session's content was scanned out.
+	FramePresented {
+		monitor_id: String,
+		sequence: u64,
+		/// `CLOCK_MONOTONIC` nanoseconds of the vblank.
+		vblank_ns: u64,
+		refresh_ns: u64,
+		missed: bool,
+	},
 }
 
 #[derive(Debug, Clone)]
@@ -31,4 +52,6 @@ pub enum SessionEvent {
 #[derive(Debug, Clone)]
 pub enum InputEvent {
 	Event(InputEventPayload),
+	/// Everything Shift coalesced since this session's last frame, oldest first.
+	Batch(Vec<InputEventPayload>),
 }
@@ -1,11 +1,17 @@
 use std::{
 	fs::OpenOptions,
-	os::fd::{AsRawFd, RawFd},
+	os::{
+		fd::{AsRawFd, RawFd},
+		unix::fs::MetadataExt,
+	},
 	path::{Path, PathBuf},
 };
 
-use gbm::{BufferObjectFlags, Device, Format};
-use tab_protocol::BufferIndex;
+use gbm::{BufferObject, BufferObjectFlags, Device, Format, Modifier};
+use tab_protocol::{
+	BufferIndex, DRM_FORMAT_MOD_INVALID, DRM_FORMAT_MOD_LINEAR, MAX_SWAPCHAIN_BUFFERS,
+	MIN_SWAPCHAIN_BUFFERS, RenderNodeInfo,
+};
 
 use crate::{
 	error::TabClientError,
@@ -48,16 +54,36 @@ pub struct GbmAllocator {
 	format: Format,
 	preferred_usage: BufferObjectFlags,
 	fallback_usage: BufferObjectFlags,
+	/// Buffers are shared with another GPU and must stay linear.
+	cross_gpu: bool,
+}
+
+/// A DRM node to try opening.
+struct Candidate {
+	path: PathBuf,
+	/// Whether the node has to show it can allocate before it is picked. Shift's own node is
+	/// known to work and taken as is.
+	probe: bool,
 }
 
 impl GbmAllocator {
-	pub fn new(configured_node: Option<&Path>) -> Result<Self, TabClientError> {
+	/// Opens the GBM device to allocate on. By default that is `display_node`, the node Shift
+	/// advertised; with `cross_gpu` it is any other GPU.
+	pub fn new(
+		configured_node: Option<&Path>,
+		display_node: Option<&RenderNodeInfo>,
+		cross_gpu: bool,
+	) -> Result<Self, TabClientError> {
 		let mut last_error = None;
-		for candidate in Self::render_node_candidates(configured_node) {
+		for Candidate {
+			path: candidate,
+			probe,
+		} in Self::render_node_candidates(configured_node, display_node, cross_gpu)
+		{
 			match OpenOptions::new().read(true).write(true).open(&candidate) {
 				Ok(file) => match Device::new(file) {
 					Ok(device) => {
-						if let Err(source) = probe_buffer_allocation(&device) {
+						if probe && let Err(source) = probe_buffer_allocation(&device) {
 							tracing::warn!(
 								path = %candidate.display(),
 								backend = device.backend_name(),
@@ -73,13 +99,21 @@ impl GbmAllocator {
 						tracing::info!(
 							path = %candidate.display(),
 							backend = device.backend_name(),
+							cross_gpu,
+							probed = probe,
 							"selected GBM device"
 						);
+						let usage = if cross_gpu {
+							BufferObjectFlags::RENDERING | BufferObjectFlags::LINEAR
+						} else {
+							BufferObjectFlags::RENDERING
+						};
 						return Ok(Self {
 							device,
 							format: Format::Xrgb8888,
-							preferred_usage: BufferObjectFlags::RENDERING,
-							fallback_usage: BufferObjectFlags::RENDERING,
+							preferred_usage: usage,
+							fallback_usage: usage,
+							cross_gpu,
 						});
 					}
 					Err(err) => {
@@ -103,20 +137,95 @@ impl GbmAllocator {
 		self.device.as_raw_fd()
 	}
 
-	pub fn create_swapchain(&self, monitor: &MonitorState) -> Result<TabSwapchain, TabClientError> {
+	pub fn create_swapchain(
+		&self,
+		monitor: &MonitorState,
+		buffer_count: usize,
+	) -> Result<TabSwapchain, TabClientError> {
 		let width =
 			u32::try_from(monitor.info.width).map_err(|_| TabClientError::InvalidMonitorDimensions)?;
 		let height =
 			u32::try_from(monitor.info.height).map_err(|_| TabClientError::InvalidMonitorDimensions)?;
-		let bo0 = self
+		if !(MIN_SWAPCHAIN_BUFFERS..=MAX_SWAPCHAIN_BUFFERS).contains(&buffer_count) {
+			return Err(TabClientError::InvalidSwapchainDepth(buffer_count));
+		}
+		let modifiers = monitor
+			.info
+			.formats
+			.iter()
+			.find(|entry| entry.fourcc == self.format as u32)
+			.map(|entry| {
+				entry
+					.modifiers
+					.iter()
+					.copied()
+					.filter(|modifier| *modifier != DRM_FORMAT_MOD_INVALID)
+					// Tiled layouts don't carry across GPUs.
+					.filter(|modifier| !self.cross_gpu || *modifier == DRM_FORMAT_MOD_LINEAR)
+					.collect::<Vec<_>>()
+			})
+			.unwrap_or_default();
+		let indices = BufferIndex::ALL.into_iter().take(buffer_count);
+		// One link describes every buffer, so they all take the negotiated modifiers or all fall
+		// back to the implicit layout. Any buffer failing or landing on a different layout
+		// reallocates the whole swapchain implicitly.
+		let explicit = indices
+			.clone()
+			.map(|index| {
+				let bo = self.create_with_modifiers(width, height, &modifiers)?;
+				Some(TabBuffer::new(index, bo, true))
+			})
+			.collect::<Option<Vec<_>>>()
+			.filter(|buffers| {
+				let same = buffers.windows(2).all(|pair| pair[0].same_layout(&pair[1]));
+				if !same {
+					tracing::debug!("modifier-aware buffers disagree on their layout, using implicit layout");
+				}
+				same
+			});
+		let buffers = match explicit {
+			Some(buffers) => buffers,
+			None => indices
+				.map(|index| {
+					Ok(TabBuffer::new(
+						index,
+						self.create_implicit(width, height)?,
+						false,
+					))
+				})
+				.collect::<Result<Vec<_>, TabClientError>>()?,
+		};
+		Ok(TabSwapchain::new(monitor.info.id.clone(), buffers))
+	}
+
+	/// Lets GBM pick the best layout Shift can import. `None` if Shift advertised no
+	/// modifiers for the format or the driver can't satisfy any of them.
+	fn create_with_modifiers(
+		&self,
+		width: u32,
+		height: u32,
+		modifiers: &[u64],
+	) -> Option<BufferObject<()>> {
+		if modifiers.is_empty() {
+			return None;
+		}
+		self
 			.device
-			.create_buffer_object::<()>(width, height, self.format, self.preferred_usage)
-			.or_else(|_| {
-				self
-					.device
-					.create_buffer_object::<()>(width, height, self.format, self.fallback_usage)
-			})?;
-		let bo1 = self
+			.create_buffer_object_with_modifiers2::<()>(
+				width,
+				height,
+				self.format,
+				modifiers.iter().copied().map(Modifier::from),
+				self.preferred_usage,
+			)
+			.inspect_err(
+				|err| tracing::debug!(%err, "modifier-aware allocation failed, using implicit layout"),
+			)
+			.ok()
+	}
+
+	fn create_implicit(&self, width: u32, height: u32) -> Result<BufferObject<()>, TabClientError> {
+		let bo = self
 			.device
 			.create_buffer_object::<()>(width, height, self.format, self.preferred_usage)
 			.or_else(|_| {
@@ -124,28 +233,65 @@ impl GbmAllocator {
 					.device
 					.create_buffer_object::<()>(width, height, self.format, self.fallback_usage)
 			})?;
-		let buffers = [
-			TabBuffer::new(BufferIndex::Zero, bo0),
-			TabBuffer::new(BufferIndex::One, bo1),
-		];
-		Ok(TabSwapchain::new(monitor.info.id.clone(), buffers))
+		Ok(bo)
 	}
 
-	fn render_node_candidates(configured: Option<&Path>) -> Vec<PathBuf> {
+	fn render_node_candidates(
+		configured: Option<&Path>,
+		display_node: Option<&RenderNodeInfo>,
+		cross_gpu: bool,
+	) -> Vec<Candidate> {
+		let probed = |path: PathBuf| Candidate { path, probe: true };
 		if let Some(path) = configured {
-			vec![path.to_path_buf()]
-		} else if let Ok(env) = std::env::var("TAB_CLIENT_RENDER_NODE") {
-			vec![PathBuf::from(env)]
-		} else {
-			DEFAULT_RENDER_NODES
-				.iter()
-				.chain(DEFAULT_PRIMARY_NODES.iter())
-				.map(|p| PathBuf::from(p))
-				.collect()
+			return vec![probed(path.to_path_buf())];
+		}
+		if let Ok(env) = std::env::var("TAB_CLIENT_RENDER_NODE") {
+			return vec![probed(PathBuf::from(env))];
+		}
+		let defaults = DEFAULT_RENDER_NODES
+			.iter()
+			.chain(DEFAULT_PRIMARY_NODES.iter())
+			.map(PathBuf::from);
+		let Some(display_node) = display_node else {
+			return defaults.map(probed).collect();
+		};
+		if cross_gpu {
+			return defaults
+				.filter(|path| node_dev(path).is_some_and(|dev| dev != display_node.dev))
+				.map(probed)
+				.collect();
 		}
+		// The advertised path, or else whatever node has the same device number in this mount
+		// namespace. Only if neither opens, anything that allocates.
+		let advertised = PathBuf::from(&display_node.path);
+		let same_gpu = if node_dev(&advertised) == Some(display_node.dev) {
+			Some(advertised)
+		} else {
+			defaults
+				.clone()
+				.find(|path| node_dev(path) == Some(display_node.dev))
+		};
+		let mut candidates = same_gpu
+			.iter()
+			.map(|path| Candidate {
+				path: path.clone(),
+				probe: false,
+			})
+			.collect::<Vec<_>>();
+		candidates.extend(
+			defaults
+				.filter(|path| same_gpu.as_ref() != Some(path))
+				.map(probed),
+		);
+		candidates
 	}
 }
 
+/// Device number of the DRM node at `path`.
+fn node_dev(path: &Path) -> Option<u64> {
+	std::fs::metadata(path).ok().map(|meta| meta.rdev())
+}
+
 fn probe_buffer_allocation(device: &Device<std::fs::File>) -> std::io::Result<()> {
 	let probe =
 		device.create_buffer_object::<()>(64, 64, Format::Xrgb8888, BufferObjectFlags::RENDERING)?;
@@ -8,6 +8,8 @@ mod gbm_allocator;
 mod monitor;
 mod swapchain;
 
+#[doc(hidden)]
+pub use c_bindings::bench_support;
 pub use config::TabClientConfig;
 pub use error::TabClientError;
 pub use events::{InputEvent, MonitorEvent, RenderEvent, SessionEvent};
@@ -15,24 +17,89 @@ pub use monitor::{MonitorId, MonitorState};
 pub use swapchain::{TabBuffer, TabSwapchain};
 
 use std::collections::HashMap;
+use std::fmt::Write as _;
 use std::os::{
 	fd::{AsFd, AsRawFd, IntoRawFd, OwnedFd, RawFd},
 	unix::net::UnixStream,
 };
 use std::time::{Duration, Instant};
 
+use tab_protocol::input_ring::InputRing;
 use tab_protocol::message_frame::{TabMessageFrame, TabMessageFrameReader};
 use tab_protocol::message_header;
 use tab_protocol::{
 	AuthErrorPayload, AuthOkPayload, AuthPayload, BufferIndex, BufferReleasePayload,
-	BufferRequestAckPayload, InputEventPayload, MonitorInfo, SessionActivePayload,
-	SessionAwakePayload, SessionCreatePayload, SessionCreatedPayload, SessionInfo,
-	SessionReadyPayload, SessionRole, SessionSleepPayload, SessionStatePayload, SessionSwitchPayload,
-	TabMessage,
+	BufferRequestAckPayload, BufferRequestRejectedPayload, DamageRect, FramePresentedPayload,
+	FramebufferLinkBatchEntry, FramebufferLinkBatchPayload, GpuMemoryPayload, InputBatchPayload,
+	InputCaughtUpPayload, InputEventPayload, MonitorInfo, PayloadEncoding, PresentMode,
+	PresentModePayload, SessionActivePayload, SessionAwakePayload, SessionCreatePayload,
+	SessionCreatedPayload, SessionInfo, SessionReadyPayload, SessionRole, SessionSleepPayload,
+	SessionStatePayload, SessionSwitchPayload, StatsPayload, TabMessage,
 };
 
 use crate::gbm_allocator::GbmAllocator;
 
+/// Sends `buffer_request`s on a client's connection from any thread.
+///
+/// Every request is one small `sendmsg` that the kernel queues whole, so submitters can run
+/// next to each other and next to the [`TabClient`] they came from. Replies still arrive
+/// through that client's [`TabClient::dispatch_events`].
+#[derive(Debug)]
+pub struct BufferSubmitter {
+	socket: UnixStream,
+	encoding: PayloadEncoding,
+}
+
+impl BufferSubmitter {
+	/// Same as [`TabClient::submit_buffer`].
+	pub fn submit(
+		&self,
+		monitor_id: &str,
+		buffer: BufferIndex,
+		acquire_fence: Option<RawFd>,
+		damage: &[DamageRect],
+	) -> Result<(), TabClientError> {
+		buffer_request_frame(self.encoding, monitor_id, buffer, acquire_fence, damage)?
+			.encode_and_send(&self.socket)?;
+		Ok(())
+	}
+}
+
+fn buffer_request_frame(
+	encoding: PayloadEncoding,
+	monitor_id: &str,
+	buffer: BufferIndex,
+	acquire_fence: Option<RawFd>,
+	damage: &[DamageRect],
+) -> Result<TabMessageFrame, tab_protocol::ProtocolError> {
+	// Shift rejects the whole request over one malformed rect, so those are dropped here; with
+	// nothing valid left the request falls back to full damage.
+	let damage = damage
+		.iter()
+		.filter_map(|rect| rect.validate().ok())
+		.collect::<Vec<_>>();
+	let damage = DamageRect::clamp_count(&damage);
+	let mut frame = match encoding {
+		PayloadEncoding::Binary => TabMessageFrame::binary(
+			message_header::BUFFER_REQUEST,
+			tab_protocol::binary::encode_buffer_request_payload(monitor_id, buffer, &damage)?,
+		),
+		PayloadEncoding::Json => {
+			let mut args = format!("{monitor_id} {}", buffer as u8);
+			for rect in &damage {
+				let _ = write!(
+					args,
+					" {},{},{},{}",
+					rect.x, rect.y, rect.width, rect.height
+				);
+			}
+			TabMessageFrame::raw(message_header::BUFFER_REQUEST, args)
+		}
+	};
+	frame.fds = acquire_fence.map_or_else(Vec::new, |fd| vec![fd]);
+	Ok(frame)
+}
+
 /// Primary synchronous Tab client handle.
 pub struct TabClient {
 	socket: UnixStream,
@@ -43,7 +110,21 @@ pub struct TabClient {
 	render_listeners: Vec<Box<dyn Fn(&RenderEvent)>>,
 	session_listeners: Vec<Box<dyn Fn(&SessionEvent)>>,
 	input_listeners: Vec<Box<dyn Fn(&InputEvent)>>,
+	input_sink: Option<Box<dyn FnMut(InputEvent)>>,
 	gbm: GbmAllocator,
+	swapchain_buffers: usize,
+	/// Swapchains linked while connecting, until [`Self::create_swapchain`] hands them out.
+	preallocated: HashMap<MonitorId, TabSwapchain>,
+	/// The server accepts `framebuffer_link_batch`.
+	link_batch: bool,
+	encoding: PayloadEncoding,
+	input_ring: Option<InputRing>,
+	/// Input events received as frames, and how many of them Shift was told about with
+	/// `input_caught_up`.
+	socket_input_events: u64,
+	acked_socket_input_events: u64,
+	gpu_memory: Option<GpuMemoryPayload>,
+	stats: Option<StatsPayload>,
 }
 
 impl TabClient {
@@ -51,6 +132,12 @@ impl TabClient {
 	const SESSION_CREATE_TIMEOUT: Duration = Duration::from_millis(500);
 
 	pub fn connect(config: TabClientConfig) -> Result<Self, TabClientError> {
+		let swapchain_buffers = config.swapchain_buffer_count();
+		if !(tab_protocol::MIN_SWAPCHAIN_BUFFERS..=tab_protocol::MAX_SWAPCHAIN_BUFFERS)
+			.contains(&swapchain_buffers)
+		{
+			return Err(TabClientError::InvalidSwapchainDepth(swapchain_buffers));
+		}
 		let socket = tab_protocol::unix_socket_utils::connect_seqpacket(config.socket_path_ref())?;
 		let mut reader = TabMessageFrameReader::new();
 		let hello = Self::read_message(&socket, &mut reader)?;
@@ -60,22 +147,52 @@ impl TabClient {
 		if payload.protocol != tab_protocol::PROTOCOL_VERSION {
 			return Err(TabClientError::Unexpected("protocol mismatch"));
 		}
+		let encoding =
+			if config.binary_encoding_enabled() && payload.encodings.contains(&PayloadEncoding::Binary) {
+				PayloadEncoding::Binary
+			} else {
+				PayloadEncoding::Json
+			};
 		let auth_frame = TabMessageFrame::json(
 			message_header::AUTH,
 			AuthPayload {
 				token: config.token().to_string(),
+				encoding,
+				input_ring: config.input_ring_enabled(),
+				input_batch: true,
 			},
 		);
 		auth_frame.encode_and_send(&socket)?;
-		let auth_ok = Self::wait_for_auth(&socket, &mut reader)?;
+		// Opening the GPU is the slow part of connecting; when `hello` already named Shift's
+		// node, do it while Shift checks the token.
+		let early_gbm = payload.render_node.as_ref().map(|node| {
+			GbmAllocator::new(
+				config.render_node_path(),
+				Some(node),
+				config.cross_gpu_enabled(),
+			)
+		});
+		let (auth_ok, input_ring_fds) = Self::wait_for_auth(&socket, &mut reader)?;
+		let encoding = auth_ok.encoding;
+		let input_ring = match (auth_ok.input_ring, input_ring_fds) {
+			(Some(info), Some((memfd, wakeup))) => Some(InputRing::from_fds(memfd, wakeup, info)?),
+			_ => None,
+		};
 		let monitors = auth_ok
 			.monitors
 			.into_iter()
 			.map(|info| (info.id.clone(), MonitorState::new(info)))
 			.collect();
-		let gbm = GbmAllocator::new(config.render_node_path())?;
+		let gbm = match early_gbm {
+			Some(gbm) => gbm?,
+			None => GbmAllocator::new(
+				config.render_node_path(),
+				auth_ok.render_node.as_ref(),
+				config.cross_gpu_enabled(),
+			)?,
+		};
 		socket.set_nonblocking(true)?;
-		Ok(Self {
+		let mut client = Self {
 			socket,
 			reader,
 			session: auth_ok.session,
@@ -84,8 +201,27 @@ impl TabClient {
 			render_listeners: Vec::new(),
 			session_listeners: Vec::new(),
 			input_listeners: Vec::new(),
+			input_sink: None,
 			gbm,
-		})
+			swapchain_buffers,
+			preallocated: HashMap::new(),
+			link_batch: payload.framebuffer_link_batch,
+			encoding,
+			input_ring,
+			socket_input_events: 0,
+			acked_socket_input_events: 0,
+			gpu_memory: None,
+			stats: None,
+		};
+		if config.preallocate_swapchains_enabled() {
+			let monitor_ids = client.monitors.keys().cloned().collect::<Vec<_>>();
+			client.preallocated = client
+				.create_swapchains(&monitor_ids)?
+				.into_iter()
+				.map(|swapchain| (swapchain.monitor_id.clone(), swapchain))
+				.collect();
+		}
+		Ok(client)
 	}
 
 	pub fn session(&self) -> &SessionInfo {
@@ -100,6 +236,24 @@ impl TabClient {
 		self.monitors.get(id)
 	}
 
+	/// Latest GPU memory report from Shift. Only admin sessions receive them; updated by
+	/// [`Self::dispatch_events`].
+	pub fn gpu_memory(&self) -> Option<&GpuMemoryPayload> {
+		self.gpu_memory.as_ref()
+	}
+
+	/// Latest reply to [`Self::request_stats`], updated by [`Self::dispatch_events`].
+	pub fn stats(&self) -> Option<&StatsPayload> {
+		self.stats.as_ref()
+	}
+
+	/// Asks Shift for its latency histograms. Admin sessions only; the reply shows up in
+	/// [`Self::stats`].
+	pub fn request_stats(&self) -> Result<(), TabClientError> {
+		TabMessageFrame::no_payload(message_header::STATS_REQUEST).encode_and_send(&self.socket)?;
+		Ok(())
+	}
+
 	pub fn socket_fd(&self) -> RawFd {
 		self.socket.as_raw_fd()
 	}
@@ -112,42 +266,140 @@ impl TabClient {
 		self.gbm.drm_fd()
 	}
 
-	pub fn create_swapchain(&self, monitor_id: &str) -> Result<TabSwapchain, TabClientError> {
+	/// Eventfd to poll next to [`TabClient::socket_fd`] when an input ring was granted.
+	pub fn input_ring_fd(&self) -> Option<RawFd> {
+		self
+			.input_ring
+			.as_ref()
+			.map(|ring| ring.wakeup_fd().as_raw_fd())
+	}
+
+	/// Shared-memory input ring, if Shift granted one at `auth_ok`.
+	pub fn input_ring_mut(&mut self) -> Option<&mut InputRing> {
+		self.input_ring.as_mut()
+	}
+
+	/// Payload encoding negotiated for input and buffer messages.
+	pub fn encoding(&self) -> PayloadEncoding {
+		self.encoding
+	}
+
+	/// Number of buffers allocated for each monitor swapchain.
+	pub fn swapchain_buffers(&self) -> usize {
+		self.swapchain_buffers
+	}
+
+	/// Allocates and links a swapchain for `monitor_id`, or hands out the one linked while
+	/// connecting (see [`TabClientConfig::preallocate_swapchains`]).
+	pub fn create_swapchain(&mut self, monitor_id: &str) -> Result<TabSwapchain, TabClientError> {
+		if let Some(swapchain) = self.preallocated.remove(monitor_id) {
+			return Ok(swapchain);
+		}
+		let swapchain = self.allocate_swapchain(monitor_id)?;
+		self.framebuffer_link(&swapchain)?;
+		Ok(swapchain)
+	}
+
+	/// Allocates swapchains for all of `monitor_ids` and links them with as few frames as
+	/// the server allows.
+	pub fn create_swapchains(
+		&self,
+		monitor_ids: &[MonitorId],
+	) -> Result<Vec<TabSwapchain>, TabClientError> {
+		let swapchains = monitor_ids
+			.iter()
+			.map(|monitor_id| self.allocate_swapchain(monitor_id))
+			.collect::<Result<Vec<_>, _>>()?;
+		self.framebuffer_link_batch(&swapchains)?;
+		Ok(swapchains)
+	}
+
+	fn allocate_swapchain(&self, monitor_id: &str) -> Result<TabSwapchain, TabClientError> {
 		let monitor = self
 			.monitors
 			.get(monitor_id)
 			.ok_or_else(|| TabClientError::UnknownMonitor(monitor_id.to_string()))?;
-		let swapchain = self.gbm.create_swapchain(monitor)?;
-		self.framebuffer_link(&swapchain)?;
-		Ok(swapchain)
+		self.gbm.create_swapchain(monitor, self.swapchain_buffers)
 	}
 
 	pub fn framebuffer_link(&self, swapchain: &TabSwapchain) -> Result<(), TabClientError> {
-		let payload = swapchain.framebuffer_link_payload();
+		let payload = swapchain.framebuffer_link_payload()?;
 		let mut frame = TabMessageFrame::json(message_header::FRAMEBUFFER_LINK, payload);
-		let fds = swapchain.export_fds();
-		frame.fds = Vec::from(fds);
+		frame.fds = swapchain.export_fds();
 		frame.encode_and_send(&self.socket)?;
 		Ok(())
 	}
 
+	/// Links several swapchains at once with `framebuffer_link_batch`, falling back to a
+	/// `framebuffer_link` each on servers that predate it.
+	pub fn framebuffer_link_batch(&self, swapchains: &[TabSwapchain]) -> Result<(), TabClientError> {
+		if !self.link_batch {
+			return swapchains
+				.iter()
+				.try_for_each(|swapchain| self.framebuffer_link(swapchain));
+		}
+		let per_frame = tab_protocol::MAX_FRAME_FDS / tab_protocol::MAX_SWAPCHAIN_BUFFERS;
+		for chunk in swapchains.chunks(per_frame) {
+			let links = chunk
+				.iter()
+				.map(|swapchain| {
+					Ok(FramebufferLinkBatchEntry {
+						link: swapchain.framebuffer_link_payload()?,
+						buffers: swapchain.buffer_count() as u32,
+					})
+				})
+				.collect::<Result<_, TabClientError>>()?;
+			let mut frame = TabMessageFrame::json(
+				message_header::FRAMEBUFFER_LINK_BATCH,
+				FramebufferLinkBatchPayload { links },
+			);
+			frame.fds = chunk.iter().flat_map(TabSwapchain::export_fds).collect();
+			frame.encode_and_send(&self.socket)?;
+		}
+		Ok(())
+	}
+
+	/// Sends `buffer_request` and blocks until Shift acks or rejects it.
+	///
+	/// `damage` lists the regions that changed since the previous request on this monitor;
+	/// an empty slice means the whole buffer changed.
 	pub fn request_buffer(
 		&mut self,
 		monitor_id: &str,
 		buffer: BufferIndex,
 		acquire_fence: Option<RawFd>,
+		damage: &[DamageRect],
 	) -> Result<(), TabClientError> {
-		let payload = format!("{monitor_id} {}", buffer as u8);
-		let frame = TabMessageFrame {
-			header: message_header::BUFFER_REQUEST.into(),
-			payload: Some(payload),
-			fds: acquire_fence.map_or_else(Vec::new, |fd| vec![fd]),
-		};
-		frame.encode_and_send(&self.socket)?;
+		self.submit_buffer(monitor_id, buffer, acquire_fence, damage)?;
 		self.wait_for_buffer_request_ack(monitor_id, buffer)?;
 		Ok(())
 	}
 
+	/// Sends `buffer_request` without waiting for the reply.
+	///
+	/// The outcome is delivered to render listeners as
+	/// [`RenderEvent::BufferAcked`] or [`RenderEvent::BufferRejected`] from
+	/// [`TabClient::dispatch_events`].
+	pub fn submit_buffer(
+		&self,
+		monitor_id: &str,
+		buffer: BufferIndex,
+		acquire_fence: Option<RawFd>,
+		damage: &[DamageRect],
+	) -> Result<(), TabClientError> {
+		buffer_request_frame(self.encoding, monitor_id, buffer, acquire_fence, damage)?
+			.encode_and_send(&self.socket)?;
+		Ok(())
+	}
+
+	/// A handle for [`TabClient::submit_buffer`] that can be moved to other threads.
+	pub fn buffer_submitter(&self) -> Result<BufferSubmitter, TabClientError> {
+		Ok(BufferSubmitter {
+			socket: self.socket.try_clone()?,
+			encoding: self.encoding,
+		})
+	}
+
 	pub fn send_ready(&self) -> Result<(), TabClientError> {
 		let payload = SessionReadyPayload {
 			session_id: self.session.id.clone(),
@@ -181,6 +433,15 @@ impl TabClient {
 		Ok(())
 	}
 
+	/// Asks Shift to present this session's frames with `mode`. It only applies while the
+	/// session is active and covers a monitor; anything else is shown with vsync. Shift does
+	/// not apply VRR or tearing flips yet, see [`PresentMode`].
+	pub fn set_present_mode(&self, mode: PresentMode) -> Result<(), TabClientError> {
+		let payload = PresentModePayload { mode };
+		TabMessageFrame::json(message_header::PRESENT_MODE, payload).encode_and_send(&self.socket)?;
+		Ok(())
+	}
+
 	pub fn on_monitor_event<F>(&mut self, listener: F)
 	where
 		F: Fn(&MonitorEvent) + 'static,
@@ -209,17 +470,61 @@ impl TabClient {
 		self.input_listeners.push(Box::new(listener));
 	}
 
+	/// Like [`Self::on_input_event`], but `sink` takes each event by value, so it can keep
+	/// batches without copying them. Runs after the other input listeners; replaces any
+	/// previous sink.
+	pub fn set_input_sink<F>(&mut self, sink: F)
+	where
+		F: FnMut(InputEvent) + 'static,
+	{
+		self.input_sink = Some(Box::new(sink));
+	}
+
 	pub fn dispatch_events(&mut self) -> Result<(), TabClientError> {
+		self.drain_input_ring()?;
 		loop {
-			match self.reader.read_framed(&self.socket) {
-				Ok(frame) => {
-					let message = TabMessage::try_from(frame)?;
+			match self.reader.read_message(&self.socket) {
+				Ok(message) => {
 					self.handle_message(message)?;
 				}
 				Err(tab_protocol::ProtocolError::WouldBlock) => break,
 				Err(other) => return Err(other.into()),
 			}
 		}
+		self.ack_socket_input()
+	}
+
+	/// Tells Shift the socket holds no more unread input, so it can go back to the ring.
+	fn ack_socket_input(&mut self) -> Result<(), TabClientError> {
+		if self.input_ring.is_none() || self.socket_input_events == self.acked_socket_input_events {
+			return Ok(());
+		}
+		TabMessageFrame::json(
+			message_header::INPUT_CAUGHT_UP,
+			InputCaughtUpPayload {
+				socket_events: self.socket_input_events,
+			},
+		)
+		.encode_and_send(&self.socket)?;
+		self.acked_socket_input_events = self.socket_input_events;
+		Ok(())
+	}
+
+	/// Delivers everything queued in the input ring to the input listeners.
+	fn drain_input_ring(&mut self) -> Result<(), TabClientError> {
+		let Some(ring) = self.input_ring.as_ref() else {
+			return Ok(());
+		};
+		ring.clear_wakeup();
+		while let Some(event) = self
+			.input_ring
+			.as_mut()
+			.map(InputRing::pop)
+			.transpose()?
+			.flatten()
+		{
+			self.handle_input_event(event);
+		}
 		Ok(())
 	}
 
@@ -227,17 +532,19 @@ impl TabClient {
 		socket: &UnixStream,
 		reader: &mut TabMessageFrameReader,
 	) -> Result<TabMessage, TabClientError> {
-		let frame = reader.read_framed(socket)?;
-		Ok(TabMessage::try_from(frame)?)
+		Ok(reader.read_message(socket)?)
 	}
 
 	fn wait_for_auth(
 		socket: &UnixStream,
 		reader: &mut TabMessageFrameReader,
-	) -> Result<AuthOkPayload, TabClientError> {
+	) -> Result<(AuthOkPayload, Option<(OwnedFd, OwnedFd)>), TabClientError> {
 		loop {
 			match Self::read_message(socket, reader)? {
-				TabMessage::AuthOk(payload) => return Ok(payload),
+				TabMessage::AuthOk {
+					payload,
+					input_ring_fds,
+				} => return Ok((payload, input_ring_fds)),
 				TabMessage::AuthError(AuthErrorPayload { error }) => {
 					return Err(TabClientError::Auth(error));
 				}
@@ -269,6 +576,35 @@ impl TabClient {
 			} => {
 				self.handle_buffer_release(payload, release_fence);
 			}
+			TabMessage::BufferRequestAck(BufferRequestAckPayload { monitor_id, buffer }) => {
+				self.emit_render_event(RenderEvent::BufferAcked { monitor_id, buffer });
+			}
+			TabMessage::BufferRequestRejected(BufferRequestRejectedPayload {
+				monitor_id,
+				buffer,
+				code,
+			}) => {
+				self.emit_render_event(RenderEvent::BufferRejected {
+					monitor_id,
+					buffer,
+					code,
+				});
+			}
+			TabMessage::FramePresented(FramePresentedPayload {
+				monitor_id,
+				sequence,
+				vblank_ns,
+				refresh_ns,
+				missed,
+			}) => {
+				self.emit_render_event(RenderEvent::FramePresented {
+					monitor_id,
+					sequence,
+					vblank_ns,
+					refresh_ns,
+					missed,
+				});
+			}
 			TabMessage::SessionAwake(SessionAwakePayload { session_id }) => {
 				self.handle_session_awake(session_id);
 			}
@@ -281,9 +617,24 @@ impl TabClient {
 			TabMessage::SessionState(SessionStatePayload { session }) => {
 				self.handle_session_state(session);
 			}
+			// Shift only falls back to the socket while the ring is backed up; what the ring
+			// holds was sent first.
 			TabMessage::InputEvent(payload) => {
+				self.drain_input_ring()?;
+				self.socket_input_events += 1;
 				self.handle_input_event(payload);
 			}
+			TabMessage::InputBatch(InputBatchPayload { events }) => {
+				self.drain_input_ring()?;
+				self.socket_input_events += events.len() as u64;
+				self.dispatch_input_event(InputEvent::Batch(events));
+			}
+			TabMessage::GpuMemory(payload) => {
+				self.gpu_memory = Some(payload);
+			}
+			TabMessage::Stats(payload) => {
+				self.stats = Some(payload);
+			}
 			_ => {}
 		}
 		Ok(())
@@ -291,6 +642,7 @@ impl TabClient {
 
 	fn handle_monitor_added(&mut self, info: MonitorInfo) {
 		let state = MonitorState::new(info);
+		self.preallocated.remove(&state.info.id);
 		self.monitors.insert(state.info.id.clone(), state.clone());
 		let event = MonitorEvent::Added(state);
 		for listener in &self.monitor_listeners {
@@ -300,6 +652,7 @@ impl TabClient {
 
 	fn handle_monitor_removed(&mut self, monitor_id: String, name: String) {
 		self.monitors.remove(&monitor_id);
+		self.preallocated.remove(&monitor_id);
 		let event = MonitorEvent::Removed { monitor_id, name };
 		for listener in &self.monitor_listeners {
 			listener(&event);
@@ -327,6 +680,12 @@ impl TabClient {
 		}
 	}
 
+	fn emit_render_event(&self, event: RenderEvent) {
+		for listener in &self.render_listeners {
+			listener(&event);
+		}
+	}
+
 	fn handle_session_awake(&mut self, session_id: String) {
 		let event = SessionEvent::Awake(session_id);
 		for listener in &self.session_listeners {
@@ -363,10 +722,16 @@ impl TabClient {
 	}
 
 	fn handle_input_event(&mut self, payload: InputEventPayload) {
-		let event = InputEvent::Event(payload);
+		self.dispatch_input_event(InputEvent::Event(payload));
+	}
+
+	fn dispatch_input_event(&mut self, event: InputEvent) {
 		for listener in &self.input_listeners {
 			listener(&event);
 		}
+		if let Some(sink) = self.input_sink.as_mut() {
+			sink(event);
+		}
 	}
 
 	fn wait_for_buffer_request_ack(
@@ -379,28 +744,35 @@ impl TabClient {
 			if Instant::now() >= deadline {
 				return Err(TabClientError::Unexpected("buffer_request_ack timeout"));
 			}
-			match self.reader.read_framed(&self.socket) {
-				Ok(frame) => {
-					let message = TabMessage::try_from(frame)?;
-					match message {
-						TabMessage::BufferRequestAck(BufferRequestAckPayload {
+			match self.reader.read_message(&self.socket) {
+				Ok(message) => match message {
+					TabMessage::BufferRequestAck(BufferRequestAckPayload {
+						monitor_id: ack_monitor,
+						buffer: ack_buffer,
+					}) => {
+						if ack_monitor == monitor_id && ack_buffer == buffer {
+							return Ok(());
+						}
+						self.emit_render_event(RenderEvent::BufferAcked {
 							monitor_id: ack_monitor,
 							buffer: ack_buffer,
-						}) => {
-							if ack_monitor == monitor_id && ack_buffer == buffer {
-								return Ok(());
-							}
-						}
-						TabMessage::Error(err) => {
-							let details = err
-								.message
-								.map(|m| format!("{}: {m}", err.code))
-								.unwrap_or(err.code);
-							return Err(TabClientError::Server(details));
+						});
+					}
+					TabMessage::BufferRequestRejected(rejected) => {
+						if rejected.monitor_id == monitor_id && rejected.buffer == buffer {
+							return Err(TabClientError::Server(rejected.code));
 						}
-						other => self.handle_message(other)?,
+						self.handle_message(TabMessage::BufferRequestRejected(rejected))?;
 					}
-				}
+					TabMessage::Error(err) => {
+						let details = err
+							.message
+							.map(|m| format!("{}: {m}", err.code))
+							.unwrap_or(err.code);
+						return Err(TabClientError::Server(details));
+					}
+					other => self.handle_message(other)?,
+				},
 				Err(tab_protocol::ProtocolError::WouldBlock) => {
 					self.poll_socket_until(deadline)?;
 				}
@@ -415,24 +787,21 @@ impl TabClient {
 			if Instant::now() >= deadline {
 				return Err(TabClientError::Unexpected("session_created timeout"));
 			}
-			match self.reader.read_framed(&self.socket) {
-				Ok(frame) => {
-					let message = TabMessage::try_from(frame)?;
-					match message {
-						TabMessage::SessionCreated(payload) => {
-							self.handle_session_created(payload.session.clone(), payload.token.clone());
-							return Ok(payload);
-						}
-						TabMessage::Error(err) => {
-							let details = err
-								.message
-								.map(|m| format!("{}: {m}", err.code))
-								.unwrap_or(err.code);
-							return Err(TabClientError::Server(details));
-						}
-						other => self.handle_message(other)?,
+			match self.reader.read_message(&self.socket) {
+				Ok(message) => match message {
+					TabMessage::SessionCreated(payload) => {
+						self.handle_session_created(payload.session.clone(), payload.token.clone());
+						return Ok(payload);
 					}
-				}
+					TabMessage::Error(err) => {
+						let details = err
+							.message
+							.map(|m| format!("{}: {m}", err.code))
+							.unwrap_or(err.code);
+						return Err(TabClientError::Server(details));
+					}
+					other => self.handle_message(other)?,
+				},
 				Err(tab_protocol::ProtocolError::WouldBlock) => {
 					self.poll_socket_until(deadline)?;
 				}
@@ -1,7 +1,9 @@
 use std::os::fd::{AsRawFd, OwnedFd, RawFd};
 
 use gbm::BufferObject;
-use tab_protocol::{BufferIndex, FramebufferLinkPayload};
+use tab_protocol::{BufferIndex, FramebufferLinkPayload, PlaneLayout};
+
+use crate::error::TabClientError;
 
 /// Metadata describing a DMA-BUF-backed buffer.
 #[derive(Debug)]
@@ -9,14 +11,17 @@ pub struct TabBuffer {
 	pub index: BufferIndex,
 	bo: BufferObject<()>,
 	fd: OwnedFd,
+	/// Whether the buffer was allocated against Shift's advertised modifier list.
+	explicit_modifier: bool,
 }
 
 impl TabBuffer {
-	pub fn new(index: BufferIndex, bo: BufferObject<()>) -> Self {
+	pub fn new(index: BufferIndex, bo: BufferObject<()>, explicit_modifier: bool) -> Self {
 		Self {
 			index,
 			fd: bo.fd().unwrap(),
 			bo,
+			explicit_modifier,
 		}
 	}
 
@@ -40,51 +45,84 @@ impl TabBuffer {
 		self.bo.format() as u32 as i32
 	}
 
+	/// Layout modifier, or `None` if the driver picked an implicit layout.
+	pub fn modifier(&self) -> Option<u64> {
+		self
+			.explicit_modifier
+			.then(|| u64::from(self.bo.modifier()))
+			.filter(|modifier| *modifier != tab_protocol::DRM_FORMAT_MOD_INVALID)
+	}
+
+	/// Offset and stride of every plane. All planes live in [`fd`](Self::fd).
+	pub fn planes(&self) -> Vec<PlaneLayout> {
+		let count = (self.bo.plane_count() as usize).clamp(1, tab_protocol::MAX_DMABUF_PLANES);
+		(0..count as i32)
+			.map(|plane| PlaneLayout {
+				offset: self.bo.offset(plane) as i32,
+				stride: self.bo.stride_for_plane(plane) as i32,
+			})
+			.collect()
+	}
+
 	pub fn fd(&self) -> RawFd {
 		self.fd.as_raw_fd()
 	}
+
+	/// Whether both buffers can be described by the same `framebuffer_link`.
+	pub fn same_layout(&self, other: &TabBuffer) -> bool {
+		self.width() == other.width()
+			&& self.height() == other.height()
+			&& self.fourcc() == other.fourcc()
+			&& self.modifier() == other.modifier()
+			&& self.planes() == other.planes()
+	}
 }
 
-/// Double-buffer swapchain model.
+/// Multi-buffer swapchain model (2 to [`tab_protocol::MAX_SWAPCHAIN_BUFFERS`] buffers).
 #[derive(Debug)]
 pub struct TabSwapchain {
 	pub monitor_id: String,
-	pub buffers: [TabBuffer; 2],
+	pub buffers: Vec<TabBuffer>,
 	current: BufferIndex,
-	last_acquired: Option<BufferIndex>,
-	busy: [bool; 2],
+	/// Buffer that was current before the last unconfirmed `acquire_next`.
+	rollback_to: Option<BufferIndex>,
+	busy: Vec<bool>,
 }
 
 impl TabSwapchain {
-	pub fn new(monitor_id: impl Into<String>, buffers: [TabBuffer; 2]) -> Self {
+	pub fn new(monitor_id: impl Into<String>, buffers: Vec<TabBuffer>) -> Self {
+		let busy = vec![false; buffers.len()];
 		Self {
 			monitor_id: monitor_id.into(),
 			buffers,
 			current: BufferIndex::Zero,
-			last_acquired: None,
-			busy: [false, false],
+			rollback_to: None,
+			busy,
 		}
 	}
 
+	/// Number of buffers in this swapchain.
+	pub fn buffer_count(&self) -> usize {
+		self.buffers.len()
+	}
+
 	pub fn acquire_next(&mut self) -> Option<(&TabBuffer, BufferIndex)> {
-		let preferred = match self.current {
-			BufferIndex::Zero => BufferIndex::One,
-			BufferIndex::One => BufferIndex::Zero,
-		};
-		let candidate = [preferred, self.current]
-			.into_iter()
-			.find(|idx| !self.busy[*idx as usize])?;
+		// Walk the ring starting after the current buffer so the most recently
+		// submitted buffer is only reused when every other one is busy.
+		let count = self.buffers.len();
+		let start = self.current as usize;
+		let candidate = (1..=count)
+			.map(|step| (start + step) % count)
+			.find(|idx| !self.busy[*idx])
+			.and_then(BufferIndex::from_index)?;
+		self.rollback_to = Some(self.current);
 		self.current = candidate;
-		self.last_acquired = Some(candidate);
 		Some((&self.buffers[candidate as usize], candidate))
 	}
 
 	pub fn rollback(&mut self) {
-		if let Some(last) = self.last_acquired.take() {
-			self.current = match last {
-				BufferIndex::Zero => BufferIndex::One,
-				BufferIndex::One => BufferIndex::Zero,
-			};
+		if let Some(previous) = self.rollback_to.take() {
+			self.current = previous;
 		}
 	}
 
@@ -93,29 +131,44 @@ impl TabSwapchain {
 	}
 
 	pub fn mark_busy(&mut self, idx: BufferIndex) {
-		self.busy[idx as usize] = true;
-		self.last_acquired = None;
+		if let Some(busy) = self.busy.get_mut(idx as usize) {
+			*busy = true;
+		}
+		self.rollback_to = None;
 	}
 
 	pub fn mark_released(&mut self, idx: BufferIndex) {
-		self.busy[idx as usize] = false;
+		if let Some(busy) = self.busy.get_mut(idx as usize) {
+			*busy = false;
+		}
 	}
 
-	pub fn framebuffer_link_payload(&self) -> FramebufferLinkPayload {
+	/// Describes the swapchain for `framebuffer_link`, which carries one layout for all buffers.
+	/// Fails if the buffers don't share it.
+	pub fn framebuffer_link_payload(&self) -> Result<FramebufferLinkPayload, TabClientError> {
 		let buffer = &self.buffers[0];
-		FramebufferLinkPayload {
+		if !self.buffers[1..]
+			.iter()
+			.all(|other| buffer.same_layout(other))
+		{
+			return Err(TabClientError::MixedSwapchainLayout(
+				self.monitor_id.clone(),
+			));
+		}
+		Ok(FramebufferLinkPayload {
 			monitor_id: self.monitor_id.clone(),
 			width: buffer.width(),
 			height: buffer.height(),
 			stride: buffer.stride(),
 			offset: buffer.offset(),
 			fourcc: buffer.fourcc(),
-		}
+			modifier: buffer.modifier(),
+			planes: buffer.planes(),
+		})
 	}
 
-	pub fn export_fds(&self) -> [RawFd; 2] {
-		let fd0 = self.buffers[0].fd();
-		let fd1 = self.buffers[1].fd();
-		[fd0, fd1]
+	/// Dma-buf fds for every buffer, in buffer index order.
+	pub fn export_fds(&self) -> Vec<RawFd> {
+		self.buffers.iter().map(TabBuffer::fd).collect()
 	}
 }
@@ -0,0 +1,524 @@
+//! Framing and parsing costs of the tab protocol.
+//!
+//! `cargo bench -p tab-protocol` runs everything; pass a filter such as `message/` to run
+//! one group.
+
+use std::{
+	hint::black_box,
+	io::Read,
+	os::{fd::IntoRawFd, unix::net::UnixStream},
+	time::Duration,
+};
+
+use criterion::{BatchSize, BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use tab_protocol::{
+	AuthErrorPayload, AuthOkPayload, AuthPayload, BufferIndex, DamageRect, ErrorPayload,
+	FormatModifiers, FramePresentedPayload, FramebufferLinkPayload, GpuMemoryPayload, GpuMemoryUsage,
+	InputBatchPayload, InputEventPayload, KeyState, LatencyHistogram, MonitorAddedPayload,
+	MonitorInfo, MonitorLatencyStats, MonitorRemovedPayload, PayloadEncoding, PresentMode,
+	PresentModePayload, SessionActivePayload, SessionAwakePayload, SessionCreatePayload,
+	SessionCreatedPayload, SessionInfo, SessionLatencyStats, SessionLifecycle, SessionReadyPayload,
+	SessionRole, SessionSleepPayload, SessionStatePayload, SessionSwitchPayload, StatsPayload,
+	TabMessage, TabMessageFrame, TabMessageFrameReader, binary, message_header,
+};
+
+const MONITOR_ID: &str = "mon_1f2e3d4c5b6a7988";
+const SESSION_ID: &str = "ses_0123456789abcdef";
+/// Events in the `input_batch` samples, about one libinput dispatch of a fast mouse.
+const BATCH_EVENTS: usize = 32;
+
+fn monitor_info() -> MonitorInfo {
+	MonitorInfo {
+		id: MONITOR_ID.into(),
+		width: 2560,
+		height: 1440,
+		refresh_rate: 144,
+		name: "DP-1".into(),
+		formats: vec![FormatModifiers {
+			fourcc: 0x3432_5258,
+			modifiers: vec![0, 0x0100_0000_0000_0001, 0x0100_0000_0000_0002],
+		}],
+	}
+}
+
+fn session_info() -> SessionInfo {
+	SessionInfo {
+		id: SESSION_ID.into(),
+		role: SessionRole::Session,
+		display_name: Some("Terminal".into()),
+		state: SessionLifecycle::Occupied,
+	}
+}
+
+fn pointer_motion(time_usec: u64) -> InputEventPayload {
+	InputEventPayload::PointerMotion {
+		device: 3,
+		time_usec,
+		x: 1280.5,
+		y: 720.25,
+		dx: 1.5,
+		dy: -0.75,
+		unaccel_dx: 1.0,
+		unaccel_dy: -0.5,
+	}
+}
+
+fn input_events() -> Vec<InputEventPayload> {
+	(0..BATCH_EVENTS as u64)
+		.map(|i| {
+			if i % 8 == 7 {
+				InputEventPayload::Key {
+					device: 1,
+					time_usec: 1_000 + i,
+					key: 30,
+					state: KeyState::Pressed,
+				}
+			} else {
+				pointer_motion(1_000 + i)
+			}
+		})
+		.collect()
+}
+
+fn stats_payload() -> StatsPayload {
+	let mut histogram = LatencyHistogram::default();
+	for us in [120, 480, 900, 1_700, 4_200, 8_300, 16_600] {
+		histogram.record_us(us);
+	}
+	StatsPayload {
+		sessions: (0..4)
+			.map(|i| SessionLatencyStats {
+				session_id: format!("ses_{i:016x}"),
+				input: histogram,
+				monitors: vec![MonitorLatencyStats {
+					monitor_id: MONITOR_ID.into(),
+					acquire: histogram,
+					composite: histogram,
+					present: histogram,
+					release: histogram,
+				}],
+			})
+			.collect(),
+	}
+}
+
+/// Fds a sample frame needs to parse; they are consumed by the parsed message.
+fn fds_for(header: &str) -> usize {
+	match header {
+		message_header::FRAMEBUFFER_LINK => 3,
+		_ => 0,
+	}
+}
+
+/// One frame per message type, as peers send them. Hot-path messages use the binary
+/// encoding.
+fn sample_frames() -> Vec<(&'static str, TabMessageFrame)> {
+	let damage = [
+		DamageRect {
+			x: 0,
+			y: 0,
+			width: 640,
+			height: 32,
+		},
+		DamageRect {
+			x: 100,
+			y: 400,
+			width: 24,
+			height: 48,
+		},
+	];
+	vec![
+		("hello", TabMessageFrame::hello("shift", None)),
+		(
+			"auth",
+			TabMessageFrame::json(
+				message_header::AUTH,
+				AuthPayload {
+					token: "c2hpZnQtYmVuY2gtdG9rZW4tMDEyMzQ1Njc4OWFi".into(),
+					encoding: PayloadEncoding::Binary,
+					input_ring: false,
+					input_batch: true,
+				},
+			),
+		),
+		(
+			"auth_ok",
+			TabMessageFrame::json(
+				message_header::AUTH_OK,
+				AuthOkPayload {
+					session: session_info(),
+					monitors: vec![monitor_info(), monitor_info()],
+					encoding: PayloadEncoding::Binary,
+					input_ring: None,
+					render_node: None,
+				},
+			),
+		),
+		(
+			"auth_error",
+			TabMessageFrame::json(
+				message_header::AUTH_ERROR,
+				AuthErrorPayload {
+					error: "token not found".into(),
+				},
+			),
+		),
+		(
+			"framebuffer_link",
+			TabMessageFrame::json(
+				message_header::FRAMEBUFFER_LINK,
+				FramebufferLinkPayload {
+					monitor_id: MONITOR_ID.into(),
+					width: 2560,
+					height: 1440,
+					stride: 10240,
+					offset: 0,
+					fourcc: 0x3432_5258,
+					modifier: Some(0),
+					planes: Vec::new(),
+				},
+			),
+		),
+		(
+			"buffer_request",
+			TabMessageFrame::binary(
+				message_header::BUFFER_REQUEST,
+				binary::encode_buffer_request_payload(MONITOR_ID, BufferIndex::One, &damage)
+					.expect("short monitor id"),
+			),
+		),
+		(
+			"buffer_request_ack",
+			TabMessageFrame::binary(
+				message_header::BUFFER_REQUEST_ACK,
+				binary::encode_buffer_payload(MONITOR_ID, BufferIndex::One).expect("short monitor id"),
+			),
+		),
+		(
+			"buffer_request_rejected",
+			TabMessageFrame::raw(
+				message_header::BUFFER_REQUEST_REJECTED,
+				format!("{MONITOR_ID} 1 unlinked_buffer"),
+			),
+		),
+		(
+			"buffer_release",
+			TabMessageFrame::binary(
+				message_header::BUFFER_RELEASE,
+				binary::encode_buffer_payload(MONITOR_ID, BufferIndex::Zero).expect("short monitor id"),
+			),
+		),
+		(
+			"frame_presented",
+			TabMessageFrame::json(
+				message_header::FRAME_PRESENTED,
+				FramePresentedPayload {
+					monitor_id: MONITOR_ID.into(),
+					sequence: 123_456,
+					vblank_ns: 98_765_432_100,
+					refresh_ns: 6_944_444,
+					missed: false,
+				},
+			),
+		),
+		(
+			"input_event",
+			TabMessageFrame::binary(
+				message_header::INPUT_EVENT,
+				binary::encode_input_event(&pointer_motion(1_000)),
+			),
+		),
+		(
+			"input_event_json",
+			TabMessageFrame::json(message_header::INPUT_EVENT, pointer_motion(1_000)),
+		),
+		(
+			"input_batch",
+			TabMessageFrame::binary(
+				message_header::INPUT_BATCH,
+				binary::encode_input_batch(&input_events()),
+			),
+		),
+		(
+			"input_batch_json",
+			TabMessageFrame::json(
+				message_header::INPUT_BATCH,
+				InputBatchPayload {
+					events: input_events(),
+				},
+			),
+		),
+		(
+			"monitor_added",
+			TabMessageFrame::json(
+				message_header::MONITOR_ADDED,
+				MonitorAddedPayload {
+					monitor: monitor_info(),
+				},
+			),
+		),
+		(
+			"monitor_removed",
+			TabMessageFrame::json(
+				message_header::MONITOR_REMOVED,
+				MonitorRemovedPayload {
+					monitor_id: MONITOR_ID.into(),
+					name: "DP-1".into(),
+				},
+			),
+		),
+		(
+			"session_switch",
+			TabMessageFrame::json(
+				message_header::SESSION_SWITCH,
+				SessionSwitchPayload {
+					session_id: SESSION_ID.into(),
+					animation: Some("slide".into()),
+					duration: Duration::from_millis(250),
+				},
+			),
+		),
+		(
+			"session_create",
+			TabMessageFrame::json(
+				message_header::SESSION_CREATE,
+				SessionCreatePayload {
+					role: SessionRole::Session,
+					display_name: Some("Terminal".into()),
+				},
+			),
+		),
+		(
+			"session_created",
+			TabMessageFrame::json(
+				message_header::SESSION_CREATED,
+				SessionCreatedPayload {
+					session: session_info(),
+					token: "c2hpZnQtYmVuY2gtdG9rZW4tMDEyMzQ1Njc4OWFi".into(),
+				},
+			),
+		),
+		(
+			"session_ready",
+			TabMessageFrame::json(
+				message_header::SESSION_READY,
+				SessionReadyPayload {
+					session_id: SESSION_ID.into(),
+				},
+			),
+		),
+		(
+			"session_state",
+			TabMessageFrame::json(
+				message_header::SESSION_STATE,
+				SessionStatePayload {
+					session: session_info(),
+				},
+			),
+		),
+		(
+			"session_active",
+			TabMessageFrame::json(
+				message_header::SESSION_ACTIVE,
+				SessionActivePayload {
+					session_id: SESSION_ID.into(),
+				},
+			),
+		),
+		(
+			"session_awake",
+			TabMessageFrame::json(
+				message_header::SESSION_AWAKE,
+				SessionAwakePayload {
+					session_id: SESSION_ID.into(),
+				},
+			),
+		),
+		(
+			"session_sleep",
+			TabMessageFrame::json(
+				message_header::SESSION_SLEEP,
+				SessionSleepPayload {
+					session_id: SESSION_ID.into(),
+				},
+			),
+		),
+		(
+			"present_mode",
+			TabMessageFrame::json(
+				message_header::PRESENT_MODE,
+				PresentModePayload {
+					mode: PresentMode::AdaptiveSync,
+				},
+			),
+		),
+		(
+			"gpu_memory",
+			TabMessageFrame::json(
+				message_header::GPU_MEMORY,
+				GpuMemoryPayload {
+					total_bytes: 512 << 20,
+					budget_bytes: Some(1 << 30),
+					skia_cache_bytes: 64 << 20,
+					retired_import_bytes: 0,
+					client_import_bytes: 384 << 20,
+					sessions: (0..4)
+						.map(|i| GpuMemoryUsage {
+							id: format!("ses_{i:016x}"),
+							bytes: 8 << 20,
+							client_bytes: 96 << 20,
+							evicted: false,
+						})
+						.collect(),
+					monitors: vec![GpuMemoryUsage {
+						id: MONITOR_ID.into(),
+						bytes: 56 << 20,
+						client_bytes: 0,
+						evicted: false,
+					}],
+				},
+			),
+		),
+		(
+			"stats_request",
+			TabMessageFrame::no_payload(message_header::STATS_REQUEST),
+		),
+		(
+			"stats",
+			TabMessageFrame::json(message_header::STATS, stats_payload()),
+		),
+		(
+			"error",
+			TabMessageFrame::json(
+				message_header::ERROR,
+				ErrorPayload {
+					code: "forbidden".into(),
+					message: Some("admin sessions only".into()),
+				},
+			),
+		),
+		("ping", TabMessageFrame::no_payload(message_header::PING)),
+		("pong", TabMessageFrame::no_payload(message_header::PONG)),
+	]
+}
+
+/// Frames the other benchmarks are dominated by at runtime.
+fn hot_path_frames() -> Vec<(&'static str, TabMessageFrame)> {
+	const HOT: [&str; 5] = [
+		"buffer_request",
+		"buffer_request_ack",
+		"buffer_release",
+		"input_batch",
+		"frame_presented",
+	];
+	sample_frames()
+		.into_iter()
+		.filter(|(name, _)| HOT.contains(name))
+		.collect()
+}
+
+/// The bytes `frame` puts on the wire, captured through a socketpair.
+fn wire_bytes(frame: &TabMessageFrame) -> Vec<u8> {
+	let (tx, mut rx) = UnixStream::pair().expect("socketpair");
+	frame.encode_and_send(&tx).expect("send sample frame");
+	drop(tx);
+	let mut bytes = Vec::new();
+	rx.read_to_end(&mut bytes).expect("read sample frame");
+	bytes
+}
+
+/// Fresh fds for a frame that hands them to the parsed message.
+fn placeholder_fds(count: usize) -> Vec<i32> {
+	(0..count)
+		.map(|_| {
+			std::fs::File::open("/dev/null")
+				.expect("open /dev/null")
+				.into_raw_fd()
+		})
+		.collect()
+}
+
+fn parse_from_bytes(c: &mut Criterion) {
+	let mut group = c.benchmark_group("frame/parse_from_bytes");
+	for (name, frame) in hot_path_frames() {
+		let bytes = wire_bytes(&frame);
+		group.throughput(Throughput::Bytes(bytes.len() as u64));
+		group.bench_with_input(BenchmarkId::from_parameter(name), &bytes, |b, bytes| {
+			b.iter(|| TabMessageFrame::parse_from_bytes(black_box(bytes), Vec::new()));
+		});
+	}
+	group.finish();
+}
+
+fn encode_and_send(c: &mut Criterion) {
+	let (tx, rx) = UnixStream::pair().expect("socketpair");
+	let mut reader = TabMessageFrameReader::new();
+	let mut group = c.benchmark_group("frame/encode_and_send");
+	for (name, frame) in hot_path_frames() {
+		group.throughput(Throughput::Elements(1));
+		group.bench_with_input(BenchmarkId::from_parameter(name), &frame, |b, frame| {
+			b.iter(|| {
+				frame.encode_and_send(&tx).expect("send");
+				black_box(reader.read_frame_ref(&rx).expect("receive").header.len())
+			});
+		});
+	}
+	group.finish();
+
+	// Bursts the reader has to split out of one receive buffer, like an input storm.
+	let batch = TabMessageFrame::binary(
+		message_header::INPUT_EVENT,
+		binary::encode_input_event(&pointer_motion(1_000)),
+	);
+	let mut group = c.benchmark_group("frame/burst");
+	for burst in [8usize, 64] {
+		group.throughput(Throughput::Elements(burst as u64));
+		group.bench_with_input(BenchmarkId::from_parameter(burst), &burst, |b, burst| {
+			b.iter(|| {
+				for _ in 0..*burst {
+					batch.encode_and_send(&tx).expect("send");
+				}
+				for _ in 0..*burst {
+					black_box(reader.read_message(&rx).expect("receive"));
+				}
+			});
+		});
+	}
+	group.finish();
+}
+
+fn parse_message_frame(c: &mut Criterion) {
+	let mut group = c.benchmark_group("message/parse_message_frame");
+	for (name, frame) in sample_frames() {
+		let fds = fds_for(&frame.header.0);
+		group.bench_with_input(BenchmarkId::from_parameter(name), &frame, |b, frame| {
+			if fds == 0 {
+				b.iter_batched(
+					|| frame.clone(),
+					|frame| TabMessage::parse_message_frame(black_box(frame)).expect("parse"),
+					BatchSize::SmallInput,
+				);
+			} else {
+				// Parsing takes ownership of the fds, so every iteration needs its own.
+				b.iter_batched(
+					|| {
+						let mut frame = frame.clone();
+						frame.fds = placeholder_fds(fds);
+						frame
+					},
+					|frame| TabMessage::parse_message_frame(black_box(frame)).expect("parse"),
+					BatchSize::SmallInput,
+				);
+			}
+		});
+	}
+	group.finish();
+}
+
+criterion_group!(
+	benches,
+	parse_from_bytes,
+	encode_and_send,
+	parse_message_frame
+);
+criterion_main!(benches);
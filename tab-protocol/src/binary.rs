@@ -0,0 +1,1328 @@
+//! Fixed-layout binary payloads for the hot-path messages (`input_event`, `input_batch`,
+//! `buffer_request`, `buffer_request_ack` and `buffer_release`).
+//!
+//! Only used once both peers agreed on [`PayloadEncoding::Binary`](crate::PayloadEncoding) during
+//! the handshake. All integers and floats are little-endian, `Option`s are a presence byte followed
+//! by the value, strings are a `u8` length followed by UTF-8 bytes and so at most 255 bytes long.
+
+use crate::{
+	AxisOrientation, AxisPhase, AxisSource, BufferIndex, BufferRequestPayload, ButtonState,
+	DamageRect, InputEventPayload, KeyState, MAX_DAMAGE_RECTS, ProtocolError, SwitchState,
+	SwitchType, TabletTool, TabletToolAxes, TabletToolCapability, TabletToolType, TipState,
+	TouchContact,
+};
+
+/// Appends little-endian fields to a byte buffer.
+#[derive(Default)]
+pub struct BinaryWriter {
+	buf: Vec<u8>,
+}
+impl BinaryWriter {
+	pub fn with_capacity(capacity: usize) -> Self {
+		Self {
+			buf: Vec::with_capacity(capacity),
+		}
+	}
+	pub fn into_bytes(self) -> Vec<u8> {
+		self.buf
+	}
+	pub fn as_bytes(&self) -> &[u8] {
+		&self.buf
+	}
+	/// Empties the buffer, keeping its allocation for the next payload.
+	pub fn clear(&mut self) {
+		self.buf.clear();
+	}
+	pub fn u8(&mut self, v: u8) {
+		self.buf.push(v);
+	}
+	pub fn bool(&mut self, v: bool) {
+		self.buf.push(v as u8);
+	}
+	pub fn u32(&mut self, v: u32) {
+		self.buf.extend_from_slice(&v.to_le_bytes());
+	}
+	pub fn i32(&mut self, v: i32) {
+		self.buf.extend_from_slice(&v.to_le_bytes());
+	}
+	pub fn u64(&mut self, v: u64) {
+		self.buf.extend_from_slice(&v.to_le_bytes());
+	}
+	pub fn f64(&mut self, v: f64) {
+		self.buf.extend_from_slice(&v.to_le_bytes());
+	}
+	pub fn opt_f64(&mut self, v: Option<f64>) {
+		self.bool(v.is_some());
+		self.f64(v.unwrap_or_default());
+	}
+	pub fn opt_i32(&mut self, v: Option<i32>) {
+		self.bool(v.is_some());
+		self.i32(v.unwrap_or_default());
+	}
+	/// Writes a short string, failing instead of truncating one longer than 255 bytes.
+	pub fn str(&mut self, v: &str) -> Result<(), ProtocolError> {
+		let len = u8::try_from(v.len()).map_err(|_| {
+			ProtocolError::InvalidPayload(format!(
+				"binary strings are at most 255 bytes, got {}",
+				v.len()
+			))
+		})?;
+		self.u8(len);
+		self.buf.extend_from_slice(v.as_bytes());
+		Ok(())
+	}
+}
+
+/// Reads little-endian fields from a binary payload, failing on truncation.
+pub struct BinaryReader<'a> {
+	bytes: &'a [u8],
+}
+impl<'a> BinaryReader<'a> {
+	pub fn new(bytes: &'a [u8]) -> Self {
+		Self { bytes }
+	}
+	fn take<const N: usize>(&mut self) -> Result<[u8; N], ProtocolError> {
+		let Some((head, rest)) = self.bytes.split_first_chunk::<N>() else {
+			return Err(ProtocolError::InvalidPayload(
+				"binary payload is truncated".into(),
+			));
+		};
+		self.bytes = rest;
+		Ok(*head)
+	}
+	pub fn u8(&mut self) -> Result<u8, ProtocolError> {
+		Ok(self.take::<1>()?[0])
+	}
+	pub fn bool(&mut self) -> Result<bool, ProtocolError> {
+		Ok(self.u8()? != 0)
+	}
+	pub fn u32(&mut self) -> Result<u32, ProtocolError> {
+		Ok(u32::from_le_bytes(self.take()?))
+	}
+	pub fn i32(&mut self) -> Result<i32, ProtocolError> {
+		Ok(i32::from_le_bytes(self.take()?))
+	}
+	pub fn u64(&mut self) -> Result<u64, ProtocolError> {
+		Ok(u64::from_le_bytes(self.take()?))
+	}
+	pub fn f64(&mut self) -> Result<f64, ProtocolError> {
+		Ok(f64::from_le_bytes(self.take()?))
+	}
+	pub fn opt_f64(&mut self) -> Result<Option<f64>, ProtocolError> {
+		let present = self.bool()?;
+		let value = self.f64()?;
+		Ok(present.then_some(value))
+	}
+	pub fn opt_i32(&mut self) -> Result<Option<i32>, ProtocolError> {
+		let present = self.bool()?;
+		let value = self.i32()?;
+		Ok(present.then_some(value))
+	}
+	pub fn str(&mut self) -> Result<&'a str, ProtocolError> {
+		let len = self.u8()? as usize;
+		if self.bytes.len() < len {
+			return Err(ProtocolError::InvalidPayload(
+				"binary payload is truncated".into(),
+			));
+		}
+		let (head, rest) = self.bytes.split_at(len);
+		self.bytes = rest;
+		std::str::from_utf8(head)
+			.map_err(|_| ProtocolError::InvalidPayload("binary string is not valid utf-8".into()))
+	}
+	/// Whether every byte of the payload has been read.
+	pub fn is_empty(&self) -> bool {
+		self.bytes.is_empty()
+	}
+	/// Fails if the payload carried more bytes than the layout consumed.
+	pub fn finish(self) -> Result<(), ProtocolError> {
+		if self.bytes.is_empty() {
+			Ok(())
+		} else {
+			Err(ProtocolError::TrailingData)
+		}
+	}
+}
+
+fn invalid_tag(what: &str, tag: u8) -> ProtocolError {
+	ProtocolError::InvalidPayload(format!("unknown {what} tag {tag} in binary payload"))
+}
+
+/// Shared by `buffer_request`, `buffer_request_ack` and `buffer_release`:
+/// `str monitor_id, u8 buffer_index`. `buffer_request` may append damage, see
+/// [`encode_buffer_request_payload`].
+pub fn encode_buffer_payload(
+	monitor_id: &str,
+	buffer: BufferIndex,
+) -> Result<Vec<u8>, ProtocolError> {
+	let mut w = BinaryWriter::with_capacity(monitor_id.len() + 2);
+	w.str(monitor_id)?;
+	w.u8(buffer as u8);
+	Ok(w.into_bytes())
+}
+
+pub fn decode_buffer_payload(bytes: &[u8]) -> Result<(String, BufferIndex), ProtocolError> {
+	let mut r = BinaryReader::new(bytes);
+	let monitor_id = r.str()?.to_string();
+	let index = r.u8()?;
+	r.finish()?;
+	let buffer =
+		BufferIndex::from_index(index as usize).ok_or_else(|| invalid_tag("buffer index", index))?;
+	Ok((monitor_id, buffer))
+}
+
+/// `buffer_request`: the shared buffer layout, then optionally `u8 count` and `count` damage
+/// rectangles of four `i32`s (`x, y, width, height`). No trailer means full damage.
+/// More than [`MAX_DAMAGE_RECTS`] are merged with [`DamageRect::clamp_count`], so the
+/// encoded damage still covers all of them.
+pub fn encode_buffer_request_payload(
+	monitor_id: &str,
+	buffer: BufferIndex,
+	damage: &[DamageRect],
+) -> Result<Vec<u8>, ProtocolError> {
+	let clamped;
+	let damage = if damage.len() > MAX_DAMAGE_RECTS {
+		clamped = DamageRect::clamp_count(damage);
+		&clamped[..]
+	} else {
+		damage
+	};
+	let mut w = BinaryWriter::with_capacity(monitor_id.len() + 3 + damage.len() * 16);
+	w.str(monitor_id)?;
+	w.u8(buffer as u8);
+	if !damage.is_empty() {
+		w.u8(damage.len() as u8);
+		for rect in damage {
+			w.i32(rect.x);
+			w.i32(rect.y);
+			w.i32(rect.width);
+			w.i32(rect.height);
+		}
+	}
+	Ok(w.into_bytes())
+}
+
+pub fn decode_buffer_request_payload(bytes: &[u8]) -> Result<BufferRequestPayload, ProtocolError> {
+	let mut r = BinaryReader::new(bytes);
+	let monitor_id = r.str()?.to_string();
+	let index = r.u8()?;
+	let buffer =
+		BufferIndex::from_index(index as usize).ok_or_else(|| invalid_tag("buffer index", index))?;
+	let mut damage = Vec::new();
+	if !r.is_empty() {
+		let count = r.u8()? as usize;
+		if count > MAX_DAMAGE_RECTS {
+			return Err(ProtocolError::InvalidPayload(format!(
+				"buffer_request carries {count} damage rectangles, at most {MAX_DAMAGE_RECTS} are allowed"
+			)));
+		}
+		damage.reserve_exact(count);
+		for _ in 0..count {
+			damage.push(
+				DamageRect {
+					x: r.i32()?,
+					y: r.i32()?,
+					width: r.i32()?,
+					height: r.i32()?,
+				}
+				.validate()?,
+			);
+		}
+	}
+	r.finish()?;
+	Ok(BufferRequestPayload {
+		monitor_id,
+		buffer,
+		damage,
+	})
+}
+
+fn button_state_tag(v: &ButtonState) -> u8 {
+	match v {
+		ButtonState::Pressed => 0,
+		ButtonState::Released => 1,
+	}
+}
+fn button_state(tag: u8) -> Result<ButtonState, ProtocolError> {
+	match tag {
+		0 => Ok(ButtonState::Pressed),
+		1 => Ok(ButtonState::Released),
+		t => Err(invalid_tag("button state", t)),
+	}
+}
+fn key_state_tag(v: &KeyState) -> u8 {
+	match v {
+		KeyState::Pressed => 0,
+		KeyState::Released => 1,
+	}
+}
+fn key_state(tag: u8) -> Result<KeyState, ProtocolError> {
+	match tag {
+		0 => Ok(KeyState::Pressed),
+		1 => Ok(KeyState::Released),
+		t => Err(invalid_tag("key state", t)),
+	}
+}
+fn tip_state_tag(v: &TipState) -> u8 {
+	match v {
+		TipState::Down => 0,
+		TipState::Up => 1,
+	}
+}
+fn tip_state(tag: u8) -> Result<TipState, ProtocolError> {
+	match tag {
+		0 => Ok(TipState::Down),
+		1 => Ok(TipState::Up),
+		t => Err(invalid_tag("tip state", t)),
+	}
+}
+fn orientation_tag(v: &AxisOrientation) -> u8 {
+	match v {
+		AxisOrientation::Vertical => 0,
+		AxisOrientation::Horizontal => 1,
+	}
+}
+fn orientation(tag: u8) -> Result<AxisOrientation, ProtocolError> {
+	match tag {
+		0 => Ok(AxisOrientation::Vertical),
+		1 => Ok(AxisOrientation::Horizontal),
+		t => Err(invalid_tag("axis orientation", t)),
+	}
+}
+fn axis_source_tag(v: &AxisSource) -> u8 {
+	match v {
+		AxisSource::Wheel => 0,
+		AxisSource::Finger => 1,
+		AxisSource::Continuous => 2,
+		AxisSource::WheelTilt => 3,
+	}
+}
+fn axis_source(tag: u8) -> Result<AxisSource, ProtocolError> {
+	match tag {
+		0 => Ok(AxisSource::Wheel),
+		1 => Ok(AxisSource::Finger),
+		2 => Ok(AxisSource::Continuous),
+		3 => Ok(AxisSource::WheelTilt),
+		t => Err(invalid_tag("axis source", t)),
+	}
+}
+fn axis_phase_tag(v: &AxisPhase) -> u8 {
+	match v {
+		AxisPhase::Started => 0,
+		AxisPhase::Moved => 1,
+		AxisPhase::Ended => 2,
+		AxisPhase::Cancelled => 3,
+	}
+}
+fn axis_phase(tag: u8) -> Result<AxisPhase, ProtocolError> {
+	match tag {
+		0 => Ok(AxisPhase::Started),
+		1 => Ok(AxisPhase::Moved),
+		2 => Ok(AxisPhase::Ended),
+		3 => Ok(AxisPhase::Cancelled),
+		t => Err(invalid_tag("axis phase", t)),
+	}
+}
+fn switch_type_tag(v: &SwitchType) -> u8 {
+	match v {
+		SwitchType::Lid => 0,
+		SwitchType::TabletMode => 1,
+	}
+}
+fn switch_type(tag: u8) -> Result<SwitchType, ProtocolError> {
+	match tag {
+		0 => Ok(SwitchType::Lid),
+		1 => Ok(SwitchType::TabletMode),
+		t => Err(invalid_tag("switch type", t)),
+	}
+}
+fn switch_state_tag(v: &SwitchState) -> u8 {
+	match v {
+		SwitchState::On => 0,
+		SwitchState::Off => 1,
+	}
+}
+fn switch_state(tag: u8) -> Result<SwitchState, ProtocolError> {
+	match tag {
+		0 => Ok(SwitchState::On),
+		1 => Ok(SwitchState::Off),
+		t => Err(invalid_tag("switch state", t)),
+	}
+}
+const TOOL_TYPES: [TabletToolType; 8] = [
+	TabletToolType::Pen,
+	TabletToolType::Eraser,
+	TabletToolType::Brush,
+	TabletToolType::Pencil,
+	TabletToolType::Airbrush,
+	TabletToolType::Finger,
+	TabletToolType::Mouse,
+	TabletToolType::Lens,
+];
+
+fn write_contact(w: &mut BinaryWriter, c: &TouchContact) {
+	w.i32(c.id);
+	w.f64(c.x);
+	w.f64(c.y);
+	w.f64(c.x_transformed);
+	w.f64(c.y_transformed);
+}
+fn read_contact(r: &mut BinaryReader) -> Result<TouchContact, ProtocolError> {
+	Ok(TouchContact {
+		id: r.i32()?,
+		x: r.f64()?,
+		y: r.f64()?,
+		x_transformed: r.f64()?,
+		y_transformed: r.f64()?,
+	})
+}
+fn write_tool(w: &mut BinaryWriter, t: &TabletTool) {
+	w.u64(t.serial);
+	let type_tag = TOOL_TYPES
+		.iter()
+		.position(|k| *k == t.tool_type)
+		.unwrap_or_default();
+	w.u8(type_tag as u8);
+	let c = &t.capability;
+	let caps = [
+		c.pressure, c.distance, c.tilt, c.rotation, c.slider, c.wheel,
+	]
+	.iter()
+	.enumerate()
+	.fold(0u8, |acc, (bit, set)| acc | ((*set as u8) << bit));
+	w.u8(caps);
+}
+fn read_tool(r: &mut BinaryReader) -> Result<TabletTool, ProtocolError> {
+	let serial = r.u64()?;
+	let type_tag = r.u8()?;
+	let tool_type = *TOOL_TYPES
+		.get(type_tag as usize)
+		.ok_or_else(|| invalid_tag("tablet tool type", type_tag))?;
+	let caps = r.u8()?;
+	let bit = |n: u8| caps & (1 << n) != 0;
+	Ok(TabletTool {
+		serial,
+		tool_type,
+		capability: TabletToolCapability {
+			pressure: bit(0),
+			distance: bit(1),
+			tilt: bit(2),
+			rotation: bit(3),
+			slider: bit(4),
+			wheel: bit(5),
+		},
+	})
+}
+fn write_axes(w: &mut BinaryWriter, a: &TabletToolAxes) {
+	w.f64(a.x);
+	w.f64(a.y);
+	w.opt_f64(a.pressure);
+	w.opt_f64(a.distance);
+	w.opt_f64(a.tilt_x);
+	w.opt_f64(a.tilt_y);
+	w.opt_f64(a.rotation);
+	w.opt_f64(a.slider);
+	w.opt_f64(a.wheel_delta);
+	let count = a.buttons.len().min(u8::MAX as usize);
+	w.u8(count as u8);
+	for button in &a.buttons[..count] {
+		w.u32(*button);
+	}
+}
+fn read_axes(r: &mut BinaryReader) -> Result<TabletToolAxes, ProtocolError> {
+	let x = r.f64()?;
+	let y = r.f64()?;
+	let pressure = r.opt_f64()?;
+	let distance = r.opt_f64()?;
+	let tilt_x = r.opt_f64()?;
+	let tilt_y = r.opt_f64()?;
+	let rotation = r.opt_f64()?;
+	let slider = r.opt_f64()?;
+	let wheel_delta = r.opt_f64()?;
+	let count = r.u8()?;
+	let buttons = (0..count).map(|_| r.u32()).collect::<Result<_, _>>()?;
+	Ok(TabletToolAxes {
+		x,
+		y,
+		pressure,
+		distance,
+		tilt_x,
+		tilt_y,
+		rotation,
+		slider,
+		wheel_delta,
+		buttons,
+	})
+}
+
+/// Encodes an input event as `u8 kind` followed by the variant's fields in declaration order.
+pub fn encode_input_event(event: &InputEventPayload) -> Vec<u8> {
+	let mut w = BinaryWriter::with_capacity(64);
+	write_input_event(&mut w, event);
+	w.into_bytes()
+}
+
+/// Appends the [`encode_input_event`] bytes of `event` to `w`.
+pub fn write_input_event(w: &mut BinaryWriter, event: &InputEventPayload) {
+	use InputEventPayload as E;
+	match event {
+		E::PointerMotion {
+			device,
+			time_usec,
+			x,
+			y,
+			dx,
+			dy,
+			unaccel_dx,
+			unaccel_dy,
+		} => {
+			w.u8(0);
+			w.u32(*device);
+			w.u64(*time_usec);
+			for v in [x, y, dx, dy, unaccel_dx, unaccel_dy] {
+				w.f64(*v);
+			}
+		}
+		E::PointerMotionAbsolute {
+			device,
+			time_usec,
+			x,
+			y,
+			x_transformed,
+			y_transformed,
+		} => {
+			w.u8(1);
+			w.u32(*device);
+			w.u64(*time_usec);
+			for v in [x, y, x_transformed, y_transformed] {
+				w.f64(*v);
+			}
+		}
+		E::PointerButton {
+			device,
+			time_usec,
+			button,
+			state,
+		} => {
+			w.u8(2);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*button);
+			w.u8(button_state_tag(state));
+		}
+		E::PointerAxis {
+			device,
+			time_usec,
+			orientation,
+			delta,
+			delta_discrete,
+			source,
+			phase,
+		} => {
+			w.u8(3);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u8(orientation_tag(orientation));
+			w.f64(*delta);
+			w.opt_i32(*delta_discrete);
+			w.u8(axis_source_tag(source));
+			w.u8(axis_phase_tag(phase));
+		}
+		E::Key {
+			device,
+			time_usec,
+			key,
+			state,
+		} => {
+			w.u8(4);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*key);
+			w.u8(key_state_tag(state));
+		}
+		E::TouchDown {
+			device,
+			time_usec,
+			contact,
+		} => {
+			w.u8(5);
+			w.u32(*device);
+			w.u64(*time_usec);
+			write_contact(w, contact);
+		}
+		E::TouchUp {
+			device,
+			time_usec,
+			contact_id,
+		} => {
+			w.u8(6);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.i32(*contact_id);
+		}
+		E::TouchMotion {
+			device,
+			time_usec,
+			contact,
+		} => {
+			w.u8(7);
+			w.u32(*device);
+			w.u64(*time_usec);
+			write_contact(w, contact);
+		}
+		E::TouchFrame { time_usec } => {
+			w.u8(8);
+			w.u64(*time_usec);
+		}
+		E::TouchCancel { time_usec } => {
+			w.u8(9);
+			w.u64(*time_usec);
+		}
+		E::TableToolProximity {
+			device,
+			time_usec,
+			in_proximity,
+			tool,
+		} => {
+			w.u8(10);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.bool(*in_proximity);
+			write_tool(w, tool);
+		}
+		E::TabletToolAxis {
+			device,
+			time_usec,
+			tool,
+			axes,
+		} => {
+			w.u8(11);
+			w.u32(*device);
+			w.u64(*time_usec);
+			write_tool(w, tool);
+			write_axes(w, axes);
+		}
+		E::TabletToolTip {
+			device,
+			time_usec,
+			tool,
+			state,
+		} => {
+			w.u8(12);
+			w.u32(*device);
+			w.u64(*time_usec);
+			write_tool(w, tool);
+			w.u8(tip_state_tag(state));
+		}
+		E::TabletToolButton {
+			device,
+			time_usec,
+			tool,
+			button,
+			state,
+		} => {
+			w.u8(13);
+			w.u32(*device);
+			w.u64(*time_usec);
+			write_tool(w, tool);
+			w.u32(*button);
+			w.u8(button_state_tag(state));
+		}
+		E::TablePadButton {
+			device,
+			time_usec,
+			button,
+			state,
+		} => {
+			w.u8(14);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*button);
+			w.u8(button_state_tag(state));
+		}
+		E::TablePadRing {
+			device,
+			time_usec,
+			ring,
+			position,
+			source,
+		} => {
+			w.u8(15);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*ring);
+			w.f64(*position);
+			w.u8(axis_source_tag(source));
+		}
+		E::TablePadStrip {
+			device,
+			time_usec,
+			strip,
+			position,
+			source,
+		} => {
+			w.u8(16);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*strip);
+			w.f64(*position);
+			w.u8(axis_source_tag(source));
+		}
+		E::SwitchToggle {
+			device,
+			time_usec,
+			switch,
+			state,
+		} => {
+			w.u8(17);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u8(switch_type_tag(switch));
+			w.u8(switch_state_tag(state));
+		}
+		E::GestureSwipeBegin {
+			device,
+			time_usec,
+			fingers,
+		} => {
+			w.u8(18);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*fingers);
+		}
+		E::GestureSwipeUpdate {
+			device,
+			time_usec,
+			fingers,
+			dx,
+			dy,
+		} => {
+			w.u8(19);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*fingers);
+			w.f64(*dx);
+			w.f64(*dy);
+		}
+		E::GestureSwipeEnd {
+			device,
+			time_usec,
+			cancelled,
+		} => {
+			w.u8(20);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.bool(*cancelled);
+		}
+		E::GesturePinchBegin {
+			device,
+			time_usec,
+			fingers,
+		} => {
+			w.u8(21);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*fingers);
+		}
+		E::GesturePinchUpdate {
+			device,
+			time_usec,
+			fingers,
+			dx,
+			dy,
+			scale,
+			rotation,
+		} => {
+			w.u8(22);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*fingers);
+			for v in [dx, dy, scale, rotation] {
+				w.f64(*v);
+			}
+		}
+		E::GesturePinchEnd {
+			device,
+			time_usec,
+			cancelled,
+		} => {
+			w.u8(23);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.bool(*cancelled);
+		}
+		E::GestureHoldBegin {
+			device,
+			time_usec,
+			fingers,
+		} => {
+			w.u8(24);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.u32(*fingers);
+		}
+		E::GestureHoldEnd {
+			device,
+			time_usec,
+			cancelled,
+		} => {
+			w.u8(25);
+			w.u32(*device);
+			w.u64(*time_usec);
+			w.bool(*cancelled);
+		}
+	}
+}
+
+pub fn decode_input_event(bytes: &[u8]) -> Result<InputEventPayload, ProtocolError> {
+	use InputEventPayload as E;
+	let mut r = BinaryReader::new(bytes);
+	let kind = r.u8()?;
+	let event = match kind {
+		8 => E::TouchFrame {
+			time_usec: r.u64()?,
+		},
+		9 => E::TouchCancel {
+			time_usec: r.u64()?,
+		},
+		kind => {
+			let device = r.u32()?;
+			let time_usec = r.u64()?;
+			match kind {
+				0 => E::PointerMotion {
+					device,
+					time_usec,
+					x: r.f64()?,
+					y: r.f64()?,
+					dx: r.f64()?,
+					dy: r.f64()?,
+					unaccel_dx: r.f64()?,
+					unaccel_dy: r.f64()?,
+				},
+				1 => E::PointerMotionAbsolute {
+					device,
+					time_usec,
+					x: r.f64()?,
+					y: r.f64()?,
+					x_transformed: r.f64()?,
+					y_transformed: r.f64()?,
+				},
+				2 => E::PointerButton {
+					device,
+					time_usec,
+					button: r.u32()?,
+					state: button_state(r.u8()?)?,
+				},
+				3 => E::PointerAxis {
+					device,
+					time_usec,
+					orientation: orientation(r.u8()?)?,
+					delta: r.f64()?,
+					delta_discrete: r.opt_i32()?,
+					source: axis_source(r.u8()?)?,
+					phase: axis_phase(r.u8()?)?,
+				},
+				4 => E::Key {
+					device,
+					time_usec,
+					key: r.u32()?,
+					state: key_state(r.u8()?)?,
+				},
+				5 => E::TouchDown {
+					device,
+					time_usec,
+					contact: read_contact(&mut r)?,
+				},
+				6 => E::TouchUp {
+					device,
+					time_usec,
+					contact_id: r.i32()?,
+				},
+				7 => E::TouchMotion {
+					device,
+					time_usec,
+					contact: read_contact(&mut r)?,
+				},
+				10 => E::TableToolProximity {
+					device,
+					time_usec,
+					in_proximity: r.bool()?,
+					tool: read_tool(&mut r)?,
+				},
+				11 => E::TabletToolAxis {
+					device,
+					time_usec,
+					tool: read_tool(&mut r)?,
+					axes: read_axes(&mut r)?,
+				},
+				12 => E::TabletToolTip {
+					device,
+					time_usec,
+					tool: read_tool(&mut r)?,
+					state: tip_state(r.u8()?)?,
+				},
+				13 => E::TabletToolButton {
+					device,
+					time_usec,
+					tool: read_tool(&mut r)?,
+					button: r.u32()?,
+					state: button_state(r.u8()?)?,
+				},
+				14 => E::TablePadButton {
+					device,
+					time_usec,
+					button: r.u32()?,
+					state: button_state(r.u8()?)?,
+				},
+				15 => E::TablePadRing {
+					device,
+					time_usec,
+					ring: r.u32()?,
+					position: r.f64()?,
+					source: axis_source(r.u8()?)?,
+				},
+				16 => E::TablePadStrip {
+					device,
+					time_usec,
+					strip: r.u32()?,
+					position: r.f64()?,
+					source: axis_source(r.u8()?)?,
+				},
+				17 => E::SwitchToggle {
+					device,
+					time_usec,
+					switch: switch_type(r.u8()?)?,
+					state: switch_state(r.u8()?)?,
+				},
+				18 => E::GestureSwipeBegin {
+					device,
+					time_usec,
+					fingers: r.u32()?,
+				},
+				19 => E::GestureSwipeUpdate {
+					device,
+					time_usec,
+					fingers: r.u32()?,
+					dx: r.f64()?,
+					dy: r.f64()?,
+				},
+				20 => E::GestureSwipeEnd {
+					device,
+					time_usec,
+					cancelled: r.bool()?,
+				},
+				21 => E::GesturePinchBegin {
+					device,
+					time_usec,
+					fingers: r.u32()?,
+				},
+				22 => E::GesturePinchUpdate {
+					device,
+					time_usec,
+					fingers: r.u32()?,
+					dx: r.f64()?,
+					dy: r.f64()?,
+					scale: r.f64()?,
+					rotation: r.f64()?,
+				},
+				23 => E::GesturePinchEnd {
+					device,
+					time_usec,
+					cancelled: r.bool()?,
+				},
+				24 => E::GestureHoldBegin {
+					device,
+					time_usec,
+					fingers: r.u32()?,
+				},
+				25 => E::GestureHoldEnd {
+					device,
+					time_usec,
+					cancelled: r.bool()?,
+				},
+				t => return Err(invalid_tag("input event", t)),
+			}
+		}
+	};
+	r.finish()?;
+	Ok(event)
+}
+
+/// Encodes an input batch as `u32 count` followed by `u32 len` + [`encode_input_event`] bytes
+/// per event.
+pub fn encode_input_batch(events: &[InputEventPayload]) -> Vec<u8> {
+	let mut w = BinaryWriter::with_capacity(4 + events.len() * 68);
+	w.u32(events.len() as u32);
+	for event in events {
+		let len_at = w.buf.len();
+		w.u32(0);
+		write_input_event(&mut w, event);
+		let len = (w.buf.len() - len_at - 4) as u32;
+		w.buf[len_at..len_at + 4].copy_from_slice(&len.to_le_bytes());
+	}
+	w.into_bytes()
+}
+
+pub fn decode_input_batch(bytes: &[u8]) -> Result<Vec<InputEventPayload>, ProtocolError> {
+	let mut r = BinaryReader::new(bytes);
+	let count = r.u32()? as usize;
+	// Every event takes at least its length prefix and kind byte.
+	let mut events = Vec::with_capacity(count.min(r.bytes.len() / 5));
+	for _ in 0..count {
+		let len = r.u32()? as usize;
+		if r.bytes.len() < len {
+			return Err(ProtocolError::InvalidPayload(
+				"binary payload is truncated".into(),
+			));
+		}
+		let (event, rest) = r.bytes.split_at(len);
+		r.bytes = rest;
+		events.push(decode_input_event(event)?);
+	}
+	r.finish()?;
+	Ok(events)
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	const MONITOR_ID: &str = "mon_0123456789abcdef";
+
+	fn contact(id: i32) -> TouchContact {
+		TouchContact {
+			id,
+			x: 1.5,
+			y: 2.5,
+			x_transformed: 150.0,
+			y_transformed: 250.0,
+		}
+	}
+
+	fn tool(tool_type: TabletToolType) -> TabletTool {
+		TabletTool {
+			serial: 0xdead_beef,
+			tool_type,
+			capability: TabletToolCapability {
+				pressure: true,
+				distance: false,
+				tilt: true,
+				rotation: false,
+				slider: false,
+				wheel: true,
+			},
+		}
+	}
+
+	/// One event of every kind, with every enum value showing up at least once.
+	fn every_event() -> Vec<InputEventPayload> {
+		use InputEventPayload as E;
+		let mut events = vec![
+			E::PointerMotion {
+				device: 1,
+				time_usec: 10,
+				x: 1.0,
+				y: 2.0,
+				dx: -3.0,
+				dy: 4.0,
+				unaccel_dx: -5.0,
+				unaccel_dy: 6.0,
+			},
+			E::PointerMotionAbsolute {
+				device: 1,
+				time_usec: 11,
+				x: 0.25,
+				y: 0.75,
+				x_transformed: 480.0,
+				y_transformed: 810.0,
+			},
+			E::TouchDown {
+				device: 2,
+				time_usec: 12,
+				contact: contact(0),
+			},
+			E::TouchMotion {
+				device: 2,
+				time_usec: 13,
+				contact: contact(1),
+			},
+			E::TouchUp {
+				device: 2,
+				time_usec: 14,
+				contact_id: 1,
+			},
+			E::TouchFrame { time_usec: 15 },
+			E::TouchCancel { time_usec: 16 },
+			E::TabletToolAxis {
+				device: 3,
+				time_usec: 17,
+				tool: tool(TabletToolType::Airbrush),
+				axes: TabletToolAxes {
+					x: 10.0,
+					y: 20.0,
+					pressure: Some(0.5),
+					distance: None,
+					tilt_x: Some(-12.0),
+					tilt_y: Some(8.0),
+					rotation: None,
+					slider: None,
+					wheel_delta: Some(15.0),
+					buttons: vec![0x14b, 0x14c],
+				},
+			},
+			E::TablePadButton {
+				device: 3,
+				time_usec: 18,
+				button: 2,
+				state: ButtonState::Pressed,
+			},
+			E::GestureSwipeBegin {
+				device: 4,
+				time_usec: 19,
+				fingers: 3,
+			},
+			E::GestureSwipeUpdate {
+				device: 4,
+				time_usec: 20,
+				fingers: 3,
+				dx: 1.0,
+				dy: -1.0,
+			},
+			E::GestureSwipeEnd {
+				device: 4,
+				time_usec: 21,
+				cancelled: false,
+			},
+			E::GesturePinchBegin {
+				device: 4,
+				time_usec: 22,
+				fingers: 2,
+			},
+			E::GesturePinchUpdate {
+				device: 4,
+				time_usec: 23,
+				fingers: 2,
+				dx: 0.5,
+				dy: 0.25,
+				scale: 1.25,
+				rotation: -3.0,
+			},
+			E::GesturePinchEnd {
+				device: 4,
+				time_usec: 24,
+				cancelled: true,
+			},
+			E::GestureHoldBegin {
+				device: 4,
+				time_usec: 25,
+				fingers: 4,
+			},
+			E::GestureHoldEnd {
+				device: 4,
+				time_usec: 26,
+				cancelled: false,
+			},
+		];
+		for (i, state) in [ButtonState::Pressed, ButtonState::Released]
+			.into_iter()
+			.enumerate()
+		{
+			events.push(E::PointerButton {
+				device: 1,
+				time_usec: 30 + i as u64,
+				button: 0x110,
+				state: state.clone(),
+			});
+			events.push(E::TabletToolButton {
+				device: 3,
+				time_usec: 30 + i as u64,
+				tool: tool(TabletToolType::Pen),
+				button: 0x14b,
+				state,
+			});
+		}
+		for state in [KeyState::Pressed, KeyState::Released] {
+			events.push(E::Key {
+				device: 5,
+				time_usec: 40,
+				key: 30,
+				state,
+			});
+		}
+		for state in [TipState::Down, TipState::Up] {
+			events.push(E::TabletToolTip {
+				device: 3,
+				time_usec: 50,
+				tool: tool(TabletToolType::Eraser),
+				state,
+			});
+		}
+		for (i, tool_type) in TOOL_TYPES.into_iter().enumerate() {
+			events.push(E::TableToolProximity {
+				device: 3,
+				time_usec: 60 + i as u64,
+				in_proximity: i % 2 == 0,
+				tool: tool(tool_type),
+			});
+		}
+		for orientation in [AxisOrientation::Vertical, AxisOrientation::Horizontal] {
+			for phase in [
+				AxisPhase::Started,
+				AxisPhase::Moved,
+				AxisPhase::Ended,
+				AxisPhase::Cancelled,
+			] {
+				events.push(E::PointerAxis {
+					device: 1,
+					time_usec: 70,
+					orientation: orientation.clone(),
+					delta: 15.0,
+					delta_discrete: matches!(phase, AxisPhase::Moved).then_some(1),
+					source: AxisSource::Finger,
+					phase,
+				});
+			}
+		}
+		for source in [
+			AxisSource::Wheel,
+			AxisSource::Finger,
+			AxisSource::Continuous,
+			AxisSource::WheelTilt,
+		] {
+			events.push(E::TablePadRing {
+				device: 3,
+				time_usec: 80,
+				ring: 0,
+				position: 90.0,
+				source: source.clone(),
+			});
+			events.push(E::TablePadStrip {
+				device: 3,
+				time_usec: 81,
+				strip: 1,
+				position: 0.5,
+				source,
+			});
+		}
+		for switch in [SwitchType::Lid, SwitchType::TabletMode] {
+			for state in [SwitchState::On, SwitchState::Off] {
+				events.push(E::SwitchToggle {
+					device: 6,
+					time_usec: 90,
+					switch: switch.clone(),
+					state,
+				});
+			}
+		}
+		events
+	}
+
+	#[test]
+	fn round_trips_buffer_payloads() {
+		for buffer in [BufferIndex::Zero, BufferIndex::One] {
+			let bytes = encode_buffer_payload(MONITOR_ID, buffer).unwrap();
+			assert_eq!(
+				decode_buffer_payload(&bytes).unwrap(),
+				(MONITOR_ID.to_string(), buffer)
+			);
+		}
+	}
+
+	#[test]
+	fn round_trips_buffer_requests() {
+		let damage = [
+			DamageRect {
+				x: 0,
+				y: 0,
+				width: 64,
+				height: 32,
+			},
+			DamageRect {
+				x: -16,
+				y: 100,
+				width: 1,
+				height: 1,
+			},
+		];
+		for damage in [&damage[..], &[]] {
+			let bytes = encode_buffer_request_payload(MONITOR_ID, BufferIndex::One, damage).unwrap();
+			assert_eq!(
+				decode_buffer_request_payload(&bytes).unwrap(),
+				BufferRequestPayload {
+					monitor_id: MONITOR_ID.into(),
+					buffer: BufferIndex::One,
+					damage: damage.to_vec(),
+				}
+			);
+		}
+	}
+
+	#[test]
+	fn merges_damage_past_the_limit_instead_of_dropping_it() {
+		let damage = (0..MAX_DAMAGE_RECTS as i32 + 4)
+			.map(|i| DamageRect {
+				x: i * 10,
+				y: 0,
+				width: 5,
+				height: 5,
+			})
+			.collect::<Vec<_>>();
+		let bytes = encode_buffer_request_payload(MONITOR_ID, BufferIndex::One, &damage).unwrap();
+		let decoded = decode_buffer_request_payload(&bytes).unwrap();
+		assert_eq!(decoded.damage, DamageRect::clamp_count(&damage));
+		assert_eq!(
+			decoded.damage.last(),
+			Some(&DamageRect {
+				x: (MAX_DAMAGE_RECTS as i32 - 1) * 10,
+				y: 0,
+				width: 45,
+				height: 5,
+			})
+		);
+	}
+
+	#[test]
+	fn round_trips_every_input_event() {
+		for event in every_event() {
+			let bytes = encode_input_event(&event);
+			assert_eq!(decode_input_event(&bytes).unwrap(), event);
+		}
+	}
+
+	#[test]
+	fn round_trips_input_batches() {
+		let events = every_event();
+		assert_eq!(
+			decode_input_batch(&encode_input_batch(&events)).unwrap(),
+			events
+		);
+		assert!(
+			decode_input_batch(&encode_input_batch(&[]))
+				.unwrap()
+				.is_empty()
+		);
+	}
+
+	#[test]
+	fn rejects_truncated_and_padded_payloads() {
+		let bytes = encode_input_event(&every_event()[0]);
+		assert!(decode_input_event(&bytes[..bytes.len() - 1]).is_err());
+		let mut padded = bytes;
+		padded.push(0);
+		assert!(matches!(
+			decode_input_event(&padded),
+			Err(ProtocolError::TrailingData)
+		));
+	}
+
+	#[test]
+	fn refuses_strings_over_255_bytes() {
+		let longest = "m".repeat(255);
+		let bytes = encode_buffer_payload(&longest, BufferIndex::Zero).unwrap();
+		assert_eq!(decode_buffer_payload(&bytes).unwrap().0, longest);
+
+		let too_long = "m".repeat(256);
+		assert!(encode_buffer_payload(&too_long, BufferIndex::Zero).is_err());
+		assert!(encode_buffer_request_payload(&too_long, BufferIndex::Zero, &[]).is_err());
+	}
+}
@@ -0,0 +1,359 @@
+//! Recording of the frames a [`crate::TabMessageFrameReader`] receives, for replaying a
+//! session's traffic later.
+//!
+//! A capture file starts with [`CAPTURE_MAGIC`], followed by one record per frame:
+//!
+//! ```text
+//! u64 timestamp_ns | u32 frame_len | u8 fd_count | fd_count × (u8 kind, u8 signaled, u64 size) | frame
+//! ```
+//!
+//! Integers are little-endian, `timestamp_ns` is `CLOCK_MONOTONIC` at the moment the frame
+//! was parsed and `frame` holds the bytes exactly as they came over the wire. FDs cannot be
+//! stored, so each one is described by what it was and how large, which is enough to stand
+//! in placeholders of the same shape.
+//!
+//! The token of a captured `auth` frame is blanked before it is written, and capture files
+//! are only readable by their owner.
+
+use std::{
+	borrow::Cow,
+	fs::{File, OpenOptions, Permissions},
+	io::{self, BufReader, BufWriter, ErrorKind, Read, Write},
+	mem::ManuallyDrop,
+	os::{
+		fd::{BorrowedFd, FromRawFd, RawFd},
+		unix::fs::{OpenOptionsExt, PermissionsExt},
+	},
+	path::Path,
+};
+
+use nix::poll::{PollFd, PollFlags, PollTimeout, poll};
+
+use crate::{AuthPayload, ProtocolError, TabMessageFrame, latency::monotonic_ns, message_header};
+
+/// First bytes of every capture file; the last byte is the format version.
+pub const CAPTURE_MAGIC: &[u8; 8] = b"TABCAP\0\x01";
+/// Captured data is flushed to the file at least this often.
+const FLUSH_INTERVAL_NS: u64 = 1_000_000_000;
+
+/// What a received FD referred to.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+#[repr(u8)]
+pub enum FdKind {
+	DmaBuf = 0,
+	SyncFile = 1,
+	EventFd = 2,
+	Memfd = 3,
+	Other = 255,
+}
+impl FdKind {
+	fn from_u8(raw: u8) -> Self {
+		match raw {
+			0 => Self::DmaBuf,
+			1 => Self::SyncFile,
+			2 => Self::EventFd,
+			3 => Self::Memfd,
+			_ => Self::Other,
+		}
+	}
+	/// Classifies `fd` by the name the kernel gives it in `/proc/self/fd`.
+	fn of(fd: RawFd) -> Self {
+		let Ok(target) = std::fs::read_link(format!("/proc/self/fd/{fd}")) else {
+			return Self::Other;
+		};
+		let target = target.to_string_lossy();
+		if target.starts_with("/dmabuf:") {
+			Self::DmaBuf
+		} else if target == "anon_inode:sync_file" {
+			Self::SyncFile
+		} else if target == "anon_inode:[eventfd]" {
+			Self::EventFd
+		} else if target.starts_with("/memfd:") {
+			Self::Memfd
+		} else {
+			Self::Other
+		}
+	}
+}
+
+/// Metadata of one FD attached to a captured frame.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct FdInfo {
+	pub kind: FdKind,
+	/// Whether the FD was already readable when the frame arrived; for a fence, whether it
+	/// had signaled.
+	pub signaled: bool,
+	/// Size reported by `fstat`, the buffer size for dma-bufs and memfds.
+	pub size: u64,
+}
+impl FdInfo {
+	const ENCODED_LEN: usize = 10;
+
+	fn of(fd: RawFd) -> Self {
+		// Borrow the FD as a file for `fstat` without taking ownership of it.
+		let file = ManuallyDrop::new(unsafe { File::from_raw_fd(fd) });
+		let size = file.metadata().map(|meta| meta.len()).unwrap_or(0);
+		let borrowed = unsafe { BorrowedFd::borrow_raw(fd) };
+		let mut poll_fds = [PollFd::new(borrowed, PollFlags::POLLIN)];
+		let signaled = poll(&mut poll_fds, PollTimeout::ZERO).is_ok_and(|ready| ready > 0);
+		Self {
+			kind: FdKind::of(fd),
+			signaled,
+			size,
+		}
+	}
+}
+
+/// One frame read back from a capture file. The frame's `fds` are always empty; see
+/// [`CaptureRecord::fds`] for what was attached.
+#[derive(Debug, Clone)]
+pub struct CaptureRecord {
+	pub timestamp_ns: u64,
+	pub frame: TabMessageFrame,
+	pub fds: Vec<FdInfo>,
+}
+
+/// `frame` with the session token of an `auth` frame blanked, so a capture cannot be used to
+/// authenticate. Replay authenticates with a token of its own.
+fn redact(frame: &[u8]) -> Cow<'_, [u8]> {
+	let Some(payload) = frame
+		.strip_prefix(message_header::AUTH.as_bytes())
+		.and_then(|rest| rest.strip_prefix(b"\n"))
+	else {
+		return Cow::Borrowed(frame);
+	};
+	let payload = payload.strip_suffix(b"\n").unwrap_or(payload);
+	// An `auth` that does not parse is kept without its payload rather than verbatim.
+	let body = serde_json::from_slice::<AuthPayload>(payload)
+		.ok()
+		.and_then(|mut auth| {
+			auth.token.clear();
+			serde_json::to_string(&auth).ok()
+		})
+		.unwrap_or_else(|| "\0\0\0\0".into());
+	Cow::Owned(format!("{}\n{body}\n", message_header::AUTH).into_bytes())
+}
+
+/// Appends received frames to a capture file. Install it with
+/// [`crate::TabMessageFrameReader::set_capture`].
+pub struct CaptureWriter {
+	out: Box<dyn Write + Send>,
+	last_flush_ns: u64,
+}
+impl CaptureWriter {
+	/// Creates (or truncates) the capture file at `path`, readable only by its owner.
+	pub fn create(path: impl AsRef<Path>) -> io::Result<Self> {
+		let file = OpenOptions::new()
+			.write(true)
+			.create(true)
+			.truncate(true)
+			.mode(0o600)
+			.open(path)?;
+		// `mode` only applies to new files; an existing one keeps its permissions otherwise.
+		file.set_permissions(Permissions::from_mode(0o600))?;
+		Self::new(BufWriter::new(file))
+	}
+	pub fn new(out: impl Write + Send + 'static) -> io::Result<Self> {
+		let mut out: Box<dyn Write + Send> = Box::new(out);
+		out.write_all(CAPTURE_MAGIC)?;
+		Ok(Self {
+			out,
+			last_flush_ns: monotonic_ns(),
+		})
+	}
+	/// Records one frame given its wire bytes and the FDs that came with it.
+	pub fn record(&mut self, frame: &[u8], fds: &[RawFd]) -> io::Result<()> {
+		let now_ns = monotonic_ns();
+		let frame = redact(frame);
+		let len = u32::try_from(frame.len())
+			.map_err(|_| io::Error::new(ErrorKind::InvalidInput, "frame too large to capture"))?;
+		let fd_count = u8::try_from(fds.len())
+			.map_err(|_| io::Error::new(ErrorKind::InvalidInput, "too many fds to capture"))?;
+		let mut head = Vec::with_capacity(13 + fds.len() * FdInfo::ENCODED_LEN);
+		head.extend_from_slice(&now_ns.to_le_bytes());
+		head.extend_from_slice(&len.to_le_bytes());
+		head.push(fd_count);
+		for fd in fds {
+			let info = FdInfo::of(*fd);
+			head.push(info.kind as u8);
+			head.push(info.signaled as u8);
+			head.extend_from_slice(&info.size.to_le_bytes());
+		}
+		self.out.write_all(&head)?;
+		self.out.write_all(&frame)?;
+		if now_ns.saturating_sub(self.last_flush_ns) >= FLUSH_INTERVAL_NS {
+			self.out.flush()?;
+			self.last_flush_ns = now_ns;
+		}
+		Ok(())
+	}
+	pub fn flush(&mut self) -> io::Result<()> {
+		self.out.flush()
+	}
+}
+impl Drop for CaptureWriter {
+	fn drop(&mut self) {
+		let _ = self.out.flush();
+	}
+}
+
+/// Reads the records of a capture file in order.
+pub struct CaptureReader<R: Read = BufReader<File>> {
+	input: R,
+}
+impl CaptureReader {
+	pub fn open(path: impl AsRef<Path>) -> Result<Self, ProtocolError> {
+		Self::new(BufReader::new(File::open(path)?))
+	}
+}
+impl<R: Read> CaptureReader<R> {
+	pub fn new(mut input: R) -> Result<Self, ProtocolError> {
+		let mut magic = [0u8; CAPTURE_MAGIC.len()];
+		input.read_exact(&mut magic)?;
+		if &magic != CAPTURE_MAGIC {
+			return Err(ProtocolError::InvalidCapture(
+				"not a tab capture file".into(),
+			));
+		}
+		Ok(Self { input })
+	}
+	/// The next record, or `None` at the end of the file. A record cut short by a crash
+	/// while capturing also ends the file.
+	pub fn next_record(&mut self) -> Result<Option<CaptureRecord>, ProtocolError> {
+		let mut head = [0u8; 13];
+		match self.input.read_exact(&mut head) {
+			Ok(()) => {}
+			Err(e) if e.kind() == ErrorKind::UnexpectedEof => return Ok(None),
+			Err(e) => return Err(e.into()),
+		}
+		let timestamp_ns = u64::from_le_bytes(head[0..8].try_into().unwrap());
+		let len = u32::from_le_bytes(head[8..12].try_into().unwrap()) as usize;
+		let mut fd_bytes = vec![0u8; head[12] as usize * FdInfo::ENCODED_LEN];
+		let mut bytes = vec![0u8; len];
+		match self
+			.input
+			.read_exact(&mut fd_bytes)
+			.and_then(|()| self.input.read_exact(&mut bytes))
+		{
+			Ok(()) => {}
+			Err(e) if e.kind() == ErrorKind::UnexpectedEof => return Ok(None),
+			Err(e) => return Err(e.into()),
+		}
+		let fds = fd_bytes
+			.chunks_exact(FdInfo::ENCODED_LEN)
+			.map(|chunk| FdInfo {
+				kind: FdKind::from_u8(chunk[0]),
+				signaled: chunk[1] != 0,
+				size: u64::from_le_bytes(chunk[2..10].try_into().unwrap()),
+			})
+			.collect();
+		let Some((frame, used)) = TabMessageFrame::parse_from_bytes(&bytes, Vec::new())? else {
+			return Err(ProtocolError::InvalidCapture(
+				"record does not hold a complete frame".into(),
+			));
+		};
+		if used != bytes.len() {
+			return Err(ProtocolError::InvalidCapture(
+				"record holds more than one frame".into(),
+			));
+		}
+		Ok(Some(CaptureRecord {
+			timestamp_ns,
+			frame,
+			fds,
+		}))
+	}
+}
+impl<R: Read> Iterator for CaptureReader<R> {
+	type Item = Result<CaptureRecord, ProtocolError>;
+
+	fn next(&mut self) -> Option<Self::Item> {
+		self.next_record().transpose()
+	}
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	fn temp_path(name: &str) -> std::path::PathBuf {
+		std::env::temp_dir().join(format!("tab-capture-{}-{name}", std::process::id()))
+	}
+
+	#[test]
+	fn round_trips_frames_and_fd_metadata() {
+		let path = temp_path("round-trip");
+		let fd_path = temp_path("round-trip-fd");
+		std::fs::write(&fd_path, b"12345").unwrap();
+		let attached = File::open(&fd_path).unwrap();
+		{
+			let mut writer = CaptureWriter::create(&path).unwrap();
+			writer.record(b"ping\n\0\0\0\0\n", &[]).unwrap();
+			writer
+				.record(
+					b"input 3\nabc\n",
+					&[std::os::fd::AsRawFd::as_raw_fd(&attached)],
+				)
+				.unwrap();
+		}
+		let mode = std::fs::metadata(&path).unwrap().permissions().mode();
+		assert_eq!(mode & 0o777, 0o600);
+
+		let records = CaptureReader::open(&path)
+			.unwrap()
+			.collect::<Result<Vec<_>, _>>()
+			.unwrap();
+		assert_eq!(records.len(), 2);
+		assert_eq!(records[0].frame.header.0, "ping");
+		assert!(records[0].fds.is_empty());
+		assert!(records[0].timestamp_ns <= records[1].timestamp_ns);
+		assert_eq!(records[1].frame.binary.as_deref(), Some(&b"abc"[..]));
+		assert_eq!(
+			records[1].fds,
+			[FdInfo {
+				kind: FdKind::Other,
+				signaled: true,
+				size: 5,
+			}]
+		);
+		std::fs::remove_file(path).unwrap();
+		std::fs::remove_file(fd_path).unwrap();
+	}
+
+	#[test]
+	fn blanks_the_auth_token() {
+		let frame = TabMessageFrame::json(
+			message_header::AUTH,
+			AuthPayload {
+				token: "secret".into(),
+				encoding: Default::default(),
+				input_ring: true,
+				input_batch: false,
+			},
+		);
+		let (header, payload) = frame.serialize();
+		let bytes = format!("{header}\n{payload}\n");
+		let redacted = redact(bytes.as_bytes());
+		let (parsed, _) = TabMessageFrame::parse_from_bytes(&redacted, Vec::new())
+			.unwrap()
+			.unwrap();
+		let auth: AuthPayload = serde_json::from_str(parsed.payload.as_deref().unwrap()).unwrap();
+		assert!(auth.token.is_empty());
+		assert!(auth.input_ring);
+
+		let other = b"ping\n\0\0\0\0\n";
+		assert!(matches!(redact(other), Cow::Borrowed(_)));
+	}
+
+	#[test]
+	fn truncated_records_end_the_capture() {
+		let mut bytes = CAPTURE_MAGIC.to_vec();
+		bytes.extend_from_slice(&0u64.to_le_bytes());
+		bytes.extend_from_slice(&100u32.to_le_bytes());
+		bytes.push(0);
+		bytes.extend_from_slice(b"short");
+		let mut reader = CaptureReader::new(&bytes[..]).unwrap();
+		assert!(reader.next_record().unwrap().is_none());
+		assert!(CaptureReader::new(&b"NOTACAPT"[..]).is_err());
+	}
+}
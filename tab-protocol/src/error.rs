@@ -11,6 +11,8 @@ pub enum ProtocolError {
 	InvalidPayload(String),
 	#[error("utf8 error: {0}")]
 	Utf8(#[from] std::string::FromUtf8Error),
+	#[error("utf8 error: {0}")]
+	Utf8Str(#[from] std::str::Utf8Error),
 	#[error("nix error: {0}")]
 	Nix(#[from] nix::Error),
 	#[error("unexpected extra data after payload")]
@@ -25,4 +27,10 @@ pub enum ProtocolError {
 		"Expected the received message to contain exactly {expected} attached file descriptors, got {found}"
 	)]
 	ExpectedFds { expected: u32, found: u32 },
+	#[error(
+		"Expected the received message to contain between {min} and {max} attached file descriptors, got {found}"
+	)]
+	ExpectedFdRange { min: u32, max: u32, found: u32 },
+	#[error("invalid capture file: {0}")]
+	InvalidCapture(String),
 }
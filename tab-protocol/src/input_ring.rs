@@ -0,0 +1,413 @@
+//! Shared-memory ring carrying input events from Shift to a single session.
+//!
+//! The ring is a memfd shared between exactly one producer (Shift) and one consumer (the
+//! client), plus an eventfd used for wakeups. Records are fixed-size slots holding the
+//! [`binary`](crate::binary) encoding of an [`InputEventPayload`].
+//!
+//! Layout (all offsets in bytes, integers native-endian):
+//!
+//! | offset | field                                        |
+//! |--------|----------------------------------------------|
+//! | 0      | magic, version, capacity, slot size (`u32`s) |
+//! | 64     | head (`u64`, written by the producer)        |
+//! | 128    | tail (`u64`, written by the consumer)        |
+//! | 192    | overflows (`u64`, written by the producer)   |
+//! | 256    | `capacity` slots of `slot size` bytes        |
+//!
+//! Each slot starts with a `u32` payload length. The producer only signals the eventfd when it
+//! pushes into an empty ring, so a burst costs one wakeup instead of one syscall per event.
+//!
+//! Events are never dropped. A batch that does not fit is refused as a whole and the producer
+//! sends it some other way (Shift uses the socket). Later batches are refused too until the
+//! producer calls [`InputRing::resume`], which Shift does once the client reported it has read
+//! everything sent the other way, so events from the two paths don't interleave.
+
+use std::fs::File;
+use std::io::{ErrorKind, Read, Write};
+use std::num::NonZeroUsize;
+use std::os::fd::{AsFd, BorrowedFd, OwnedFd};
+use std::ptr::NonNull;
+use std::sync::atomic::{AtomicU32, AtomicU64, Ordering};
+
+use nix::sys::eventfd::{EfdFlags, EventFd};
+use nix::sys::memfd::{MemFdCreateFlag, memfd_create};
+use nix::sys::mman::{MapFlags, ProtFlags, mmap, munmap};
+use serde::{Deserialize, Serialize};
+
+use crate::{
+	InputEventPayload, ProtocolError,
+	binary::{self, BinaryWriter},
+};
+
+pub const INPUT_RING_MAGIC: u32 = u32::from_le_bytes(*b"TABR");
+pub const INPUT_RING_VERSION: u32 = 1;
+/// Slots per ring unless the server picks otherwise. Must be a power of two.
+pub const INPUT_RING_DEFAULT_CAPACITY: u32 = 1024;
+/// Bytes per slot, including the `u32` length prefix.
+pub const INPUT_RING_SLOT_SIZE: u32 = 256;
+
+const HEAD_OFFSET: usize = 64;
+const TAIL_OFFSET: usize = 128;
+const OVERFLOWS_OFFSET: usize = 192;
+const SLOTS_OFFSET: usize = 256;
+
+/// Ring geometry announced in `auth_ok`; the memfd and eventfd travel as the frame's FDs.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct InputRingInfo {
+	pub capacity: u32,
+	pub slot_size: u32,
+}
+
+#[derive(Debug, thiserror::Error)]
+pub enum InputRingPushError {
+	#[error("input ring is full")]
+	Full,
+	#[error("input event does not fit in a ring slot ({0} bytes)")]
+	TooLarge(usize),
+}
+
+/// One end of a shared input ring. Shift holds the producer end, the client the consumer end;
+/// each end must only call its own half of the API.
+pub struct InputRing {
+	base: NonNull<u8>,
+	len: usize,
+	info: InputRingInfo,
+	memfd: OwnedFd,
+	wakeup: File,
+	/// Producer-side copy of `head`, so a misbehaving consumer can't steer writes.
+	local_head: u64,
+	/// Producer: a batch was refused and [`InputRing::resume`] was not called since.
+	overflowed: bool,
+	/// Producer: encoding buffer reused for every event.
+	scratch: BinaryWriter,
+}
+
+// The mapping is only touched through atomics and the SPSC protocol above.
+unsafe impl Send for InputRing {}
+
+impl InputRing {
+	/// Creates a new ring and eventfd for the producer side.
+	pub fn create(capacity: u32) -> Result<Self, ProtocolError> {
+		if !capacity.is_power_of_two() {
+			return Err(ProtocolError::InvalidPayload(format!(
+				"input ring capacity {capacity} is not a power of two"
+			)));
+		}
+		let info = InputRingInfo {
+			capacity,
+			slot_size: INPUT_RING_SLOT_SIZE,
+		};
+		let memfd = memfd_create(c"tab-input-ring", MemFdCreateFlag::MFD_CLOEXEC)?;
+		let len = Self::mapping_len(info);
+		File::from(memfd.try_clone()?).set_len(len as u64)?;
+		let wakeup: OwnedFd =
+			EventFd::from_value_and_flags(0, EfdFlags::EFD_CLOEXEC | EfdFlags::EFD_NONBLOCK)?.into();
+		let ring = Self::map(memfd, wakeup, info)?;
+		ring.header(0).store(INPUT_RING_MAGIC, Ordering::Relaxed);
+		ring.header(1).store(INPUT_RING_VERSION, Ordering::Relaxed);
+		ring.header(2).store(info.capacity, Ordering::Relaxed);
+		ring.header(3).store(info.slot_size, Ordering::Release);
+		Ok(ring)
+	}
+
+	/// Maps a ring received from Shift for the consumer side.
+	pub fn from_fds(
+		memfd: OwnedFd,
+		wakeup: OwnedFd,
+		info: InputRingInfo,
+	) -> Result<Self, ProtocolError> {
+		if !info.capacity.is_power_of_two() || (info.slot_size as usize) < 8 {
+			return Err(ProtocolError::InvalidPayload(
+				"invalid input ring geometry".into(),
+			));
+		}
+		let len = (info.capacity as u64)
+			.checked_mul(info.slot_size as u64)
+			.and_then(|slots| slots.checked_add(SLOTS_OFFSET as u64));
+		// Mapping past the end of a shorter memfd would fault on the first access instead.
+		let size = File::from(memfd.try_clone()?).metadata()?.len();
+		if len.is_none_or(|len| size < len) {
+			return Err(ProtocolError::InvalidPayload(format!(
+				"input ring memfd of {size} bytes is too small for its geometry"
+			)));
+		}
+		let ring = Self::map(memfd, wakeup, info)?;
+		let header_matches = ring.header(0).load(Ordering::Acquire) == INPUT_RING_MAGIC
+			&& ring.header(1).load(Ordering::Relaxed) == INPUT_RING_VERSION
+			&& ring.header(2).load(Ordering::Relaxed) == info.capacity
+			&& ring.header(3).load(Ordering::Relaxed) == info.slot_size;
+		if !header_matches {
+			return Err(ProtocolError::InvalidPayload(
+				"input ring header does not match auth_ok".into(),
+			));
+		}
+		Ok(ring)
+	}
+
+	fn mapping_len(info: InputRingInfo) -> usize {
+		SLOTS_OFFSET + info.capacity as usize * info.slot_size as usize
+	}
+
+	fn map(memfd: OwnedFd, wakeup: OwnedFd, info: InputRingInfo) -> Result<Self, ProtocolError> {
+		let len = Self::mapping_len(info);
+		let base = unsafe {
+			mmap(
+				None,
+				NonZeroUsize::new(len).expect("ring mapping is never empty"),
+				ProtFlags::PROT_READ | ProtFlags::PROT_WRITE,
+				MapFlags::MAP_SHARED,
+				&memfd,
+				0,
+			)?
+		};
+		Ok(Self {
+			base: base.cast(),
+			len,
+			info,
+			memfd,
+			wakeup: File::from(wakeup),
+			local_head: 0,
+			overflowed: false,
+			scratch: BinaryWriter::with_capacity(INPUT_RING_SLOT_SIZE as usize),
+		})
+	}
+
+	pub fn info(&self) -> InputRingInfo {
+		self.info
+	}
+
+	pub fn memfd(&self) -> BorrowedFd<'_> {
+		self.memfd.as_fd()
+	}
+
+	/// Eventfd that becomes readable when events are pushed into an empty ring.
+	pub fn wakeup_fd(&self) -> BorrowedFd<'_> {
+		self.wakeup.as_fd()
+	}
+
+	/// Batches the producer could not push because the ring was full.
+	pub fn overflows(&self) -> u64 {
+		self.counter(OVERFLOWS_OFFSET).load(Ordering::Relaxed)
+	}
+
+	fn header(&self, index: usize) -> &AtomicU32 {
+		unsafe { &*(self.base.as_ptr().add(index * 4) as *const AtomicU32) }
+	}
+
+	fn counter(&self, offset: usize) -> &AtomicU64 {
+		unsafe { &*(self.base.as_ptr().add(offset) as *const AtomicU64) }
+	}
+
+	fn slot(&self, position: u64) -> *mut u8 {
+		let index = (position & (self.info.capacity as u64 - 1)) as usize;
+		unsafe {
+			self
+				.base
+				.as_ptr()
+				.add(SLOTS_OFFSET + index * self.info.slot_size as usize)
+		}
+	}
+
+	/// Producer: appends `event`, see [`InputRing::push_batch`].
+	pub fn push(&mut self, event: &InputEventPayload) -> Result<(), InputRingPushError> {
+		self.push_batch(std::slice::from_ref(event))
+	}
+
+	/// Producer: appends all of `events` or none of them, signalling the eventfd if the ring
+	/// was empty. After a refused batch, every batch is refused until [`InputRing::resume`].
+	pub fn push_batch(&mut self, events: &[InputEventPayload]) -> Result<(), InputRingPushError> {
+		if self.overflowed {
+			return Err(InputRingPushError::Full);
+		}
+		let head = self.local_head;
+		let tail = self.counter(TAIL_OFFSET).load(Ordering::Acquire);
+		if head.wrapping_sub(tail) + events.len() as u64 > self.info.capacity as u64 {
+			return Err(self.refuse(InputRingPushError::Full));
+		}
+		if events.is_empty() {
+			return Ok(());
+		}
+		// Slots past `head` are not visible to the consumer until it is published, so a batch
+		// abandoned halfway leaves nothing behind.
+		let max = self.info.slot_size as usize - 4;
+		for (position, event) in (head..).zip(events) {
+			self.scratch.clear();
+			binary::write_input_event(&mut self.scratch, event);
+			let bytes = self.scratch.as_bytes();
+			if bytes.len() > max {
+				let len = bytes.len();
+				return Err(self.refuse(InputRingPushError::TooLarge(len)));
+			}
+			let slot = self.slot(position);
+			unsafe {
+				(slot as *mut u32).write_unaligned(bytes.len() as u32);
+				std::ptr::copy_nonoverlapping(bytes.as_ptr(), slot.add(4), bytes.len());
+			}
+		}
+		self.local_head = head + events.len() as u64;
+		self
+			.counter(HEAD_OFFSET)
+			.store(self.local_head, Ordering::SeqCst);
+		// Re-read the tail after publishing so a consumer that just drained the ring
+		// and is about to sleep still gets woken.
+		if self.counter(TAIL_OFFSET).load(Ordering::SeqCst) == head {
+			let _ = (&self.wakeup).write(&1u64.to_ne_bytes());
+		}
+		Ok(())
+	}
+
+	fn refuse(&mut self, err: InputRingPushError) -> InputRingPushError {
+		self.overflowed = true;
+		self
+			.counter(OVERFLOWS_OFFSET)
+			.fetch_add(1, Ordering::Relaxed);
+		err
+	}
+
+	/// Producer: whether batches are refused since one did not fit.
+	pub fn is_overflowed(&self) -> bool {
+		self.overflowed
+	}
+
+	/// Producer: accepts batches again. Only call once the consumer has received everything
+	/// sent in place of the refused batches, or new ring events could overtake it.
+	pub fn resume(&mut self) {
+		self.overflowed = false;
+	}
+
+	/// Consumer: pops the next event, or `None` if the ring is empty. Never makes a syscall.
+	pub fn pop(&mut self) -> Result<Option<InputEventPayload>, ProtocolError> {
+		let tail = self.counter(TAIL_OFFSET).load(Ordering::Relaxed);
+		let head = self.counter(HEAD_OFFSET).load(Ordering::SeqCst);
+		if head == tail {
+			return Ok(None);
+		}
+		let slot = self.slot(tail);
+		let max = self.info.slot_size as usize - 4;
+		let result = unsafe {
+			let len = (slot as *const u32).read_unaligned() as usize;
+			if len > max {
+				Err(ProtocolError::Truncated)
+			} else {
+				binary::decode_input_event(std::slice::from_raw_parts(slot.add(4), len))
+			}
+		};
+		self
+			.counter(TAIL_OFFSET)
+			.store(tail.wrapping_add(1), Ordering::SeqCst);
+		result.map(Some)
+	}
+
+	/// Consumer: resets the eventfd. Call before draining so no wakeup is lost.
+	pub fn clear_wakeup(&self) {
+		let mut buf = [0u8; 8];
+		match (&self.wakeup).read(&mut buf) {
+			Ok(_) => {}
+			Err(e) if e.kind() == ErrorKind::WouldBlock => {}
+			Err(e) => tracing::warn!("failed to clear input ring wakeup: {e}"),
+		}
+	}
+}
+
+impl Drop for InputRing {
+	fn drop(&mut self) {
+		unsafe {
+			let _ = munmap(self.base.cast(), self.len);
+		}
+	}
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+	use crate::KeyState;
+
+	fn key(key: u32) -> InputEventPayload {
+		InputEventPayload::Key {
+			device: 1,
+			time_usec: key as u64,
+			key,
+			state: KeyState::Pressed,
+		}
+	}
+
+	fn pair(capacity: u32) -> (InputRing, InputRing) {
+		let producer = InputRing::create(capacity).unwrap();
+		let consumer = InputRing::from_fds(
+			producer.memfd().try_clone_to_owned().unwrap(),
+			producer.wakeup_fd().try_clone_to_owned().unwrap(),
+			producer.info(),
+		)
+		.unwrap();
+		(producer, consumer)
+	}
+
+	fn drain(consumer: &mut InputRing) -> Vec<InputEventPayload> {
+		std::iter::from_fn(|| consumer.pop().unwrap()).collect()
+	}
+
+	#[test]
+	fn wraps_around_in_order() {
+		let (mut producer, mut consumer) = pair(4);
+		for round in 0..5u32 {
+			let events = (0..3).map(|i| key(round * 3 + i)).collect::<Vec<_>>();
+			producer.push_batch(&events).unwrap();
+			assert_eq!(drain(&mut consumer), events);
+		}
+		assert_eq!(producer.overflows(), 0);
+	}
+
+	#[test]
+	fn full_ring_refuses_whole_batches_until_drained() {
+		let (mut producer, mut consumer) = pair(4);
+		producer.push_batch(&[key(0), key(1), key(2)]).unwrap();
+		assert!(matches!(
+			producer.push_batch(&[key(3), key(4)]),
+			Err(InputRingPushError::Full)
+		));
+		// Fits, but would land after the refused batch the caller sent elsewhere.
+		assert!(matches!(
+			producer.push(&key(5)),
+			Err(InputRingPushError::Full)
+		));
+		assert_eq!(drain(&mut consumer), [key(0), key(1), key(2)]);
+		// Draining alone is not enough: what went elsewhere may still be unread.
+		assert!(matches!(
+			producer.push(&key(5)),
+			Err(InputRingPushError::Full)
+		));
+		assert!(producer.is_overflowed());
+		producer.resume();
+		producer.push(&key(6)).unwrap();
+		assert_eq!(drain(&mut consumer), [key(6)]);
+		assert_eq!(consumer.overflows(), 1);
+	}
+
+	#[test]
+	fn oversized_events_are_refused() {
+		let (mut producer, mut consumer) = pair(4);
+		// No event outgrows a real slot, so shrink the producer's view of them instead.
+		producer.info.slot_size = 8;
+		assert!(matches!(
+			producer.push_batch(&[key(0), key(1)]),
+			Err(InputRingPushError::TooLarge(_))
+		));
+		assert!(drain(&mut consumer).is_empty());
+		assert_eq!(producer.overflows(), 1);
+	}
+
+	#[test]
+	fn rejects_memfd_smaller_than_its_geometry() {
+		let producer = InputRing::create(4).unwrap();
+		let info = InputRingInfo {
+			capacity: 1 << 20,
+			slot_size: producer.info().slot_size,
+		};
+		let result = InputRing::from_fds(
+			producer.memfd().try_clone_to_owned().unwrap(),
+			producer.wakeup_fd().try_clone_to_owned().unwrap(),
+			info,
+		);
+		assert!(matches!(result, Err(ProtocolError::InvalidPayload(_))));
+	}
+}
@@ -0,0 +1,187 @@
+//! Latency histograms Shift keeps per session and monitor, reported in `stats`.
+//!
+//! Buckets are powers of two in microseconds: bucket `0` counts samples under 1µs, bucket `i`
+//! samples in `[2^(i-1), 2^i)`µs, and the last bucket everything from `2^(LATENCY_BUCKETS - 2)`µs
+//! up. Histograms only ever grow; consumers diff two reports to get a window.
+
+use nix::time::{ClockId, clock_gettime};
+use serde::{Deserialize, Serialize};
+
+/// Number of buckets; the last one is unbounded (~4.2s and up).
+pub const LATENCY_BUCKETS: usize = 24;
+
+/// `CLOCK_MONOTONIC` in nanoseconds, the clock Shift timestamps input, vblanks and latency
+/// samples with.
+pub fn monotonic_ns() -> u64 {
+	clock_gettime(ClockId::CLOCK_MONOTONIC)
+		.map(|ts| ts.tv_sec() as u64 * 1_000_000_000 + ts.tv_nsec() as u64)
+		.unwrap_or(0)
+}
+
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct LatencyHistogram {
+	pub count: u64,
+	pub sum_us: u64,
+	pub max_us: u64,
+	pub buckets: [u64; LATENCY_BUCKETS],
+}
+
+impl LatencyHistogram {
+	pub fn record_us(&mut self, us: u64) {
+		self.count += 1;
+		self.sum_us = self.sum_us.saturating_add(us);
+		self.max_us = self.max_us.max(us);
+		self.buckets[Self::bucket_of(us)] += 1;
+	}
+
+	pub fn record_ns(&mut self, ns: u64) {
+		self.record_us(ns / 1_000);
+	}
+
+	/// Index of the bucket `us` falls in.
+	pub fn bucket_of(us: u64) -> usize {
+		((u64::BITS - us.leading_zeros()) as usize).min(LATENCY_BUCKETS - 1)
+	}
+
+	/// Exclusive upper bound of bucket `index` in microseconds, `None` for the last one.
+	pub fn bucket_upper_us(index: usize) -> Option<u64> {
+		(index < LATENCY_BUCKETS - 1).then(|| 1 << index)
+	}
+
+	pub fn mean_us(&self) -> u64 {
+		self.sum_us.checked_div(self.count).unwrap_or(0)
+	}
+
+	/// Upper bound of the bucket holding quantile `q` (`0.0..=1.0`), capped at the maximum
+	/// seen. `0` while empty.
+	pub fn quantile_us(&self, q: f64) -> u64 {
+		if self.count == 0 {
+			return 0;
+		}
+		let rank = ((self.count as f64 * q.clamp(0.0, 1.0)).ceil() as u64).max(1);
+		let mut seen = 0;
+		for (index, count) in self.buckets.iter().enumerate() {
+			seen += count;
+			if seen >= rank {
+				return Self::bucket_upper_us(index).map_or(self.max_us, |upper| upper.min(self.max_us));
+			}
+		}
+		self.max_us
+	}
+
+	pub fn merge(&mut self, other: &Self) {
+		self.count += other.count;
+		self.sum_us = self.sum_us.saturating_add(other.sum_us);
+		self.max_us = self.max_us.max(other.max_us);
+		for (bucket, count) in self.buckets.iter_mut().zip(other.buckets) {
+			*bucket += count;
+		}
+	}
+}
+
+/// Frame latency of one session on one monitor.
+#[derive(Debug, Clone, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct MonitorLatencyStats {
+	pub monitor_id: String,
+	/// `buffer_request` received until its acquire fence signaled (or it was accepted, without
+	/// a fence).
+	pub acquire: LatencyHistogram,
+	/// Buffer ready until composited into a frame.
+	pub composite: LatencyHistogram,
+	/// Frame composited until its page flip completed.
+	pub present: LatencyHistogram,
+	/// Release fence attached until `buffer_release` was sent.
+	pub release: LatencyHistogram,
+}
+
+#[derive(Debug, Clone, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct SessionLatencyStats {
+	pub session_id: String,
+	/// libinput event timestamp until the event was handed to the session.
+	pub input: LatencyHistogram,
+	pub monitors: Vec<MonitorLatencyStats>,
+}
+
+/// Reply to `stats_request`: histograms since Shift started, for every live session.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct StatsPayload {
+	pub sessions: Vec<SessionLatencyStats>,
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	const LAST: usize = LATENCY_BUCKETS - 1;
+
+	#[test]
+	fn buckets_are_powers_of_two() {
+		assert_eq!(LatencyHistogram::bucket_of(0), 0);
+		assert_eq!(LatencyHistogram::bucket_of(1), 1);
+		for index in 1..LAST {
+			let lower = 1 << (index - 1);
+			let upper = LatencyHistogram::bucket_upper_us(index).unwrap();
+			assert_eq!(upper, 1 << index);
+			assert_eq!(LatencyHistogram::bucket_of(lower), index);
+			assert_eq!(LatencyHistogram::bucket_of(upper - 1), index);
+			assert_eq!(LatencyHistogram::bucket_of(upper), index + 1);
+		}
+	}
+
+	#[test]
+	fn last_bucket_is_unbounded() {
+		assert_eq!(LatencyHistogram::bucket_upper_us(LAST), None);
+		assert_eq!(LatencyHistogram::bucket_of(1 << (LAST - 1)), LAST);
+		assert_eq!(LatencyHistogram::bucket_of(u64::MAX), LAST);
+	}
+
+	#[test]
+	fn records_count_sum_and_max() {
+		let mut histogram = LatencyHistogram::default();
+		assert_eq!(histogram.mean_us(), 0);
+		assert_eq!(histogram.quantile_us(0.5), 0);
+
+		histogram.record_us(100);
+		histogram.record_ns(300_999);
+		histogram.record_us(u64::MAX);
+		assert_eq!(histogram.count, 3);
+		assert_eq!(histogram.sum_us, u64::MAX);
+		assert_eq!(histogram.max_us, u64::MAX);
+		assert_eq!(histogram.buckets[LatencyHistogram::bucket_of(300)], 1);
+		assert_eq!(histogram.buckets.iter().sum::<u64>(), 3);
+	}
+
+	#[test]
+	fn quantiles_are_bucket_bounds_capped_at_the_max() {
+		let mut histogram = LatencyHistogram::default();
+		for _ in 0..9 {
+			histogram.record_us(100);
+		}
+		histogram.record_us(5_000);
+		assert_eq!(histogram.mean_us(), 590);
+		assert_eq!(histogram.quantile_us(0.5), 128);
+		assert_eq!(histogram.quantile_us(0.9), 128);
+		assert_eq!(histogram.quantile_us(0.99), 5_000);
+		assert_eq!(histogram.quantile_us(0.0), 128);
+		assert_eq!(histogram.quantile_us(2.0), 5_000);
+	}
+
+	#[test]
+	fn merging_adds_up() {
+		let mut a = LatencyHistogram::default();
+		let mut b = LatencyHistogram::default();
+		a.record_us(10);
+		b.record_us(10);
+		b.record_us(1_000);
+		a.merge(&b);
+		assert_eq!((a.count, a.sum_us, a.max_us), (3, 1_020, 1_000));
+		assert_eq!(a.buckets[LatencyHistogram::bucket_of(10)], 2);
+	}
+
+	#[test]
+	fn monotonic_clock_never_goes_back() {
+		let first = monotonic_ns();
+		assert!(first > 0);
+		assert!(monotonic_ns() >= first);
+	}
+}
@@ -2,6 +2,7 @@
 //! - Message framing over Unix domain sockets (sendmsg/recvmsg + SCM_RIGHTS)
 //! - Raw TabMessageFrame representation (header + payload string + FDs)
 //! - Parsing helpers into typed TabMessage variants
+//! - Optional binary payloads for hot-path messages (see [`binary`])
 
 use serde::{Deserialize, Serialize};
 use std::{
@@ -10,27 +11,54 @@ use std::{
 	time::Duration,
 };
 
+pub mod binary;
+pub mod capture;
+pub mod input_ring;
+pub mod latency;
 pub mod message_frame;
 pub mod unix_socket_utils;
 /// Default Unix domain socket for Tab connections.
 pub const DEFAULT_SOCKET_PATH: &str = "/tmp/shift.sock";
 /// Protocol identifier string expected in `hello` payloads. Used to check if the client and server are compatible.
 pub const PROTOCOL_VERSION: &str = const_str::concat!("tab/v", env!("CARGO_PKG_VERSION"));
+/// Smallest swapchain a client may link with `framebuffer_link`.
+pub const MIN_SWAPCHAIN_BUFFERS: usize = 2;
+/// Largest swapchain a client may link with `framebuffer_link`.
+pub const MAX_SWAPCHAIN_BUFFERS: usize = 4;
+/// Most planes a linked dma-buf may describe.
+pub const MAX_DMABUF_PLANES: usize = 4;
+/// Most FDs a single frame may carry; receivers reserve control-message space for this many.
+pub const MAX_FRAME_FDS: usize = 32;
+/// Largest payload a frame may carry. Receivers reject longer frames instead of buffering them.
+pub const MAX_FRAME_PAYLOAD: usize = 1024 * 1024;
+/// Most damage rectangles a `buffer_request` may carry; clients merge anything beyond this.
+pub const MAX_DAMAGE_RECTS: usize = 16;
+/// `DRM_FORMAT_MOD_LINEAR`.
+pub const DRM_FORMAT_MOD_LINEAR: u64 = 0;
+/// `DRM_FORMAT_MOD_INVALID`: the layout is implied by the driver.
+pub const DRM_FORMAT_MOD_INVALID: u64 = 0x00ff_ffff_ffff_ffff;
 #[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Serialize, Deserialize)]
 #[repr(u8)]
 pub enum BufferIndex {
 	Zero = 0,
 	One = 1,
+	Two = 2,
+	Three = 3,
+}
+impl BufferIndex {
+	/// Every buffer index in slot order, up to [`MAX_SWAPCHAIN_BUFFERS`].
+	pub const ALL: [BufferIndex; MAX_SWAPCHAIN_BUFFERS] =
+		[Self::Zero, Self::One, Self::Two, Self::Three];
+
+	pub fn from_index(index: usize) -> Option<Self> {
+		Self::ALL.get(index).copied()
+	}
 }
 impl FromStr for BufferIndex {
 	type Err = ();
 
 	fn from_str(s: &str) -> Result<Self, ()> {
-		match s {
-			"0" => Ok(Self::Zero),
-			"1" => Ok(Self::One),
-			_ => Err(()),
-		}
+		s.parse::<usize>().ok().and_then(Self::from_index).ok_or(())
 	}
 }
 /// Parsed, semantic Tab message.
@@ -38,22 +66,33 @@ impl FromStr for BufferIndex {
 pub enum TabMessage {
 	Hello(HelloPayload),
 	Auth(AuthPayload),
-	AuthOk(AuthOkPayload),
+	AuthOk {
+		payload: AuthOkPayload,
+		/// Input ring memfd and eventfd, present when `payload.input_ring` is set.
+		input_ring_fds: Option<(OwnedFd, OwnedFd)>,
+	},
 	AuthError(AuthErrorPayload),
 	FramebufferLink {
 		payload: FramebufferLinkPayload,
-		dma_bufs: [OwnedFd; 2],
+		/// One dma-buf per swapchain buffer, in buffer index order.
+		dma_bufs: Vec<OwnedFd>,
 	},
+	/// Several `framebuffer_link`s in one frame, each with its own dma-bufs.
+	FramebufferLinkBatch(Vec<(FramebufferLinkPayload, Vec<OwnedFd>)>),
 	BufferRequest {
 		payload: BufferRequestPayload,
 		acquire_fence: Option<OwnedFd>,
 	},
 	BufferRequestAck(BufferRequestAckPayload),
+	BufferRequestRejected(BufferRequestRejectedPayload),
 	BufferRelease {
 		payload: BufferReleasePayload,
 		release_fence: Option<OwnedFd>,
 	},
+	FramePresented(FramePresentedPayload),
 	InputEvent(InputEventPayload),
+	InputBatch(InputBatchPayload),
+	InputCaughtUp(InputCaughtUpPayload),
 	MonitorAdded(MonitorAddedPayload),
 	MonitorRemoved(MonitorRemovedPayload),
 	SessionSwitch(SessionSwitchPayload),
@@ -64,6 +103,10 @@ pub enum TabMessage {
 	SessionActive(SessionActivePayload),
 	SessionAwake(SessionAwakePayload),
 	SessionSleep(SessionSleepPayload),
+	PresentMode(PresentModePayload),
+	GpuMemory(GpuMemoryPayload),
+	StatsRequest,
+	Stats(StatsPayload),
 	Error(ErrorPayload),
 	Ping,
 	Pong,
@@ -75,12 +118,23 @@ impl TryFrom<TabMessageFrame> for TabMessage {
 		Self::parse_message_frame(value)
 	}
 }
+impl TryFrom<TabMessageFrameRef<'_>> for TabMessage {
+	type Error = ProtocolError;
+	fn try_from(value: TabMessageFrameRef<'_>) -> Result<Self, ProtocolError> {
+		Self::parse_frame_ref(value)
+	}
+}
 
 impl TabMessage {
 	/// Parse the raw TabMessageFrame into a typed `TabMessage` variant.
-	#[tracing::instrument(skip_all, fields(header = %msg.header.0))]
 	pub fn parse_message_frame(msg: TabMessageFrame) -> Result<Self, ProtocolError> {
-		let header = msg.header.0.as_str();
+		Self::parse_frame_ref(msg.as_frame_ref())
+	}
+
+	/// Parse a frame borrowed from the reader's buffer; only the typed payload is allocated.
+	#[tracing::instrument(skip_all, fields(header = %msg.header))]
+	pub fn parse_frame_ref(msg: TabMessageFrameRef<'_>) -> Result<Self, ProtocolError> {
+		let header = msg.header;
 
 		match header {
 			message_header::HELLO => {
@@ -93,7 +147,21 @@ impl TabMessage {
 			}
 			message_header::AUTH_OK => {
 				let payload: AuthOkPayload = msg.expect_payload_json()?;
-				Ok(TabMessage::AuthOk(payload))
+				let input_ring_fds = if payload.input_ring.is_some() {
+					msg.expect_n_fds(2)?;
+					Some(unsafe {
+						(
+							OwnedFd::from_raw_fd(msg.fds[0]),
+							OwnedFd::from_raw_fd(msg.fds[1]),
+						)
+					})
+				} else {
+					None
+				};
+				Ok(TabMessage::AuthOk {
+					payload,
+					input_ring_fds,
+				})
 			}
 			message_header::AUTH_ERROR => {
 				let payload: AuthErrorPayload = msg.expect_payload_json()?;
@@ -101,30 +169,57 @@ impl TabMessage {
 			}
 			message_header::FRAMEBUFFER_LINK => {
 				let payload: FramebufferLinkPayload = msg.expect_payload_json()?;
-				msg.expect_n_fds(2)?;
-				let dma_bufs = unsafe {
-					[
-						OwnedFd::from_raw_fd(msg.fds[0]),
-						OwnedFd::from_raw_fd(msg.fds[1]),
-					]
-				};
+				if payload.planes.len() > MAX_DMABUF_PLANES {
+					return Err(ProtocolError::InvalidPayload(format!(
+						"framebuffer_link describes {} planes, at most {MAX_DMABUF_PLANES} are supported",
+						payload.planes.len()
+					)));
+				}
+				msg.expect_fds_in_range(MIN_SWAPCHAIN_BUFFERS as u32, MAX_SWAPCHAIN_BUFFERS as u32)?;
+				let dma_bufs = msg
+					.fds
+					.iter()
+					.map(|fd| unsafe { OwnedFd::from_raw_fd(*fd) })
+					.collect();
 				Ok(TabMessage::FramebufferLink { payload, dma_bufs })
 			}
+			message_header::FRAMEBUFFER_LINK_BATCH => {
+				let payload: FramebufferLinkBatchPayload = msg.expect_payload_json()?;
+				let mut expected_fds = 0u32;
+				for entry in &payload.links {
+					if entry.link.planes.len() > MAX_DMABUF_PLANES {
+						return Err(ProtocolError::InvalidPayload(format!(
+							"framebuffer_link_batch entry for {} describes {} planes, at most {MAX_DMABUF_PLANES} are supported",
+							entry.link.monitor_id,
+							entry.link.planes.len()
+						)));
+					}
+					if !(MIN_SWAPCHAIN_BUFFERS as u32..=MAX_SWAPCHAIN_BUFFERS as u32).contains(&entry.buffers)
+					{
+						return Err(ProtocolError::InvalidPayload(format!(
+							"framebuffer_link_batch entry for {} links {} buffers",
+							entry.link.monitor_id, entry.buffers
+						)));
+					}
+					expected_fds += entry.buffers;
+				}
+				msg.expect_n_fds(expected_fds)?;
+				let mut fds = msg
+					.fds
+					.iter()
+					.map(|fd| unsafe { OwnedFd::from_raw_fd(*fd) });
+				let links = payload
+					.links
+					.into_iter()
+					.map(|entry| {
+						let dma_bufs = fds.by_ref().take(entry.buffers as usize).collect();
+						(entry.link, dma_bufs)
+					})
+					.collect();
+				Ok(TabMessage::FramebufferLinkBatch(links))
+			}
 			message_header::BUFFER_REQUEST => {
-				let payload = msg.payload.clone().ok_or(ProtocolError::ExpectedPayload)?;
-				let err = ProtocolError::InvalidPayload(
-					r#""buffer_request" request requires 2 arguments: <monitor_id> <0 or 1 (buffer index)>"#
-						.into(),
-				);
-				let split = payload.split_ascii_whitespace().collect::<Vec<_>>();
-				let [monitor_id, buffer_index_str] = split[..] else {
-					return Err(err);
-				};
-				let buffer_index = buffer_index_str.parse().map_err(|_| err)?;
-				let payload = BufferRequestPayload {
-					monitor_id: monitor_id.into(),
-					buffer: buffer_index,
-				};
+				let payload = msg.expect_buffer_request_args()?;
 				let acquire_fence = match msg.fds.len() {
 					0 => None,
 					1 => Some(unsafe { OwnedFd::from_raw_fd(msg.fds[0]) }),
@@ -141,32 +236,33 @@ impl TabMessage {
 				})
 			}
 			message_header::BUFFER_REQUEST_ACK => {
-				let payload = msg.payload.clone().ok_or(ProtocolError::ExpectedPayload)?;
-				let err = ProtocolError::InvalidPayload(
-					r#""buffer_request_ack" event requires 2 arguments: <monitor_id> <0 or 1 (buffer index)>"#
-						.into(),
-				);
-				let split = payload.split_ascii_whitespace().collect::<Vec<_>>();
-				let [monitor_id, buffer_index_str] = split[..] else {
-					return Err(err);
-				};
-				let buffer_index = buffer_index_str.parse().map_err(|_| err)?;
+				let (monitor_id, buffer) = msg.expect_buffer_args("buffer_request_ack", "event")?;
 				Ok(TabMessage::BufferRequestAck(BufferRequestAckPayload {
-					monitor_id: monitor_id.into(),
-					buffer: buffer_index,
+					monitor_id,
+					buffer,
 				}))
 			}
-			message_header::BUFFER_RELEASE => {
-				let payload = msg.payload.clone().ok_or(ProtocolError::ExpectedPayload)?;
+			message_header::BUFFER_REQUEST_REJECTED => {
+				let payload = msg.payload.ok_or(ProtocolError::ExpectedPayload)?;
 				let err = ProtocolError::InvalidPayload(
-					r#""buffer_release" event requires 2 arguments: <monitor_id> <0 or 1 (buffer index)>"#
+					r#""buffer_request_rejected" event requires 3 arguments: <monitor_id> <buffer index> <code>"#
 						.into(),
 				);
 				let split = payload.split_ascii_whitespace().collect::<Vec<_>>();
-				let [monitor_id, buffer_index_str] = split[..] else {
+				let [monitor_id, buffer_index_str, code] = split[..] else {
 					return Err(err);
 				};
 				let buffer_index = buffer_index_str.parse().map_err(|_| err)?;
+				Ok(TabMessage::BufferRequestRejected(
+					BufferRequestRejectedPayload {
+						monitor_id: monitor_id.into(),
+						buffer: buffer_index,
+						code: code.into(),
+					},
+				))
+			}
+			message_header::BUFFER_RELEASE => {
+				let (monitor_id, buffer) = msg.expect_buffer_args("buffer_release", "event")?;
 				let release_fence = match msg.fds.len() {
 					0 => None,
 					1 => Some(unsafe { OwnedFd::from_raw_fd(msg.fds[0]) }),
@@ -178,17 +274,34 @@ impl TabMessage {
 					}
 				};
 				Ok(TabMessage::BufferRelease {
-					payload: BufferReleasePayload {
-						monitor_id: monitor_id.into(),
-						buffer: buffer_index,
-					},
+					payload: BufferReleasePayload { monitor_id, buffer },
 					release_fence,
 				})
 			}
+			message_header::FRAME_PRESENTED => {
+				let payload: FramePresentedPayload = msg.expect_payload_json()?;
+				Ok(TabMessage::FramePresented(payload))
+			}
 			message_header::INPUT_EVENT => {
-				let payload: InputEventPayload = msg.expect_payload_json()?;
+				let payload: InputEventPayload = match msg.binary {
+					Some(bytes) => binary::decode_input_event(bytes)?,
+					None => msg.expect_payload_json()?,
+				};
 				Ok(TabMessage::InputEvent(payload))
 			}
+			message_header::INPUT_BATCH => {
+				let payload: InputBatchPayload = match msg.binary {
+					Some(bytes) => InputBatchPayload {
+						events: binary::decode_input_batch(bytes)?,
+					},
+					None => msg.expect_payload_json()?,
+				};
+				Ok(TabMessage::InputBatch(payload))
+			}
+			message_header::INPUT_CAUGHT_UP => {
+				let payload: InputCaughtUpPayload = msg.expect_payload_json()?;
+				Ok(TabMessage::InputCaughtUp(payload))
+			}
 			message_header::MONITOR_ADDED => {
 				let payload: MonitorAddedPayload = msg.expect_payload_json()?;
 				Ok(TabMessage::MonitorAdded(payload))
@@ -229,26 +342,70 @@ impl TabMessage {
 				let payload: SessionSleepPayload = msg.expect_payload_json()?;
 				Ok(TabMessage::SessionSleep(payload))
 			}
+			message_header::PRESENT_MODE => {
+				let payload: PresentModePayload = msg.expect_payload_json()?;
+				Ok(TabMessage::PresentMode(payload))
+			}
+			message_header::GPU_MEMORY => {
+				let payload: GpuMemoryPayload = msg.expect_payload_json()?;
+				Ok(TabMessage::GpuMemory(payload))
+			}
+			message_header::STATS_REQUEST => Ok(TabMessage::StatsRequest),
+			message_header::STATS => {
+				let payload: StatsPayload = msg.expect_payload_json()?;
+				Ok(TabMessage::Stats(payload))
+			}
 			message_header::ERROR => {
 				let payload: ErrorPayload = msg.expect_payload_json()?;
 				Ok(TabMessage::Error(payload))
 			}
 			message_header::PING => Ok(TabMessage::Ping),
 			message_header::PONG => Ok(TabMessage::Pong),
-			_ => Ok(TabMessage::Unknown(msg)),
+			_ => Ok(TabMessage::Unknown(msg.into_owned())),
 		}
 	}
 }
+/// Payload encodings a peer can use for the hot-path messages.
+/// Control messages are always JSON.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum PayloadEncoding {
+	#[default]
+	Json,
+	/// Fixed-layout payloads from [`binary`] for `input_event`, `buffer_request`,
+	/// `buffer_request_ack` and `buffer_release`.
+	Binary,
+}
+
 /// Typed payloads
 #[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
 pub struct HelloPayload {
 	pub server: String,
 	pub protocol: String,
+	/// Encodings the server accepts. Older servers omit this and only speak JSON.
+	#[serde(default)]
+	pub encodings: Vec<PayloadEncoding>,
+	/// Same as [`AuthOkPayload::render_node`], sent early so clients can open the GPU while
+	/// authenticating.
+	#[serde(default, skip_serializing_if = "Option::is_none")]
+	pub render_node: Option<RenderNodeInfo>,
+	/// The server accepts `framebuffer_link_batch`.
+	#[serde(default)]
+	pub framebuffer_link_batch: bool,
 }
 
 #[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
 pub struct AuthPayload {
 	pub token: String,
+	/// Encoding the client wants for hot-path messages, picked from the `hello` list.
+	#[serde(default)]
+	pub encoding: PayloadEncoding,
+	/// Ask for input events through a shared-memory ring instead of `input_event` frames.
+	#[serde(default)]
+	pub input_ring: bool,
+	/// Accept `input_batch` frames. Without it each batch is split into `input_event`s.
+	#[serde(default)]
+	pub input_batch: bool,
 }
 
 #[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
@@ -258,6 +415,17 @@ pub struct MonitorInfo {
 	pub height: i32,
 	pub refresh_rate: i32,
 	pub name: String,
+	/// Formats Shift accepts in `framebuffer_link` for this monitor, best modifiers first.
+	/// Older servers omit this; clients then allocate implicit-modifier XRGB8888.
+	#[serde(default, skip_serializing_if = "Vec::is_empty")]
+	pub formats: Vec<FormatModifiers>,
+}
+
+/// A DRM fourcc and the modifiers it can be used with.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FormatModifiers {
+	pub fourcc: u32,
+	pub modifiers: Vec<u64>,
 }
 
 #[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
@@ -288,6 +456,24 @@ pub enum SessionRole {
 pub struct AuthOkPayload {
 	pub session: SessionInfo,
 	pub monitors: Vec<MonitorInfo>,
+	/// Encoding both sides use for hot-path messages from here on.
+	#[serde(default)]
+	pub encoding: PayloadEncoding,
+	/// Set when Shift granted an input ring; the memfd and eventfd are attached to the frame.
+	#[serde(default, skip_serializing_if = "Option::is_none")]
+	pub input_ring: Option<input_ring::InputRingInfo>,
+	/// Render node of the GPU Shift composites and scans out with.
+	#[serde(default, skip_serializing_if = "Option::is_none")]
+	pub render_node: Option<RenderNodeInfo>,
+}
+
+/// A DRM node, by path and by device number, so clients in another mount namespace can still
+/// find it under a different path.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct RenderNodeInfo {
+	pub path: String,
+	/// `st_rdev` of the node.
+	pub dev: u64,
 }
 
 #[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
@@ -300,15 +486,105 @@ pub struct FramebufferLinkPayload {
 	pub monitor_id: String,
 	pub width: i32,
 	pub height: i32,
+	/// Plane 0 layout, kept for servers that predate `planes`.
 	pub stride: i32,
 	pub offset: i32,
 	pub fourcc: i32,
+	/// Explicit modifier; `None` means the driver's implicit layout.
+	#[serde(default, skip_serializing_if = "Option::is_none")]
+	pub modifier: Option<u64>,
+	/// Every plane (up to [`MAX_DMABUF_PLANES`]), all inside each buffer's single dma-buf.
+	/// Empty means one plane described by `stride`/`offset`.
+	#[serde(default, skip_serializing_if = "Vec::is_empty")]
+	pub planes: Vec<PlaneLayout>,
+}
+
+/// Swapchains for several monitors, linked with one frame. The dma-bufs of every entry are
+/// attached in entry order, at most [`MAX_FRAME_FDS`] in total.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FramebufferLinkBatchPayload {
+	pub links: Vec<FramebufferLinkBatchEntry>,
+}
+
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FramebufferLinkBatchEntry {
+	pub link: FramebufferLinkPayload,
+	/// Number of dma-bufs that belong to this entry.
+	pub buffers: u32,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct PlaneLayout {
+	pub offset: i32,
+	pub stride: i32,
 }
 
 #[derive(Debug, Clone, PartialEq, Eq)]
 pub struct BufferRequestPayload {
 	pub monitor_id: String,
 	pub buffer: BufferIndex,
+	/// Regions that changed since the previous request on this monitor, in buffer pixels.
+	/// Empty means the whole buffer changed.
+	pub damage: Vec<DamageRect>,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Serialize, Deserialize)]
+pub struct DamageRect {
+	pub x: i32,
+	pub y: i32,
+	pub width: i32,
+	pub height: i32,
+}
+
+impl DamageRect {
+	/// Checks a rect received from a peer: the size must be non-negative and the far edges
+	/// must fit in an `i32`.
+	pub fn validate(self) -> Result<Self, ProtocolError> {
+		if self.width < 0
+			|| self.height < 0
+			|| self.x.checked_add(self.width).is_none()
+			|| self.y.checked_add(self.height).is_none()
+		{
+			return Err(ProtocolError::InvalidPayload(format!(
+				"invalid damage rectangle {self:?}"
+			)));
+		}
+		Ok(self)
+	}
+
+	/// Smallest rectangle covering both, saturating at the `i32` range.
+	pub fn union(self, other: Self) -> Self {
+		let x0 = self.x.min(other.x);
+		let y0 = self.y.min(other.y);
+		let x1 = self
+			.x
+			.saturating_add(self.width)
+			.max(other.x.saturating_add(other.width));
+		let y1 = self
+			.y
+			.saturating_add(self.height)
+			.max(other.y.saturating_add(other.height));
+		Self {
+			x: x0,
+			y: y0,
+			width: x1.saturating_sub(x0),
+			height: y1.saturating_sub(y0),
+		}
+	}
+
+	/// Caps `rects` at [`MAX_DAMAGE_RECTS`] by merging the tail into one bounding box.
+	pub fn clamp_count(rects: &[Self]) -> Vec<Self> {
+		if rects.len() <= MAX_DAMAGE_RECTS {
+			return rects.to_vec();
+		}
+		let (head, tail) = rects.split_at(MAX_DAMAGE_RECTS - 1);
+		let merged = tail[1..].iter().fold(tail[0], |acc, rect| acc.union(*rect));
+		head
+			.iter()
+			.copied()
+			.chain(std::iter::once(merged))
+			.collect()
+	}
 }
 
 #[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
@@ -317,11 +593,48 @@ pub struct BufferRequestAckPayload {
 	pub buffer: BufferIndex,
 }
 
+/// Sent instead of `buffer_request_ack` when a buffer request is refused.
+/// Ownership of the buffer does not change.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct BufferRequestRejectedPayload {
+	pub monitor_id: String,
+	pub buffer: BufferIndex,
+	/// Machine-readable reason, e.g. `ownership_violation` or `session_sleeping`.
+	pub code: String,
+}
+
+/// Sent after a page flip that scanned out this session's content on `monitor_id`.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FramePresentedPayload {
+	pub monitor_id: String,
+	/// Per-monitor flip counter, increasing by one per presented frame.
+	pub sequence: u64,
+	/// `CLOCK_MONOTONIC` time of the vblank the frame was shown at, in nanoseconds.
+	pub vblank_ns: u64,
+	/// Duration of one refresh cycle of the active mode, in nanoseconds.
+	pub refresh_ns: u64,
+	/// The flip landed at least one refresh later than the vblank following its commit.
+	pub missed: bool,
+}
+
 #[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
 pub struct BufferReleasePayload {
 	pub monitor_id: String,
 	pub buffer: BufferIndex,
 }
+/// Input coalesced by Shift since the session's last frame, oldest first.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct InputBatchPayload {
+	pub events: Vec<InputEventPayload>,
+}
+
+/// Sent by a client with an input ring once it has read every input frame Shift sent so far.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct InputCaughtUpPayload {
+	/// Input events received as `input_event` or `input_batch` frames since `auth_ok`.
+	pub socket_events: u64,
+}
+
 #[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 #[serde(tag = "kind", rename_all = "snake_case")]
 pub enum InputEventPayload {
@@ -490,6 +803,40 @@ pub enum InputEventPayload {
 	},
 }
 
+impl InputEventPayload {
+	/// When the kernel saw the event, in `CLOCK_MONOTONIC` microseconds.
+	pub fn time_usec(&self) -> u64 {
+		match self {
+			Self::PointerMotion { time_usec, .. }
+			| Self::PointerMotionAbsolute { time_usec, .. }
+			| Self::PointerButton { time_usec, .. }
+			| Self::PointerAxis { time_usec, .. }
+			| Self::Key { time_usec, .. }
+			| Self::TouchDown { time_usec, .. }
+			| Self::TouchUp { time_usec, .. }
+			| Self::TouchMotion { time_usec, .. }
+			| Self::TouchFrame { time_usec, .. }
+			| Self::TouchCancel { time_usec, .. }
+			| Self::TableToolProximity { time_usec, .. }
+			| Self::TabletToolAxis { time_usec, .. }
+			| Self::TabletToolTip { time_usec, .. }
+			| Self::TabletToolButton { time_usec, .. }
+			| Self::TablePadButton { time_usec, .. }
+			| Self::TablePadRing { time_usec, .. }
+			| Self::TablePadStrip { time_usec, .. }
+			| Self::SwitchToggle { time_usec, .. }
+			| Self::GestureSwipeBegin { time_usec, .. }
+			| Self::GestureSwipeUpdate { time_usec, .. }
+			| Self::GestureSwipeEnd { time_usec, .. }
+			| Self::GesturePinchBegin { time_usec, .. }
+			| Self::GesturePinchUpdate { time_usec, .. }
+			| Self::GesturePinchEnd { time_usec, .. }
+			| Self::GestureHoldBegin { time_usec, .. }
+			| Self::GestureHoldEnd { time_usec, .. } => *time_usec,
+		}
+	}
+}
+
 #[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
 pub enum ButtonState {
 	Pressed,
@@ -649,6 +996,62 @@ pub struct SessionSleepPayload {
 	pub session_id: String,
 }
 
+/// How a session wants its frames put on screen while it is shown fullscreen.
+///
+/// Shift does not enable VRR or tearing flips yet: every page flip waits for vblank. The
+/// non-vsync modes only stop Shift from holding a new buffer back until the predicted vblank.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash, Serialize, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum PresentMode {
+	/// Every frame is paced to the predicted vblank.
+	#[default]
+	Vsync,
+	/// Meant for variable refresh. For now: composited right away, flipped at the next vblank.
+	AdaptiveSync,
+	/// Meant for tearing flips. For now: composited right away, flipped at the next vblank.
+	Async,
+}
+
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct PresentModePayload {
+	pub mode: PresentMode,
+}
+
+/// GPU memory one session or monitor accounts for.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct GpuMemoryUsage {
+	/// Session or monitor id.
+	pub id: String,
+	/// Memory Shift allocated itself and counts against the budget.
+	pub bytes: u64,
+	/// Client-allocated buffers Shift holds imports of; reported, not budgeted.
+	#[serde(default)]
+	pub client_bytes: u64,
+	/// Snapshots dropped to stay within the budget, taken again once the session draws.
+	#[serde(default)]
+	pub evicted: bool,
+}
+
+/// Renderer GPU memory, sent to admin sessions.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct GpuMemoryPayload {
+	/// Memory Shift allocated itself, the amount the budget limits.
+	pub total_bytes: u64,
+	/// Configured budget; `None` when unlimited.
+	pub budget_bytes: Option<u64>,
+	/// Skia's own cache (blur pyramids, glyphs, scratch targets) beyond what is attributed below.
+	pub skia_cache_bytes: u64,
+	/// Imports kept for reuse after their slot went away.
+	pub retired_import_bytes: u64,
+	/// Client-allocated buffers imported for sessions, outside `total_bytes`.
+	#[serde(default)]
+	pub client_import_bytes: u64,
+	/// Snapshots and held client imports, per session.
+	pub sessions: Vec<GpuMemoryUsage>,
+	/// Render targets and transition caches, per monitor.
+	pub monitors: Vec<GpuMemoryUsage>,
+}
+
 #[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct ErrorPayload {
 	pub code: String,
@@ -661,4 +1064,32 @@ pub mod message_header;
 mod error;
 pub use error::*;
 
-pub use crate::message_frame::{TabMessageFrame, TabMessageFrameReader};
+pub use crate::latency::{
+	LatencyHistogram, MonitorLatencyStats, SessionLatencyStats, StatsPayload,
+};
+pub use crate::message_frame::{TabMessageFrame, TabMessageFrameReader, TabMessageFrameRef};
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	#[test]
+	fn damage_union_saturates() {
+		let a = DamageRect {
+			x: i32::MIN,
+			y: 0,
+			width: 0,
+			height: 1,
+		};
+		let b = DamageRect {
+			x: i32::MAX - 1,
+			y: 0,
+			width: 1,
+			height: 1,
+		};
+		let merged = a.union(b);
+		assert_eq!(merged.x, i32::MIN);
+		assert_eq!(merged.width, i32::MAX);
+		assert_eq!(merged.height, 1);
+	}
+}
@@ -2,143 +2,278 @@ use nix::errno::Errno;
 use nix::sys::socket::{ControlMessage, ControlMessageOwned, MsgFlags, recvmsg, sendmsg};
 use serde::Serialize;
 use std::collections::VecDeque;
-use std::io::{ErrorKind, IoSlice, IoSliceMut};
+use std::io::{ErrorKind, IoSlice, IoSliceMut, Write};
 use std::os::fd::{AsRawFd, RawFd};
 
-use crate::{HelloPayload, MessageHeader, PROTOCOL_VERSION, ProtocolError};
+use crate::{
+	BufferIndex, BufferRequestPayload, DamageRect, HelloPayload, MAX_DAMAGE_RECTS, MAX_FRAME_FDS,
+	MAX_FRAME_PAYLOAD, MessageHeader, PROTOCOL_VERSION, PayloadEncoding, ProtocolError,
+	RenderNodeInfo, TabMessage, binary, capture::CaptureWriter,
+};
 
 /// Raw framed Tab message: header line + payload line (strings) plus optional FDs.
+///
+/// Binary frames carry their payload in `binary` instead of `payload` and are framed as
+/// `<header> <len>\n<len bytes>\n`, since the bytes may contain newlines.
 #[derive(Debug, Clone, PartialEq, Eq)]
 pub struct TabMessageFrame {
 	pub header: MessageHeader,
 	pub payload: Option<String>,
+	pub binary: Option<Vec<u8>>,
 	pub fds: Vec<RawFd>,
 }
+/// Borrowed view of a frame parsed in place from a [`TabMessageFrameReader`] buffer.
+///
+/// Header and payload point into the reader's receive buffer; call
+/// [`TabMessageFrameRef::into_owned`] to keep the frame past the next read.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct TabMessageFrameRef<'a> {
+	pub header: &'a str,
+	pub payload: Option<&'a str>,
+	pub binary: Option<&'a [u8]>,
+	pub fds: Vec<RawFd>,
+}
+/// Location of one complete frame inside a byte slice.
+#[derive(Debug, Clone, Copy)]
+struct FrameSpan {
+	header: (usize, usize),
+	body: FrameBody,
+	len: usize,
+}
+#[derive(Debug, Clone, Copy)]
+enum FrameBody {
+	Empty,
+	Text(usize, usize),
+	Binary(usize, usize),
+}
 fn would_block_err() -> std::io::Error {
 	std::io::Error::new(ErrorKind::WouldBlock, ProtocolError::WouldBlock)
 }
-#[derive(Default)]
+/// Incremental frame reader over a reusable receive buffer.
+///
+/// Bytes are received straight into the buffer and frames are parsed where they land. The
+/// buffer is only compacted before the next receive, and then only the unparsed tail moves.
 pub struct TabMessageFrameReader {
-	pending_bytes: Vec<u8>,
-	pending_fds: Vec<RawFd>,
-	ready_frames: VecDeque<TabMessageFrame>,
+	buf: Vec<u8>,
+	/// First byte that has not been handed out as a frame yet.
+	start: usize,
+	/// End of the received bytes.
+	end: usize,
+	/// FDs received with a chunk, keyed by the buffer offset the chunk ended at. Stream sockets
+	/// stop a read right after a message carrying FDs, so they belong to the first frame that
+	/// ends at or past that offset.
+	pending_fds: VecDeque<(usize, Vec<RawFd>)>,
+	cmsg_space: Vec<u8>,
+	/// Records every frame handed out, see [`crate::capture`].
+	capture: Option<CaptureWriter>,
+}
+impl Default for TabMessageFrameReader {
+	fn default() -> Self {
+		Self {
+			buf: vec![0; Self::RECV_WINDOW],
+			start: 0,
+			end: 0,
+			pending_fds: VecDeque::new(),
+			cmsg_space: nix::cmsg_space!([RawFd; MAX_FRAME_FDS]),
+			capture: None,
+		}
+	}
 }
 impl TabMessageFrameReader {
+	/// Free space guaranteed before each receive. Large enough that a burst of queued input
+	/// and release messages is drained with a single `recvmsg`.
+	const RECV_WINDOW: usize = 64 * 1024;
+
 	pub fn new() -> Self {
 		Self::default()
 	}
-	fn pop_ready(&mut self) -> Option<TabMessageFrame> {
-		self.ready_frames.pop_front()
+	/// Starts (or with `None` stops) recording every frame this reader hands out. A failed
+	/// write stops the capture; reading goes on regardless.
+	pub fn set_capture(&mut self, capture: Option<CaptureWriter>) {
+		self.capture = capture;
 	}
-	pub fn try_pop_ready_frame(&mut self) -> Option<TabMessageFrame> {
-		self.pop_ready()
+	/// Pops the next frame that is already buffered, without touching the socket.
+	pub fn try_pop_ready_frame(&mut self) -> Result<Option<TabMessageFrame>, ProtocolError> {
+		Ok(
+			self
+				.next_buffered_frame()?
+				.map(TabMessageFrameRef::into_owned),
+		)
 	}
-	#[tracing::instrument(skip_all)]
-	fn feed_chunk(&mut self, bytes: &[u8], mut fds: Vec<RawFd>) -> Result<(), ProtocolError> {
-		if !bytes.is_empty() {
-			self.pending_bytes.extend_from_slice(bytes);
+	/// Borrows the next frame that is already buffered, without touching the socket.
+	pub fn next_buffered_frame(&mut self) -> Result<Option<TabMessageFrameRef<'_>>, ProtocolError> {
+		match self.next_span()? {
+			Some(span) => Ok(Some(self.take_span(span))),
+			None => Ok(None),
 		}
-		if !fds.is_empty() {
-			self.pending_fds.append(&mut fds);
+	}
+	fn next_span(&self) -> Result<Option<FrameSpan>, ProtocolError> {
+		if self.start == self.end {
+			return Ok(None);
 		}
-		self.process_pending()?;
-		Ok(())
+		FrameSpan::parse(&self.buf[self.start..self.end])
 	}
-	#[tracing::instrument(skip_all)]
-	fn process_pending(&mut self) -> Result<(), ProtocolError> {
-		loop {
-			if self.pending_bytes.is_empty() {
+	fn take_span(&mut self, span: FrameSpan) -> TabMessageFrameRef<'_> {
+		let base = self.start;
+		let frame_end = base + span.len;
+		self.start = frame_end;
+		let mut fds = Vec::new();
+		while let Some((mark, _)) = self.pending_fds.front() {
+			if *mark > frame_end {
 				break;
 			}
-			let fds_for_frame = self.pending_fds.clone();
-			match TabMessageFrame::parse_from_bytes(&self.pending_bytes, fds_for_frame)? {
-				Some((frame, used)) => {
-					self.pending_bytes.drain(..used);
-					self.pending_fds.clear();
-					self.ready_frames.push_back(frame);
+			let (_, mut chunk_fds) = self.pending_fds.pop_front().unwrap();
+			fds.append(&mut chunk_fds);
+		}
+		if let Some(capture) = &mut self.capture
+			&& let Err(e) = capture.record(&self.buf[base..frame_end], &fds)
+		{
+			tracing::warn!("stopping protocol capture: {e}");
+			self.capture = None;
+		}
+		if self.start == self.end {
+			self.start = 0;
+			self.end = 0;
+		}
+		span.view(&self.buf[base..frame_end], fds)
+	}
+	/// Receives whatever is queued on the socket into the buffer.
+	#[tracing::instrument(skip_all)]
+	fn fill(&mut self, stream: &impl AsRawFd) -> Result<(), ProtocolError> {
+		if self.start > 0 {
+			self.buf.copy_within(self.start..self.end, 0);
+			for (mark, _) in self.pending_fds.iter_mut() {
+				*mark -= self.start;
+			}
+			self.end -= self.start;
+			self.start = 0;
+		}
+		if self.buf.len() - self.end < Self::RECV_WINDOW {
+			self.buf.resize(self.end + Self::RECV_WINDOW, 0);
+		}
+		let mut iov = [IoSliceMut::new(&mut self.buf[self.end..])];
+		let msg = loop {
+			match recvmsg::<()>(
+				stream.as_raw_fd(),
+				&mut iov,
+				Some(&mut self.cmsg_space),
+				MsgFlags::MSG_CMSG_CLOEXEC,
+			) {
+				Err(errno) if errno == Errno::EINTR => continue,
+				Err(errno) if errno == Errno::EAGAIN || errno == Errno::EWOULDBLOCK => {
+					break Err(ProtocolError::WouldBlock);
 				}
-				None => break,
+				Err(errno) => break Err(ProtocolError::Nix(errno.into())),
+				Ok(msg) => break Ok(msg),
 			}
+		}?;
+		if msg.bytes == 0 {
+			return Err(ProtocolError::UnexpectedEof);
+		}
+		if msg.flags.contains(MsgFlags::MSG_TRUNC) {
+			return Err(ProtocolError::Truncated);
+		}
+		let mut fds = Vec::new();
+		for cmsg in msg.cmsgs()? {
+			if let ControlMessageOwned::ScmRights(rights) = cmsg {
+				fds.extend(rights);
+			}
+		}
+		let bytes = msg.bytes;
+		self.end += bytes;
+		if !fds.is_empty() {
+			self.pending_fds.push_back((self.end, fds));
 		}
 		Ok(())
 	}
+	/// Reads the next frame, borrowing it from the receive buffer.
 	#[tracing::instrument(skip_all)]
-	pub fn read_framed(&mut self, stream: &impl AsRawFd) -> Result<TabMessageFrame, ProtocolError> {
+	pub fn read_frame_ref(
+		&mut self,
+		stream: &impl AsRawFd,
+	) -> Result<TabMessageFrameRef<'_>, ProtocolError> {
 		loop {
-			if let Some(frame) = self.pop_ready() {
-				return Ok(frame);
+			if let Some(span) = self.next_span()? {
+				return Ok(self.take_span(span));
 			}
-			let (bytes, fds) = recv_into_vec(stream)?;
-			self.feed_chunk(&bytes, fds)?;
+			self.fill(stream)?;
 		}
 	}
+	#[tracing::instrument(skip_all)]
+	pub fn read_framed(&mut self, stream: &impl AsRawFd) -> Result<TabMessageFrame, ProtocolError> {
+		self
+			.read_frame_ref(stream)
+			.map(TabMessageFrameRef::into_owned)
+	}
+	/// Reads and parses the next message without copying the frame out of the receive buffer.
+	pub fn read_message(&mut self, stream: &impl AsRawFd) -> Result<TabMessage, ProtocolError> {
+		self.read_frame_ref(stream).and_then(TabMessage::try_from)
+	}
 	#[cfg(feature = "async")]
 	#[tracing::instrument(skip_all)]
-	pub async fn read_frame_from_async_fd<T: AsRawFd>(
-		&mut self,
+	pub async fn read_frame_ref_from_async_fd<'s, T: AsRawFd>(
+		&'s mut self,
 		fd: &tokio::io::unix::AsyncFd<T>,
-	) -> Result<TabMessageFrame, ProtocolError> {
+	) -> Result<TabMessageFrameRef<'s>, ProtocolError> {
 		loop {
-			if let Some(frame) = self.pop_ready() {
-				return Ok(frame);
+			if let Some(span) = self.next_span()? {
+				return Ok(self.take_span(span));
 			}
 			let mut guard = fd.readable().await?;
-			if let Ok(result) = guard.try_io(|_| match self.read_framed(fd.get_ref()) {
+			if let Ok(result) = guard.try_io(|inner| match self.fill(inner.get_ref()) {
 				Err(ProtocolError::WouldBlock) => Err(would_block_err()),
 				def => Ok(def),
 			}) {
-				break result?;
+				result??;
 			}
 		}
 	}
-}
-#[tracing::instrument(skip_all)]
-fn recv_into_vec(stream: &impl AsRawFd) -> Result<(Vec<u8>, Vec<RawFd>), ProtocolError> {
-	let mut buf = [0u8; 4096];
-	let mut cmsg_space = nix::cmsg_space!([RawFd; 8]);
-	let mut iov = [IoSliceMut::new(&mut buf)];
-	let msg = loop {
-		match recvmsg::<()>(
-			stream.as_raw_fd(),
-			&mut iov,
-			Some(&mut cmsg_space),
-			MsgFlags::empty(),
-		) {
-			Err(errno) if errno == Errno::EINTR => continue,
-			Err(errno) if errno == Errno::EAGAIN || errno == Errno::EWOULDBLOCK => {
-				break Err(ProtocolError::WouldBlock);
-			}
-			Err(errno) => break Err(ProtocolError::Nix(errno.into())),
-			Ok(msg) => break Ok(msg),
-		}
-	}?;
-	if msg.bytes == 0 {
-		return Err(ProtocolError::UnexpectedEof);
-	}
-	if msg.flags.contains(MsgFlags::MSG_TRUNC) {
-		return Err(ProtocolError::Truncated);
-	}
-	let mut fds = Vec::new();
-	let mut c_iter = msg.cmsgs()?;
-	while let Some(cmsg) = c_iter.next() {
-		if let ControlMessageOwned::ScmRights(rights) = cmsg {
-			fds.extend(rights);
-		}
+	#[cfg(feature = "async")]
+	pub async fn read_frame_from_async_fd<T: AsRawFd>(
+		&mut self,
+		fd: &tokio::io::unix::AsyncFd<T>,
+	) -> Result<TabMessageFrame, ProtocolError> {
+		self
+			.read_frame_ref_from_async_fd(fd)
+			.await
+			.map(TabMessageFrameRef::into_owned)
+	}
+	/// Async counterpart of [`TabMessageFrameReader::read_message`].
+	#[cfg(feature = "async")]
+	pub async fn read_message_from_async_fd<T: AsRawFd>(
+		&mut self,
+		fd: &tokio::io::unix::AsyncFd<T>,
+	) -> Result<TabMessage, ProtocolError> {
+		self
+			.read_frame_ref_from_async_fd(fd)
+			.await
+			.and_then(TabMessage::try_from)
 	}
-	let bytes = msg.bytes;
-	let _ = msg;
-	let data = iov[0][..bytes].to_vec();
-	Ok((data, fds))
 }
 impl TabMessageFrame {
 	/// Write a framed TabMessageFrame to the provided stream using sendmsg/SCM_RIGHTS.
 	pub fn encode_and_send(&self, stream: &impl AsRawFd) -> Result<(), ProtocolError> {
-		let (encoded_header, encoded_payload) = self.serialize();
-		let encoded_header = format!("{encoded_header}\n");
-		let encoded_payload = format!("{encoded_payload}\n");
+		let header_line = self.header.0.trim_end();
+		// Length suffix of a binary header line; " " + at most 20 digits.
+		let mut len_buf = [0u8; 21];
+		let (len_suffix, payload_bytes): (&[u8], &[u8]) = match &self.binary {
+			Some(bytes) => {
+				let remaining = {
+					let mut cursor = &mut len_buf[..];
+					write!(cursor, " {}", bytes.len()).expect("length fits in 21 bytes");
+					cursor.len()
+				};
+				let written = len_buf.len() - remaining;
+				(&len_buf[..written], bytes)
+			}
+			None => (&[], self.payload_line().as_bytes()),
+		};
 		let iov = [
-			IoSlice::new(encoded_header.as_bytes()),
-			IoSlice::new(encoded_payload.as_bytes()),
+			IoSlice::new(header_line.as_bytes()),
+			IoSlice::new(len_suffix),
+			IoSlice::new(b"\n"),
+			IoSlice::new(payload_bytes),
+			IoSlice::new(b"\n"),
 		];
 		let cmsg = if self.fds.is_empty() {
 			vec![]
@@ -148,15 +283,16 @@ impl TabMessageFrame {
 		sendmsg::<()>(stream.as_raw_fd(), &iov, &cmsg, MsgFlags::empty(), None)?;
 		Ok(())
 	}
-	pub fn serialize(&self) -> (String, String) {
-		let header_line = self.header.0.trim_end();
-		let payload_line = self
+	fn payload_line(&self) -> &str {
+		self
 			.payload
 			.as_ref()
 			.map(|p| p.trim_end_matches('\n'))
-			.unwrap_or_else(|| "\0\0\0\0");
-
-		(header_line.to_string(), payload_line.to_string())
+			.unwrap_or_else(|| "\0\0\0\0")
+	}
+	pub fn serialize(&self) -> (String, String) {
+		let header_line = self.header.0.trim_end();
+		(header_line.to_string(), self.payload_line().to_string())
 	}
 
 	/// Sends a message asynchronously
@@ -179,23 +315,11 @@ impl TabMessageFrame {
 		return Ok(packet);
 	}
 
-	#[tracing::instrument(skip_all)]
-	pub(crate) fn expect_payload_json<'a, T>(&'a self) -> Result<T, ProtocolError>
-	where
-		T: serde::Deserialize<'a>,
-	{
-		if let Some(payload) = &self.payload {
-			let span = tracing::span!(tracing::Level::TRACE, "json_decode");
-			let _enter = span.enter();
-			serde_json::from_str(payload.as_str()).map_err(ProtocolError::from)
-		} else {
-			Err(ProtocolError::ExpectedPayload)
-		}
-	}
 	pub fn json(header: impl Into<MessageHeader>, payload: impl Serialize) -> Self {
 		Self {
 			header: header.into(),
 			payload: Some(serde_json::to_string(&payload).unwrap()),
+			binary: None,
 			fds: Vec::new(),
 		}
 	}
@@ -204,6 +328,18 @@ impl TabMessageFrame {
 		Self {
 			header: header.into(),
 			payload: Some(body.into()),
+			binary: None,
+			fds: Vec::new(),
+		}
+	}
+
+	/// Frame carrying a fixed-layout payload from [`crate::binary`].
+	/// Only send these to peers that negotiated [`crate::PayloadEncoding::Binary`].
+	pub fn binary(header: impl Into<MessageHeader>, bytes: Vec<u8>) -> Self {
+		Self {
+			header: header.into(),
+			payload: None,
+			binary: Some(bytes),
 			fds: Vec::new(),
 		}
 	}
@@ -212,28 +348,28 @@ impl TabMessageFrame {
 		Self {
 			header: header.into(),
 			payload: None,
+			binary: None,
 			fds: Vec::new(),
 		}
 	}
-	pub fn hello(server: impl Into<String>) -> Self {
+	pub fn hello(server: impl Into<String>, render_node: Option<RenderNodeInfo>) -> Self {
 		let payload = HelloPayload {
 			server: server.into(),
 			protocol: PROTOCOL_VERSION.to_string(),
+			encodings: vec![PayloadEncoding::Json, PayloadEncoding::Binary],
+			render_node,
+			framebuffer_link_batch: true,
 		};
 		let json = serde_json::to_value(payload).expect("HelloPayload is serializable");
 		Self::json("hello", json)
 	}
 
 	pub fn expect_n_fds(&self, amount: u32) -> Result<(), ProtocolError> {
-		let found = self.fds.len() as u32;
-		if found == amount {
-			Ok(())
-		} else {
-			Err(ProtocolError::ExpectedFds {
-				expected: amount,
-				found,
-			})
-		}
+		self.as_frame_ref().expect_n_fds(amount)
+	}
+
+	pub fn expect_fds_in_range(&self, min: u32, max: u32) -> Result<(), ProtocolError> {
+		self.as_frame_ref().expect_fds_in_range(min, max)
 	}
 
 	#[tracing::instrument(skip_all, fields(frame_size = bytes.len(), fds = fds.len()))]
@@ -241,35 +377,288 @@ impl TabMessageFrame {
 		bytes: &[u8],
 		fds: Vec<RawFd>,
 	) -> Result<Option<(Self, usize)>, ProtocolError> {
-		let Some(first_nl) = bytes.iter().position(|b| *b == b'\n') else {
+		let Some(span) = FrameSpan::parse(bytes)? else {
 			return Ok(None);
 		};
+		let frame = span.view(&bytes[..span.len], fds).into_owned();
+		Ok(Some((frame, span.len)))
+	}
+
+	/// Borrows this frame as a [`TabMessageFrameRef`].
+	pub fn as_frame_ref(&self) -> TabMessageFrameRef<'_> {
+		TabMessageFrameRef {
+			header: self.header.0.as_str(),
+			payload: self.payload.as_deref(),
+			binary: self.binary.as_deref(),
+			fds: self.fds.clone(),
+		}
+	}
+}
+
+impl FrameSpan {
+	/// Locates the first complete frame in `bytes` and validates its text parts.
+	fn parse(bytes: &[u8]) -> Result<Option<Self>, ProtocolError> {
+		// A header line never comes close to this; without the bound a peer that never sends
+		// a newline would grow the receive buffer forever.
+		let Some(first_nl) = bytes.iter().position(|b| *b == b'\n') else {
+			return Self::incomplete(bytes.len());
+		};
+		if let Some(split) = bytes[..first_nl].iter().position(|b| *b == b' ') {
+			let len: usize = std::str::from_utf8(&bytes[split + 1..first_nl])
+				.ok()
+				.and_then(|len| len.parse().ok())
+				.ok_or_else(|| ProtocolError::InvalidPayload("invalid binary payload length".into()))?;
+			if len > MAX_FRAME_PAYLOAD {
+				return Err(ProtocolError::InvalidPayload(format!(
+					"binary payload of {len} bytes exceeds {MAX_FRAME_PAYLOAD}"
+				)));
+			}
+			let start = first_nl + 1;
+			let end = start
+				.checked_add(len)
+				.ok_or_else(|| ProtocolError::InvalidPayload("invalid binary payload length".into()))?;
+			if bytes.len() <= end {
+				return Ok(None);
+			}
+			if bytes[end] != b'\n' {
+				return Err(ProtocolError::TrailingData);
+			}
+			std::str::from_utf8(&bytes[..split])?;
+			return Ok(Some(Self {
+				header: (0, split),
+				body: FrameBody::Binary(start, end),
+				len: end + 1,
+			}));
+		}
 		let Some(second_rel) = bytes[first_nl + 1..].iter().position(|b| *b == b'\n') else {
-			return Ok(None);
+			return Self::incomplete(bytes.len() - first_nl - 1);
 		};
 		let second_nl = first_nl + 1 + second_rel;
-		let header_bytes = &bytes[..first_nl];
-		let payload_bytes = &bytes[first_nl + 1..second_nl];
-		let consumed = second_nl + 1;
-		let frame = Self::from_lines(header_bytes, payload_bytes, fds)?;
-		Ok(Some((frame, consumed)))
+		std::str::from_utf8(&bytes[..first_nl])?;
+		let payload = &bytes[first_nl + 1..second_nl];
+		let body = if payload == b"\0\0\0\0" {
+			FrameBody::Empty
+		} else {
+			std::str::from_utf8(payload)?;
+			FrameBody::Text(first_nl + 1, second_nl)
+		};
+		Ok(Some(Self {
+			header: (0, first_nl),
+			body,
+			len: second_nl + 1,
+		}))
 	}
-
-	fn from_lines(
-		header_bytes: &[u8],
-		payload_bytes: &[u8],
-		fds: Vec<RawFd>,
-	) -> Result<Self, ProtocolError> {
-		let header = String::from_utf8(header_bytes.to_vec())?;
-		let payload_str = String::from_utf8(payload_bytes.to_vec())?;
-		Ok(Self {
-			header: header.into(),
-			payload: if payload_str == "\0\0\0\0" {
-				None
-			} else {
-				Some(payload_str)
-			},
+	/// `Ok(None)` while an unterminated line of `len` bytes may still become a valid frame.
+	fn incomplete(len: usize) -> Result<Option<Self>, ProtocolError> {
+		if len > MAX_FRAME_PAYLOAD {
+			return Err(ProtocolError::InvalidPayload(format!(
+				"frame line exceeds {MAX_FRAME_PAYLOAD} bytes"
+			)));
+		}
+		Ok(None)
+	}
+	/// Builds the borrowed frame; `bytes` must be the slice this span was parsed from.
+	fn view(self, bytes: &[u8], fds: Vec<RawFd>) -> TabMessageFrameRef<'_> {
+		// Text ranges were validated as UTF-8 in `parse`.
+		let text =
+			|(start, end): (usize, usize)| unsafe { std::str::from_utf8_unchecked(&bytes[start..end]) };
+		let (payload, binary) = match self.body {
+			FrameBody::Empty => (None, None),
+			FrameBody::Text(start, end) => (Some(text((start, end))), None),
+			FrameBody::Binary(start, end) => (None, Some(&bytes[start..end])),
+		};
+		TabMessageFrameRef {
+			header: text(self.header),
+			payload,
+			binary,
 			fds,
+		}
+	}
+}
+
+impl TabMessageFrameRef<'_> {
+	/// Copies the header and payload out of the receive buffer.
+	pub fn into_owned(self) -> TabMessageFrame {
+		TabMessageFrame {
+			header: self.header.to_string().into(),
+			payload: self.payload.map(str::to_string),
+			binary: self.binary.map(<[u8]>::to_vec),
+			fds: self.fds,
+		}
+	}
+
+	#[tracing::instrument(skip_all)]
+	pub(crate) fn expect_payload_json<'a, T>(&'a self) -> Result<T, ProtocolError>
+	where
+		T: serde::Deserialize<'a>,
+	{
+		if let Some(payload) = self.payload {
+			let span = tracing::span!(tracing::Level::TRACE, "json_decode");
+			let _enter = span.enter();
+			serde_json::from_str(payload).map_err(ProtocolError::from)
+		} else {
+			Err(ProtocolError::ExpectedPayload)
+		}
+	}
+	/// `<monitor_id> <buffer_index>` arguments shared by the buffer messages, from either the raw
+	/// text payload or the binary layout.
+	pub(crate) fn expect_buffer_args(
+		&self,
+		name: &str,
+		kind: &str,
+	) -> Result<(String, BufferIndex), ProtocolError> {
+		if let Some(bytes) = self.binary {
+			return binary::decode_buffer_payload(bytes);
+		}
+		let payload = self.payload.ok_or(ProtocolError::ExpectedPayload)?;
+		let err = || {
+			ProtocolError::InvalidPayload(format!(
+				r#""{name}" {kind} requires 2 arguments: <monitor_id> <buffer index>"#
+			))
+		};
+		let mut split = payload.split_ascii_whitespace();
+		let (Some(monitor_id), Some(buffer_index_str), None) =
+			(split.next(), split.next(), split.next())
+		else {
+			return Err(err());
+		};
+		let buffer = buffer_index_str.parse().map_err(|_| err())?;
+		Ok((monitor_id.to_string(), buffer))
+	}
+
+	/// `buffer_request` arguments: the buffer arguments followed by optional `x,y,w,h` damage
+	/// rectangles in the text form, or the binary layout.
+	pub(crate) fn expect_buffer_request_args(&self) -> Result<BufferRequestPayload, ProtocolError> {
+		if let Some(bytes) = self.binary {
+			return binary::decode_buffer_request_payload(bytes);
+		}
+		let payload = self.payload.ok_or(ProtocolError::ExpectedPayload)?;
+		let err = || {
+			ProtocolError::InvalidPayload(
+				r#""buffer_request" request requires: <monitor_id> <buffer index> [<x>,<y>,<w>,<h> ...]"#
+					.into(),
+			)
+		};
+		let mut split = payload.split_ascii_whitespace();
+		let (Some(monitor_id), Some(buffer_index_str)) = (split.next(), split.next()) else {
+			return Err(err());
+		};
+		let buffer = buffer_index_str.parse().map_err(|_| err())?;
+		let mut damage = Vec::new();
+		for rect in split {
+			if damage.len() == MAX_DAMAGE_RECTS {
+				return Err(ProtocolError::InvalidPayload(format!(
+					"buffer_request carries more than {MAX_DAMAGE_RECTS} damage rectangles"
+				)));
+			}
+			let mut fields = rect.split(',').map(str::parse::<i32>);
+			let (Some(Ok(x)), Some(Ok(y)), Some(Ok(width)), Some(Ok(height)), None) = (
+				fields.next(),
+				fields.next(),
+				fields.next(),
+				fields.next(),
+				fields.next(),
+			) else {
+				return Err(err());
+			};
+			damage.push(
+				DamageRect {
+					x,
+					y,
+					width,
+					height,
+				}
+				.validate()?,
+			);
+		}
+		Ok(BufferRequestPayload {
+			monitor_id: monitor_id.to_string(),
+			buffer,
+			damage,
 		})
 	}
+
+	pub fn expect_n_fds(&self, amount: u32) -> Result<(), ProtocolError> {
+		let found = self.fds.len() as u32;
+		if found == amount {
+			Ok(())
+		} else {
+			Err(ProtocolError::ExpectedFds {
+				expected: amount,
+				found,
+			})
+		}
+	}
+
+	pub fn expect_fds_in_range(&self, min: u32, max: u32) -> Result<(), ProtocolError> {
+		let found = self.fds.len() as u32;
+		if (min..=max).contains(&found) {
+			Ok(())
+		} else {
+			Err(ProtocolError::ExpectedFdRange { min, max, found })
+		}
+	}
+}
+
+#[cfg(test)]
+mod tests {
+	use super::*;
+
+	#[test]
+	fn parses_binary_frames_once_complete() {
+		let frame = b"input 3\nabc\n";
+		assert!(FrameSpan::parse(&frame[..9]).unwrap().is_none());
+		let span = FrameSpan::parse(frame).unwrap().unwrap();
+		assert_eq!(span.len, frame.len());
+		let view = span.view(frame, Vec::new());
+		assert_eq!(view.header, "input");
+		assert_eq!(view.binary, Some(&b"abc"[..]));
+	}
+
+	#[test]
+	fn rejects_oversized_binary_lengths() {
+		let huge = format!("input {}\n", usize::MAX);
+		assert!(matches!(
+			FrameSpan::parse(huge.as_bytes()),
+			Err(ProtocolError::InvalidPayload(_))
+		));
+		// Valid as a number, but the reader must not wait for that many bytes.
+		let large = format!("input {}\n", MAX_FRAME_PAYLOAD + 1);
+		assert!(matches!(
+			FrameSpan::parse(large.as_bytes()),
+			Err(ProtocolError::InvalidPayload(_))
+		));
+	}
+
+	#[test]
+	fn rejects_unterminated_lines_past_the_limit() {
+		let mut bytes = b"auth\n".to_vec();
+		bytes.resize(bytes.len() + MAX_FRAME_PAYLOAD + 1, b'x');
+		assert!(matches!(
+			FrameSpan::parse(&bytes),
+			Err(ProtocolError::InvalidPayload(_))
+		));
+		assert!(matches!(
+			FrameSpan::parse(&vec![b'x'; MAX_FRAME_PAYLOAD + 1]),
+			Err(ProtocolError::InvalidPayload(_))
+		));
+	}
+
+	#[test]
+	fn rejects_overflowing_damage() {
+		let parse = |args: &str| {
+			TabMessageFrame::raw("buffer_request", args)
+				.as_frame_ref()
+				.expect_buffer_request_args()
+		};
+		let request = parse("DP-1 0 0,0,10,10").unwrap();
+		assert_eq!(request.damage.len(), 1);
+		for bad in [
+			"DP-1 0 2147483647,0,1,1",
+			"DP-1 0 0,2147483647,1,1",
+			"DP-1 0 0,0,-1,10",
+		] {
+			assert!(matches!(parse(bad), Err(ProtocolError::InvalidPayload(_))));
+		}
+	}
 }
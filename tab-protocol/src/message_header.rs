@@ -18,10 +18,15 @@ define_headers! {
 		AUTH_OK,
 		AUTH_ERROR,
 		FRAMEBUFFER_LINK,
+		FRAMEBUFFER_LINK_BATCH,
 		BUFFER_REQUEST,
 		BUFFER_REQUEST_ACK,
+		BUFFER_REQUEST_REJECTED,
 		BUFFER_RELEASE,
+		FRAME_PRESENTED,
 		INPUT_EVENT,
+		INPUT_BATCH,
+		INPUT_CAUGHT_UP,
 		MONITOR_ADDED,
 		MONITOR_REMOVED,
 		SESSION_SWITCH,
@@ -32,6 +37,10 @@ define_headers! {
 		SESSION_ACTIVE,
 		SESSION_AWAKE,
 		SESSION_SLEEP,
+		PRESENT_MODE,
+		GPU_MEMORY,
+		STATS_REQUEST,
+		STATS,
 		ERROR,
 		PING,
 		PONG,